@@ -0,0 +1,446 @@
+#include "batch_gcd.h"
+
+#include <openssl/bn.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef RSA_APP_HAVE_GMP
+#include <gmp.h>
+#endif
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "thread_pool.h"
+
+namespace rsa_app {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double SecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+#ifdef RSA_APP_HAVE_GMP
+
+// Arithmetic on GMP integers. GMP multiplies and divides in quasi-linear
+// time, which is what makes the upper tree levels affordable.
+struct GmpBackend {
+  static constexpr const char* kName = "gmp";
+
+  class Value {
+   public:
+    Value() { mpz_init(value_); }
+    ~Value() { mpz_clear(value_); }
+    Value(Value&& other) noexcept {
+      mpz_init(value_);
+      mpz_swap(value_, other.value_);
+    }
+    Value& operator=(Value&& other) noexcept {
+      mpz_swap(value_, other.value_);
+      return *this;
+    }
+    Value(const Value&) = delete;
+    Value& operator=(const Value&) = delete;
+
+    mpz_ptr get() { return value_; }
+    mpz_srcptr get() const { return value_; }
+
+   private:
+    mpz_t value_;
+  };
+
+  static void FromBigNumber(Value& out, const BigNumber& in) {
+    std::vector<unsigned char> bytes(static_cast<size_t>(BN_num_bytes(in.Get())));
+    BN_bn2lebinpad(in.Get(), bytes.data(), static_cast<int>(bytes.size()));
+    mpz_import(out.get(), bytes.size(), -1, 1, 0, 0, bytes.data());
+  }
+
+  static BigNumber ToBigNumber(const Value& in) {
+    std::vector<unsigned char> bytes((mpz_sizeinbase(in.get(), 2) + 7) / 8);
+    size_t written = 0;
+    mpz_export(bytes.data(), &written, -1, 1, 0, 0, in.get());
+    BIGNUM* value = BN_lebin2bn(bytes.data(), static_cast<int>(written), nullptr);
+    if (!value) throw std::runtime_error("BN_lebin2bn failed");
+    return BigNumber(value);
+  }
+
+  static void Copy(Value& out, const Value& a) { mpz_set(out.get(), a.get()); }
+  static void Multiply(Value& out, const Value& a, const Value& b) {
+    mpz_mul(out.get(), a.get(), b.get());
+  }
+  static void Square(Value& out, const Value& a) { mpz_mul(out.get(), a.get(), a.get()); }
+  static void Mod(Value& out, const Value& a, const Value& m) {
+    mpz_tdiv_r(out.get(), a.get(), m.get());
+  }
+  static void DivideExact(Value& out, const Value& a, const Value& b) {
+    mpz_divexact(out.get(), a.get(), b.get());
+  }
+  static void Gcd(Value& out, const Value& a, const Value& b) {
+    mpz_gcd(out.get(), a.get(), b.get());
+  }
+  static bool IsOne(const Value& a) { return mpz_cmp_ui(a.get(), 1) == 0; }
+  static bool Equal(const Value& a, const Value& b) { return mpz_cmp(a.get(), b.get()) == 0; }
+
+  // Serialized as whole limbs, least significant first.
+  static size_t Bytes(const Value& a) { return mpz_size(a.get()) * sizeof(mp_limb_t); }
+  static void Export(const Value& a, unsigned char* out) {
+    size_t written = 0;
+    mpz_export(out, &written, -1, sizeof(mp_limb_t), 0, 0, a.get());
+  }
+  static void Import(Value& out, const unsigned char* in, size_t bytes) {
+    mpz_import(out.get(), bytes / sizeof(mp_limb_t), -1, sizeof(mp_limb_t), 0, 0, in);
+  }
+};
+
+using Backend = GmpBackend;
+
+#else
+
+// Arithmetic on OpenSSL BIGNUMs: Karatsuba multiplication and schoolbook
+// division, so only practical for small batches.
+struct BnBackend {
+  static constexpr const char* kName = "openssl";
+
+  using Value = BigNumber;
+
+  static BN_CTX* Ctx() {
+    thread_local std::unique_ptr<BN_CTX, decltype(&BN_CTX_free)> ctx(BN_CTX_new(),
+                                                                      BN_CTX_free);
+    if (!ctx) throw std::runtime_error("BN_CTX_new failed");
+    return ctx.get();
+  }
+
+  static void Check(int ok) {
+    if (!ok) throw std::runtime_error("OpenSSL call failed during batch GCD");
+  }
+
+  static void FromBigNumber(Value& out, const BigNumber& in) { Copy(out, in); }
+  static BigNumber ToBigNumber(const Value& in) { return in.Copy(); }
+
+  static void Copy(Value& out, const Value& a) { Check(BN_copy(out.Get(), a.Get()) != nullptr); }
+  static void Multiply(Value& out, const Value& a, const Value& b) {
+    Check(BN_mul(out.Get(), a.Get(), b.Get(), Ctx()));
+  }
+  static void Square(Value& out, const Value& a) { Check(BN_sqr(out.Get(), a.Get(), Ctx())); }
+  static void Mod(Value& out, const Value& a, const Value& m) {
+    Check(BN_div(nullptr, out.Get(), a.Get(), m.Get(), Ctx()));
+  }
+  static void DivideExact(Value& out, const Value& a, const Value& b) {
+    Check(BN_div(out.Get(), nullptr, a.Get(), b.Get(), Ctx()));
+  }
+  static void Gcd(Value& out, const Value& a, const Value& b) {
+    Check(BN_gcd(out.Get(), a.Get(), b.Get(), Ctx()));
+  }
+  static bool IsOne(const Value& a) { return BN_is_one(a.Get()); }
+  static bool Equal(const Value& a, const Value& b) { return BN_cmp(a.Get(), b.Get()) == 0; }
+
+  static size_t Bytes(const Value& a) { return static_cast<size_t>(BN_num_bytes(a.Get())); }
+  static void Export(const Value& a, unsigned char* out) {
+    BN_bn2lebinpad(a.Get(), out, static_cast<int>(Bytes(a)));
+  }
+  static void Import(Value& out, const unsigned char* in, size_t bytes) {
+    Check(BN_lebin2bn(in, static_cast<int>(bytes), out.Get()) != nullptr);
+  }
+};
+
+using Backend = BnBackend;
+
+#endif
+
+using Value = Backend::Value;
+
+constexpr size_t kSpillChunkBytes = size_t{1} << 20;
+
+// One product tree level, either in RAM or in a read-only file mapping.
+class Level {
+ public:
+  explicit Level(size_t count) : values_(count) {}
+  ~Level() { Unmap(); }
+
+  Level(const Level&) = delete;
+  Level& operator=(const Level&) = delete;
+
+  size_t Size() const { return spilled_ ? offsets_.size() - 1 : values_.size(); }
+  bool Spilled() const { return spilled_; }
+
+  // Only valid while the level is resident.
+  Value& operator[](size_t i) { return values_[i]; }
+
+  // Returns value `i`, decoding it into `scratch` if the level is spilled.
+  const Value& Get(size_t i, Value& scratch) const {
+    if (!spilled_) return values_[i];
+    Backend::Import(scratch, map_ + offsets_[i], offsets_[i + 1] - offsets_[i]);
+    return scratch;
+  }
+
+  uint64_t ResidentBytes() const {
+    if (spilled_) return 0;
+    uint64_t bytes = 0;
+    for (const Value& value : values_) bytes += Backend::Bytes(value);
+    return bytes;
+  }
+
+  // Writes the level to an unlinked file in `directory`, maps it and frees
+  // the in-memory values. Returns the bytes written, or 0 if this platform
+  // cannot spill.
+  uint64_t Spill(const std::string& directory) {
+#ifndef _WIN32
+    std::string path = directory + "/rsa_app_batch_gcd_XXXXXX";
+    int fd = mkstemp(path.data());
+    if (fd < 0) throw std::runtime_error("Cannot create spill file in " + directory);
+    unlink(path.c_str());
+
+    std::vector<uint64_t> offsets(values_.size() + 1, 0);
+    std::vector<unsigned char> buffer;
+    auto flush = [&] {
+      for (size_t done = 0; done < buffer.size();) {
+        ssize_t written = write(fd, buffer.data() + done, buffer.size() - done);
+        if (written <= 0) {
+          close(fd);
+          throw std::runtime_error("Writing spill file failed");
+        }
+        done += static_cast<size_t>(written);
+      }
+      buffer.clear();
+    };
+    for (size_t i = 0; i < values_.size(); ++i) {
+      size_t bytes = Backend::Bytes(values_[i]);
+      offsets[i + 1] = offsets[i] + bytes;
+      size_t used = buffer.size();
+      buffer.resize(used + bytes);
+      if (bytes) Backend::Export(values_[i], buffer.data() + used);
+      if (buffer.size() >= kSpillChunkBytes) flush();
+    }
+    flush();
+    uint64_t total = offsets.back();
+    if (total > 0) {
+      void* map = mmap(nullptr, total, PROT_READ, MAP_SHARED, fd, 0);
+      if (map == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("Mapping spill file failed");
+      }
+      map_ = static_cast<const unsigned char*>(map);
+    }
+    close(fd);
+    map_bytes_ = total;
+    offsets_ = std::move(offsets);
+    std::vector<Value>().swap(values_);
+    spilled_ = true;
+    return total;
+#else
+    (void)directory;
+    return 0;
+#endif
+  }
+
+  // Frees the level.
+  void Clear() {
+    std::vector<Value>().swap(values_);
+    Unmap();
+    offsets_.assign(1, 0);
+  }
+
+ private:
+  void Unmap() {
+#ifndef _WIN32
+    if (map_) munmap(const_cast<unsigned char*>(map_), map_bytes_);
+#endif
+    map_ = nullptr;
+    map_bytes_ = 0;
+  }
+
+  std::vector<Value> values_;
+  bool spilled_ = false;
+  const unsigned char* map_ = nullptr;
+  uint64_t map_bytes_ = 0;
+  std::vector<uint64_t> offsets_;
+};
+
+std::string SpillDirectory(const BatchGcdOptions& options) {
+  if (!options.spill_directory.empty()) return options.spill_directory;
+  const char* tmp = std::getenv("TMPDIR");
+  return tmp && *tmp ? tmp : "/tmp";
+}
+
+// Spills the lowest resident levels below `keep` until the resident part of
+// the tree fits `options.memory_limit`.
+void EnforceMemoryLimit(std::vector<std::unique_ptr<Level>>& tree, size_t keep,
+                        const BatchGcdOptions& options, BatchGcdStats& stats) {
+  std::vector<uint64_t> resident(tree.size());
+  uint64_t total = 0;
+  for (size_t k = 0; k < tree.size(); ++k) {
+    resident[k] = tree[k]->ResidentBytes();
+    total += resident[k];
+  }
+  stats.peak_resident_bytes = std::max(stats.peak_resident_bytes, total);
+  if (options.memory_limit == 0) return;
+  for (size_t k = 0; k < keep && total > options.memory_limit; ++k) {
+    if (tree[k]->Spilled()) continue;
+    uint64_t written = tree[k]->Spill(SpillDirectory(options));
+    if (written == 0 && !tree[k]->Spilled()) return;
+    total -= resident[k];
+    ++stats.spilled_levels;
+    stats.spilled_bytes += written;
+  }
+}
+
+// Builds the product tree bottom-up; level 0 holds the moduli and the last
+// level their product. An odd node at the end of a level is carried up.
+std::vector<std::unique_ptr<Level>> BuildProductTree(const std::vector<BigNumber>& moduli,
+                                                     ThreadPool& pool,
+                                                     const BatchGcdOptions& options,
+                                                     BatchGcdStats& stats) {
+  std::vector<std::unique_ptr<Level>> tree;
+  tree.push_back(std::make_unique<Level>(moduli.size()));
+  Level& leaves = *tree.back();
+  pool.ParallelFor(moduli.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) Backend::FromBigNumber(leaves[i], moduli[i]);
+  });
+  EnforceMemoryLimit(tree, 0, options, stats);
+
+  while (tree.back()->Size() > 1) {
+    const Level& below = *tree.back();
+    size_t count = (below.Size() + 1) / 2;
+    auto level = std::make_unique<Level>(count);
+    Level& above = *level;
+    pool.ParallelFor(count, [&](size_t begin, size_t end) {
+      Value left, right;
+      for (size_t i = begin; i < end; ++i) {
+        const Value& a = below.Get(2 * i, left);
+        if (2 * i + 1 < below.Size()) {
+          Backend::Multiply(above[i], a, below.Get(2 * i + 1, right));
+        } else {
+          Backend::Copy(above[i], a);
+        }
+      }
+    });
+    tree.push_back(std::move(level));
+    // The newest level feeds the next multiplication; keep it in RAM.
+    EnforceMemoryLimit(tree, tree.size() - 1, options, stats);
+  }
+  return tree;
+}
+
+// Descends the remainder tree: node i of level k becomes the parent's
+// remainder modulo (P_k[i])^2. Consumed product levels are freed on the way.
+std::vector<Value> DescendRemainderTree(std::vector<std::unique_ptr<Level>>& tree,
+                                        ThreadPool& pool) {
+  std::vector<Value> remainders(1);
+  Value scratch;
+  Backend::Copy(remainders[0], tree.back()->Get(0, scratch));
+  if (tree.size() > 1) tree.back()->Clear();
+  for (size_t k = tree.size() - 1; k-- > 0;) {
+    const Level& level = *tree[k];
+    std::vector<Value> next(level.Size());
+    pool.ParallelFor(level.Size(), [&](size_t begin, size_t end) {
+      Value node, square;
+      for (size_t i = begin; i < end; ++i) {
+        Backend::Square(square, level.Get(i, node));
+        Backend::Mod(next[i], remainders[i / 2], square);
+      }
+    });
+    remainders = std::move(next);
+    if (k > 0) tree[k]->Clear();
+  }
+  return remainders;
+}
+
+}  // namespace
+
+const char* BatchGcdBackendName() { return Backend::kName; }
+
+std::vector<WeakKey> FindSharedFactors(const std::vector<BigNumber>& moduli,
+                                       const BatchGcdOptions& options,
+                                       BatchGcdStats* stats) {
+  for (const BigNumber& modulus : moduli) {
+    if (BN_is_zero(modulus.Get()) || BN_is_negative(modulus.Get())) {
+      throw std::invalid_argument("Batch GCD moduli must be positive");
+    }
+  }
+  BatchGcdStats local;
+  local.moduli = moduli.size();
+  std::vector<WeakKey> weak;
+  if (moduli.empty()) {
+    if (stats) *stats = local;
+    return weak;
+  }
+
+  ThreadPool pool(options.threads);
+  auto start = Clock::now();
+  std::vector<std::unique_ptr<Level>> tree = BuildProductTree(moduli, pool, options, local);
+  local.levels = tree.size();
+  local.product_seconds = SecondsSince(start);
+
+  start = Clock::now();
+  std::vector<Value> remainders = DescendRemainderTree(tree, pool);
+  local.remainder_seconds = SecondsSince(start);
+
+  // g_i = gcd((P mod n_i^2) / n_i, n_i) is gcd(n_i, P / n_i).
+  start = Clock::now();
+  const Level& leaves = *tree[0];
+  std::vector<Value> factors(moduli.size());
+  pool.ParallelFor(moduli.size(), [&](size_t begin, size_t end) {
+    Value node, quotient;
+    for (size_t i = begin; i < end; ++i) {
+      const Value& n = leaves.Get(i, node);
+      Backend::DivideExact(quotient, remainders[i], n);
+      Backend::Gcd(factors[i], quotient, n);
+    }
+  });
+  tree.clear();
+  std::vector<Value>().swap(remainders);
+
+  std::vector<size_t> offenders;
+  for (size_t i = 0; i < factors.size(); ++i) {
+    if (!Backend::IsOne(factors[i])) offenders.push_back(i);
+  }
+
+  // Two weak moduli share a prime exactly when their factors do.
+  std::vector<std::vector<size_t>> partners(offenders.size());
+  if (offenders.size() <= options.max_partner_search) {
+    pool.ParallelFor(offenders.size(), [&](size_t begin, size_t end) {
+      Value common;
+      for (size_t a = begin; a < end; ++a) {
+        const Value& fa = factors[offenders[a]];
+        for (size_t b = 0; b < offenders.size(); ++b) {
+          if (a == b) continue;
+          const Value& fb = factors[offenders[b]];
+          bool shared = Backend::Equal(fa, fb);
+          if (!shared) {
+            Backend::Gcd(common, fa, fb);
+            shared = !Backend::IsOne(common);
+          }
+          if (shared) partners[a].push_back(offenders[b]);
+        }
+      }
+    });
+  }
+
+  weak.reserve(offenders.size());
+  for (size_t a = 0; a < offenders.size(); ++a) {
+    WeakKey key;
+    key.index = offenders[a];
+    key.factor = Backend::ToBigNumber(factors[offenders[a]]);
+    key.shared_with = std::move(partners[a]);
+    weak.push_back(std::move(key));
+  }
+  local.gcd_seconds = SecondsSince(start);
+  if (stats) *stats = local;
+  return weak;
+}
+
+}  // namespace rsa_app
@@ -0,0 +1,83 @@
+#ifndef RSA_APP_BATCH_GCD_H_
+#define RSA_APP_BATCH_GCD_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bn_wrapper.h"
+
+namespace rsa_app {
+
+/**
+ * Configuration of `FindSharedFactors`.
+ */
+struct BatchGcdOptions {
+  size_t threads = 0;           // Workers; 0 selects ThreadPool::DefaultThreadCount().
+  uint64_t memory_limit = 0;    // Product tree bytes kept in RAM; 0 = no limit.
+  std::string spill_directory;  // Where spilled levels go; empty = system temp.
+  size_t max_partner_search = 4096;  // Largest offender set matched pairwise.
+};
+
+/**
+ * Work done by one `FindSharedFactors` call.
+ */
+struct BatchGcdStats {
+  size_t moduli = 0;               // Input moduli.
+  size_t levels = 0;               // Product tree levels, leaves and root included.
+  double product_seconds = 0.0;    // Building the product tree.
+  double remainder_seconds = 0.0;  // Descending the remainder tree.
+  double gcd_seconds = 0.0;        // Final gcds and partner matching.
+  size_t spilled_levels = 0;       // Levels moved to memory-mapped files.
+  uint64_t spilled_bytes = 0;      // Bytes written to those files.
+  uint64_t peak_resident_bytes = 0;  // Largest product tree size held in RAM.
+};
+
+/**
+ * A modulus that shares a factor with at least one other input.
+ */
+struct WeakKey {
+  size_t index = 0;                 // Position in the input.
+  BigNumber factor;                 // gcd(n, product of all other moduli).
+  std::vector<size_t> shared_with;  // Inputs it shares a factor with.
+};
+
+/**
+ * Returns the arithmetic library used by `FindSharedFactors` ("gmp" when
+ * built with GMP, "openssl" otherwise).
+ *
+ * OpenSSL has no subquadratic division, so without GMP the remainder tree
+ * is quadratic in the size of its upper levels and only suits small inputs.
+ */
+const char* BatchGcdBackendName();
+
+/**
+ * Finds moduli that share a prime factor with another modulus.
+ *
+ * Uses Bernstein's batch GCD: a product tree multiplies the moduli in pairs
+ * up to their product P, a remainder tree reduces P modulo the square of
+ * every node on the way back down, and modulus n_i is weak if
+ * gcd((P mod n_i^2) / n_i, n_i) > 1. Both trees are built level by level with
+ * the nodes of a level split across threads. Whenever the product tree
+ * exceeds `memory_limit`, its lowest resident levels are written to
+ * unlinked files in `spill_directory` and read back through `mmap`.
+ *
+ * Partners are found by pairwise gcds among the weak keys when there are at
+ * most `max_partner_search` of them; otherwise `shared_with` stays empty.
+ * A modulus listed twice is reported with `factor == n`.
+ *
+ * @param moduli Positive moduli.
+ * @param options Threads, memory limit and spill directory.
+ * @param stats Optional; receives timings and spill counters.
+ * @return The weak keys in input order.
+ * @throws std::invalid_argument If a modulus is not positive.
+ * @throws std::runtime_error If arithmetic or spilling fails.
+ */
+std::vector<WeakKey> FindSharedFactors(const std::vector<BigNumber>& moduli,
+                                       const BatchGcdOptions& options = {},
+                                       BatchGcdStats* stats = nullptr);
+
+}  // namespace rsa_app
+
+#endif  // RSA_APP_BATCH_GCD_H_
@@ -0,0 +1,158 @@
+#include <openssl/bn.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "batch_gcd.h"
+#include "thread_pool.h"
+
+namespace {
+
+// Hands out the primes of [2^31, 2^32) in increasing order using a segmented
+// sieve, so moduli built from them are pairwise coprime by construction.
+class PrimeStream {
+  public:
+    PrimeStream() {
+        std::vector<bool> composite(kBaseLimit, false);
+        for (uint32_t p = 2; p < kBaseLimit; ++p) {
+            if (composite[p]) continue;
+            base_.push_back(p);
+            for (uint32_t m = p * p; m < kBaseLimit; m += p) composite[m] = true;
+        }
+    }
+
+    uint32_t Next() {
+        while (position_ == segment_.size()) Sieve();
+        return segment_[position_++];
+    }
+
+  private:
+    static constexpr uint32_t kBaseLimit = 1u << 16;
+    static constexpr uint64_t kSegment = 1u << 20;
+
+    void Sieve() {
+        std::vector<bool> composite(kSegment, false);
+        for (uint64_t p : base_) {
+            uint64_t first = (low_ + p - 1) / p * p;
+            for (uint64_t m = first; m < low_ + kSegment; m += p) composite[m - low_] = true;
+        }
+        segment_.clear();
+        position_ = 0;
+        for (uint64_t i = 0; i < kSegment && low_ + i < (uint64_t{1} << 32); ++i) {
+            if (!composite[i]) segment_.push_back(static_cast<uint32_t>(low_ + i));
+        }
+        low_ += kSegment;
+        if (low_ >= (uint64_t{1} << 32) && segment_.empty()) {
+            throw std::runtime_error("Ran out of 32-bit primes");
+        }
+    }
+
+    std::vector<uint32_t> base_;
+    std::vector<uint32_t> segment_;
+    size_t position_ = 0;
+    uint64_t low_ = uint64_t{1} << 31;
+};
+
+// Builds `count` moduli of `bits` bits from distinct 32-bit primes. Every
+// `plant_every`-th modulus gives its first prime to the next one as well;
+// the indices of both are added to `planted`.
+std::vector<BigNumber> MakeModuli(size_t count, int bits, size_t plant_every,
+                                  std::set<size_t>& planted) {
+    PrimeStream primes;
+    std::vector<BigNumber> moduli(count);
+    uint32_t shared = 0;
+    for (size_t i = 0; i < count; ++i) {
+        BIGNUM* n = moduli[i].Get();
+        BN_one(n);
+        for (int k = 0; k < bits / 32; ++k) {
+            uint32_t p = primes.Next();
+            if (k == 0 && shared != 0) p = shared;
+            BN_mul_word(n, p);
+            if (k == 0) shared = 0;
+            if (k == 0 && plant_every != 0 && i % plant_every == 0 && i + 1 < count) {
+                shared = p;
+                planted.insert(i);
+                planted.insert(i + 1);
+            }
+        }
+    }
+    return moduli;
+}
+
+std::vector<size_t> ParseCounts(const std::string& list) {
+    std::vector<size_t> counts;
+    std::stringstream in(list);
+    std::string item;
+    while (std::getline(in, item, ',')) counts.push_back(std::stoul(item));
+    return counts;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::vector<size_t> counts = {100000, 1000000};
+    int bits = 1024;
+    size_t plant_every = 10000;
+    rsa_app::BatchGcdOptions options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        std::string value = argv[i + 1];
+        if (flag == "--counts") {
+            counts = ParseCounts(value);
+        } else if (flag == "--bits") {
+            bits = std::stoi(value);
+        } else if (flag == "--plant-every") {
+            plant_every = std::stoul(value);
+        } else if (flag == "--threads") {
+            options.threads = std::stoul(value);
+        } else if (flag == "--memory-mb") {
+            options.memory_limit = static_cast<uint64_t>(std::stoul(value)) << 20;
+        } else if (flag == "--spill-dir") {
+            options.spill_directory = value;
+        } else {
+            std::cerr << "Unknown option " << flag
+                      << " (supported: --counts a,b,c, --bits N, --plant-every N, --threads N,"
+                         " --memory-mb N, --spill-dir DIR)\n";
+            return 2;
+        }
+    }
+    size_t threads = options.threads ? options.threads : rsa_app::ThreadPool::DefaultThreadCount();
+
+    std::cout << "Batch GCD, " << bits << "-bit moduli, backend "
+              << rsa_app::BatchGcdBackendName() << ", " << threads << " threads, memory limit "
+              << (options.memory_limit ? std::to_string(options.memory_limit >> 20) + " MiB"
+                                       : std::string("none"))
+              << "\n";
+    std::cout << std::setw(10) << "moduli" << std::setw(10) << "product" << std::setw(11)
+              << "remainder" << std::setw(8) << "gcd" << std::setw(9) << "total" << std::setw(12)
+              << "keys/s" << std::setw(9) << "spilled" << std::setw(11) << "spill MiB"
+              << std::setw(11) << "peak MiB" << std::setw(10) << "found\n";
+    for (size_t count : counts) {
+        std::set<size_t> planted;
+        std::vector<BigNumber> moduli = MakeModuli(count, bits, plant_every, planted);
+        rsa_app::BatchGcdStats stats;
+        auto start = std::chrono::steady_clock::now();
+        std::vector<rsa_app::WeakKey> weak = rsa_app::FindSharedFactors(moduli, options, &stats);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::set<size_t> found;
+        for (const auto& key : weak) found.insert(key.index);
+        std::cout << std::setw(10) << count << std::fixed << std::setprecision(2)
+                  << std::setw(10) << stats.product_seconds << std::setw(11)
+                  << stats.remainder_seconds << std::setw(8) << stats.gcd_seconds << std::setw(9)
+                  << elapsed.count() << std::setw(12) << std::setprecision(0)
+                  << static_cast<double>(count) / elapsed.count() << std::setw(9)
+                  << stats.spilled_levels << std::setw(11)
+                  << static_cast<double>(stats.spilled_bytes) / (1 << 20) << std::setw(11)
+                  << static_cast<double>(stats.peak_resident_bytes) / (1 << 20) << std::setw(6)
+                  << found.size() << "/" << planted.size()
+                  << (found == planted ? "" : " MISMATCH") << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include "batch_gcd.h"
+#include "rsa.h"
+#include <openssl/bn.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * Parsed command-line options.
+ */
+struct Options {
+    std::vector<std::string> key_files;
+    std::vector<std::string> lists;
+    rsa_app::BatchGcdOptions gcd;
+};
+
+void PrintUsage(std::ostream& out) {
+    out << "Usage:\n"
+           "  batch_gcd [options] [KEYFILE...]\n"
+           "\n"
+           "Reports moduli that share a prime factor with another modulus.\n"
+           "\n"
+           "Options:\n"
+           "  --list FILE       Moduli, one per line as 'ID HEX' or just 'HEX' (the id\n"
+           "                    is then the line number); '-' reads stdin\n"
+           "  --threads N       Worker threads (default: all cores)\n"
+           "  --memory-mb N     Product tree megabytes kept in RAM before levels are\n"
+           "                    spilled to memory-mapped files (default: no limit)\n"
+           "  --spill-dir DIR   Directory for spilled levels (default: $TMPDIR or /tmp)\n"
+           "\n"
+           "KEYFILE is a public or private key written by rsa_program; its id is the path.\n"
+           "Exit status: 0 if no weak keys were found, 1 if some were, 2 on errors.\n";
+}
+
+size_t ParseCount(const std::string& flag, const std::string& value) {
+    size_t parsed = 0;
+    try {
+        parsed = std::stoul(value);
+    } catch (const std::exception&) {
+        throw std::invalid_argument(flag + " expects a number, got '" + value + "'");
+    }
+    if (parsed == 0) throw std::invalid_argument(flag + " must be positive");
+    return parsed;
+}
+
+Options ParseOptions(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string flag = argv[i];
+        if (flag.rfind("--", 0) != 0) {
+            options.key_files.push_back(flag);
+            continue;
+        }
+        if (i + 1 >= argc) throw std::invalid_argument("Missing value for " + flag);
+        std::string value = argv[++i];
+        if (flag == "--list") {
+            options.lists.push_back(value);
+        } else if (flag == "--threads") {
+            options.gcd.threads = ParseCount(flag, value);
+        } else if (flag == "--memory-mb") {
+            options.gcd.memory_limit = static_cast<uint64_t>(ParseCount(flag, value)) << 20;
+        } else if (flag == "--spill-dir") {
+            options.gcd.spill_directory = value;
+        } else {
+            throw std::invalid_argument("Unknown option " + flag);
+        }
+    }
+    if (options.key_files.empty() && options.lists.empty()) {
+        throw std::invalid_argument("No moduli given");
+    }
+    return options;
+}
+
+BigNumber ParseHex(const std::string& hex, const std::string& where) {
+    BIGNUM* value = nullptr;
+    if (hex.empty() || BN_hex2bn(&value, hex.c_str()) != static_cast<int>(hex.size())) {
+        BN_free(value);
+        throw std::invalid_argument(where + ": invalid hexadecimal modulus");
+    }
+    return BigNumber(value);
+}
+
+// Appends the moduli listed in `in`; blank lines and '#' comments are skipped.
+void ReadList(std::istream& in, const std::string& name, std::vector<std::string>& ids,
+              std::vector<BigNumber>& moduli) {
+    std::string line;
+    for (size_t number = 1; std::getline(in, line); ++number) {
+        std::istringstream fields(line);
+        std::string first, second;
+        if (!(fields >> first) || first[0] == '#') continue;
+        std::string where = name + ":" + std::to_string(number);
+        if (fields >> second) {
+            ids.push_back(first);
+            moduli.push_back(ParseHex(second, where));
+        } else {
+            ids.push_back(where);
+            moduli.push_back(ParseHex(first, where));
+        }
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    try {
+        options = ParseOptions(argc, argv);
+    } catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << "\n";
+        PrintUsage(std::cerr);
+        return 2;
+    }
+
+    try {
+        std::vector<std::string> ids;
+        std::vector<BigNumber> moduli;
+        for (const auto& path : options.key_files) {
+            ids.push_back(path);
+            moduli.push_back(std::move(rsa_app::LoadPublicKey(path).n));
+        }
+        for (const auto& list : options.lists) {
+            if (list == "-") {
+                ReadList(std::cin, "stdin", ids, moduli);
+            } else {
+                std::ifstream in(list);
+                if (!in) throw std::runtime_error("Cannot open " + list);
+                ReadList(in, list, ids, moduli);
+            }
+        }
+
+        rsa_app::BatchGcdStats stats;
+        std::vector<rsa_app::WeakKey> weak = rsa_app::FindSharedFactors(moduli, options.gcd, &stats);
+        for (const auto& key : weak) {
+            char* factor = BN_bn2hex(key.factor.Get());
+            std::cout << ids[key.index] << " factor " << (factor ? factor : "?");
+            OPENSSL_free(factor);
+            if (!key.shared_with.empty()) {
+                std::cout << " shared_with";
+                for (size_t other : key.shared_with) std::cout << " " << ids[other];
+            }
+            std::cout << "\n";
+        }
+        std::cerr << "batch_gcd: " << stats.moduli << " moduli, " << weak.size()
+                  << " weak, backend " << rsa_app::BatchGcdBackendName() << ", product "
+                  << stats.product_seconds << " s, remainder " << stats.remainder_seconds
+                  << " s, gcd " << stats.gcd_seconds << " s, " << stats.spilled_levels
+                  << " levels spilled (" << stats.spilled_bytes << " bytes)\n";
+        return weak.empty() ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::cerr << "An error occurred: " << e.what() << "\n";
+        return 2;
+    }
+}
@@ -0,0 +1,188 @@
+#include "block_codec.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace rsa_app {
+
+namespace {
+
+constexpr size_t kMaxPayload = 0xffff;
+
+// Bytes of the block integer: the longest string below any modulus of
+// `modulus_bits` bits.
+size_t BlockBytes(int modulus_bits) {
+  return modulus_bits > 0 ? static_cast<size_t>(modulus_bits - 1) / 8 : 0;
+}
+
+// Packs `payload` into blocks of `capacity` bytes, all carrying `flags`. If
+// `final` is set the last block is marked final, and an empty payload still
+// gives one block; otherwise only full blocks are packed.
+std::vector<BigNumber> PackPayload(const std::string& payload, size_t capacity, uint8_t flags,
+                                   bool final) {
+  size_t count = final ? (payload.empty() ? 1 : (payload.size() + capacity - 1) / capacity)
+                       : payload.size() / capacity;
+  std::vector<BigNumber> blocks;
+  blocks.reserve(count);
+  std::string block;
+  for (size_t i = 0; i < count; ++i) {
+    size_t offset = i * capacity;
+    size_t length = std::min(capacity, payload.size() - offset);
+    // Padding after the payload keeps the block width fixed.
+    block.assign(kBlockHeaderBytes + capacity, '\0');
+    block[0] = static_cast<char>(flags | (final && i + 1 == count ? kBlockFinal : 0));
+    block[1] = static_cast<char>(length >> 8);
+    block[2] = static_cast<char>(length & 0xff);
+    block.replace(kBlockHeaderBytes, length, payload, offset, length);
+    blocks.push_back(BigNumber::FromBytes(block));
+  }
+  return blocks;
+}
+
+// Checks one block, appends its payload to `data` and returns its flags.
+uint8_t ReadBlock(const BigNumber& value, size_t capacity, std::string& data) {
+  size_t width = kBlockHeaderBytes + capacity;
+  if (value.NumBits() > static_cast<int>(8 * width)) {
+    throw std::invalid_argument("Block is too large for the key size");
+  }
+  std::string block = value.ToBytes(width);
+  auto flags = static_cast<uint8_t>(block[0]);
+  size_t length = static_cast<size_t>(static_cast<uint8_t>(block[1])) << 8 |
+                  static_cast<uint8_t>(block[2]);
+  if ((flags & ~(kBlockFinal | kBlockCompressed)) != 0 || length > capacity) {
+    throw std::invalid_argument("Malformed block header");
+  }
+  if (block.find_first_not_of('\0', kBlockHeaderBytes + length) != std::string::npos) {
+    throw std::invalid_argument("Malformed block padding");
+  }
+  data.append(block, kBlockHeaderBytes, length);
+  return flags;
+}
+
+}  // namespace
+
+size_t BlockCapacity(int modulus_bits) {
+  size_t bytes = BlockBytes(modulus_bits);
+  if (bytes <= kBlockHeaderBytes) {
+    throw std::invalid_argument("Modulus too small for the block format");
+  }
+  size_t capacity = bytes - kBlockHeaderBytes;
+  if (capacity > kMaxPayload) {
+    throw std::invalid_argument("Modulus too large for the block length field");
+  }
+  return capacity;
+}
+
+size_t BlockCapacity(const PublicKey& key) { return BlockCapacity(key.n.NumBits()); }
+
+size_t BlockCount(size_t length, int modulus_bits) {
+  size_t capacity = BlockCapacity(modulus_bits);
+  return length == 0 ? 1 : (length + capacity - 1) / capacity;
+}
+
+std::vector<BigNumber> PackBlocks(const std::string& data, int modulus_bits,
+                                  BlockCompression compression) {
+  size_t capacity = BlockCapacity(modulus_bits);
+  if (compression == BlockCompression::kAuto) {
+    std::string compressed = LzCompress(data);
+    if (BlockCount(compressed.size(), modulus_bits) < BlockCount(data.size(), modulus_bits)) {
+      return PackPayload(compressed, capacity, kBlockCompressed, true);
+    }
+  }
+  return PackPayload(data, capacity, 0, true);
+}
+
+std::string UnpackBlocks(const std::vector<BigNumber>& blocks, int modulus_bits) {
+  size_t capacity = BlockCapacity(modulus_bits);
+  if (blocks.empty()) throw std::invalid_argument("No blocks to unpack");
+  std::string data;
+  data.reserve(blocks.size() * capacity);
+  uint8_t first_flags = 0;
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    uint8_t flags = ReadBlock(blocks[i], capacity, data);
+    if (i == 0) first_flags = flags;
+    if ((flags & kBlockCompressed) != (first_flags & kBlockCompressed)) {
+      throw std::invalid_argument("Blocks disagree on compression");
+    }
+    if (((flags & kBlockFinal) != 0) != (i + 1 == blocks.size())) {
+      throw std::invalid_argument("Malformed block header");
+    }
+  }
+  return (first_flags & kBlockCompressed) != 0 ? LzDecompress(data) : data;
+}
+
+std::vector<BigNumber> EncryptMessage(const std::string& data, const PublicKey& public_key,
+                                      ThreadPool& pool, BlockCompression compression) {
+  return EncryptBatch(PackBlocks(data, public_key.n.NumBits(), compression), public_key, pool);
+}
+
+std::string DecryptMessage(const std::vector<BigNumber>& ciphertexts,
+                           const PrivateKey& private_key, ThreadPool& pool) {
+  return UnpackBlocks(DecryptBatch(ciphertexts, private_key, pool), private_key.n.NumBits());
+}
+
+BlockStreamEncryptor::BlockStreamEncryptor(const PublicKey& public_key, ThreadPool& pool,
+                                           BlockCompression compression)
+    : public_key_(public_key),
+      pool_(pool),
+      compression_(compression),
+      capacity_(BlockCapacity(public_key)) {}
+
+std::vector<BigNumber> BlockStreamEncryptor::Update(const std::string& data) {
+  pending_ += compression_ == BlockCompression::kAuto ? compressor_.Update(data) : data;
+  return Flush(false);
+}
+
+std::vector<BigNumber> BlockStreamEncryptor::Finish() {
+  if (compression_ == BlockCompression::kAuto) pending_ += compressor_.Finish();
+  return Flush(true);
+}
+
+std::vector<BigNumber> BlockStreamEncryptor::Flush(bool final) {
+  uint8_t flags = compression_ == BlockCompression::kAuto ? kBlockCompressed : 0;
+  std::vector<BigNumber> blocks;
+  if (final) {
+    blocks = PackPayload(pending_, capacity_, flags, true);
+    pending_.clear();
+  } else if (pending_.size() > capacity_) {
+    // A full block that ends the buffer may still be the last one.
+    std::string ready = pending_.substr(0, (pending_.size() - 1) / capacity_ * capacity_);
+    pending_.erase(0, ready.size());
+    blocks = PackPayload(ready, capacity_, flags, false);
+  }
+  if (blocks.empty()) return blocks;
+  return EncryptBatch(blocks, public_key_, pool_);
+}
+
+BlockStreamDecryptor::BlockStreamDecryptor(const PrivateKey& private_key, ThreadPool& pool)
+    : private_key_(private_key), pool_(pool) {}
+
+std::string BlockStreamDecryptor::Update(const std::vector<BigNumber>& ciphertexts) {
+  size_t capacity = BlockCapacity(private_key_.n.NumBits());
+  std::string data;
+  for (const auto& block : DecryptBatch(ciphertexts, private_key_, pool_)) {
+    if (finished_) throw std::invalid_argument("Block after the final block");
+    std::string payload;
+    uint8_t flags = ReadBlock(block, capacity, payload);
+    bool compressed = (flags & kBlockCompressed) != 0;
+    if (blocks_++ == 0) compressed_ = compressed;
+    if (compressed != compressed_) throw std::invalid_argument("Blocks disagree on compression");
+    finished_ = (flags & kBlockFinal) != 0;
+    data += compressed_ ? decompressor_.Update(payload) : payload;
+  }
+  return data;
+}
+
+void BlockStreamDecryptor::Finish() {
+  bool finished = finished_;
+  bool compressed = compressed_;
+  blocks_ = 0;
+  compressed_ = finished_ = false;
+  if (!finished) {
+    decompressor_ = LzStreamDecompressor();
+    throw std::invalid_argument("Message ends before the final block");
+  }
+  if (compressed) decompressor_.Finish();
+}
+
+}  // namespace rsa_app
@@ -0,0 +1,211 @@
+#ifndef RSA_APP_BLOCK_CODEC_H_
+#define RSA_APP_BLOCK_CODEC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "lz.h"
+#include "rsa.h"
+#include "thread_pool.h"
+
+namespace rsa_app {
+
+/**
+ * Bytes of framing at the start of every block: one flags byte followed by
+ * the payload length as a 16-bit big-endian integer.
+ */
+constexpr size_t kBlockHeaderBytes = 3;
+
+/**
+ * Flag set on the last block of a message.
+ */
+constexpr uint8_t kBlockFinal = 0x01;
+
+/**
+ * Flag set on every block of a message whose payload is a stream of LZ
+ * frames (see lz.h) rather than the message itself.
+ */
+constexpr uint8_t kBlockCompressed = 0x02;
+
+/**
+ * Whether a message is compressed before it is split into blocks.
+ */
+enum class BlockCompression {
+  kNone,  // Pack the bytes as they are.
+  kAuto,  // Compress with `LzCompress` when that saves blocks.
+};
+
+/**
+ * Returns the payload bytes one block carries for a `modulus_bits`-bit key.
+ *
+ * A block is the big-endian integer `[flags][length][payload][zero padding]`
+ * of `(modulus_bits - 1) / 8` bytes, the longest byte string that is below
+ * every modulus of that size, so the payload capacity is that minus
+ * `kBlockHeaderBytes`. For a 2048-bit key this is 252 bytes.
+ *
+ * @throws std::invalid_argument If the key is too small to carry one byte
+ *         or the capacity does not fit the 16-bit length field.
+ */
+size_t BlockCapacity(int modulus_bits);
+
+/**
+ * Returns the payload bytes one block carries for `key`.
+ */
+size_t BlockCapacity(const PublicKey& key);
+
+/**
+ * Returns the number of blocks `PackBlocks` produces for `length` bytes;
+ * an empty message still takes one block.
+ */
+size_t BlockCount(size_t length, int modulus_bits);
+
+/**
+ * Splits arbitrary binary data into blocks for a `modulus_bits`-bit key.
+ *
+ * Each block is filled to `BlockCapacity(modulus_bits)` bytes except the
+ * last, which carries `kBlockFinal`. Unlike `StringToNumber`, leading zero
+ * bytes survive the round trip because every block records its length.
+ *
+ * With `kAuto` the data is compressed first and the compressed form is
+ * packed, with `kBlockCompressed` on every block, only if it needs fewer
+ * blocks; every block saved is one modular exponentiation less on each
+ * side.
+ *
+ * @param data The bytes to pack.
+ * @param modulus_bits The size of the key the blocks are encrypted with.
+ * @param compression Whether to try compression.
+ * @return The blocks, each smaller than any `modulus_bits`-bit modulus.
+ */
+std::vector<BigNumber> PackBlocks(const std::string& data, int modulus_bits,
+                                  BlockCompression compression = BlockCompression::kNone);
+
+/**
+ * Reassembles data packed by `PackBlocks`.
+ *
+ * @param blocks The blocks in order.
+ * @param modulus_bits The key size used for packing.
+ * @return The original bytes, decompressed if the blocks say so.
+ * @throws std::invalid_argument If a block is malformed, the final flag is
+ *         missing or misplaced, the blocks disagree on compression, the
+ *         compressed payload is corrupt, or a block is too large for the
+ *         key size.
+ */
+std::string UnpackBlocks(const std::vector<BigNumber>& blocks, int modulus_bits);
+
+/**
+ * Packs `data` with `PackBlocks` and encrypts the blocks in parallel.
+ *
+ * @param data The bytes to encrypt.
+ * @param public_key The key to encrypt with.
+ * @param pool The thread pool that performs the exponentiations.
+ * @param compression Whether to try compression.
+ * @return One ciphertext per block.
+ */
+std::vector<BigNumber> EncryptMessage(const std::string& data, const PublicKey& public_key,
+                                      ThreadPool& pool,
+                                      BlockCompression compression = BlockCompression::kNone);
+
+/**
+ * Decrypts ciphertexts produced by `EncryptMessage` and unpacks them.
+ *
+ * @param ciphertexts The ciphertexts in order.
+ * @param private_key The key to decrypt with.
+ * @param pool The thread pool that performs the exponentiations.
+ * @return The original bytes.
+ * @throws std::invalid_argument If a ciphertext exceeds the modulus or the
+ *         decrypted blocks are malformed.
+ */
+std::string DecryptMessage(const std::vector<BigNumber>& ciphertexts,
+                           const PrivateKey& private_key, ThreadPool& pool);
+
+/**
+ * Encrypts a message that arrives in pieces, in the block format of
+ * `PackBlocks`.
+ *
+ * Full blocks are encrypted as soon as the next byte proves they are not
+ * the last, so memory stays bounded by one block plus one LZ frame no
+ * matter how long the message is. With `kAuto` the stream is compressed
+ * frame by frame; since the total is not known in advance, compression is
+ * always flagged, and frames that do not shrink are stored at a cost of 4
+ * bytes each.
+ */
+class BlockStreamEncryptor {
+ public:
+  /**
+   * @param public_key The key to encrypt with; must outlive the encryptor.
+   * @param pool The thread pool that performs the exponentiations.
+   * @param compression Whether to compress.
+   */
+  BlockStreamEncryptor(const PublicKey& public_key, ThreadPool& pool,
+                       BlockCompression compression = BlockCompression::kNone);
+
+  /**
+   * Adds message bytes.
+   *
+   * @return Ciphertexts of the blocks completed so far, in order.
+   */
+  std::vector<BigNumber> Update(const std::string& data);
+
+  /**
+   * Ends the message and resets the encryptor.
+   *
+   * @return The remaining ciphertexts, the last carrying `kBlockFinal`.
+   */
+  std::vector<BigNumber> Finish();
+
+ private:
+  // Packs and encrypts the buffered payload, keeping back the last block
+  // unless `final` is set.
+  std::vector<BigNumber> Flush(bool final);
+
+  const PublicKey& public_key_;
+  ThreadPool& pool_;
+  BlockCompression compression_;
+  size_t capacity_;
+  LzStreamCompressor compressor_;
+  std::string pending_;  // Payload not yet in a block.
+};
+
+/**
+ * Decrypts the output of `BlockStreamEncryptor` or `EncryptMessage`
+ * piece by piece.
+ */
+class BlockStreamDecryptor {
+ public:
+  /**
+   * @param private_key The key to decrypt with; must outlive the decryptor.
+   * @param pool The thread pool that performs the exponentiations.
+   */
+  BlockStreamDecryptor(const PrivateKey& private_key, ThreadPool& pool);
+
+  /**
+   * Decrypts the next ciphertexts of the message.
+   *
+   * @return The message bytes they complete.
+   * @throws std::invalid_argument If a block is malformed, follows the
+   *         final block, disagrees with the first on compression, or
+   *         carries a corrupt compressed payload.
+   */
+  std::string Update(const std::vector<BigNumber>& ciphertexts);
+
+  /**
+   * Ends the message and resets the decryptor.
+   *
+   * @throws std::invalid_argument If the final block has not arrived.
+   */
+  void Finish();
+
+ private:
+  const PrivateKey& private_key_;
+  ThreadPool& pool_;
+  size_t blocks_ = 0;      // Blocks decrypted so far.
+  bool compressed_ = false;
+  bool finished_ = false;  // The final block arrived.
+  LzStreamDecompressor decompressor_;
+};
+
+}  // namespace rsa_app
+
+#endif  // RSA_APP_BLOCK_CODEC_H_
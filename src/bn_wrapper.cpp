@@ -1,7 +1,19 @@
 #include "bn_wrapper.h"
 
+#include <openssl/crypto.h>
+#include <openssl/err.h>
+
+#include <algorithm>
+#include <exception>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <vector>
+
+#include "codec.h"
+#include "drbg.h"
+#include "thread_pool.h"
+#include "trace.h"
 
 BigNumber::BigNumber() : bn_(BN_new()) {
   if (!bn_) throw std::runtime_error("BN_new failed");
@@ -97,6 +109,162 @@ bool BigNumber::IsPrime(int checks) const {
   return is_prime == 1;
 }
 
+bool BigNumber::GenerateRandom(int bits, rsa_app::Drbg& drbg) {
+  if (bits < 0) throw std::invalid_argument("Negative bit count");
+  if (bits == 0) {
+    BN_zero(bn_);
+    return true;
+  }
+  std::vector<unsigned char> bytes((bits + 7) / 8);
+  drbg.Generate(bytes.data(), bytes.size());
+  int spare = static_cast<int>(bytes.size()) * 8 - bits;
+  bytes[0] &= static_cast<unsigned char>(0xff >> spare);
+  bytes[0] |= static_cast<unsigned char>(0x80 >> spare);
+  BIGNUM* result = BN_bin2bn(bytes.data(), static_cast<int>(bytes.size()), bn_);
+  OPENSSL_cleanse(bytes.data(), bytes.size());
+  CheckError(result != nullptr);
+  return true;
+}
+
+BigNumber BigNumber::GenerateInRange(const BIGNUM* min, const BIGNUM* max,
+                                     rsa_app::Drbg& drbg) {
+  if (BN_cmp(max, min) < 0) throw std::invalid_argument("Empty range");
+  BigNumber range;
+  CheckError(BN_sub(range.Get(), max, min));
+  CheckError(BN_add_word(range.Get(), 1));
+
+  int bits = BN_num_bits(range.Get());
+  std::vector<unsigned char> bytes((bits + 7) / 8);
+  int spare = static_cast<int>(bytes.size()) * 8 - bits;
+  BigNumber result;
+  // Rejection sampling; every draw is accepted with probability above 1/2.
+  do {
+    drbg.Generate(bytes.data(), bytes.size());
+    bytes[0] &= static_cast<unsigned char>(0xff >> spare);
+    CheckError(BN_bin2bn(bytes.data(), static_cast<int>(bytes.size()),
+                         result.Get()) != nullptr);
+  } while (BN_cmp(result.Get(), range.Get()) >= 0);
+  OPENSSL_cleanse(bytes.data(), bytes.size());
+  CheckError(BN_add(result.Get(), result.Get(), min));
+  return result;
+}
+
+namespace {
+
+constexpr uint32_t kSmallPrimeLimit = 1u << 16;
+// Odd offsets tried from one random start before drawing a new one.
+constexpr uint32_t kMaxPrimeDelta = 1u << 20;
+
+using CtxPtr = std::unique_ptr<BN_CTX, decltype(&BN_CTX_free)>;
+using MontPtr = std::unique_ptr<BN_MONT_CTX, decltype(&BN_MONT_CTX_free)>;
+
+void Notify(const BigNumber::PrimeCallback& callback,
+            BigNumber::PrimeEvent event, int count) {
+  if (callback && !callback(event, count)) {
+    throw std::runtime_error("Prime search aborted by callback");
+  }
+}
+
+// Miller-Rabin on an odd n > 3 with witnesses drawn uniformly from
+// [2, n - 2].
+bool MillerRabin(const BIGNUM* n, int rounds, rsa_app::Drbg& drbg,
+                 const BigNumber::PrimeCallback& callback) {
+  CtxPtr ctx(BN_CTX_new(), BN_CTX_free);
+  MontPtr mont(BN_MONT_CTX_new(), BN_MONT_CTX_free);
+  if (!ctx || !mont || !BN_MONT_CTX_set(mont.get(), n, ctx.get())) {
+    throw std::runtime_error("Failed to set up Miller-Rabin");
+  }
+  BigNumber n_minus_1, d, two, upper, x;
+  if (!BN_sub(n_minus_1.Get(), n, BN_value_one()) ||
+      !BN_sub(upper.Get(), n_minus_1.Get(), BN_value_one())) {
+    throw std::runtime_error("OpenSSL BIGNUM operation failed");
+  }
+  int s = 1;
+  while (!BN_is_bit_set(n_minus_1.Get(), s)) ++s;
+  two.SetWord(2);
+  if (!BN_rshift(d.Get(), n_minus_1.Get(), s)) {
+    throw std::runtime_error("OpenSSL BIGNUM operation failed");
+  }
+
+  for (int round = 0; round < rounds; ++round) {
+    BigNumber witness = BigNumber::GenerateInRange(two.Get(), upper.Get(), drbg);
+    if (!BN_mod_exp_mont(x.Get(), witness.Get(), d.Get(), n, ctx.get(),
+                         mont.get())) {
+      throw std::runtime_error("OpenSSL BIGNUM operation failed");
+    }
+    bool passed = BN_is_one(x.Get()) || BN_cmp(x.Get(), n_minus_1.Get()) == 0;
+    for (int j = 1; j < s && !passed; ++j) {
+      if (!BN_mod_sqr(x.Get(), x.Get(), n, ctx.get())) {
+        throw std::runtime_error("OpenSSL BIGNUM operation failed");
+      }
+      if (BN_is_one(x.Get())) break;
+      passed = BN_cmp(x.Get(), n_minus_1.Get()) == 0;
+    }
+    if (!passed) return false;
+    Notify(callback, BigNumber::PrimeEvent::kRound, round);
+  }
+  return true;
+}
+
+}  // namespace
+
+const std::vector<uint32_t>& BigNumber::SmallPrimes() {
+  static const std::vector<uint32_t> primes = [] {
+    std::vector<bool> composite(kSmallPrimeLimit, false);
+    std::vector<uint32_t> result;
+    for (uint32_t i = 3; i < kSmallPrimeLimit; i += 2) {
+      if (composite[i]) continue;
+      result.push_back(i);
+      for (uint64_t j = uint64_t{i} * i; j < kSmallPrimeLimit; j += 2 * i) {
+        composite[j] = true;
+      }
+    }
+    return result;
+  }();
+  return primes;
+}
+
+int BigNumber::MillerRabinRounds(int bits) {
+  if (bits >= 3747) return 3;
+  if (bits >= 1345) return 4;
+  if (bits >= 476) return 5;
+  if (bits >= 400) return 6;
+  if (bits >= 347) return 7;
+  if (bits >= 308) return 8;
+  if (bits >= 55) return 27;
+  return 34;
+}
+
+bool BigNumber::IsPrime(int rounds, rsa_app::Drbg& drbg,
+                        const PrimeCallback& callback) const {
+  if (BN_is_negative(bn_) || BN_is_zero(bn_) || BN_is_one(bn_)) return false;
+  if (BN_is_word(bn_, 2)) return true;
+  if (!BN_is_odd(bn_)) return false;
+  if (BN_num_bits(bn_) <= 32) {
+    BN_ULONG value = BN_get_word(bn_);
+    for (uint32_t p : SmallPrimes()) {
+      if (static_cast<BN_ULONG>(p) * p > value) return true;
+      if (value % p == 0) return false;
+    }
+    return true;  // Unreachable: 2^16 squared exceeds 32 bits.
+  }
+  for (uint32_t p : SmallPrimes()) {
+    BN_ULONG remainder = BN_mod_word(bn_, p);
+    CheckError(remainder != static_cast<BN_ULONG>(-1));
+    if (remainder == 0) return false;
+  }
+  if (rounds <= 0) rounds = MillerRabinRounds(BN_num_bits(bn_));
+  return MillerRabin(bn_, rounds, drbg, callback);
+}
+
+bool BigNumber::PassesMillerRabin(int rounds, rsa_app::Drbg& drbg) const {
+  if (BN_is_negative(bn_) || BN_num_bits(bn_) <= 32 || !BN_is_odd(bn_)) {
+    return IsPrime(rounds, drbg);
+  }
+  if (rounds <= 0) rounds = MillerRabinRounds(BN_num_bits(bn_));
+  return MillerRabin(bn_, rounds, drbg, nullptr);
+}
+
 BigNumber BigNumber::Add(const BIGNUM* rhs) const {
   BigNumber result;
   CheckError(BN_add(result.Get(), bn_, rhs));
@@ -150,6 +318,88 @@ bool BigNumber::GeneratePrime(int bits) {
   return true;
 }
 
+namespace {
+
+// State shared with the C callback trampoline below.
+struct PrimeCallbackState {
+  const BigNumber::PrimeCallback* callback;
+  std::exception_ptr error;
+};
+
+int PrimeCallbackTrampoline(int event, int count, BN_GENCB* cb) {
+  auto* state = static_cast<PrimeCallbackState*>(BN_GENCB_get_arg(cb));
+  try {
+    return (*state->callback)(static_cast<BigNumber::PrimeEvent>(event), count)
+               ? 1
+               : 0;
+  } catch (...) {
+    // Never unwind through OpenSSL; rethrow once it has returned.
+    state->error = std::current_exception();
+    return 0;
+  }
+}
+
+}  // namespace
+
+bool BigNumber::GeneratePrime(int bits, const PrimeCallback& callback) {
+  BN_GENCB* cb = BN_GENCB_new();
+  if (!cb) throw std::runtime_error("BN_GENCB_new failed");
+  PrimeCallbackState state{&callback, nullptr};
+  BN_GENCB_set(cb, PrimeCallbackTrampoline, &state);
+  int result = BN_generate_prime_ex(bn_, bits, 0, nullptr, nullptr, cb);
+  BN_GENCB_free(cb);
+  if (state.error) std::rethrow_exception(state.error);
+  CheckError(result);
+  return true;
+}
+
+bool BigNumber::GeneratePrime(int bits, rsa_app::Drbg& drbg,
+                              const PrimeCallback& callback) {
+  if (bits < 2) throw std::invalid_argument("Primes need at least 2 bits");
+  int candidates = 0;
+  // Below 2^17 a candidate may itself be one of the sieving primes.
+  if (bits <= 17) {
+    do {
+      GenerateRandom(bits, drbg);
+      Notify(callback, PrimeEvent::kCandidate, candidates++);
+    } while (!IsPrime(0, drbg, callback));
+    Notify(callback, PrimeEvent::kFound, candidates);
+    return true;
+  }
+
+  const std::vector<uint32_t>& primes = SmallPrimes();
+  std::vector<uint32_t> remainders(primes.size());
+  int rounds = MillerRabinRounds(bits);
+  BigNumber candidate;
+  for (;;) {
+    GenerateRandom(bits, drbg);
+    CheckError(BN_set_bit(bn_, bits - 2));
+    CheckError(BN_set_bit(bn_, 0));
+    for (size_t i = 0; i < primes.size(); ++i) {
+      BN_ULONG remainder = BN_mod_word(bn_, primes[i]);
+      CheckError(remainder != static_cast<BN_ULONG>(-1));
+      remainders[i] = static_cast<uint32_t>(remainder);
+    }
+    for (uint32_t delta = 0; delta < kMaxPrimeDelta; delta += 2) {
+      bool divisible = false;
+      for (size_t i = 0; i < primes.size() && !divisible; ++i) {
+        divisible = (remainders[i] + delta) % primes[i] == 0;
+      }
+      if (divisible) continue;
+      CheckError(BN_copy(candidate.Get(), bn_) != nullptr);
+      CheckError(BN_add_word(candidate.Get(), delta));
+      if (BN_num_bits(candidate.Get()) != bits) break;
+      Notify(callback, PrimeEvent::kCandidate, candidates++);
+      rsa_app::TraceSpan span("miller_rabin", "prime", candidates);
+      if (MillerRabin(candidate.Get(), rounds, drbg, callback)) {
+        CheckError(BN_copy(bn_, candidate.Get()) != nullptr);
+        Notify(callback, PrimeEvent::kFound, candidates);
+        return true;
+      }
+    }
+  }
+}
+
 BigNumber BigNumber::Gcd(const BIGNUM* rhs) const {
   BigNumber result;
   BN_CTX* ctx = GetCtx();
@@ -166,6 +416,171 @@ BigNumber BigNumber::ModInverse(const BIGNUM* m) const {
   return result;
 }
 
+namespace {
+
+// Chunks smaller than this are not worth a worker.
+constexpr size_t kMinInverseChunk = 16;
+
+// Multiplies residues in [0, m). For odd `m` it uses Montgomery
+// multiplication on values that were never converted, so each product
+// carries a stray R^-1. The trick cancels them: with P_i = a_0...a_i R^-i,
+// inv(P_{n-1}) = (a_0...a_{n-1})^-1 R^(n-1), and each unwinding step
+// inv * P_{i-1} R^-1 and inv * a_i R^-1 drops exactly one factor of R.
+class ResidueMultiplier {
+ public:
+  ResidueMultiplier(const BIGNUM* m, BN_CTX* ctx) : m_(m), mont_(nullptr, BN_MONT_CTX_free) {
+    if (!BN_is_odd(m)) return;
+    mont_.reset(BN_MONT_CTX_new());
+    if (!mont_ || !BN_MONT_CTX_set(mont_.get(), m, ctx)) {
+      throw std::runtime_error("Failed to set up Montgomery multiplication");
+    }
+  }
+
+  void Mul(BIGNUM* r, const BIGNUM* a, const BIGNUM* b, BN_CTX* ctx) const {
+    int ok = mont_ ? BN_mod_mul_montgomery(r, a, b, mont_.get(), ctx)
+                   : BN_mod_mul(r, a, b, m_, ctx);
+    if (!ok) throw std::runtime_error("OpenSSL BIGNUM operation failed");
+  }
+
+ private:
+  const BIGNUM* m_;
+  MontPtr mont_;
+};
+
+CtxPtr NewCtx() {
+  CtxPtr ctx(BN_CTX_new(), BN_CTX_free);
+  if (!ctx) throw std::runtime_error("Failed to create BN_CTX");
+  return ctx;
+}
+
+// Stores the prefix products of inputs[begin, end) in out[begin, end).
+void PrefixProducts(const std::vector<const BIGNUM*>& inputs, size_t begin, size_t end,
+                    const ResidueMultiplier& mul, std::vector<BigNumber>& out, BN_CTX* ctx) {
+  if (!BN_copy(out[begin].Get(), inputs[begin])) {
+    throw std::runtime_error("BN_copy failed");
+  }
+  for (size_t i = begin + 1; i < end; ++i) {
+    mul.Mul(out[i].Get(), out[i - 1].Get(), inputs[i], ctx);
+  }
+}
+
+// Turns the prefix products in out[begin, end) into inverses, given
+// `inverse` = the inverse of out[end - 1]. Runs backwards, so out[i - 1]
+// still holds a prefix product when out[i] is overwritten.
+void UnwindInverses(const std::vector<const BIGNUM*>& inputs, size_t begin, size_t end,
+                    BigNumber inverse, const ResidueMultiplier& mul,
+                    std::vector<BigNumber>& out, BN_CTX* ctx) {
+  for (size_t i = end - 1; i > begin; --i) {
+    mul.Mul(out[i].Get(), inverse.Get(), out[i - 1].Get(), ctx);
+    mul.Mul(inverse.Get(), inverse.Get(), inputs[i], ctx);
+  }
+  out[begin] = std::move(inverse);
+}
+
+std::vector<BigNumber> InvertBatch(const std::vector<const BIGNUM*>& values, const BIGNUM* m,
+                                   rsa_app::ThreadPool* pool,
+                                   std::vector<size_t>* non_invertible) {
+  if (BN_is_negative(m) || BN_cmp(m, BN_value_one()) <= 0) {
+    throw std::invalid_argument("Batch inversion needs a modulus greater than one");
+  }
+  if (non_invertible) non_invertible->clear();
+  size_t count = values.size();
+  std::vector<BigNumber> results(count);
+  if (count == 0) return results;
+
+  CtxPtr ctx = NewCtx();
+  ResidueMultiplier mul(m, ctx.get());
+  std::vector<const BIGNUM*> inputs = values;
+  std::vector<BigNumber> reduced;  // Owns reduced copies of out-of-range values.
+  for (size_t i = 0; i < count; ++i) {
+    if (!BN_is_negative(values[i]) && BN_ucmp(values[i], m) < 0) continue;
+    BigNumber value;
+    if (!BN_nnmod(value.Get(), values[i], m, ctx.get())) {
+      throw std::runtime_error("OpenSSL BIGNUM operation failed");
+    }
+    inputs[i] = value.Get();
+    reduced.push_back(std::move(value));
+  }
+
+  size_t chunks = 1;
+  if (pool) chunks = std::max<size_t>(1, std::min(pool->Size(), count / kMinInverseChunk));
+  std::vector<size_t> bounds(chunks + 1);
+  for (size_t c = 0; c <= chunks; ++c) bounds[c] = count * c / chunks;
+  auto for_each_chunk = [&](const std::function<void(size_t, BN_CTX*)>& body) {
+    if (chunks == 1) {
+      body(0, ctx.get());
+      return;
+    }
+    pool->ParallelFor(chunks, [&](size_t begin, size_t end) {
+      CtxPtr chunk_ctx = NewCtx();
+      for (size_t c = begin; c < end; ++c) body(c, chunk_ctx.get());
+    });
+  };
+
+  for_each_chunk([&](size_t c, BN_CTX* chunk_ctx) {
+    PrefixProducts(inputs, bounds[c], bounds[c + 1], mul, results, chunk_ctx);
+  });
+
+  // The chunk products go through the same trick; their product is the only
+  // value inverted directly.
+  std::vector<const BIGNUM*> tops(chunks);
+  for (size_t c = 0; c < chunks; ++c) tops[c] = results[bounds[c + 1] - 1].Get();
+  std::vector<BigNumber> top_inverses(chunks);
+  PrefixProducts(tops, 0, chunks, mul, top_inverses, ctx.get());
+  BigNumber total_inverse;
+  if (!BN_mod_inverse(total_inverse.Get(), top_inverses[chunks - 1].Get(), m, ctx.get())) {
+    ERR_clear_error();
+    // Some value shares a factor with m: find them and invert the rest.
+    std::vector<char> bad(count, 0);
+    for_each_chunk([&](size_t c, BN_CTX* chunk_ctx) {
+      BigNumber gcd;
+      for (size_t i = bounds[c]; i < bounds[c + 1]; ++i) {
+        if (!BN_gcd(gcd.Get(), inputs[i], m, chunk_ctx)) {
+          throw std::runtime_error("OpenSSL BIGNUM operation failed");
+        }
+        bad[i] = !BN_is_one(gcd.Get());
+      }
+    });
+    std::vector<const BIGNUM*> invertible;
+    std::vector<size_t> positions;
+    for (size_t i = 0; i < count; ++i) {
+      if (!bad[i]) {
+        invertible.push_back(inputs[i]);
+        positions.push_back(i);
+      } else if (!non_invertible) {
+        throw std::runtime_error("Value " + std::to_string(i) + " of the batch has no inverse");
+      } else {
+        non_invertible->push_back(i);
+      }
+    }
+    std::vector<BigNumber> inverses = InvertBatch(invertible, m, pool, nullptr);
+    std::vector<BigNumber> scattered(count);
+    for (size_t j = 0; j < positions.size(); ++j) scattered[positions[j]] = std::move(inverses[j]);
+    return scattered;
+  }
+  UnwindInverses(tops, 0, chunks, std::move(total_inverse), mul, top_inverses, ctx.get());
+
+  for_each_chunk([&](size_t c, BN_CTX* chunk_ctx) {
+    UnwindInverses(inputs, bounds[c], bounds[c + 1], std::move(top_inverses[c]), mul, results,
+                   chunk_ctx);
+  });
+  return results;
+}
+
+}  // namespace
+
+std::vector<BigNumber> BigNumber::BatchModInverse(const std::vector<const BIGNUM*>& values,
+                                                  const BIGNUM* m,
+                                                  std::vector<size_t>* non_invertible) {
+  return InvertBatch(values, m, nullptr, non_invertible);
+}
+
+std::vector<BigNumber> BigNumber::BatchModInverse(const std::vector<const BIGNUM*>& values,
+                                                  const BIGNUM* m, rsa_app::ThreadPool& pool,
+                                                  std::vector<size_t>* non_invertible) {
+  return InvertBatch(values, m, &pool, non_invertible);
+}
+
 bool BigNumber::GenerateSafePrime(int bits) {
   CheckError(BN_generate_prime_ex(bn_, bits, 1, nullptr, nullptr, nullptr));
   return true;
@@ -186,11 +601,43 @@ std::string BigNumber::ToString() const {
   if (!bn_) {
     throw std::runtime_error("BIGNUM is uninitialized");
   }
-  char* hex_str = BN_bn2hex(bn_);
-  if (!hex_str) {
-    throw std::runtime_error("Failed to convert BIGNUM to string");
-  }
-  std::string result(hex_str);
-  OPENSSL_free(hex_str);
+  if (BN_is_zero(bn_)) return "0";
+
+  // Same layout as BN_bn2hex: upper case, whole bytes, optional '-' prefix.
+  int num_bytes = BN_num_bytes(bn_);
+  size_t sign = BN_is_negative(bn_) ? 1 : 0;
+  std::string result(sign + 3 * static_cast<size_t>(num_bytes), '\0');
+  auto* bytes = reinterpret_cast<unsigned char*>(result.data()) + sign +
+                2 * static_cast<size_t>(num_bytes);
+  BN_bn2bin(bn_, bytes);
+  if (sign) result[0] = '-';
+  rsa_app::HexEncodeTo(bytes, num_bytes, result.data() + sign, true);
+  result.resize(sign + 2 * static_cast<size_t>(num_bytes));
   return result;
-}
\ No newline at end of file
+}
+
+BigNumber BigNumber::FromString(const std::string& hex) {
+  size_t sign = !hex.empty() && hex[0] == '-' ? 1 : 0;
+  if (hex.size() == sign) throw std::invalid_argument("Empty hex string");
+  std::string digits = hex.substr(sign);
+  if (digits.size() % 2 != 0) digits.insert(digits.begin(), '0');
+
+  BigNumber result = FromBytes(rsa_app::HexDecode(digits));
+  if (sign) result.SetNegative(1);
+  return result;
+}
+
+BigNumber BigNumber::FromBytes(const std::string& bytes) {
+  BigNumber result;
+  CheckError(BN_bin2bn(reinterpret_cast<const unsigned char*>(bytes.data()),
+                       static_cast<int>(bytes.size()), result.Get()) != nullptr);
+  return result;
+}
+
+std::string BigNumber::ToBytes(size_t width) const {
+  if (width == 0) width = BN_num_bytes(bn_);
+  std::string result(width, '\0');
+  CheckError(BN_bn2binpad(bn_, reinterpret_cast<unsigned char*>(result.data()),
+                          static_cast<int>(width)) >= 0);
+  return result;
+}
@@ -1,9 +1,17 @@
 #ifndef RSA_APP_BN_WRAPPER_H_
 #define RSA_APP_BN_WRAPPER_H_
 
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <vector>
 #include <openssl/bn.h>
 
+namespace rsa_app {
+class Drbg;
+class ThreadPool;
+}  // namespace rsa_app
+
 /**
  * A wrapper class for managing OpenSSL BIGNUM resources.
  *
@@ -13,6 +21,25 @@
  */
 class BigNumber {
  public:
+  /**
+   * Progress events reported during prime generation.
+   *
+   * The values match the event codes OpenSSL passes to `BN_GENCB`.
+   */
+  enum class PrimeEvent {
+    kCandidate = 0,  ///< A candidate passed trial division and is tested.
+    kRound = 1,      ///< A Miller-Rabin round on the candidate passed.
+    kFound = 2,      ///< The candidate was accepted as prime.
+  };
+
+  /**
+   * Callback invoked for every `PrimeEvent`.
+   *
+   * Receives the event and OpenSSL's counter for it (candidate number or
+   * round index). Returning false aborts the search.
+   */
+  using PrimeCallback = std::function<bool(PrimeEvent event, int count)>;
+
   /**
    * Default constructor.
    *
@@ -109,6 +136,15 @@ class BigNumber {
    */
   bool GenerateRandom(int bits);
 
+  /**
+   * Generates a random BIGNUM with exactly `bits` bits from `drbg`.
+   * @param bits The number of bits; the most significant one is set.
+   * @param drbg The generator to draw from.
+   * @return True if the random number was generated successfully.
+   * @throws std::runtime_error If the operation fails.
+   */
+  bool GenerateRandom(int bits, rsa_app::Drbg& drbg);
+
   /**
    * Generates a random BIGNUM within a specified range.
    * @param min The minimum value (inclusive).
@@ -118,6 +154,18 @@ class BigNumber {
    */
   static BigNumber GenerateInRange(const BIGNUM* min, const BIGNUM* max);
 
+  /**
+   * Generates a uniformly distributed BIGNUM in `[min, max]` from `drbg`.
+   * @param min The minimum value (inclusive).
+   * @param max The maximum value (inclusive); must not be below `min`.
+   * @param drbg The generator to draw from.
+   * @return A `BigNumber` containing the generated random BIGNUM.
+   * @throws std::invalid_argument If `max < min`.
+   * @throws std::runtime_error If the operation fails.
+   */
+  static BigNumber GenerateInRange(const BIGNUM* min, const BIGNUM* max,
+                                   rsa_app::Drbg& drbg);
+
   /**
    * Checks whether the BIGNUM is prime using multiple primality tests.
    * @param checks The number of primality tests to perform (default: `BN_prime_checks`).
@@ -125,6 +173,42 @@ class BigNumber {
    */
   bool IsPrime(int checks = BN_prime_checks) const;
 
+  /**
+   * Checks primality by trial division and Miller-Rabin with witnesses drawn
+   * from `drbg`.
+   * @param rounds Miller-Rabin rounds; 0 selects `MillerRabinRounds`.
+   * @param drbg The generator the witnesses come from.
+   * @param callback Optional; receives `kRound` for every round passed.
+   *                 Returning false aborts the test.
+   * @return True if the BIGNUM is probably prime, false otherwise.
+   * @throws std::runtime_error If an operation fails or the callback aborts.
+   */
+  bool IsPrime(int rounds, rsa_app::Drbg& drbg,
+               const PrimeCallback& callback = nullptr) const;
+
+  /**
+   * Runs only the Miller-Rabin part of `IsPrime`, for values already known
+   * to have no factor in `SmallPrimes()`, such as a factor of a modulus
+   * that passed a gcd against their product.
+   * @param rounds Miller-Rabin rounds; 0 selects `MillerRabinRounds`.
+   * @param drbg The generator the witnesses come from.
+   * @return True if the BIGNUM is probably prime, false otherwise.
+   * @throws std::runtime_error If an operation fails.
+   */
+  bool PassesMillerRabin(int rounds, rsa_app::Drbg& drbg) const;
+
+  /**
+   * Returns the Miller-Rabin rounds for a random candidate of `bits` bits:
+   * 3 from 3747 bits up to 34 below 55 bits, the table behind OpenSSL 1.1's
+   * `BN_prime_checks_for_size`.
+   */
+  static int MillerRabinRounds(int bits);
+
+  /**
+   * Returns the odd primes below 2^16, used for trial division.
+   */
+  static const std::vector<uint32_t>& SmallPrimes();
+
   /**
    * Adds another BIGNUM to this BIGNUM.
    * @param rhs The BIGNUM to add.
@@ -196,6 +280,36 @@ class BigNumber {
    */
   bool GeneratePrime(int bits);
 
+  /**
+   * Generates a random prime and reports search progress.
+   * @param bits The bit length of the prime.
+   * @param callback Invoked for each `PrimeEvent`; may block to throttle the
+   *                 search or return false to abort it.
+   * @return True if the prime was generated successfully.
+   * @throws std::runtime_error If the search fails or is aborted. Exceptions
+   *         thrown by `callback` are propagated unchanged.
+   */
+  bool GeneratePrime(int bits, const PrimeCallback& callback);
+
+  /**
+   * Generates a random prime from `drbg` instead of OpenSSL's RNG.
+   *
+   * Candidates have their top two bits set, like `BN_generate_prime_ex`, and
+   * are stepped through odd values that survive trial division by
+   * `SmallPrimes()` before Miller-Rabin with `MillerRabinRounds(bits)`.
+   * With a seeded `drbg` the result is reproducible.
+   * @param bits The bit length of the prime; at least 2.
+   * @param drbg The generator to draw candidates and witnesses from.
+   * @param callback Optional; invoked for each `PrimeEvent`. Returning false
+   *                 aborts the search.
+   * @return True if the prime was generated successfully.
+   * @throws std::invalid_argument If `bits` is below 2.
+   * @throws std::runtime_error If the search fails or is aborted. Exceptions
+   *         thrown by `callback` are propagated unchanged.
+   */
+  bool GeneratePrime(int bits, rsa_app::Drbg& drbg,
+                     const PrimeCallback& callback = nullptr);
+
   /**
    * Computes the greatest common divisor (GCD) of this BIGNUM and another.
    * @param rhs The other BIGNUM.
@@ -212,6 +326,42 @@ class BigNumber {
    */
   BigNumber ModInverse(const BIGNUM* m) const;
 
+  /**
+   * Inverts many values modulo the same modulus with Montgomery's trick.
+   *
+   * The prefix products `a0`, `a0*a1`, ... are inverted with a single
+   * extended-GCD inversion and unwound into the individual inverses: 3(N-1)
+   * modular multiplications in total, in Montgomery form for odd moduli.
+   * Values need not be reduced.
+   *
+   * If a value shares a factor with `m` the product has no inverse; the
+   * batch then pays one GCD per value to find the culprits and inverts the
+   * rest.
+   * @param values The values to invert.
+   * @param m The modulus; must be greater than one.
+   * @param non_invertible Optional; receives the ascending indices of values
+   *                       without an inverse, whose results are zero.
+   * @return The inverses in `[0, m)`, in input order.
+   * @throws std::invalid_argument If `m` is not greater than one.
+   * @throws std::runtime_error If a value has no inverse and
+   *         `non_invertible` is null, naming the first such index.
+   */
+  static std::vector<BigNumber> BatchModInverse(const std::vector<const BIGNUM*>& values,
+                                                const BIGNUM* m,
+                                                std::vector<size_t>* non_invertible = nullptr);
+
+  /**
+   * Same as `BatchModInverse(values, m, non_invertible)`, with the work
+   * split into one contiguous chunk per worker of `pool`.
+   *
+   * Each chunk builds its prefix products in parallel, the chunk products
+   * go through the trick serially (still one inversion for the whole
+   * batch), and each chunk unwinds its inverses in parallel.
+   */
+  static std::vector<BigNumber> BatchModInverse(const std::vector<const BIGNUM*>& values,
+                                                const BIGNUM* m, rsa_app::ThreadPool& pool,
+                                                std::vector<size_t>* non_invertible = nullptr);
+
   /**
    * Generates a random safe prime with a specified number of bits.
    * A safe prime is a prime number p such that `(p-1)/2` is also prime.
@@ -239,6 +389,31 @@ class BigNumber {
    */
   std::string ToString() const;
 
+  /**
+   * Parses a hexadecimal string as produced by `ToString`.
+   * @param hex The hexadecimal digits, optionally prefixed with '-'.
+   * @return A `BigNumber` holding the parsed value.
+   * @throws std::invalid_argument If the string is not valid hexadecimal.
+   */
+  static BigNumber FromString(const std::string& hex);
+
+  /**
+   * Interprets a byte string as an unsigned big-endian integer.
+   * @param bytes The big-endian bytes.
+   * @return A `BigNumber` holding the value.
+   * @throws std::runtime_error If the conversion fails.
+   */
+  static BigNumber FromBytes(const std::string& bytes);
+
+  /**
+   * Converts the absolute value to big-endian bytes.
+   * @param width The exact output size, left-padded with zeros; 0 produces
+   *              the minimal encoding.
+   * @return The big-endian byte string.
+   * @throws std::runtime_error If the value does not fit in `width` bytes.
+   */
+  std::string ToBytes(size_t width = 0) const;
+
  private:
   BIGNUM* bn_;  ///< The underlying BIGNUM pointer.
 
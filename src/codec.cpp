@@ -0,0 +1,709 @@
+#include "codec.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define RSA_APP_CODEC_X86 1
+#include <immintrin.h>
+#endif
+
+namespace rsa_app {
+
+namespace {
+
+constexpr char kBase64Alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+constexpr char kHexLower[] = "0123456789abcdef";
+constexpr char kHexUpper[] = "0123456789ABCDEF";
+constexpr uint8_t kInvalid = 0xFF;
+
+constexpr std::array<uint8_t, 256> MakeBase64DecodeTable() {
+  std::array<uint8_t, 256> table{};
+  for (auto& entry : table) entry = kInvalid;
+  for (int i = 0; i < 64; ++i) {
+    table[static_cast<unsigned char>(kBase64Alphabet[i])] =
+        static_cast<uint8_t>(i);
+  }
+  return table;
+}
+
+constexpr std::array<uint8_t, 256> MakeHexDecodeTable() {
+  std::array<uint8_t, 256> table{};
+  for (auto& entry : table) entry = kInvalid;
+  for (int i = 0; i < 10; ++i) table['0' + i] = static_cast<uint8_t>(i);
+  for (int i = 0; i < 6; ++i) {
+    table['a' + i] = static_cast<uint8_t>(10 + i);
+    table['A' + i] = static_cast<uint8_t>(10 + i);
+  }
+  return table;
+}
+
+constexpr std::array<uint8_t, 256> kBase64DecodeTable = MakeBase64DecodeTable();
+constexpr std::array<uint8_t, 256> kHexDecodeTable = MakeHexDecodeTable();
+
+[[noreturn]] void ThrowInvalidBase64() {
+  throw std::invalid_argument("Invalid base64 input");
+}
+
+[[noreturn]] void ThrowInvalidHex() {
+  throw std::invalid_argument("Invalid hex input");
+}
+
+// ---------------------------------------------------------------------------
+// Scalar kernels.
+// ---------------------------------------------------------------------------
+
+size_t Base64EncodeScalar(const unsigned char* in, size_t length, char* out) {
+  char* start = out;
+  size_t i = 0;
+  for (; i + 3 <= length; i += 3) {
+    uint32_t group = (uint32_t{in[i]} << 16) | (uint32_t{in[i + 1]} << 8) |
+                     in[i + 2];
+    out[0] = kBase64Alphabet[(group >> 18) & 0x3F];
+    out[1] = kBase64Alphabet[(group >> 12) & 0x3F];
+    out[2] = kBase64Alphabet[(group >> 6) & 0x3F];
+    out[3] = kBase64Alphabet[group & 0x3F];
+    out += 4;
+  }
+  size_t rest = length - i;
+  if (rest > 0) {
+    uint32_t group = uint32_t{in[i]} << 16;
+    if (rest == 2) group |= uint32_t{in[i + 1]} << 8;
+    out[0] = kBase64Alphabet[(group >> 18) & 0x3F];
+    out[1] = kBase64Alphabet[(group >> 12) & 0x3F];
+    out[2] = rest == 2 ? kBase64Alphabet[(group >> 6) & 0x3F] : '=';
+    out[3] = '=';
+    out += 4;
+  }
+  return static_cast<size_t>(out - start);
+}
+
+// Decodes whole quads; padding is only accepted in the final quad.
+size_t Base64DecodeScalar(const char* in, size_t length, unsigned char* out) {
+  if (length % 4 != 0) ThrowInvalidBase64();
+  unsigned char* start = out;
+  for (size_t i = 0; i < length; i += 4) {
+    const auto* quad = reinterpret_cast<const unsigned char*>(in + i);
+    uint8_t a = kBase64DecodeTable[quad[0]];
+    uint8_t b = kBase64DecodeTable[quad[1]];
+    uint8_t c = kBase64DecodeTable[quad[2]];
+    uint8_t d = kBase64DecodeTable[quad[3]];
+    if (((a | b | c | d) & 0xC0) == 0) {
+      uint32_t group = (uint32_t{a} << 18) | (uint32_t{b} << 12) |
+                       (uint32_t{c} << 6) | d;
+      out[0] = static_cast<unsigned char>(group >> 16);
+      out[1] = static_cast<unsigned char>(group >> 8);
+      out[2] = static_cast<unsigned char>(group);
+      out += 3;
+      continue;
+    }
+    // Only the last quad may carry padding: "xx==" or "xxx=".
+    if (i + 4 != length || a == kInvalid || b == kInvalid ||
+        quad[3] != '=') {
+      ThrowInvalidBase64();
+    }
+    uint32_t group = (uint32_t{a} << 18) | (uint32_t{b} << 12);
+    if (quad[2] == '=') {
+      *out++ = static_cast<unsigned char>(group >> 16);
+    } else if (c != kInvalid) {
+      group |= uint32_t{c} << 6;
+      *out++ = static_cast<unsigned char>(group >> 16);
+      *out++ = static_cast<unsigned char>(group >> 8);
+    } else {
+      ThrowInvalidBase64();
+    }
+  }
+  return static_cast<size_t>(out - start);
+}
+
+size_t HexEncodeScalar(const unsigned char* in, size_t length, char* out,
+                       bool uppercase) {
+  const char* digits = uppercase ? kHexUpper : kHexLower;
+  for (size_t i = 0; i < length; ++i) {
+    out[2 * i] = digits[in[i] >> 4];
+    out[2 * i + 1] = digits[in[i] & 0x0F];
+  }
+  return 2 * length;
+}
+
+size_t HexDecodeScalar(const char* in, size_t length, unsigned char* out) {
+  if (length % 2 != 0) ThrowInvalidHex();
+  const auto* chars = reinterpret_cast<const unsigned char*>(in);
+  for (size_t i = 0; i < length; i += 2) {
+    uint8_t hi = kHexDecodeTable[chars[i]];
+    uint8_t lo = kHexDecodeTable[chars[i + 1]];
+    if (((hi | lo) & 0xF0) != 0) ThrowInvalidHex();
+    out[i / 2] = static_cast<unsigned char>((hi << 4) | lo);
+  }
+  return length / 2;
+}
+
+// ---------------------------------------------------------------------------
+// Vectorized kernels. Each kernel processes as many full blocks as it can and
+// returns how much input it consumed; the scalar kernels finish the tail and
+// report errors at the exact position.
+// ---------------------------------------------------------------------------
+
+#ifdef RSA_APP_CODEC_X86
+
+// Spreads 12 input bytes (in lanes 0..11) into 16 6-bit indices.
+__attribute__((target("ssse3"))) inline __m128i Base64EncReshuffle(
+    __m128i in) {
+  in = _mm_shuffle_epi8(
+      in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00));
+  const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+  const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003F03F0));
+  const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+  return _mm_or_si128(t1, t3);
+}
+
+// Maps 6-bit indices to ASCII by adding a per-range offset.
+__attribute__((target("ssse3"))) inline __m128i Base64EncTranslate(
+    __m128i indices) {
+  const __m128i lut = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4,
+                                    -4, -4, -19, -16, 0, 0);
+  __m128i offsets = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  const __m128i above_25 = _mm_cmpgt_epi8(indices, _mm_set1_epi8(25));
+  offsets = _mm_sub_epi8(offsets, above_25);
+  return _mm_add_epi8(indices, _mm_shuffle_epi8(lut, offsets));
+}
+
+__attribute__((target("ssse3"))) size_t Base64EncodeSsse3(
+    const unsigned char* in, size_t length, char* out, size_t* consumed) {
+  size_t i = 0;
+  size_t written = 0;
+  // Each iteration reads 16 bytes but only consumes 12.
+  for (; i + 16 <= length; i += 12) {
+    __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    block = Base64EncTranslate(Base64EncReshuffle(block));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + written), block);
+    written += 16;
+  }
+  *consumed = i;
+  return written;
+}
+
+__attribute__((target("avx2"))) inline __m256i Base64EncReshuffle256(
+    __m256i in) {
+  in = _mm256_shuffle_epi8(
+      in, _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                          10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00));
+  const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+  const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0));
+  const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+  return _mm256_or_si256(t1, t3);
+}
+
+__attribute__((target("avx2"))) inline __m256i Base64EncTranslate256(
+    __m256i indices) {
+  const __m256i lut = _mm256_setr_epi8(
+      65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0, 65, 71,
+      -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+  __m256i offsets = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+  const __m256i above_25 = _mm256_cmpgt_epi8(indices, _mm256_set1_epi8(25));
+  offsets = _mm256_sub_epi8(offsets, above_25);
+  return _mm256_add_epi8(indices, _mm256_shuffle_epi8(lut, offsets));
+}
+
+__attribute__((target("avx2"))) size_t Base64EncodeAvx2(
+    const unsigned char* in, size_t length, char* out, size_t* consumed) {
+  size_t i = 0;
+  size_t written = 0;
+  // Each 128-bit lane handles 12 bytes; the upper load reads up to in+28.
+  for (; i + 28 <= length; i += 24) {
+    const __m128i lo =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    const __m128i hi =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 12));
+    __m256i block = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+    block = Base64EncTranslate256(Base64EncReshuffle256(block));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + written), block);
+    written += 32;
+  }
+  *consumed = i;
+  return written;
+}
+
+// Returns false if `block` contains a character outside the alphabet
+// (padding included); otherwise replaces it with the 6-bit values.
+__attribute__((target("ssse3"))) inline bool Base64DecTranslate(
+    __m128i* block) {
+  const __m128i lut_lo =
+      _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                    0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+  const __m128i lut_hi =
+      _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10,
+                    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m128i lut_roll =
+      _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i mask_2f = _mm_set1_epi8(0x2F);
+
+  const __m128i hi_nibbles =
+      _mm_and_si128(_mm_srli_epi32(*block, 4), mask_2f);
+  const __m128i lo_nibbles = _mm_and_si128(*block, mask_2f);
+  const __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+  const __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+  if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi),
+                                       _mm_setzero_si128())) != 0) {
+    return false;
+  }
+  const __m128i eq_2f = _mm_cmpeq_epi8(*block, mask_2f);
+  const __m128i roll =
+      _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+  *block = _mm_add_epi8(*block, roll);
+  return true;
+}
+
+// Packs 16 6-bit values into 12 bytes at the start of the register.
+__attribute__((target("ssse3"))) inline __m128i Base64DecReshuffle(
+    __m128i values) {
+  const __m128i merged =
+      _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+  const __m128i packed = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+  return _mm_shuffle_epi8(packed, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14,
+                                                13, 12, -1, -1, -1, -1));
+}
+
+__attribute__((target("ssse3"))) size_t Base64DecodeSsse3(
+    const char* in, size_t length, unsigned char* out, size_t* consumed) {
+  size_t i = 0;
+  size_t written = 0;
+  // Keep at least 8 chars back so the 16-byte store stays inside the output
+  // and the padded final quad is left to the scalar kernel.
+  for (; i + 24 <= length; i += 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    if (!Base64DecTranslate(&block)) break;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + written),
+                     Base64DecReshuffle(block));
+    written += 12;
+  }
+  *consumed = i;
+  return written;
+}
+
+__attribute__((target("avx2"))) inline bool Base64DecTranslate256(
+    __m256i* block) {
+  const __m256i lut_lo = _mm256_setr_epi8(
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A,
+      0x1B, 0x1B, 0x1B, 0x1A, 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+      0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+  const __m256i lut_hi = _mm256_setr_epi8(
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m256i lut_roll = _mm256_setr_epi8(
+      0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 19, 4,
+      -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i mask_2f = _mm256_set1_epi8(0x2F);
+
+  const __m256i hi_nibbles =
+      _mm256_and_si256(_mm256_srli_epi32(*block, 4), mask_2f);
+  const __m256i lo_nibbles = _mm256_and_si256(*block, mask_2f);
+  const __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+  const __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+  if (!_mm256_testz_si256(lo, hi)) return false;
+  const __m256i eq_2f = _mm256_cmpeq_epi8(*block, mask_2f);
+  const __m256i roll =
+      _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles));
+  *block = _mm256_add_epi8(*block, roll);
+  return true;
+}
+
+__attribute__((target("avx2"))) inline __m256i Base64DecReshuffle256(
+    __m256i values) {
+  const __m256i merged =
+      _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+  __m256i packed = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+  packed = _mm256_shuffle_epi8(
+      packed, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1,
+                               -1, -1, 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                               -1, -1, -1, -1));
+  // Close the 4-byte gap between the two 12-byte lanes.
+  return _mm256_permutevar8x32_epi32(packed,
+                                     _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+}
+
+__attribute__((target("avx2"))) size_t Base64DecodeAvx2(
+    const char* in, size_t length, unsigned char* out, size_t* consumed) {
+  size_t i = 0;
+  size_t written = 0;
+  // The 32-byte store needs 8 bytes of slack, i.e. at least 16 more chars.
+  for (; i + 48 <= length; i += 32) {
+    __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+    if (!Base64DecTranslate256(&block)) break;
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + written),
+                        Base64DecReshuffle256(block));
+    written += 24;
+  }
+  *consumed = i;
+  return written;
+}
+
+__attribute__((target("ssse3"))) size_t HexEncodeSsse3(
+    const unsigned char* in, size_t length, char* out, bool uppercase,
+    size_t* consumed) {
+  const __m128i lut = _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(uppercase ? kHexUpper : kHexLower));
+  const __m128i mask = _mm_set1_epi8(0x0F);
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    const __m128i hi =
+        _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(bytes, 4), mask));
+    const __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(bytes, mask));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i),
+                     _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i + 16),
+                     _mm_unpackhi_epi8(hi, lo));
+  }
+  *consumed = i;
+  return 2 * i;
+}
+
+__attribute__((target("avx2"))) size_t HexEncodeAvx2(const unsigned char* in,
+                                                     size_t length, char* out,
+                                                     bool uppercase,
+                                                     size_t* consumed) {
+  const __m256i lut = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(uppercase ? kHexUpper : kHexLower)));
+  const __m256i mask = _mm256_set1_epi8(0x0F);
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32) {
+    const __m256i bytes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+    const __m256i hi = _mm256_shuffle_epi8(
+        lut, _mm256_and_si256(_mm256_srli_epi16(bytes, 4), mask));
+    const __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(bytes, mask));
+    const __m256i first = _mm256_unpacklo_epi8(hi, lo);
+    const __m256i second = _mm256_unpackhi_epi8(hi, lo);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * i),
+                        _mm256_permute2x128_si256(first, second, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * i + 32),
+                        _mm256_permute2x128_si256(first, second, 0x31));
+  }
+  *consumed = i;
+  return 2 * i;
+}
+
+// Converts 16 hex characters to nibble values; returns false on bad input.
+__attribute__((target("ssse3"))) inline bool HexNibbles(__m128i chars,
+                                                        __m128i* nibbles) {
+  const __m128i digit = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+  const __m128i is_digit =
+      _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+  const __m128i alpha = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)),
+                                     _mm_set1_epi8('a'));
+  const __m128i is_alpha =
+      _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(5)), alpha);
+  if (_mm_movemask_epi8(_mm_or_si128(is_digit, is_alpha)) != 0xFFFF) {
+    return false;
+  }
+  const __m128i alpha_value = _mm_add_epi8(alpha, _mm_set1_epi8(10));
+  *nibbles = _mm_or_si128(_mm_and_si128(is_digit, digit),
+                          _mm_andnot_si128(is_digit, alpha_value));
+  return true;
+}
+
+__attribute__((target("ssse3"))) size_t HexDecodeSsse3(const char* in,
+                                                       size_t length,
+                                                       unsigned char* out,
+                                                       size_t* consumed) {
+  const __m128i weights = _mm_set1_epi16(0x0110);
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32) {
+    __m128i first, second;
+    if (!HexNibbles(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)),
+                    &first) ||
+        !HexNibbles(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 16)),
+            &second)) {
+      break;
+    }
+    const __m128i packed = _mm_packus_epi16(_mm_maddubs_epi16(first, weights),
+                                            _mm_maddubs_epi16(second, weights));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i / 2), packed);
+  }
+  *consumed = i;
+  return i / 2;
+}
+
+__attribute__((target("avx2"))) inline bool HexNibbles256(__m256i chars,
+                                                          __m256i* nibbles) {
+  const __m256i digit = _mm256_sub_epi8(chars, _mm256_set1_epi8('0'));
+  const __m256i is_digit =
+      _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+  const __m256i alpha = _mm256_sub_epi8(
+      _mm256_or_si256(chars, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+  const __m256i is_alpha =
+      _mm256_cmpeq_epi8(_mm256_min_epu8(alpha, _mm256_set1_epi8(5)), alpha);
+  if (_mm256_movemask_epi8(_mm256_or_si256(is_digit, is_alpha)) != -1) {
+    return false;
+  }
+  const __m256i alpha_value = _mm256_add_epi8(alpha, _mm256_set1_epi8(10));
+  *nibbles = _mm256_blendv_epi8(alpha_value, digit, is_digit);
+  return true;
+}
+
+__attribute__((target("avx2"))) size_t HexDecodeAvx2(const char* in,
+                                                     size_t length,
+                                                     unsigned char* out,
+                                                     size_t* consumed) {
+  const __m256i weights = _mm256_set1_epi16(0x0110);
+  size_t i = 0;
+  for (; i + 64 <= length; i += 64) {
+    __m256i first, second;
+    if (!HexNibbles256(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)),
+            &first) ||
+        !HexNibbles256(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 32)),
+            &second)) {
+      break;
+    }
+    const __m256i packed =
+        _mm256_packus_epi16(_mm256_maddubs_epi16(first, weights),
+                            _mm256_maddubs_epi16(second, weights));
+    // packus interleaves the 128-bit lanes of both inputs; restore order.
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i / 2),
+                        _mm256_permute4x64_epi64(packed, 0xD8));
+  }
+  *consumed = i;
+  return i / 2;
+}
+
+#endif  // RSA_APP_CODEC_X86
+
+// ---------------------------------------------------------------------------
+// Dispatch.
+// ---------------------------------------------------------------------------
+
+bool KernelSupported(CodecKernel kernel) {
+#ifdef RSA_APP_CODEC_X86
+  switch (kernel) {
+    case CodecKernel::kScalar:
+      return true;
+    case CodecKernel::kSsse3:
+      return __builtin_cpu_supports("ssse3");
+    case CodecKernel::kAvx2:
+      return __builtin_cpu_supports("avx2");
+  }
+  return false;
+#else
+  return kernel == CodecKernel::kScalar;
+#endif
+}
+
+std::atomic<CodecKernel>& ActiveKernelSlot() {
+  static std::atomic<CodecKernel> active{BestCodecKernel()};
+  return active;
+}
+
+}  // namespace
+
+CodecKernel BestCodecKernel() {
+  static const CodecKernel best = [] {
+    if (KernelSupported(CodecKernel::kAvx2)) return CodecKernel::kAvx2;
+    if (KernelSupported(CodecKernel::kSsse3)) return CodecKernel::kSsse3;
+    return CodecKernel::kScalar;
+  }();
+  return best;
+}
+
+CodecKernel ActiveCodecKernel() {
+  return ActiveKernelSlot().load(std::memory_order_relaxed);
+}
+
+void SetCodecKernel(CodecKernel kernel) {
+  if (!KernelSupported(kernel)) kernel = BestCodecKernel();
+  ActiveKernelSlot().store(kernel, std::memory_order_relaxed);
+}
+
+const char* CodecKernelName(CodecKernel kernel) {
+  switch (kernel) {
+    case CodecKernel::kScalar:
+      return "scalar";
+    case CodecKernel::kSsse3:
+      return "ssse3";
+    case CodecKernel::kAvx2:
+      return "avx2";
+  }
+  return "unknown";
+}
+
+size_t Base64EncodeTo(const unsigned char* input, size_t length,
+                      char* output) {
+  size_t consumed = 0;
+  size_t written = 0;
+#ifdef RSA_APP_CODEC_X86
+  switch (ActiveCodecKernel()) {
+    case CodecKernel::kAvx2:
+      written = Base64EncodeAvx2(input, length, output, &consumed);
+      break;
+    case CodecKernel::kSsse3:
+      written = Base64EncodeSsse3(input, length, output, &consumed);
+      break;
+    case CodecKernel::kScalar:
+      break;
+  }
+#endif
+  return written + Base64EncodeScalar(input + consumed, length - consumed,
+                                      output + written);
+}
+
+size_t Base64DecodeTo(const char* input, size_t length,
+                      unsigned char* output) {
+  if (length % 4 != 0) ThrowInvalidBase64();
+  size_t consumed = 0;
+  size_t written = 0;
+#ifdef RSA_APP_CODEC_X86
+  switch (ActiveCodecKernel()) {
+    case CodecKernel::kAvx2:
+      written = Base64DecodeAvx2(input, length, output, &consumed);
+      break;
+    case CodecKernel::kSsse3:
+      written = Base64DecodeSsse3(input, length, output, &consumed);
+      break;
+    case CodecKernel::kScalar:
+      break;
+  }
+#endif
+  return written + Base64DecodeScalar(input + consumed, length - consumed,
+                                      output + written);
+}
+
+std::string Base64Decode(const std::string& input) {
+  std::string result(Base64DecodedMaxLength(input.size()), '\0');
+  size_t written = Base64DecodeTo(
+      input.data(), input.size(),
+      reinterpret_cast<unsigned char*>(result.data()));
+  result.resize(written);
+  return result;
+}
+
+size_t HexEncodeTo(const unsigned char* input, size_t length, char* output,
+                   bool uppercase) {
+  size_t consumed = 0;
+  size_t written = 0;
+#ifdef RSA_APP_CODEC_X86
+  switch (ActiveCodecKernel()) {
+    case CodecKernel::kAvx2:
+      written = HexEncodeAvx2(input, length, output, uppercase, &consumed);
+      break;
+    case CodecKernel::kSsse3:
+      written = HexEncodeSsse3(input, length, output, uppercase, &consumed);
+      break;
+    case CodecKernel::kScalar:
+      break;
+  }
+#endif
+  return written + HexEncodeScalar(input + consumed, length - consumed,
+                                   output + written, uppercase);
+}
+
+std::string HexEncode(const std::string& input, bool uppercase) {
+  std::string result(2 * input.size(), '\0');
+  HexEncodeTo(reinterpret_cast<const unsigned char*>(input.data()),
+              input.size(), result.data(), uppercase);
+  return result;
+}
+
+size_t HexDecodeTo(const char* input, size_t length, unsigned char* output) {
+  if (length % 2 != 0) ThrowInvalidHex();
+  size_t consumed = 0;
+  size_t written = 0;
+#ifdef RSA_APP_CODEC_X86
+  switch (ActiveCodecKernel()) {
+    case CodecKernel::kAvx2:
+      written = HexDecodeAvx2(input, length, output, &consumed);
+      break;
+    case CodecKernel::kSsse3:
+      written = HexDecodeSsse3(input, length, output, &consumed);
+      break;
+    case CodecKernel::kScalar:
+      break;
+  }
+#endif
+  return written + HexDecodeScalar(input + consumed, length - consumed,
+                                   output + written);
+}
+
+std::string HexDecode(const std::string& input) {
+  std::string result(input.size() / 2, '\0');
+  HexDecodeTo(input.data(), input.size(),
+              reinterpret_cast<unsigned char*>(result.data()));
+  return result;
+}
+
+size_t Base64StreamEncoder::Update(const unsigned char* input, size_t length,
+                                   char* output) {
+  size_t written = 0;
+  // Complete the group left over from the previous chunk first.
+  while (pending_size_ > 0 && pending_size_ < 3 && length > 0) {
+    pending_[pending_size_++] = *input++;
+    --length;
+  }
+  if (pending_size_ == 3) {
+    written += Base64EncodeScalar(pending_, 3, output);
+    pending_size_ = 0;
+  }
+  if (pending_size_ > 0) return written;
+
+  size_t whole = length - length % 3;
+  written += Base64EncodeTo(input, whole, output + written);
+  pending_size_ = length - whole;
+  std::memcpy(pending_, input + whole, pending_size_);
+  return written;
+}
+
+size_t Base64StreamEncoder::Finish(char* output) {
+  size_t written = Base64EncodeScalar(pending_, pending_size_, output);
+  pending_size_ = 0;
+  return written;
+}
+
+size_t Base64StreamDecoder::Update(const char* input, size_t length,
+                                   unsigned char* output) {
+  if (length == 0) return 0;
+  if (finished_) ThrowInvalidBase64();
+  size_t written = 0;
+  while (pending_size_ > 0 && pending_size_ < 4 && length > 0) {
+    pending_[pending_size_++] = *input++;
+    --length;
+  }
+  if (pending_size_ == 4) {
+    written += Base64DecodeScalar(pending_, 4, output);
+    finished_ = pending_[3] == '=';
+    pending_size_ = 0;
+  }
+  if (length == 0) return written;
+  if (finished_) ThrowInvalidBase64();
+  size_t whole = length - length % 4;
+  if (whole > 0) {
+    written += Base64DecodeTo(input, whole, output + written);
+    finished_ = input[whole - 1] == '=';
+  }
+  pending_size_ = length - whole;
+  if (pending_size_ > 0 && finished_) ThrowInvalidBase64();
+  std::memcpy(pending_, input + whole, pending_size_);
+  return written;
+}
+
+void Base64StreamDecoder::Finish() {
+  bool partial = pending_size_ != 0;
+  pending_size_ = 0;
+  finished_ = false;
+  if (partial) ThrowInvalidBase64();
+}
+
+}  // namespace rsa_app
@@ -0,0 +1,216 @@
+#ifndef RSA_APP_CODEC_H_
+#define RSA_APP_CODEC_H_
+
+#include <cstddef>
+#include <string>
+
+namespace rsa_app {
+
+/**
+ * Identifies the kernel family used by the base64/hex codec.
+ *
+ * The fastest kernel supported by the running CPU is selected once on first
+ * use. `kScalar` is available everywhere; the vectorized kernels are only
+ * compiled for x86 targets built with GCC or Clang.
+ */
+enum class CodecKernel {
+  kScalar,  // Table-driven portable kernels.
+  kSsse3,   // 128-bit PSHUFB based kernels.
+  kAvx2,    // 256-bit PSHUFB based kernels.
+};
+
+/**
+ * Returns the kernel currently used by the codec functions.
+ */
+CodecKernel ActiveCodecKernel();
+
+/**
+ * Returns the fastest kernel supported by the running CPU.
+ */
+CodecKernel BestCodecKernel();
+
+/**
+ * Overrides the kernel used by the codec functions.
+ *
+ * Intended for tests and benchmarks. Requesting a kernel the CPU does not
+ * support falls back to the best supported one.
+ *
+ * @param kernel The kernel to use from now on.
+ */
+void SetCodecKernel(CodecKernel kernel);
+
+/**
+ * Returns a printable name for a codec kernel ("scalar", "ssse3", "avx2").
+ */
+const char* CodecKernelName(CodecKernel kernel);
+
+/**
+ * Computes the length of the padded base64 encoding of `length` bytes.
+ */
+constexpr size_t Base64EncodedLength(size_t length) {
+  return (length + 2) / 3 * 4;
+}
+
+/**
+ * Computes an upper bound for the decoded size of `length` base64 characters.
+ */
+constexpr size_t Base64DecodedMaxLength(size_t length) {
+  return length / 4 * 3;
+}
+
+/**
+ * Encodes binary data as padded base64 into a caller-provided buffer.
+ *
+ * @param input The bytes to encode.
+ * @param length The number of bytes in `input`.
+ * @param output Destination with room for `Base64EncodedLength(length)` chars.
+ * @return The number of characters written.
+ */
+size_t Base64EncodeTo(const unsigned char* input, size_t length, char* output);
+
+/**
+ * Decodes padded base64 into a caller-provided buffer.
+ *
+ * @param input The base64 characters (no whitespace).
+ * @param length The number of characters in `input`.
+ * @param output Destination with room for `Base64DecodedMaxLength(length)`
+ *               bytes.
+ * @return The number of bytes written.
+ * @throws std::invalid_argument If the input is not valid padded base64.
+ */
+size_t Base64DecodeTo(const char* input, size_t length, unsigned char* output);
+
+/**
+ * Decodes a padded base64 string.
+ *
+ * @param input The base64 string to decode.
+ * @return The decoded bytes.
+ * @throws std::invalid_argument If the input is not valid padded base64.
+ */
+std::string Base64Decode(const std::string& input);
+
+/**
+ * Encodes binary data as hexadecimal into a caller-provided buffer.
+ *
+ * @param input The bytes to encode.
+ * @param length The number of bytes in `input`.
+ * @param output Destination with room for `2 * length` chars.
+ * @param uppercase Emit `A-F` instead of `a-f`.
+ * @return The number of characters written.
+ */
+size_t HexEncodeTo(const unsigned char* input, size_t length, char* output,
+                   bool uppercase = false);
+
+/**
+ * Encodes a byte string as hexadecimal.
+ *
+ * @param input The bytes to encode.
+ * @param uppercase Emit `A-F` instead of `a-f`.
+ * @return The hexadecimal representation.
+ */
+std::string HexEncode(const std::string& input, bool uppercase = false);
+
+/**
+ * Decodes hexadecimal characters into a caller-provided buffer.
+ *
+ * Both upper and lower case digits are accepted.
+ *
+ * @param input The hexadecimal characters.
+ * @param length The number of characters in `input` (must be even).
+ * @param output Destination with room for `length / 2` bytes.
+ * @return The number of bytes written.
+ * @throws std::invalid_argument If the input has odd length or contains a
+ *         non-hex character.
+ */
+size_t HexDecodeTo(const char* input, size_t length, unsigned char* output);
+
+/**
+ * Decodes a hexadecimal string.
+ *
+ * @param input The hexadecimal string to decode.
+ * @return The decoded bytes.
+ * @throws std::invalid_argument If the input is not valid hexadecimal.
+ */
+std::string HexDecode(const std::string& input);
+
+/**
+ * Incremental base64 encoder for data that arrives in chunks.
+ *
+ * Up to two trailing bytes of each chunk are carried over to the next call
+ * so the output is identical to encoding the concatenated input at once.
+ */
+class Base64StreamEncoder {
+ public:
+  /**
+   * Computes the output space `Update` may need for a chunk of `length`.
+   */
+  static constexpr size_t MaxUpdateLength(size_t length) {
+    return Base64EncodedLength(length + 2);
+  }
+
+  /**
+   * Encodes the next chunk of input.
+   *
+   * @param input The chunk to encode.
+   * @param length The number of bytes in `input`.
+   * @param output Destination with room for `MaxUpdateLength(length)` chars.
+   * @return The number of characters written.
+   */
+  size_t Update(const unsigned char* input, size_t length, char* output);
+
+  /**
+   * Flushes the carried-over bytes with padding and resets the encoder.
+   *
+   * @param output Destination with room for 4 chars.
+   * @return The number of characters written.
+   */
+  size_t Finish(char* output);
+
+ private:
+  unsigned char pending_[3] = {0, 0, 0};  ///< Bytes not yet forming a group.
+  size_t pending_size_ = 0;  ///< Number of valid bytes in pending_.
+};
+
+/**
+ * Incremental base64 decoder for input that arrives in chunks.
+ *
+ * Chunks may be split at any character; incomplete quads are carried over
+ * to the next call.
+ */
+class Base64StreamDecoder {
+ public:
+  /**
+   * Computes the output space `Update` may need for a chunk of `length`.
+   */
+  static constexpr size_t MaxUpdateLength(size_t length) {
+    return Base64DecodedMaxLength(length + 3);
+  }
+
+  /**
+   * Decodes the next chunk of input.
+   *
+   * @param input The chunk to decode.
+   * @param length The number of characters in `input`.
+   * @param output Destination with room for `MaxUpdateLength(length)` bytes.
+   * @return The number of bytes written.
+   * @throws std::invalid_argument If the input is malformed or continues
+   *         after padding.
+   */
+  size_t Update(const char* input, size_t length, unsigned char* output);
+
+  /**
+   * Verifies that the input ended on a quad boundary and resets the decoder.
+   *
+   * @throws std::invalid_argument If a partial quad is left over.
+   */
+  void Finish();
+
+ private:
+  char pending_[4] = {0, 0, 0, 0};  ///< Characters not yet forming a quad.
+  size_t pending_size_ = 0;         ///< Number of valid chars in pending_.
+  bool finished_ = false;           ///< Set once a padded quad was decoded.
+};
+
+}  // namespace rsa_app
+
+#endif  // RSA_APP_CODEC_H_
@@ -0,0 +1,158 @@
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <openssl/bio.h>
+#include <openssl/bn.h>
+#include <openssl/evp.h>
+#include "codec.h"
+
+// Base64 encoder as previously implemented in rsa.cpp (BIO chain per call).
+std::string BioBase64Encode(const std::string& input) {
+    BIO* bio = BIO_new(BIO_s_mem());
+    BIO* b64 = BIO_new(BIO_f_base64());
+    bio = BIO_push(b64, bio);
+
+    BIO_set_flags(bio, BIO_FLAGS_BASE64_NO_NL);
+    BIO_write(bio, input.data(), static_cast<int>(input.size()));
+    BIO_flush(bio);
+
+    char* encoded_data;
+    long len = BIO_get_mem_data(bio, &encoded_data);
+
+    std::string result(encoded_data, len);
+    BIO_free_all(bio);
+    return result;
+}
+
+// Base64 decoder built from the same BIO chain, for comparison.
+std::string BioBase64Decode(const std::string& input) {
+    BIO* bio = BIO_new_mem_buf(input.data(), static_cast<int>(input.size()));
+    BIO* b64 = BIO_new(BIO_f_base64());
+    bio = BIO_push(b64, bio);
+    BIO_set_flags(bio, BIO_FLAGS_BASE64_NO_NL);
+
+    std::string result(rsa_app::Base64DecodedMaxLength(input.size()), '\0');
+    int len = BIO_read(bio, result.data(), static_cast<int>(result.size()));
+    BIO_free_all(bio);
+    result.resize(len > 0 ? len : 0);
+    return result;
+}
+
+// Hex conversion as previously implemented in BigNumber::ToString.
+std::string Bn2HexEncode(const BIGNUM* bn) {
+    char* hex_str = BN_bn2hex(bn);
+    std::string result(hex_str);
+    OPENSSL_free(hex_str);
+    return result;
+}
+
+// Runs `operation` repeatedly for roughly 200 ms and returns MB/s of input.
+template <typename Operation>
+double MeasureThroughput(size_t bytes_per_call, Operation operation) {
+    using Clock = std::chrono::steady_clock;
+    size_t calls = 0;
+    auto start = Clock::now();
+    std::chrono::duration<double> elapsed{};
+    do {
+        for (int i = 0; i < 64; ++i) operation();
+        calls += 64;
+        elapsed = Clock::now() - start;
+    } while (elapsed.count() < 0.2);
+    return static_cast<double>(calls * bytes_per_call) / elapsed.count() / 1e6;
+}
+
+void PrintRow(const std::string& operation, size_t size, const std::string& path,
+              double mb_per_s, double baseline) {
+    std::cout << std::left << std::setw(16) << operation << std::right << std::setw(10) << size
+              << "  " << std::left << std::setw(8) << path << std::right << std::setw(12)
+              << std::fixed << std::setprecision(1) << mb_per_s << std::setw(10)
+              << std::setprecision(2) << mb_per_s / baseline << "x\n";
+}
+
+int main() {
+    std::cout << "Codec throughput (MB/s of input, speedup vs OpenSSL path)\n";
+    std::cout << std::left << std::setw(16) << "operation" << std::right << std::setw(10) << "bytes"
+              << "  " << std::left << std::setw(8) << "path" << std::right << std::setw(12)
+              << "MB/s" << std::setw(11) << "speedup\n";
+
+    std::vector<rsa_app::CodecKernel> kernels;
+    for (auto kernel : {rsa_app::CodecKernel::kScalar, rsa_app::CodecKernel::kSsse3,
+                        rsa_app::CodecKernel::kAvx2}) {
+        rsa_app::SetCodecKernel(kernel);
+        if (rsa_app::ActiveCodecKernel() == kernel) kernels.push_back(kernel);
+    }
+
+    std::mt19937 rng(42);
+    // 256/512 bytes are 2048/4096-bit ciphertexts; the larger sizes are bulk data.
+    for (size_t size : {256, 512, 4096, 1 << 20}) {
+        std::string input(size, '\0');
+        for (char& c : input) c = static_cast<char>(rng() & 0xFF);
+        std::string encoded = BioBase64Encode(input);
+        volatile size_t sink = 0;
+
+        double bio = MeasureThroughput(size, [&] { sink = sink + BioBase64Encode(input).size(); });
+        PrintRow("base64-encode", size, "bio", bio, bio);
+        std::string out(rsa_app::Base64EncodedLength(size), '\0');
+        for (auto kernel : kernels) {
+            rsa_app::SetCodecKernel(kernel);
+            double mb = MeasureThroughput(size, [&] {
+                sink = sink + rsa_app::Base64EncodeTo(
+                                  reinterpret_cast<const unsigned char*>(input.data()), size,
+                                  out.data());
+            });
+            PrintRow("base64-encode", size, rsa_app::CodecKernelName(kernel), mb, bio);
+        }
+
+        bio = MeasureThroughput(encoded.size(),
+                                [&] { sink = sink + BioBase64Decode(encoded).size(); });
+        PrintRow("base64-decode", size, "bio", bio, bio);
+        std::string decoded(rsa_app::Base64DecodedMaxLength(encoded.size()), '\0');
+        for (auto kernel : kernels) {
+            rsa_app::SetCodecKernel(kernel);
+            double mb = MeasureThroughput(encoded.size(), [&] {
+                sink = sink + rsa_app::Base64DecodeTo(
+                                  encoded.data(), encoded.size(),
+                                  reinterpret_cast<unsigned char*>(decoded.data()));
+            });
+            PrintRow("base64-decode", size, rsa_app::CodecKernelName(kernel), mb, bio);
+        }
+
+        BIGNUM* bn = BN_bin2bn(reinterpret_cast<const unsigned char*>(input.data()),
+                               static_cast<int>(size), nullptr);
+        double bn2hex = MeasureThroughput(size, [&] { sink = sink + Bn2HexEncode(bn).size(); });
+        PrintRow("hex-encode", size, "bn2hex", bn2hex, bn2hex);
+        std::string hex(2 * size, '\0');
+        for (auto kernel : kernels) {
+            rsa_app::SetCodecKernel(kernel);
+            double mb = MeasureThroughput(size, [&] {
+                sink = sink + rsa_app::HexEncodeTo(
+                                  reinterpret_cast<const unsigned char*>(input.data()), size,
+                                  hex.data(), true);
+            });
+            PrintRow("hex-encode", size, rsa_app::CodecKernelName(kernel), mb, bn2hex);
+        }
+
+        std::string hex_text = Bn2HexEncode(bn);
+        double hex2bn = MeasureThroughput(size, [&] {
+            BIGNUM* parsed = nullptr;
+            sink = sink + BN_hex2bn(&parsed, hex_text.c_str());
+            BN_free(parsed);
+        });
+        PrintRow("hex-decode", size, "hex2bn", hex2bn, hex2bn);
+        for (auto kernel : kernels) {
+            rsa_app::SetCodecKernel(kernel);
+            double mb = MeasureThroughput(size, [&] {
+                sink = sink + rsa_app::HexDecodeTo(
+                                  hex_text.data(), hex_text.size(),
+                                  reinterpret_cast<unsigned char*>(decoded.data()));
+            });
+            PrintRow("hex-decode", size, rsa_app::CodecKernelName(kernel), mb, hex2bn);
+        }
+        BN_free(bn);
+    }
+    return 0;
+}
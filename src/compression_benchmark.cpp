@@ -0,0 +1,164 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "block_codec.h"
+#include "lz.h"
+#include "rsa.h"
+#include "thread_pool.h"
+
+// Measures what the LZ stage in front of the block codec buys: blocks (and
+// so modular exponentiations) saved per message, the cost of compressing
+// and decompressing, and end-to-end encrypt+decrypt throughput with and
+// without compression on generated corpora shaped like the traffic we
+// encrypt.
+
+using Clock = std::chrono::steady_clock;
+
+const std::vector<std::string>& Words() {
+    static const std::vector<std::string> words = {
+        "the", "key", "of", "and", "a", "to", "message", "is", "in", "block", "that", "server",
+        "for", "request", "with", "modulus", "as", "on", "client", "by", "prime", "this",
+        "encrypted", "be", "from", "signature", "are", "at", "session", "or", "certificate",
+        "exponent", "an", "which", "payload", "not", "random", "stream", "it", "latency"};
+    return words;
+}
+
+// Prose with a skewed word distribution
+std::string MakeText(size_t bytes, std::mt19937_64& rng) {
+    std::geometric_distribution<size_t> pick(0.12);
+    std::string text;
+    size_t in_sentence = 0;
+    while (text.size() < bytes) {
+        std::string word = Words()[pick(rng) % Words().size()];
+        if (in_sentence == 0) word[0] = static_cast<char>(word[0] - 'a' + 'A');
+        text += word;
+        if (++in_sentence > 8 + rng() % 10) {
+            text += ". ";
+            in_sentence = 0;
+        } else {
+            text += ' ';
+        }
+    }
+    text.resize(bytes);
+    return text;
+}
+
+// API responses: repeated keys, short varying values
+std::string MakeJson(size_t bytes, std::mt19937_64& rng) {
+    std::string json = "[";
+    for (uint64_t id = 1000; json.size() < bytes; ++id) {
+        json += "{\"id\":" + std::to_string(id) + ",\"tenant\":\"tenant-" +
+                std::to_string(rng() % 40) + "\",\"status\":\"" +
+                (rng() % 5 ? "active" : "suspended") + "\",\"key_bits\":" +
+                (rng() % 3 ? "2048" : "4096") + ",\"requests\":" + std::to_string(rng() % 100000) +
+                ",\"tags\":[\"" + Words()[rng() % Words().size()] + "\",\"" +
+                Words()[rng() % Words().size()] + "\"]},";
+    }
+    json.resize(bytes);
+    return json;
+}
+
+// Access-log lines with timestamps and latencies
+std::string MakeLogs(size_t bytes, std::mt19937_64& rng) {
+    static const char* kPaths[] = {"/v1/encrypt", "/v1/decrypt", "/v1/keys", "/healthz"};
+    std::string logs;
+    for (uint64_t second = 1700000000; logs.size() < bytes; second += rng() % 3) {
+        logs += std::to_string(second) + " 10.0." + std::to_string(rng() % 4) + "." +
+                std::to_string(rng() % 256) + " POST " + kPaths[rng() % 4] + " " +
+                (rng() % 50 ? "200" : "503") + " " + std::to_string(rng() % 5000) + "us\n";
+    }
+    logs.resize(bytes);
+    return logs;
+}
+
+std::string MakeRandom(size_t bytes, std::mt19937_64& rng) {
+    std::string data(bytes, '\0');
+    for (char& c : data) c = static_cast<char>(rng());
+    return data;
+}
+
+template <typename Fn>
+double Seconds(Fn fn) {
+    auto start = Clock::now();
+    fn();
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    return elapsed.count();
+}
+
+int main(int argc, char** argv) {
+    size_t bytes = 256 * 1024;
+    int bits = 2048;
+    size_t threads = rsa_app::ThreadPool::DefaultThreadCount();
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--bytes") {
+            bytes = std::stoul(argv[i + 1]);
+        } else if (flag == "--bits") {
+            bits = std::stoi(argv[i + 1]);
+        } else if (flag == "--threads") {
+            threads = std::stoul(argv[i + 1]);
+        } else {
+            std::cerr << "Unknown option " << flag
+                      << " (supported: --bytes N, --bits N, --threads N)\n";
+            return 2;
+        }
+    }
+
+    std::mt19937_64 rng(42);
+    struct Corpus {
+        const char* name;
+        std::string data;
+    };
+    std::vector<Corpus> corpora = {{"text", MakeText(bytes, rng)},
+                                   {"json", MakeJson(bytes, rng)},
+                                   {"logs", MakeLogs(bytes, rng)},
+                                   {"random", MakeRandom(bytes, rng)}};
+
+    rsa_app::KeyPair key = rsa_app::GenerateKeyPair(bits);
+    rsa_app::ThreadPool pool(threads);
+    double megabytes = static_cast<double>(bytes) / (1024.0 * 1024.0);
+    std::cout << bytes << "-byte messages, " << bits << "-bit key, " << threads << " threads\n\n";
+    std::cout << std::left << std::setw(8) << "corpus" << std::right << std::setw(8) << "ratio"
+              << std::setw(10) << "lz MB/s" << std::setw(11) << "unlz MB/s" << std::setw(9)
+              << "blocks" << std::setw(9) << "packed" << std::setw(12) << "modexp -%"
+              << std::setw(11) << "raw MB/s" << std::setw(10) << "lz MB/s" << std::setw(9)
+              << "speedup\n";
+    for (const Corpus& corpus : corpora) {
+        std::string compressed;
+        double compress = Seconds([&] { compressed = rsa_app::LzCompress(corpus.data); });
+        double decompress = Seconds([&] {
+            if (rsa_app::LzDecompress(compressed) != corpus.data) {
+                throw std::runtime_error("LZ round trip failed");
+            }
+        });
+
+        // End to end: pack, encrypt, decrypt, unpack.
+        size_t plain_blocks = 0, packed_blocks = 0;
+        auto round_trip = [&](rsa_app::BlockCompression compression, size_t& blocks) {
+            std::vector<BigNumber> ciphertexts =
+                rsa_app::EncryptMessage(corpus.data, key.public_key, pool, compression);
+            blocks = ciphertexts.size();
+            if (rsa_app::DecryptMessage(ciphertexts, key.private_key, pool) != corpus.data) {
+                throw std::runtime_error("Block round trip failed");
+            }
+        };
+        double raw = Seconds([&] { round_trip(rsa_app::BlockCompression::kNone, plain_blocks); });
+        double lz = Seconds([&] { round_trip(rsa_app::BlockCompression::kAuto, packed_blocks); });
+
+        double saved = 100.0 * (1.0 - static_cast<double>(packed_blocks) / plain_blocks);
+        std::cout << std::left << std::setw(8) << corpus.name << std::right << std::fixed
+                  << std::setprecision(2) << std::setw(8)
+                  << static_cast<double>(corpus.data.size()) / compressed.size()
+                  << std::setprecision(1) << std::setw(10) << megabytes / compress
+                  << std::setw(11) << megabytes / decompress << std::setw(9) << plain_blocks
+                  << std::setw(9) << packed_blocks << std::setw(12) << saved
+                  << std::setprecision(3) << std::setw(11) << megabytes / raw << std::setw(10)
+                  << megabytes / lz << std::setprecision(2) << std::setw(8) << raw / lz
+                  << "x\n";
+    }
+    return 0;
+}
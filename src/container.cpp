@@ -0,0 +1,274 @@
+#include "container.h"
+
+#include <fcntl.h>
+#include <openssl/evp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+
+#include "block_codec.h"
+
+namespace rsa_app {
+
+namespace {
+
+constexpr char kMagic[8] = {'R', 'S', 'A', 'B', 'L', 'K', 'C', '1'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kFingerprintBytes = 32;
+constexpr size_t kIndexEntryBytes = 8;
+
+void PutU32(unsigned char* out, uint32_t value) {
+  for (int i = 3; i >= 0; --i, value >>= 8) out[i] = static_cast<unsigned char>(value);
+}
+
+void PutU64(unsigned char* out, uint64_t value) {
+  for (int i = 7; i >= 0; --i, value >>= 8) out[i] = static_cast<unsigned char>(value);
+}
+
+uint32_t GetU32(const unsigned char* in) {
+  uint32_t value = 0;
+  for (int i = 0; i < 4; ++i) value = value << 8 | in[i];
+  return value;
+}
+
+uint64_t GetU64(const unsigned char* in) {
+  uint64_t value = 0;
+  for (int i = 0; i < 8; ++i) value = value << 8 | in[i];
+  return value;
+}
+
+}  // namespace
+
+std::string KeyFingerprint(const BigNumber& modulus) {
+  std::string bytes = modulus.ToBytes();
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int length = 0;
+  if (EVP_Digest(bytes.data(), bytes.size(), digest, &length, EVP_sha256(), nullptr) != 1) {
+    throw std::runtime_error("EVP_Digest failed");
+  }
+  return std::string(reinterpret_cast<char*>(digest), length);
+}
+
+ContainerWriter::ContainerWriter(const std::string& path, const PublicKey& public_key,
+                                 ThreadPool& pool, size_t batch_blocks)
+    : path_(path),
+      file_(path, std::ios::binary | std::ios::trunc),
+      public_key_(public_key),
+      pool_(pool),
+      batch_blocks_(std::max<size_t>(batch_blocks, 1)) {
+  if (!file_.is_open()) throw std::runtime_error("Cannot create container: " + path);
+  info_.modulus_bits = public_key.n.NumBits();
+  info_.block_bytes = static_cast<size_t>(BN_num_bytes(public_key.n.Get()));
+  info_.block_capacity = BlockCapacity(public_key);
+  info_.fingerprint = KeyFingerprint(public_key.n);
+  // The header is zero until Finish writes it.
+  std::string placeholder(kContainerHeaderBytes, '\0');
+  file_.write(placeholder.data(), static_cast<std::streamsize>(placeholder.size()));
+}
+
+void ContainerWriter::Append(const std::string& data) {
+  if (finished_) throw std::logic_error("Container already finished");
+  pending_ += data;
+  info_.plaintext_size += data.size();
+  if (pending_.size() >= batch_blocks_ * info_.block_capacity) Flush(false);
+}
+
+void ContainerWriter::Flush(bool final) {
+  size_t capacity = info_.block_capacity;
+  size_t count = final ? (pending_.size() + capacity - 1) / capacity : pending_.size() / capacity;
+  std::vector<BigNumber> blocks(count);
+  pool_.ParallelFor(count, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      size_t length = std::min(capacity, pending_.size() - i * capacity);
+      std::vector<BigNumber> packed =
+          PackBlocks(pending_.substr(i * capacity, length), info_.modulus_bits);
+      blocks[i] = Encrypt(packed[0], public_key_);
+    }
+  });
+
+  uint64_t offset = info_.plaintext_size - pending_.size();
+  for (size_t i = 0; i < count; ++i) {
+    std::string bytes = blocks[i].ToBytes(info_.block_bytes);
+    file_.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    offsets_.push_back(offset + i * capacity);
+  }
+  pending_.erase(0, std::min(pending_.size(), count * capacity));
+  info_.block_count = offsets_.size();
+  if (!file_.good()) throw std::runtime_error("Failed to write container: " + path_);
+}
+
+ContainerInfo ContainerWriter::Finish() {
+  if (finished_) throw std::logic_error("Container already finished");
+  finished_ = true;
+  Flush(true);
+
+  std::vector<unsigned char> index(offsets_.size() * kIndexEntryBytes);
+  for (size_t i = 0; i < offsets_.size(); ++i) PutU64(&index[i * kIndexEntryBytes], offsets_[i]);
+  file_.write(reinterpret_cast<const char*>(index.data()),
+              static_cast<std::streamsize>(index.size()));
+
+  unsigned char header[kContainerHeaderBytes] = {};
+  std::memcpy(header, kMagic, sizeof(kMagic));
+  PutU32(header + 8, kVersion);
+  PutU32(header + 12, static_cast<uint32_t>(kContainerHeaderBytes));
+  PutU32(header + 16, static_cast<uint32_t>(info_.modulus_bits));
+  PutU32(header + 20, static_cast<uint32_t>(info_.block_bytes));
+  PutU32(header + 24, static_cast<uint32_t>(info_.block_capacity));
+  PutU64(header + 32, info_.block_count);
+  PutU64(header + 40, info_.plaintext_size);
+  std::memcpy(header + 48, info_.fingerprint.data(), kFingerprintBytes);
+  file_.seekp(0);
+  file_.write(reinterpret_cast<const char*>(header), sizeof(header));
+  file_.close();
+  if (file_.fail()) throw std::runtime_error("Failed to write container: " + path_);
+  return info_;
+}
+
+ContainerReader::ContainerReader(const std::string& path) : path_(path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) throw std::runtime_error("Cannot open container: " + path + ": " + strerror(errno));
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    int error = errno;
+    close(fd);
+    throw std::runtime_error("Cannot stat container: " + path + ": " + strerror(error));
+  }
+  size_ = static_cast<size_t>(st.st_size);
+  if (size_ < kContainerHeaderBytes) {
+    close(fd);
+    throw std::invalid_argument("Not a container: " + path);
+  }
+  void* mapped = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    throw std::runtime_error("Cannot map container: " + path + ": " + strerror(errno));
+  }
+  data_ = static_cast<const unsigned char*>(mapped);
+  // Reads jump to the covering blocks; read-ahead would only waste I/O.
+  madvise(mapped, size_, MADV_RANDOM);
+
+  try {
+    if (std::memcmp(data_, kMagic, sizeof(kMagic)) != 0 || GetU32(data_ + 8) != kVersion ||
+        GetU32(data_ + 12) != kContainerHeaderBytes) {
+      throw std::invalid_argument("Not a container: " + path);
+    }
+    info_.modulus_bits = static_cast<int>(GetU32(data_ + 16));
+    info_.block_bytes = GetU32(data_ + 20);
+    info_.block_capacity = GetU32(data_ + 24);
+    info_.block_count = GetU64(data_ + 32);
+    info_.plaintext_size = GetU64(data_ + 40);
+    info_.fingerprint.assign(reinterpret_cast<const char*>(data_ + 48), kFingerprintBytes);
+
+    bool sizes_ok = info_.modulus_bits > 0 &&
+                    info_.block_bytes == static_cast<size_t>(info_.modulus_bits + 7) / 8 &&
+                    info_.block_capacity == BlockCapacity(info_.modulus_bits);
+    // Each block carries at least one byte and at most the capacity.
+    uint64_t per_entry = info_.block_bytes + kIndexEntryBytes;
+    sizes_ok = sizes_ok && info_.block_count <= (size_ - kContainerHeaderBytes) / per_entry &&
+               kContainerHeaderBytes + info_.block_count * per_entry == size_ &&
+               info_.plaintext_size >= info_.block_count &&
+               info_.plaintext_size <= info_.block_count * info_.block_capacity;
+    if (!sizes_ok) throw std::invalid_argument("Corrupt container header: " + path);
+    index_ = data_ + kContainerHeaderBytes + info_.block_count * info_.block_bytes;
+  } catch (...) {
+    munmap(const_cast<unsigned char*>(data_), size_);
+    throw;
+  }
+}
+
+ContainerReader::~ContainerReader() { munmap(const_cast<unsigned char*>(data_), size_); }
+
+uint64_t ContainerReader::BlockOffset(uint64_t i) const {
+  return i == info_.block_count ? info_.plaintext_size
+                                : GetU64(index_ + i * kIndexEntryBytes);
+}
+
+std::pair<uint64_t, uint64_t> ContainerReader::CoveringBlocks(uint64_t offset,
+                                                              uint64_t length) const {
+  if (offset > info_.plaintext_size || length > info_.plaintext_size - offset) {
+    throw std::out_of_range("Range beyond the container's plaintext");
+  }
+  if (length == 0) return {0, 0};
+  // The last block whose start is <= `position`.
+  auto find = [this](uint64_t position) {
+    uint64_t low = 0, high = info_.block_count;
+    while (high - low > 1) {
+      uint64_t mid = low + (high - low) / 2;
+      if (BlockOffset(mid) <= position) {
+        low = mid;
+      } else {
+        high = mid;
+      }
+    }
+    return low;
+  };
+  uint64_t first = find(offset);
+  uint64_t last = find(offset + length - 1) + 1;
+  // Only the entries bounding the covering blocks are checked.
+  if (BlockOffset(first) > offset || BlockOffset(last) < offset + length ||
+      (first == 0 && BlockOffset(0) != 0)) {
+    throw std::invalid_argument("Corrupt container index: " + path_);
+  }
+  return {first, last};
+}
+
+std::string ContainerReader::Read(uint64_t offset, uint64_t length,
+                                  const PrivateKey& private_key, ThreadPool& pool) const {
+  std::pair<uint64_t, uint64_t> blocks = CoveringBlocks(offset, length);
+  if (length == 0) return std::string();
+  if (KeyFingerprint(private_key.n) != info_.fingerprint) {
+    throw std::invalid_argument("Key does not match the container: " + path_);
+  }
+
+  uint64_t first = blocks.first;
+  size_t count = static_cast<size_t>(blocks.second - blocks.first);
+  std::vector<std::string> payloads(count);
+  std::vector<std::exception_ptr> errors(count);
+  pool.ParallelFor(count, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      try {
+        uint64_t block = first + i;
+        uint64_t start = BlockOffset(block);
+        uint64_t next = BlockOffset(block + 1);
+        if (next <= start || next - start > info_.block_capacity) {
+          throw std::invalid_argument("Corrupt container index: " + path_);
+        }
+        const unsigned char* bytes =
+            data_ + kContainerHeaderBytes + block * info_.block_bytes;
+        std::vector<BigNumber> plain;
+        plain.push_back(Decrypt(
+            BigNumber::FromBytes(std::string(reinterpret_cast<const char*>(bytes),
+                                             info_.block_bytes)),
+            private_key));
+        payloads[i] = UnpackBlocks(plain, info_.modulus_bits);
+        if (payloads[i].size() != next - start) {
+          throw std::invalid_argument("Container block " + std::to_string(block) +
+                                      " does not match the index");
+        }
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    }
+  });
+  for (const auto& error : errors) {
+    if (error) std::rethrow_exception(error);
+  }
+
+  std::string out;
+  out.reserve(static_cast<size_t>(length));
+  uint64_t skip = offset - BlockOffset(first);
+  for (const auto& payload : payloads) {
+    size_t take = static_cast<size_t>(std::min<uint64_t>(payload.size() - skip, length - out.size()));
+    out.append(payload, static_cast<size_t>(skip), take);
+    skip = 0;
+  }
+  return out;
+}
+
+}  // namespace rsa_app
@@ -0,0 +1,178 @@
+#ifndef RSA_APP_CONTAINER_H_
+#define RSA_APP_CONTAINER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rsa.h"
+#include "thread_pool.h"
+
+namespace rsa_app {
+
+/**
+ * Bytes of the fixed container header.
+ */
+constexpr size_t kContainerHeaderBytes = 80;
+
+/**
+ * Returns the SHA-256 digest of a modulus's big-endian bytes.
+ *
+ * Both halves of a key pair carry `n`, so encryptor and decryptor compute
+ * the same fingerprint.
+ */
+std::string KeyFingerprint(const BigNumber& modulus);
+
+/**
+ * What a container header records.
+ */
+struct ContainerInfo {
+  int modulus_bits = 0;
+  size_t block_bytes = 0;     // Width of every ciphertext block.
+  size_t block_capacity = 0;  // Most plaintext bytes per block.
+  uint64_t block_count = 0;
+  uint64_t plaintext_size = 0;
+  std::string fingerprint;    // `KeyFingerprint` of the key's modulus.
+};
+
+/**
+ * Writes an indexed ciphertext container.
+ *
+ * Layout, all integers big-endian:
+ *
+ *   header  `kContainerHeaderBytes`: magic "RSABLKC1", version, header size,
+ *           modulus bits, block width, block capacity, block count,
+ *           plaintext size and the key fingerprint
+ *   blocks  `block_count` ciphertexts of `block_bytes` each, so block `i`
+ *           sits at a computable offset
+ *   index   `block_count` 64-bit plaintext offsets, one per block
+ *
+ * Every block decrypts to a one-block `PackBlocks` message, so it can be
+ * decoded without its neighbours. The index follows the blocks because a
+ * streaming writer learns the count last; the header, including the
+ * magic, is written by `Finish`, so an unfinished file is never mistaken
+ * for a container.
+ *
+ * Blocks are encrypted in parallel batches; memory is bounded by one
+ * batch plus the index.
+ */
+class ContainerWriter {
+ public:
+  /**
+   * Creates or truncates `path`.
+   *
+   * @param path The container file.
+   * @param public_key The key to encrypt with; must outlive the writer.
+   * @param pool The thread pool that performs the exponentiations.
+   * @param batch_blocks Blocks encrypted per parallel batch.
+   * @throws std::runtime_error If the file cannot be created.
+   */
+  ContainerWriter(const std::string& path, const PublicKey& public_key, ThreadPool& pool,
+                  size_t batch_blocks = 256);
+
+  /**
+   * Appends plaintext.
+   *
+   * @throws std::runtime_error If writing fails.
+   * @throws std::logic_error After `Finish`.
+   */
+  void Append(const std::string& data);
+
+  /**
+   * Writes the remaining blocks, the index and the header.
+   *
+   * @return What the header records.
+   * @throws std::runtime_error If writing fails.
+   * @throws std::logic_error If called twice.
+   */
+  ContainerInfo Finish();
+
+ private:
+  // Encrypts and writes full blocks from `pending_`, or all of it if `final`.
+  void Flush(bool final);
+
+  std::string path_;
+  std::ofstream file_;
+  const PublicKey& public_key_;
+  ThreadPool& pool_;
+  size_t batch_blocks_;
+  ContainerInfo info_;
+  std::string pending_;           // Plaintext not yet in a block.
+  std::vector<uint64_t> offsets_;  // Plaintext offset of every written block.
+  bool finished_ = false;
+};
+
+/**
+ * Reads a container through a read-only `mmap`.
+ *
+ * Opening checks the header and the file size only; the blocks and index
+ * entries a read needs are checked when it touches them, so a partial
+ * read of a multi-gigabyte container costs the blocks it covers and not
+ * the whole file.
+ *
+ * Reads are thread-safe.
+ */
+class ContainerReader {
+ public:
+  /**
+   * Maps `path`.
+   *
+   * @throws std::runtime_error If the file cannot be opened or mapped.
+   * @throws std::invalid_argument If it is not a valid container.
+   */
+  explicit ContainerReader(const std::string& path);
+  ~ContainerReader();
+
+  ContainerReader(const ContainerReader&) = delete;
+  ContainerReader& operator=(const ContainerReader&) = delete;
+
+  /**
+   * Returns what the header records.
+   */
+  const ContainerInfo& Info() const { return info_; }
+
+  /**
+   * Returns the plaintext size.
+   */
+  uint64_t Size() const { return info_.plaintext_size; }
+
+  /**
+   * Returns the blocks `[first, last)` that cover plaintext bytes
+   * `[offset, offset + length)`; empty for an empty range.
+   *
+   * @throws std::out_of_range If the range exceeds the plaintext.
+   * @throws std::invalid_argument If the index is corrupt.
+   */
+  std::pair<uint64_t, uint64_t> CoveringBlocks(uint64_t offset, uint64_t length) const;
+
+  /**
+   * Decrypts plaintext bytes `[offset, offset + length)`.
+   *
+   * Only the covering blocks are read and decrypted, in parallel on
+   * `pool`.
+   *
+   * @throws std::out_of_range If the range exceeds the plaintext.
+   * @throws std::invalid_argument If the key does not match the
+   *         container's fingerprint or a covering block or index entry is
+   *         corrupt.
+   */
+  std::string Read(uint64_t offset, uint64_t length, const PrivateKey& private_key,
+                   ThreadPool& pool) const;
+
+ private:
+  // Plaintext offset of block `i`, from the index.
+  uint64_t BlockOffset(uint64_t i) const;
+
+  std::string path_;
+  ContainerInfo info_;
+  const unsigned char* data_ = nullptr;  // The mapped file.
+  size_t size_ = 0;
+  const unsigned char* index_ = nullptr;
+};
+
+}  // namespace rsa_app
+
+#endif  // RSA_APP_CONTAINER_H_
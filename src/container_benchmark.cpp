@@ -0,0 +1,106 @@
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "container.h"
+#include "rsa.h"
+#include "stats.h"
+#include "thread_pool.h"
+
+// Writes a container and compares decrypting it whole against decrypting
+// small random ranges: a range read costs the blocks that cover it, not the
+// file, so its latency should track the range length.
+
+using Clock = std::chrono::steady_clock;
+
+double Seconds(Clock::time_point start) {
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    return elapsed.count();
+}
+
+int main(int argc, char** argv) {
+    size_t bytes = 1024 * 1024;
+    int bits = 2048;
+    size_t threads = rsa_app::ThreadPool::DefaultThreadCount();
+    int reads = 50;
+    std::string path = "/tmp/rsa_container_benchmark_" + std::to_string(getpid());
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--bytes") {
+            bytes = std::stoul(argv[i + 1]);
+        } else if (flag == "--bits") {
+            bits = std::stoi(argv[i + 1]);
+        } else if (flag == "--threads") {
+            threads = std::stoul(argv[i + 1]);
+        } else if (flag == "--reads") {
+            reads = std::stoi(argv[i + 1]);
+        } else if (flag == "--path") {
+            path = argv[i + 1];
+        } else {
+            std::cerr << "Unknown option " << flag
+                      << " (supported: --bytes N, --bits N, --threads N, --reads N, --path P)\n";
+            return 2;
+        }
+    }
+
+    std::mt19937_64 rng(42);
+    std::string data(bytes, '\0');
+    for (char& c : data) c = static_cast<char>(rng());
+
+    rsa_app::KeyPair key = rsa_app::GenerateKeyPair(bits);
+    rsa_app::ThreadPool pool(threads);
+    double megabytes = static_cast<double>(bytes) / (1024.0 * 1024.0);
+
+    auto start = Clock::now();
+    rsa_app::ContainerWriter writer(path, key.public_key, pool);
+    for (size_t pos = 0; pos < data.size(); pos += 64 * 1024) writer.Append(data.substr(pos, 64 * 1024));
+    rsa_app::ContainerInfo info = writer.Finish();
+    double write = Seconds(start);
+
+    rsa_app::ContainerReader reader(path);
+    start = Clock::now();
+    if (reader.Read(0, bytes, key.private_key, pool) != data) {
+        throw std::runtime_error("Full read does not match");
+    }
+    double full = Seconds(start);
+
+    std::cout << bytes << " bytes, " << bits << "-bit key, " << threads << " threads, "
+              << info.block_count << " blocks of " << info.block_capacity << " bytes\n"
+              << std::fixed << std::setprecision(3) << "write " << write << " s ("
+              << megabytes / write << " MB/s), full read " << full << " s ("
+              << megabytes / full << " MB/s)\n\n";
+
+    std::cout << std::left << std::setw(10) << "range" << std::right << std::setw(10)
+              << "blocks" << std::setw(12) << "p50 ms" << std::setw(12) << "p99 ms"
+              << std::setw(14) << "vs full read\n";
+    for (size_t length : {size_t{100}, size_t{4096}, size_t{64 * 1024}}) {
+        if (length > bytes) continue;
+        std::vector<double> latencies;
+        double blocks = 0;
+        for (int i = 0; i < reads; ++i) {
+            uint64_t offset = rng() % (bytes - length + 1);
+            std::pair<uint64_t, uint64_t> covering = reader.CoveringBlocks(offset, length);
+            blocks += static_cast<double>(covering.second - covering.first);
+            start = Clock::now();
+            std::string range = reader.Read(offset, length, key.private_key, pool);
+            latencies.push_back(Seconds(start) * 1e3);
+            if (range != data.substr(offset, length)) {
+                throw std::runtime_error("Range read does not match");
+            }
+        }
+        std::sort(latencies.begin(), latencies.end());
+        double p50 = rsa_app::Percentile(latencies, 0.5);
+        std::cout << std::left << std::setw(10) << length << std::right << std::setprecision(1)
+                  << std::setw(10) << blocks / reads << std::setprecision(3) << std::setw(12)
+                  << p50 << std::setw(12) << rsa_app::Percentile(latencies, 0.99)
+                  << std::setprecision(4) << std::setw(12) << p50 / (full * 1e3) << "x\n";
+    }
+    std::remove(path.c_str());
+    return 0;
+}
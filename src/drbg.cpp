@@ -0,0 +1,173 @@
+#include "drbg.h"
+
+#include <openssl/crypto.h>
+#include <openssl/rand.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <sys/random.h>
+#endif
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+namespace rsa_app {
+
+namespace {
+
+// Bumped in the child after fork() so that system-seeded generators do not
+// repeat their parent's output.
+std::atomic<uint64_t> fork_generation{0};
+
+uint64_t CurrentForkGeneration() {
+#ifndef _WIN32
+  static std::once_flag registered;
+  std::call_once(registered, [] {
+    pthread_atfork(nullptr, nullptr, [] { fork_generation.fetch_add(1); });
+  });
+#endif
+  return fork_generation.load(std::memory_order_relaxed);
+}
+
+void SystemEntropy(unsigned char* out, size_t length) {
+#if defined(__linux__)
+  while (length > 0) {
+    ssize_t got = getrandom(out, length, 0);
+    if (got < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    out += got;
+    length -= static_cast<size_t>(got);
+  }
+  if (length == 0) return;
+#endif
+  if (RAND_priv_bytes(out, static_cast<int>(length)) != 1) {
+    throw std::runtime_error("No system entropy available for the DRBG");
+  }
+}
+
+inline uint32_t Rotate(uint32_t value, int shift) {
+  return (value << shift) | (value >> (32 - shift));
+}
+
+inline void QuarterRound(uint32_t* x, int a, int b, int c, int d) {
+  x[a] += x[b]; x[d] = Rotate(x[d] ^ x[a], 16);
+  x[c] += x[d]; x[b] = Rotate(x[b] ^ x[c], 12);
+  x[a] += x[b]; x[d] = Rotate(x[d] ^ x[a], 8);
+  x[c] += x[d]; x[b] = Rotate(x[b] ^ x[c], 7);
+}
+
+// Writes ChaCha20 block `counter` of `key` with an all-zero nonce (RFC 8439).
+void ChaChaBlock(const uint32_t key[8], uint32_t counter, unsigned char* out) {
+  uint32_t state[16] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+  std::copy(key, key + 8, state + 4);
+  state[12] = counter;
+  uint32_t x[16];
+  std::copy(state, state + 16, x);
+  for (int round = 0; round < 10; ++round) {
+    QuarterRound(x, 0, 4, 8, 12);
+    QuarterRound(x, 1, 5, 9, 13);
+    QuarterRound(x, 2, 6, 10, 14);
+    QuarterRound(x, 3, 7, 11, 15);
+    QuarterRound(x, 0, 5, 10, 15);
+    QuarterRound(x, 1, 6, 11, 12);
+    QuarterRound(x, 2, 7, 8, 13);
+    QuarterRound(x, 3, 4, 9, 14);
+  }
+  for (int i = 0; i < 16; ++i) {
+    uint32_t word = x[i] + state[i];
+    for (int k = 0; k < 4; ++k) out[4 * i + k] = static_cast<unsigned char>(word >> (8 * k));
+  }
+  OPENSSL_cleanse(x, sizeof(x));
+  OPENSSL_cleanse(state, sizeof(state));
+}
+
+uint32_t LoadWord(const unsigned char* in) {
+  return static_cast<uint32_t>(in[0]) | static_cast<uint32_t>(in[1]) << 8 |
+         static_cast<uint32_t>(in[2]) << 16 | static_cast<uint32_t>(in[3]) << 24;
+}
+
+}  // namespace
+
+Drbg::Drbg() : deterministic_(false) {
+  Seed();
+}
+
+Drbg::Drbg(uint64_t seed, uint64_t stream) : deterministic_(true) {
+  key_[0] = static_cast<uint32_t>(seed);
+  key_[1] = static_cast<uint32_t>(seed >> 32);
+  key_[2] = static_cast<uint32_t>(stream);
+  key_[3] = static_cast<uint32_t>(stream >> 32);
+  // "rsa_app drbg" tag, keeping seeded keys apart from all-zero patterns.
+  key_[4] = 0x5f617372;
+  key_[5] = 0x20707061;
+  key_[6] = 0x67627264;
+  key_[7] = 0;
+}
+
+Drbg::~Drbg() {
+  OPENSSL_cleanse(key_, sizeof(key_));
+  OPENSSL_cleanse(buffer_, sizeof(buffer_));
+}
+
+void Drbg::Seed() {
+  unsigned char entropy[sizeof(key_)];
+  SystemEntropy(entropy, sizeof(entropy));
+  // XOR so that a reseed keeps the entropy already in the key.
+  for (size_t i = 0; i < 8; ++i) key_[i] ^= LoadWord(entropy + 4 * i);
+  OPENSSL_cleanse(entropy, sizeof(entropy));
+  OPENSSL_cleanse(buffer_, sizeof(buffer_));
+  available_ = 0;
+  since_reseed_ = 0;
+  fork_generation_ = CurrentForkGeneration();
+}
+
+void Drbg::Refill() {
+  for (size_t block = 0; block < kBufferBlocks; ++block) {
+    ChaChaBlock(key_, static_cast<uint32_t>(block), buffer_ + block * kBlockBytes);
+  }
+  // Fast key erasure: the first 32 bytes become the next key.
+  for (size_t i = 0; i < 8; ++i) key_[i] = LoadWord(buffer_ + 4 * i);
+  OPENSSL_cleanse(buffer_, sizeof(key_));
+  available_ = sizeof(buffer_) - sizeof(key_);
+}
+
+void Drbg::Generate(unsigned char* out, size_t length) {
+  if (!deterministic_ && (since_reseed_ >= kReseedInterval ||
+                          fork_generation_ != CurrentForkGeneration())) {
+    Seed();
+  }
+  since_reseed_ += length;
+  while (length > 0) {
+    if (available_ == 0) Refill();
+    size_t offset = sizeof(buffer_) - available_;
+    size_t take = std::min(length, available_);
+    std::memcpy(out, buffer_ + offset, take);
+    OPENSSL_cleanse(buffer_ + offset, take);
+    available_ -= take;
+    out += take;
+    length -= take;
+  }
+}
+
+uint64_t Drbg::NextWord() {
+  unsigned char bytes[8];
+  Generate(bytes, sizeof(bytes));
+  uint64_t word = 0;
+  for (int k = 7; k >= 0; --k) word = (word << 8) | bytes[k];
+  return word;
+}
+
+Drbg& ThreadDrbg() {
+  thread_local Drbg drbg;
+  return drbg;
+}
+
+}  // namespace rsa_app
@@ -0,0 +1,94 @@
+#ifndef RSA_APP_DRBG_H_
+#define RSA_APP_DRBG_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rsa_app {
+
+/**
+ * A ChaCha20 random bit generator owned by one thread.
+ *
+ * Output is the ChaCha20 keystream with fast key erasure: every refill of
+ * the internal buffer replaces the key with the first 32 keystream bytes,
+ * so earlier output cannot be recovered from the current state. Nothing is
+ * shared between instances, so concurrent generators never contend.
+ *
+ * A default-constructed generator is seeded from the system entropy source
+ * (`getrandom` on Linux, OpenSSL's private RNG elsewhere), mixes in fresh
+ * entropy every `kReseedInterval` bytes and reseeds after `fork()`. A
+ * seeded generator is deterministic and meant for reproducible tests and
+ * benchmarks only.
+ *
+ * Instances are not thread-safe; use one per thread, e.g. `ThreadDrbg()`.
+ */
+class Drbg {
+ public:
+  /**
+   * Bytes a system-seeded generator produces before mixing in new entropy.
+   */
+  static constexpr uint64_t kReseedInterval = uint64_t{1} << 20;
+
+  /**
+   * Creates a generator seeded from the system entropy source.
+   *
+   * @throws std::runtime_error If no entropy is available.
+   */
+  Drbg();
+
+  /**
+   * Creates a deterministic generator.
+   *
+   * @param seed The seed; equal seeds and streams give equal output.
+   * @param stream Selects one of 2^64 independent sequences per seed.
+   */
+  Drbg(uint64_t seed, uint64_t stream);
+
+  /**
+   * Erases the key and buffered output.
+   */
+  ~Drbg();
+
+  Drbg(const Drbg&) = delete;
+  Drbg& operator=(const Drbg&) = delete;
+
+  /**
+   * Fills `out` with `length` random bytes.
+   *
+   * @throws std::runtime_error If reseeding from the system fails.
+   */
+  void Generate(unsigned char* out, size_t length);
+
+  /**
+   * Returns 64 random bits.
+   */
+  uint64_t NextWord();
+
+  /**
+   * Returns true if the generator was created from a seed.
+   */
+  bool Deterministic() const { return deterministic_; }
+
+ private:
+  void Seed();
+  void Refill();
+
+  static constexpr size_t kBlockBytes = 64;
+  static constexpr size_t kBufferBlocks = 8;
+
+  uint32_t key_[8] = {};
+  unsigned char buffer_[kBlockBytes * kBufferBlocks];
+  size_t available_ = 0;  // Unused bytes at the end of `buffer_`.
+  uint64_t since_reseed_ = 0;
+  uint64_t fork_generation_ = 0;
+  bool deterministic_;
+};
+
+/**
+ * Returns the calling thread's system-seeded generator.
+ */
+Drbg& ThreadDrbg();
+
+}  // namespace rsa_app
+
+#endif  // RSA_APP_DRBG_H_
@@ -0,0 +1,311 @@
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <openssl/bn.h>
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/param_build.h>
+#include <openssl/rsa.h>
+#include "bn_wrapper.h"
+#include "rsa.h"
+#include "thread_pool.h"
+
+// Compares rsa_app::Encrypt/Decrypt with OpenSSL's raw (unpadded) EVP RSA on
+// the same keys and messages. Both sides take and return modulus-width byte
+// strings, so the wrapper pays for its BigNumber conversions just as a caller
+// would.
+
+using Clock = std::chrono::steady_clock;
+
+// The paths being compared
+enum class Path { kWrapper, kEvpCrt, kEvpNoCrt };
+
+const char* PathName(Path path) {
+    switch (path) {
+        case Path::kWrapper:
+            return "rsa_app";
+        case Path::kEvpCrt:
+            return "evp_crt";
+        case Path::kEvpNoCrt:
+            return "evp_no_crt";
+    }
+    return "unknown";
+}
+
+void Check(bool ok, const char* what) {
+    if (!ok) throw std::runtime_error(std::string(what) + " failed");
+}
+
+BigNumber GetParam(const EVP_PKEY* pkey, const char* name) {
+    BIGNUM* value = nullptr;
+    Check(EVP_PKEY_get_bn_param(pkey, name, &value) == 1, "EVP_PKEY_get_bn_param");
+    BigNumber result;
+    Check(BN_copy(result.Get(), value) != nullptr, "BN_copy");
+    BN_free(value);
+    return result;
+}
+
+// One key in the three forms under test
+struct BenchKey {
+    int bits = 0;
+    size_t width = 0;
+    rsa_app::KeyPair pair;
+    EVP_PKEY* crt = nullptr;     // From EVP_RSA_gen: p, q and the CRT exponents.
+    EVP_PKEY* no_crt = nullptr;  // Only n, e and d, like rsa_app::PrivateKey.
+
+    BenchKey() = default;
+    BenchKey(const BenchKey&) = delete;
+    BenchKey& operator=(const BenchKey&) = delete;
+    ~BenchKey() {
+        EVP_PKEY_free(crt);
+        EVP_PKEY_free(no_crt);
+    }
+};
+
+void MakeKey(int bits, BenchKey& key) {
+    key.bits = bits;
+    key.width = static_cast<size_t>(bits + 7) / 8;
+    key.crt = EVP_RSA_gen(static_cast<unsigned int>(bits));
+    Check(key.crt != nullptr, "EVP_RSA_gen");
+    key.pair.public_key.n = GetParam(key.crt, OSSL_PKEY_PARAM_RSA_N);
+    key.pair.public_key.e = GetParam(key.crt, OSSL_PKEY_PARAM_RSA_E);
+    key.pair.private_key.n = key.pair.public_key.n.Copy();
+    key.pair.private_key.d = GetParam(key.crt, OSSL_PKEY_PARAM_RSA_D);
+
+    OSSL_PARAM_BLD* builder = OSSL_PARAM_BLD_new();
+    Check(builder != nullptr, "OSSL_PARAM_BLD_new");
+    OSSL_PARAM_BLD_push_BN(builder, OSSL_PKEY_PARAM_RSA_N, key.pair.public_key.n.Get());
+    OSSL_PARAM_BLD_push_BN(builder, OSSL_PKEY_PARAM_RSA_E, key.pair.public_key.e.Get());
+    OSSL_PARAM_BLD_push_BN(builder, OSSL_PKEY_PARAM_RSA_D, key.pair.private_key.d.Get());
+    OSSL_PARAM* params = OSSL_PARAM_BLD_to_param(builder);
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_from_name(nullptr, "RSA", nullptr);
+    bool ok = params && ctx && EVP_PKEY_fromdata_init(ctx) == 1 &&
+              EVP_PKEY_fromdata(ctx, &key.no_crt, EVP_PKEY_KEYPAIR, params) == 1;
+    EVP_PKEY_CTX_free(ctx);
+    OSSL_PARAM_free(params);
+    OSSL_PARAM_BLD_free(builder);
+    Check(ok, "EVP_PKEY_fromdata");
+}
+
+// A raw RSA context for one thread
+class EvpContext {
+  public:
+    EvpContext(EVP_PKEY* pkey, bool decrypt) : decrypt_(decrypt) {
+        ctx_ = EVP_PKEY_CTX_new_from_pkey(nullptr, pkey, nullptr);
+        Check(ctx_ != nullptr, "EVP_PKEY_CTX_new_from_pkey");
+        int init = decrypt ? EVP_PKEY_decrypt_init(ctx_) : EVP_PKEY_encrypt_init(ctx_);
+        Check(init == 1 && EVP_PKEY_CTX_set_rsa_padding(ctx_, RSA_NO_PADDING) == 1,
+              "EVP_PKEY init");
+    }
+    ~EvpContext() { EVP_PKEY_CTX_free(ctx_); }
+    EvpContext(const EvpContext&) = delete;
+    EvpContext& operator=(const EvpContext&) = delete;
+
+    void Run(const std::string& in, std::string& out) {
+        size_t length = out.size();
+        auto* dst = reinterpret_cast<unsigned char*>(&out[0]);
+        auto* src = reinterpret_cast<const unsigned char*>(in.data());
+        int ok = decrypt_ ? EVP_PKEY_decrypt(ctx_, dst, &length, src, in.size())
+                          : EVP_PKEY_encrypt(ctx_, dst, &length, src, in.size());
+        Check(ok == 1 && length == out.size(), "EVP_PKEY raw RSA");
+    }
+
+  private:
+    EVP_PKEY_CTX* ctx_;
+    bool decrypt_;
+};
+
+EVP_PKEY* PathKey(const BenchKey& key, Path path) {
+    return path == Path::kEvpNoCrt ? key.no_crt : key.crt;
+}
+
+// One operation through `path`; `evp` is null for the wrapper.
+void RunOnce(const BenchKey& key, bool decrypt, EvpContext* evp, const std::string& in,
+             std::string& out) {
+    if (evp) {
+        evp->Run(in, out);
+        return;
+    }
+    BigNumber input = BigNumber::FromBytes(in);
+    BigNumber result = decrypt ? rsa_app::Decrypt(input, key.pair.private_key)
+                               : rsa_app::Encrypt(input, key.pair.public_key);
+    out = result.ToBytes(key.width);
+}
+
+// Runs `path` on every worker of a `threads`-wide pool for `seconds` and
+// returns operations per second.
+double MeasureThroughput(const BenchKey& key, bool decrypt, Path path, size_t threads,
+                         const std::vector<std::string>& inputs, double seconds) {
+    rsa_app::ThreadPool pool(threads);
+    std::atomic<size_t> operations{0};
+    auto start = Clock::now();
+    auto deadline = start + std::chrono::duration<double>(seconds);
+    pool.ParallelFor(threads, [&](size_t begin, size_t end) {
+        for (size_t worker = begin; worker < end; ++worker) {
+            std::unique_ptr<EvpContext> evp;
+            if (path != Path::kWrapper) {
+                evp = std::make_unique<EvpContext>(PathKey(key, path), decrypt);
+            }
+            std::string out(key.width, '\0');
+            size_t done = 0;
+            for (size_t i = worker; Clock::now() < deadline; i += threads, ++done) {
+                RunOnce(key, decrypt, evp.get(), inputs[i % inputs.size()], out);
+            }
+            operations += done;
+        }
+    });
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    return static_cast<double>(operations) / elapsed.count();
+}
+
+// Mean microseconds of each phase of one operation
+struct Phases {
+    std::vector<std::pair<std::string, double>> micros;
+
+    double Total() const {
+        double total = 0.0;
+        for (const auto& phase : micros) total += phase.second;
+        return total;
+    }
+};
+
+// Times the phases of `path` on one thread, each operation from scratch.
+Phases MeasurePhases(const BenchKey& key, bool decrypt, Path path,
+                     const std::vector<std::string>& inputs, size_t iterations) {
+    std::vector<double> seconds(3, 0.0);
+    std::string out(key.width, '\0');
+    for (size_t i = 0; i < iterations; ++i) {
+        const std::string& in = inputs[i % inputs.size()];
+        auto t0 = Clock::now();
+        if (path == Path::kWrapper) {
+            BigNumber input = BigNumber::FromBytes(in);
+            auto t1 = Clock::now();
+            BigNumber result = decrypt ? rsa_app::Decrypt(input, key.pair.private_key)
+                                       : rsa_app::Encrypt(input, key.pair.public_key);
+            auto t2 = Clock::now();
+            out = result.ToBytes(key.width);
+            auto t3 = Clock::now();
+            seconds[0] += std::chrono::duration<double>(t1 - t0).count();
+            seconds[1] += std::chrono::duration<double>(t2 - t1).count();
+            seconds[2] += std::chrono::duration<double>(t3 - t2).count();
+        } else {
+            EvpContext evp(PathKey(key, path), decrypt);
+            auto t1 = Clock::now();
+            evp.Run(in, out);
+            auto t2 = Clock::now();
+            seconds[0] += std::chrono::duration<double>(t1 - t0).count();
+            seconds[1] += std::chrono::duration<double>(t2 - t1).count();
+        }
+    }
+    Phases phases;
+    double scale = 1e6 / static_cast<double>(iterations);
+    if (path == Path::kWrapper) {
+        phases.micros = {{"bytes_to_bn", seconds[0] * scale},
+                         {"modexp", seconds[1] * scale},
+                         {"bn_to_bytes", seconds[2] * scale}};
+    } else {
+        phases.micros = {{"ctx_setup", seconds[0] * scale}, {"rsa_op", seconds[1] * scale}};
+    }
+    return phases;
+}
+
+std::vector<int> ParseSizes(const std::string& list) {
+    std::vector<int> sizes;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == std::string::npos) comma = list.size();
+        sizes.push_back(std::stoi(list.substr(start, comma - start)));
+        start = comma + 1;
+    }
+    return sizes;
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> sizes = {1024, 2048, 3072, 4096};
+    size_t max_threads = rsa_app::ThreadPool::DefaultThreadCount();
+    double seconds = 0.5;
+    size_t phase_iterations = 200;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--sizes") {
+            sizes = ParseSizes(argv[i + 1]);
+        } else if (flag == "--max-threads") {
+            max_threads = std::stoul(argv[i + 1]);
+        } else if (flag == "--seconds") {
+            seconds = std::stod(argv[i + 1]);
+        } else if (flag == "--phase-iterations") {
+            phase_iterations = std::stoul(argv[i + 1]);
+        } else {
+            std::cerr << "Unknown option " << flag
+                      << " (supported: --sizes LIST, --max-threads N, --seconds S,"
+                         " --phase-iterations N)\n";
+            return 2;
+        }
+    }
+
+    std::cout << "rsa_app vs raw EVP RSA (RSA_NO_PADDING), overhead = EVP ops/s / rsa_app ops/s\n";
+    for (int bits : sizes) {
+        BenchKey key;
+        MakeKey(bits, key);
+
+        // Random messages below n, their ciphertexts and a cross-check that
+        // all paths agree.
+        std::vector<std::string> messages, ciphertexts;
+        for (int i = 0; i < 16; ++i) {
+            BigNumber m;
+            Check(BN_rand_range(m.Get(), key.pair.public_key.n.Get()) == 1, "BN_rand_range");
+            messages.push_back(m.ToBytes(key.width));
+            ciphertexts.push_back(rsa_app::Encrypt(m, key.pair.public_key).ToBytes(key.width));
+        }
+        std::string out(key.width, '\0');
+        for (Path path : {Path::kEvpCrt, Path::kEvpNoCrt}) {
+            EvpContext evp(PathKey(key, path), true);
+            evp.Run(ciphertexts[0], out);
+            Check(out == messages[0], "Cross-check of EVP and rsa_app results");
+        }
+
+        for (bool decrypt : {false, true}) {
+            const char* op = decrypt ? "decrypt" : "encrypt";
+            const std::vector<std::string>& inputs = decrypt ? ciphertexts : messages;
+            std::vector<Path> paths = {Path::kWrapper, Path::kEvpCrt};
+            if (decrypt) paths.push_back(Path::kEvpNoCrt);
+
+            std::cout << "\n" << op << ", " << bits << "-bit\n";
+            std::cout << std::left << std::setw(12) << "path" << std::right << std::setw(8)
+                      << "threads" << std::setw(12) << "ops/s" << std::setw(11) << "us/op"
+                      << std::setw(11) << "overhead\n";
+            for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+                double wrapper = 0.0;
+                for (Path path : paths) {
+                    double rate = MeasureThroughput(key, decrypt, path, threads, inputs, seconds);
+                    if (path == Path::kWrapper) wrapper = rate;
+                    std::cout << std::left << std::setw(12) << PathName(path) << std::right
+                              << std::setw(8) << threads << std::setw(12) << std::fixed
+                              << std::setprecision(1) << rate << std::setw(11)
+                              << std::setprecision(2) << 1e6 * threads / rate << std::setw(9)
+                              << rate / wrapper << "x\n";
+                }
+            }
+
+            std::cout << "phases, 1 thread, fresh state per operation:\n";
+            for (Path path : paths) {
+                Phases phases = MeasurePhases(key, decrypt, path, inputs, phase_iterations);
+                for (const auto& phase : phases.micros) {
+                    std::cout << "  " << std::left << std::setw(12) << PathName(path)
+                              << std::setw(14) << phase.first << std::right << std::setw(11)
+                              << std::fixed << std::setprecision(2) << phase.second << " us"
+                              << std::setw(8) << std::setprecision(1)
+                              << 100.0 * phase.second / phases.Total() << "%\n";
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,525 @@
+#include "fixed_modexp.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+#if defined(__SIZEOF_INT128__)
+#define RSA_APP_FIXED_MODEXP 1
+#endif
+
+#if defined(RSA_APP_FIXED_MODEXP) && defined(__x86_64__) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define RSA_APP_FIXED_MODEXP_ADX 1
+#include <cpuid.h>
+#endif
+
+// Asks the compiler to unroll a loop whose trip count is a template
+// constant.
+#if defined(__clang__)
+#define RSA_APP_UNROLL _Pragma("unroll 8")
+#elif defined(__GNUC__)
+#define RSA_APP_UNROLL _Pragma("GCC unroll 8")
+#else
+#define RSA_APP_UNROLL
+#endif
+
+namespace rsa_app {
+
+namespace {
+
+#ifdef RSA_APP_FIXED_MODEXP
+
+using u128 = unsigned __int128;
+
+constexpr int kWindowBits = 5;
+constexpr uint64_t kTableSize = uint64_t{1} << kWindowBits;
+
+struct CtxDeleter {
+  void operator()(BN_CTX* ctx) const { BN_CTX_free(ctx); }
+};
+
+void Check(int result) {
+  if (result == 0) throw std::runtime_error("OpenSSL error in fixed-size modexp");
+}
+
+// Returns all ones if a == b and zero otherwise, without branching.
+// Both values must be below 2^63.
+inline uint64_t ConstantTimeEqualMask(uint64_t a, uint64_t b) {
+  return 0 - (((a ^ b) - 1) >> 63);
+}
+
+// A residue as little-endian 64-bit limbs, one cache line aligned.
+template <size_t kLimbs>
+struct alignas(64) Number {
+  uint64_t limb[kLimbs];
+};
+
+template <size_t kLimbs>
+void LoadNumber(const BIGNUM* value, Number<kLimbs>& out) {
+  unsigned char bytes[kLimbs * 8];
+  Check(BN_bn2lebinpad(value, bytes, sizeof(bytes)) >= 0);
+  for (size_t i = 0; i < kLimbs; ++i) {
+    uint64_t word = 0;
+    for (int k = 7; k >= 0; --k) word = (word << 8) | bytes[i * 8 + k];
+    out.limb[i] = word;
+  }
+}
+
+template <size_t kLimbs>
+BigNumber StoreNumber(const Number<kLimbs>& in) {
+  unsigned char bytes[kLimbs * 8];
+  for (size_t i = 0; i < kLimbs; ++i) {
+    for (int k = 0; k < 8; ++k) {
+      bytes[i * 8 + k] = static_cast<unsigned char>(in.limb[i] >> (8 * k));
+    }
+  }
+  BIGNUM* value = BN_lebin2bn(bytes, sizeof(bytes), nullptr);
+  if (!value) throw std::runtime_error("OpenSSL error in fixed-size modexp");
+  return BigNumber(value);
+}
+
+// ---------------------------------------------------------------------------
+// Row kernels: r[0..len) += a[0..len) * w, returning the carry-out word.
+// ---------------------------------------------------------------------------
+
+struct PortableRows {
+  template <size_t kLength>
+  static uint64_t MulAdd(uint64_t* r, const uint64_t* a, uint64_t w) {
+    uint64_t carry = 0;
+    RSA_APP_UNROLL
+    for (size_t j = 0; j < kLength; ++j) {
+      u128 product = static_cast<u128>(w) * a[j] + r[j] + carry;
+      r[j] = static_cast<uint64_t>(product);
+      carry = static_cast<uint64_t>(product >> 64);
+    }
+    return carry;
+  }
+
+  static uint64_t MulAdd(uint64_t* r, const uint64_t* a, size_t length,
+                         uint64_t w, uint64_t carry = 0) {
+    for (size_t j = 0; j < length; ++j) {
+      u128 product = static_cast<u128>(w) * a[j] + r[j] + carry;
+      r[j] = static_cast<uint64_t>(product);
+      carry = static_cast<uint64_t>(product >> 64);
+    }
+    return carry;
+  }
+};
+
+#ifdef RSA_APP_FIXED_MODEXP_ADX
+
+// Uses MULX with two independent carry chains (ADCX for the product
+// halves, ADOX for the accumulator), which the compiler cannot derive from
+// 128-bit arithmetic. Needs BMI2 and ADX.
+struct AdxRows {
+  // Processes eight words; the carry-in is folded into the first one.
+  static uint64_t MulAdd8(uint64_t* r, const uint64_t* a, uint64_t w,
+                          uint64_t carry) {
+    uint64_t lo, hi0, hi1, zero;
+    __asm__(
+        "xorl %k[zero], %k[zero]\n\t"
+        "mulxq 0(%[a]), %[lo], %[hi0]\n\t"
+        "adcxq %[carry], %[lo]\n\t"
+        "adoxq 0(%[r]), %[lo]\n\t"
+        "movq %[lo], 0(%[r])\n\t"
+        "mulxq 8(%[a]), %[lo], %[hi1]\n\t"
+        "adcxq %[hi0], %[lo]\n\t"
+        "adoxq 8(%[r]), %[lo]\n\t"
+        "movq %[lo], 8(%[r])\n\t"
+        "mulxq 16(%[a]), %[lo], %[hi0]\n\t"
+        "adcxq %[hi1], %[lo]\n\t"
+        "adoxq 16(%[r]), %[lo]\n\t"
+        "movq %[lo], 16(%[r])\n\t"
+        "mulxq 24(%[a]), %[lo], %[hi1]\n\t"
+        "adcxq %[hi0], %[lo]\n\t"
+        "adoxq 24(%[r]), %[lo]\n\t"
+        "movq %[lo], 24(%[r])\n\t"
+        "mulxq 32(%[a]), %[lo], %[hi0]\n\t"
+        "adcxq %[hi1], %[lo]\n\t"
+        "adoxq 32(%[r]), %[lo]\n\t"
+        "movq %[lo], 32(%[r])\n\t"
+        "mulxq 40(%[a]), %[lo], %[hi1]\n\t"
+        "adcxq %[hi0], %[lo]\n\t"
+        "adoxq 40(%[r]), %[lo]\n\t"
+        "movq %[lo], 40(%[r])\n\t"
+        "mulxq 48(%[a]), %[lo], %[hi0]\n\t"
+        "adcxq %[hi1], %[lo]\n\t"
+        "adoxq 48(%[r]), %[lo]\n\t"
+        "movq %[lo], 48(%[r])\n\t"
+        "mulxq 56(%[a]), %[lo], %[hi1]\n\t"
+        "adcxq %[hi0], %[lo]\n\t"
+        "adoxq 56(%[r]), %[lo]\n\t"
+        "movq %[lo], 56(%[r])\n\t"
+        "adcxq %[zero], %[hi1]\n\t"
+        "adoxq %[zero], %[hi1]\n\t"
+        : [lo] "=&r"(lo), [hi0] "=&r"(hi0), [hi1] "=&r"(hi1),
+          [zero] "=&r"(zero), [carry] "+r"(carry)
+        : [r] "r"(r), [a] "r"(a), "d"(w)
+        : "cc", "memory");
+    return hi1;
+  }
+
+  template <size_t kLength>
+  static uint64_t MulAdd(uint64_t* r, const uint64_t* a, uint64_t w) {
+    static_assert(kLength % 8 == 0, "ADX rows work on 8-word blocks");
+    uint64_t carry = 0;
+    for (size_t j = 0; j < kLength; j += 8) carry = MulAdd8(r + j, a + j, w, carry);
+    return carry;
+  }
+
+  static uint64_t MulAdd(uint64_t* r, const uint64_t* a, size_t length,
+                         uint64_t w) {
+    uint64_t carry = 0;
+    size_t j = 0;
+    for (; j + 8 <= length; j += 8) carry = MulAdd8(r + j, a + j, w, carry);
+    return PortableRows::MulAdd(r + j, a + j, length - j, w, carry);
+  }
+};
+
+bool CpuHasAdx() {
+  static const bool has_adx = [] {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+    const unsigned int kBmi2 = 1u << 8, kAdx = 1u << 19;
+    return (ebx & kBmi2) && (ebx & kAdx);
+  }();
+  return has_adx;
+}
+
+#endif  // RSA_APP_FIXED_MODEXP_ADX
+
+/**
+ * Montgomery arithmetic modulo one odd `kLimbs * 64`-bit modulus.
+ *
+ * Products and reductions are built from `Rows` multiply-accumulate rows
+ * whose length is a template constant, so the compiler can unroll them.
+ * All results are fully reduced with a branch-free final subtraction.
+ */
+template <size_t kLimbs, typename Rows>
+class MontgomeryEngine {
+ public:
+  using Num = Number<kLimbs>;
+
+  MontgomeryEngine(const BIGNUM* modulus, BN_CTX* ctx) {
+    LoadNumber(modulus, n_);
+    // Newton's iteration doubles the correct low bits: 3 -> 6 -> ... -> 96.
+    uint64_t inverse = n_.limb[0];
+    for (int i = 0; i < 5; ++i) inverse *= 2 - n_.limb[0] * inverse;
+    k0_ = 0 - inverse;
+
+    BigNumber power;
+    Check(BN_set_bit(power.Get(), kLimbs * 64));
+    Check(BN_nnmod(power.Get(), power.Get(), modulus, ctx));
+    LoadNumber(power.Get(), one_);
+    BN_zero(power.Get());
+    Check(BN_set_bit(power.Get(), kLimbs * 128));
+    Check(BN_nnmod(power.Get(), power.Get(), modulus, ctx));
+    LoadNumber(power.Get(), rr_);
+    modulus_ = modulus;
+  }
+
+  // Constant-time fixed-window exponentiation.
+  BigNumber ModExp(const BIGNUM* base, const BIGNUM* exponent,
+                   BN_CTX* ctx) const {
+    Num table[kTableSize];
+    table[0] = one_;
+    ToMontgomery(table[1], base, ctx);
+    for (uint64_t entry = 2; entry < kTableSize; ++entry) {
+      if (entry % 2 == 0) {
+        Sqr(table[entry], table[entry / 2]);
+      } else {
+        Mul(table[entry], table[entry - 1], table[1]);
+      }
+    }
+
+    int windows = (BN_num_bits(exponent) + kWindowBits - 1) / kWindowBits;
+    if (windows == 0) windows = 1;
+    Num acc, selected;
+    Select(acc, table, Digit(exponent, windows - 1));
+    for (int window = windows - 2; window >= 0; --window) {
+      for (int bit = 0; bit < kWindowBits; ++bit) Sqr(acc, acc);
+      Select(selected, table, Digit(exponent, window));
+      Mul(acc, acc, selected);
+    }
+    return FromMontgomery(acc);
+  }
+
+  // Left-to-right binary exponentiation for public exponents.
+  BigNumber ModExpPublic(const BIGNUM* base, const BIGNUM* exponent,
+                         BN_CTX* ctx) const {
+    int bits = BN_num_bits(exponent);
+    if (bits == 0) return FromMontgomery(one_);
+    Num power, acc;
+    ToMontgomery(power, base, ctx);
+    acc = power;
+    for (int bit = bits - 2; bit >= 0; --bit) {
+      Sqr(acc, acc);
+      if (BN_is_bit_set(exponent, bit)) Mul(acc, acc, power);
+    }
+    return FromMontgomery(acc);
+  }
+
+ private:
+  // out = a * b / R mod n.
+  void Mul(Num& out, const Num& a, const Num& b) const {
+    uint64_t t[2 * kLimbs];
+    for (size_t i = 0; i < kLimbs; ++i) t[i] = 0;
+    for (size_t i = 0; i < kLimbs; ++i) {
+      t[i + kLimbs] =
+          Rows::template MulAdd<kLimbs>(t + i, b.limb, a.limb[i]);
+    }
+    Reduce(out, t);
+  }
+
+  // out = a^2 / R mod n; computes each cross product once.
+  void Sqr(Num& out, const Num& a) const {
+    uint64_t t[2 * kLimbs] = {};
+    for (size_t i = 0; i + 1 < kLimbs; ++i) {
+      t[i + kLimbs] = Rows::MulAdd(t + 2 * i + 1, a.limb + i + 1,
+                                   kLimbs - i - 1, a.limb[i]);
+    }
+
+    uint64_t shifted_out = 0;
+    RSA_APP_UNROLL
+    for (size_t k = 0; k < 2 * kLimbs; ++k) {
+      uint64_t word = t[k];
+      t[k] = (word << 1) | shifted_out;
+      shifted_out = word >> 63;
+    }
+
+    uint64_t carry = 0;
+    RSA_APP_UNROLL
+    for (size_t i = 0; i < kLimbs; ++i) {
+      u128 square = static_cast<u128>(a.limb[i]) * a.limb[i];
+      u128 sum = static_cast<u128>(t[2 * i]) + static_cast<uint64_t>(square) +
+                 carry;
+      t[2 * i] = static_cast<uint64_t>(sum);
+      sum = static_cast<u128>(t[2 * i + 1]) +
+            static_cast<uint64_t>(square >> 64) +
+            static_cast<uint64_t>(sum >> 64);
+      t[2 * i + 1] = static_cast<uint64_t>(sum);
+      carry = static_cast<uint64_t>(sum >> 64);
+    }
+    Reduce(out, t);
+  }
+
+  // out = t / R mod n for a double-width t < n * R.
+  void Reduce(Num& out, uint64_t* t) const {
+    uint64_t top = 0;
+    for (size_t i = 0; i < kLimbs; ++i) {
+      uint64_t carry =
+          Rows::template MulAdd<kLimbs>(t + i, n_.limb, t[i] * k0_);
+      u128 sum = static_cast<u128>(t[i + kLimbs]) + carry + top;
+      t[i + kLimbs] = static_cast<uint64_t>(sum);
+      top = static_cast<uint64_t>(sum >> 64);
+    }
+    FinalSubtract(out, t + kLimbs, top);
+  }
+
+  // out = value - n if (top:value) >= n, else value; for values below 2n.
+  void FinalSubtract(Num& out, const uint64_t* value, uint64_t top) const {
+    uint64_t difference[kLimbs];
+    uint64_t borrow = 0;
+    RSA_APP_UNROLL
+    for (size_t j = 0; j < kLimbs; ++j) {
+      u128 d = static_cast<u128>(value[j]) - n_.limb[j] - borrow;
+      difference[j] = static_cast<uint64_t>(d);
+      borrow = static_cast<uint64_t>(d >> 64) & 1;
+    }
+    const uint64_t keep = 0 - (borrow & (top ^ 1));
+    RSA_APP_UNROLL
+    for (size_t j = 0; j < kLimbs; ++j) {
+      out.limb[j] = (value[j] & keep) | (difference[j] & ~keep);
+    }
+  }
+
+  // Copies table[digit] while reading every entry.
+  static void Select(Num& out, const Num* table, uint64_t digit) {
+    for (size_t j = 0; j < kLimbs; ++j) out.limb[j] = 0;
+    for (uint64_t entry = 0; entry < kTableSize; ++entry) {
+      const uint64_t mask = ConstantTimeEqualMask(entry, digit);
+      RSA_APP_UNROLL
+      for (size_t j = 0; j < kLimbs; ++j) {
+        out.limb[j] |= table[entry].limb[j] & mask;
+      }
+    }
+  }
+
+  // Returns window `window` (counting from the least significant) of e.
+  static uint64_t Digit(const BIGNUM* exponent, int window) {
+    uint64_t digit = 0;
+    for (int bit = kWindowBits - 1; bit >= 0; --bit) {
+      digit = (digit << 1) | static_cast<uint64_t>(BN_is_bit_set(
+                                 exponent, window * kWindowBits + bit));
+    }
+    return digit;
+  }
+
+  void ToMontgomery(Num& out, const BIGNUM* base, BN_CTX* ctx) const {
+    Num plain;
+    if (BN_cmp(base, modulus_) >= 0) {
+      BigNumber reduced;
+      Check(BN_nnmod(reduced.Get(), base, modulus_, ctx));
+      LoadNumber(reduced.Get(), plain);
+    } else {
+      LoadNumber(base, plain);
+    }
+    Mul(out, plain, rr_);
+  }
+
+  BigNumber FromMontgomery(const Num& value) const {
+    uint64_t t[2 * kLimbs] = {};
+    for (size_t j = 0; j < kLimbs; ++j) t[j] = value.limb[j];
+    Num out;
+    Reduce(out, t);
+    return StoreNumber(out);
+  }
+
+  Num n_;
+  Num one_;  // R mod n, i.e. 1 in Montgomery form.
+  Num rr_;   // R^2 mod n, converts into Montgomery form.
+  uint64_t k0_;  // -n^-1 mod 2^64.
+  const BIGNUM* modulus_;
+};
+
+template <size_t kLimbs, typename Rows>
+BigNumber RunEngine(const BIGNUM* base, const BIGNUM* exponent,
+                    const BIGNUM* modulus, bool public_exponent) {
+  std::unique_ptr<BN_CTX, CtxDeleter> ctx(BN_CTX_new());
+  if (!ctx) throw std::runtime_error("Failed to allocate BN_CTX");
+  MontgomeryEngine<kLimbs, Rows> engine(modulus, ctx.get());
+  return public_exponent ? engine.ModExpPublic(base, exponent, ctx.get())
+                         : engine.ModExp(base, exponent, ctx.get());
+}
+
+template <size_t kLimbs>
+BigNumber Run(const BIGNUM* base, const BIGNUM* exponent,
+              const BIGNUM* modulus, bool public_exponent,
+              FixedKernel kernel) {
+#ifdef RSA_APP_FIXED_MODEXP_ADX
+  if (kernel == FixedKernel::kMulxAdx) {
+    return RunEngine<kLimbs, AdxRows>(base, exponent, modulus,
+                                      public_exponent);
+  }
+#else
+  (void)kernel;
+#endif
+  return RunEngine<kLimbs, PortableRows>(base, exponent, modulus,
+                                         public_exponent);
+}
+
+#endif  // RSA_APP_FIXED_MODEXP
+
+size_t LimbCount(const BIGNUM* modulus) {
+  return static_cast<size_t>(BN_num_bits(modulus) + 63) / 64;
+}
+
+BigNumber Dispatch(const BIGNUM* base, const BIGNUM* exponent,
+                   const BIGNUM* modulus, bool public_exponent,
+                   FixedKernel kernel) {
+  if (!FixedModExpSupports(modulus)) {
+    throw std::invalid_argument("Modulus size not supported by fixed modexp");
+  }
+  if (BN_is_negative(base) || BN_is_negative(exponent)) {
+    throw std::invalid_argument("Fixed modexp inputs must be non-negative");
+  }
+  if (!FixedKernelSupported(kernel)) kernel = BestFixedKernel();
+#ifdef RSA_APP_FIXED_MODEXP
+  switch (LimbCount(modulus)) {
+    case 32:
+      return Run<32>(base, exponent, modulus, public_exponent, kernel);
+    case 48:
+      return Run<48>(base, exponent, modulus, public_exponent, kernel);
+    case 64:
+      return Run<64>(base, exponent, modulus, public_exponent, kernel);
+  }
+#endif
+  throw std::invalid_argument("Modulus size not supported by fixed modexp");
+}
+
+std::atomic<ModExpBackend>& BackendSlot() {
+  static std::atomic<ModExpBackend> backend{ModExpBackend::kFixed};
+  return backend;
+}
+
+std::atomic<FixedKernel>& KernelSlot() {
+  static std::atomic<FixedKernel> kernel{BestFixedKernel()};
+  return kernel;
+}
+
+}  // namespace
+
+bool FixedKernelSupported(FixedKernel kernel) {
+  switch (kernel) {
+    case FixedKernel::kPortable:
+#ifdef RSA_APP_FIXED_MODEXP
+      return true;
+#else
+      return false;
+#endif
+    case FixedKernel::kMulxAdx:
+#ifdef RSA_APP_FIXED_MODEXP_ADX
+      return CpuHasAdx();
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
+FixedKernel BestFixedKernel() {
+  return FixedKernelSupported(FixedKernel::kMulxAdx) ? FixedKernel::kMulxAdx
+                                                     : FixedKernel::kPortable;
+}
+
+const char* FixedKernelName(FixedKernel kernel) {
+  switch (kernel) {
+    case FixedKernel::kPortable:
+      return "portable";
+    case FixedKernel::kMulxAdx:
+      return "mulx_adx";
+  }
+  return "unknown";
+}
+
+FixedKernel ActiveFixedKernel() {
+  return KernelSlot().load(std::memory_order_relaxed);
+}
+
+void SetFixedKernel(FixedKernel kernel) {
+  KernelSlot().store(FixedKernelSupported(kernel) ? kernel : BestFixedKernel(),
+                     std::memory_order_relaxed);
+}
+
+ModExpBackend ActiveModExpBackend() {
+  return BackendSlot().load(std::memory_order_relaxed);
+}
+
+void SetModExpBackend(ModExpBackend backend) {
+  BackendSlot().store(backend, std::memory_order_relaxed);
+}
+
+bool FixedModExpSupports(const BIGNUM* modulus) {
+#ifdef RSA_APP_FIXED_MODEXP
+  if (!BN_is_odd(modulus) || BN_is_negative(modulus)) return false;
+  size_t limbs = LimbCount(modulus);
+  return limbs == 32 || limbs == 48 || limbs == 64;
+#else
+  (void)modulus;
+  return false;
+#endif
+}
+
+BigNumber FixedModExp(const BIGNUM* base, const BIGNUM* exponent,
+                      const BIGNUM* modulus, FixedKernel kernel) {
+  return Dispatch(base, exponent, modulus, false, kernel);
+}
+
+BigNumber FixedModExpPublic(const BIGNUM* base, const BIGNUM* exponent,
+                            const BIGNUM* modulus, FixedKernel kernel) {
+  return Dispatch(base, exponent, modulus, true, kernel);
+}
+
+}  // namespace rsa_app
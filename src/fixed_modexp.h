@@ -0,0 +1,121 @@
+#ifndef RSA_APP_FIXED_MODEXP_H_
+#define RSA_APP_FIXED_MODEXP_H_
+
+#include "bn_wrapper.h"
+
+namespace rsa_app {
+
+/**
+ * Identifies the multiply-accumulate rows used by the fixed-size engine.
+ */
+enum class FixedKernel {
+  kPortable,  // 64x64->128-bit multiplies with one carry chain.
+  kMulxAdx,   // MULX with separate ADCX/ADOX carry chains (x86-64).
+};
+
+/**
+ * Returns true if the running CPU supports `kernel`.
+ */
+bool FixedKernelSupported(FixedKernel kernel);
+
+/**
+ * Returns the fastest kernel supported by the running CPU.
+ */
+FixedKernel BestFixedKernel();
+
+/**
+ * Returns a printable name for a kernel ("portable", "mulx_adx").
+ */
+const char* FixedKernelName(FixedKernel kernel);
+
+/**
+ * Returns the kernel `FixedModExp` and `FixedModExpPublic` use by default
+ * (initially `BestFixedKernel()`).
+ */
+FixedKernel ActiveFixedKernel();
+
+/**
+ * Overrides the default kernel for the whole process, e.g. with the one a
+ * tuning profile measured fastest.
+ *
+ * @param kernel The kernel to use from now on; unsupported kernels select
+ *               `BestFixedKernel()`.
+ */
+void SetFixedKernel(FixedKernel kernel);
+
+/**
+ * Selects how `Encrypt` and `Decrypt` exponentiate.
+ */
+enum class ModExpBackend {
+  kOpenSsl,  // Always `BigNumber::ModExp`.
+  kFixed,    // `FixedModExp`/`FixedModExpPublic` for supported moduli.
+};
+
+/**
+ * Returns the backend used by `Encrypt` and `Decrypt` (default `kFixed`).
+ */
+ModExpBackend ActiveModExpBackend();
+
+/**
+ * Overrides the backend for the whole process.
+ *
+ * @param backend The backend to use from now on.
+ */
+void SetModExpBackend(ModExpBackend backend);
+
+/**
+ * Returns true if `FixedModExp` has a kernel for `modulus`.
+ *
+ * Kernels are compiled for 32, 48 and 64 limbs of 64 bits, i.e. odd moduli
+ * of 1985-2048, 3009-3072 and 4033-4096 bits. They need a compiler with
+ * 128-bit integers; elsewhere this always returns false.
+ *
+ * @param modulus The modulus.
+ * @return True if the modulus is odd and has a supported size.
+ */
+bool FixedModExpSupports(const BIGNUM* modulus);
+
+/**
+ * Computes `base^exponent mod modulus` with a size-specialized kernel.
+ *
+ * The Montgomery multiply and square loops are unrolled for the modulus
+ * size. The exponent is scanned in fixed 5-bit windows and every lookup
+ * reads the whole table, so the sequence of operations and memory accesses
+ * depends only on the exponent length. Use it for private exponents.
+ *
+ * @param base The base; values >= the modulus are reduced first.
+ * @param exponent The non-negative exponent.
+ * @param modulus A modulus accepted by `FixedModExpSupports`.
+ * @param kernel The row kernel; unsupported kernels fall back to
+ *               `BestFixedKernel()`. Defaults to `ActiveFixedKernel()`.
+ * @return The result.
+ * @throws std::invalid_argument If the modulus is not supported or a value
+ *         is negative.
+ */
+BigNumber FixedModExp(const BIGNUM* base, const BIGNUM* exponent,
+                      const BIGNUM* modulus,
+                      FixedKernel kernel = ActiveFixedKernel());
+
+/**
+ * Computes `base^exponent mod modulus` for a public exponent.
+ *
+ * Same kernels as `FixedModExp`, but with plain left-to-right binary
+ * exponentiation: short public exponents such as 65537 do not pay for the
+ * window table, and the timing depends on the exponent bits.
+ *
+ * @param base The base; values >= the modulus are reduced first.
+ * @param exponent The non-negative, public exponent.
+ * @param modulus A modulus accepted by `FixedModExpSupports`.
+ * @param kernel The row kernel; unsupported kernels fall back to
+ *               `BestFixedKernel()`. Defaults to `ActiveFixedKernel()`.
+ * @return The result.
+ * @throws std::invalid_argument If the modulus is not supported or a value
+ *         is negative.
+ */
+BigNumber FixedModExpPublic(const BIGNUM* base, const BIGNUM* exponent,
+                            const BIGNUM* modulus,
+                            FixedKernel kernel = ActiveFixedKernel());
+
+}  // namespace rsa_app
+
+#endif  // RSA_APP_FIXED_MODEXP_H_
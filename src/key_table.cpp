@@ -0,0 +1,278 @@
+#include "key_table.h"
+
+#include <openssl/bn.h>
+#include <openssl/crypto.h>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace rsa_app {
+
+namespace {
+
+constexpr size_t kCacheLineWords = 64 / sizeof(uint64_t);
+constexpr size_t kMinCapacity = 64;
+
+size_t PageBytes() {
+#ifndef _WIN32
+  static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  return page;
+#else
+  return 4096;
+#endif
+}
+
+size_t RoundUp(size_t value, size_t multiple) {
+  return (value + multiple - 1) / multiple * multiple;
+}
+
+// Writes `value` into `limbs` little-endian words.
+void StoreLimbs(const BIGNUM* value, uint64_t* out, size_t limbs) {
+  std::vector<unsigned char> bytes(limbs * 8);
+  if (BN_bn2lebinpad(value, bytes.data(), static_cast<int>(bytes.size())) < 0) {
+    throw std::invalid_argument("Value does not fit the key table row");
+  }
+  for (size_t i = 0; i < limbs; ++i) {
+    uint64_t word = 0;
+    for (int k = 7; k >= 0; --k) word = (word << 8) | bytes[i * 8 + k];
+    out[i] = word;
+  }
+  OPENSSL_cleanse(bytes.data(), bytes.size());
+}
+
+BigNumber LoadLimbs(const uint64_t* limbs, size_t count) {
+  std::vector<unsigned char> bytes(count * 8);
+  for (size_t i = 0; i < count; ++i) {
+    for (int k = 0; k < 8; ++k) {
+      bytes[i * 8 + k] = static_cast<unsigned char>(limbs[i] >> (8 * k));
+    }
+  }
+  BIGNUM* value = BN_lebin2bn(bytes.data(), static_cast<int>(bytes.size()), nullptr);
+  OPENSSL_cleanse(bytes.data(), bytes.size());
+  if (!value) throw std::runtime_error("BN_lebin2bn failed");
+  return BigNumber(value);
+}
+
+// Bytes glibc malloc reserves for a request: an 8-byte header, rounded up
+// to 16 bytes, at least 32.
+size_t MallocChunkBytes(size_t request) {
+  return std::max<size_t>(32, RoundUp(request + 8, 16));
+}
+
+// OpenSSL 3's `struct bignum_st`: limb pointer, top, dmax, neg, flags.
+constexpr size_t kBignumHeaderBytes = sizeof(void*) + 4 * sizeof(int);
+
+size_t BigNumberBytes(const BigNumber& value) {
+  size_t limbs = static_cast<size_t>(BN_num_bytes(value.Get()) + 7) / 8;
+  return MallocChunkBytes(kBignumHeaderBytes) +
+         (limbs ? MallocChunkBytes(limbs * 8) : 0);
+}
+
+}  // namespace
+
+KeyTable::KeyTable(int bits, size_t capacity) : bits_(bits) {
+  if (bits <= 0) throw std::invalid_argument("Key table size must be positive");
+  size_t limbs = (static_cast<size_t>(bits) + 63) / 64;
+  stride_ = RoundUp(limbs, kCacheLineWords);
+  if (capacity > 0) Grow(capacity);
+}
+
+KeyTable::~KeyTable() {
+  Release(moduli_, false);
+  Release(exponents_, false);
+  Release(private_, true);
+}
+
+KeyTable::Region KeyTable::Allocate(size_t words, bool secret) {
+  Region region;
+  size_t bytes = RoundUp(words * sizeof(uint64_t), PageBytes());
+  region.capacity = bytes / sizeof(uint64_t);
+#ifndef _WIN32
+  void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) throw std::bad_alloc();
+  region.words = static_cast<uint64_t*>(memory);
+  if (secret) {
+#ifdef MADV_DONTDUMP
+    madvise(memory, bytes, MADV_DONTDUMP);
+#endif
+    // Best effort: an unlocked table still works, see PrivateLocked().
+    region.locked = mlock(memory, bytes) == 0;
+  }
+#else
+  (void)secret;
+  region.words = static_cast<uint64_t*>(
+      ::operator new(bytes, std::align_val_t{64}));
+  std::memset(region.words, 0, bytes);
+#endif
+  return region;
+}
+
+void KeyTable::Release(Region& region, bool secret) {
+  if (!region.words) return;
+  size_t bytes = region.capacity * sizeof(uint64_t);
+  if (secret) OPENSSL_cleanse(region.words, bytes);
+#ifndef _WIN32
+  if (region.locked) munlock(region.words, bytes);
+  munmap(region.words, bytes);
+#else
+  ::operator delete(region.words, std::align_val_t{64});
+#endif
+  region = Region{};
+}
+
+void KeyTable::Grow(size_t keys) {
+  size_t target = std::max({keys, capacity_ * 2, kMinCapacity});
+  Region moduli = Allocate(target * stride_, false);
+  Region exponents = Allocate(target, false);
+  Region secrets;
+  try {
+    secrets = Allocate(target * stride_, true);
+  } catch (...) {
+    Release(moduli, false);
+    Release(exponents, false);
+    throw;
+  }
+  if (size_) {
+    std::memcpy(moduli.words, moduli_.words, size_ * stride_ * sizeof(uint64_t));
+    std::memcpy(exponents.words, exponents_.words, size_ * sizeof(uint64_t));
+    std::memcpy(secrets.words, private_.words, size_ * stride_ * sizeof(uint64_t));
+  }
+  Release(moduli_, false);
+  Release(exponents_, false);
+  Release(private_, true);
+  moduli_ = moduli;
+  exponents_ = exponents;
+  private_ = secrets;
+  // Page rounding may leave room for more keys than asked for.
+  capacity_ = std::min({moduli_.capacity / stride_, exponents_.capacity,
+                        private_.capacity / stride_});
+}
+
+KeyHandle KeyTable::Add(const KeyPair& key_pair) {
+  const BIGNUM* n = key_pair.public_key.n.Get();
+  const BIGNUM* e = key_pair.public_key.e.Get();
+  const BIGNUM* d = key_pair.private_key.d.Get();
+  if (BN_num_bits(n) > bits_ || BN_num_bits(key_pair.private_key.n.Get()) > bits_) {
+    throw std::invalid_argument("Modulus too large for key table");
+  }
+  if (BN_cmp(n, key_pair.private_key.n.Get()) != 0) {
+    throw std::invalid_argument("Public and private modulus differ");
+  }
+  if (BN_num_bits(e) > 64) {
+    throw std::invalid_argument("Public exponent does not fit in 64 bits");
+  }
+  if (BN_num_bits(d) > bits_ || BN_is_negative(d) || BN_is_negative(e)) {
+    throw std::invalid_argument("Private exponent does not fit the key table");
+  }
+  if (size_ == capacity_) Grow(size_ + 1);
+
+  size_t index = size_;
+  StoreLimbs(n, moduli_.words + index * stride_, stride_);
+  StoreLimbs(d, private_.words + index * stride_, stride_);
+  exponents_.words[index] = BN_get_word(e);
+  ++size_;
+  return KeyHandle{this, index};
+}
+
+KeyHandle KeyTable::Add(KeyHandle key) {
+  if (key.table == nullptr) throw std::invalid_argument("Empty key handle");
+  const KeyTable& other = *key.table;
+  other.CheckIndex(key.index);
+  if (other.bits_ > bits_) throw std::invalid_argument("Modulus too large for key table");
+  if (size_ == capacity_) Grow(size_ + 1);
+
+  // `other` may be this table, so its arrays are read after growing.
+  size_t index = size_;
+  size_t row = key.index * other.stride_;
+  std::copy_n(other.moduli_.words + row, other.stride_, moduli_.words + index * stride_);
+  std::copy_n(other.private_.words + row, other.stride_, private_.words + index * stride_);
+  exponents_.words[index] = other.exponents_.words[key.index];
+  ++size_;
+  return KeyHandle{this, index};
+}
+
+void KeyTable::CheckIndex(size_t index) const {
+  if (index >= size_) throw std::out_of_range("Key table index out of range");
+}
+
+KeyHandle KeyTable::Handle(size_t index) const {
+  CheckIndex(index);
+  return KeyHandle{this, index};
+}
+
+const uint64_t* KeyTable::ModulusLimbs(size_t index) const {
+  CheckIndex(index);
+  return moduli_.words + index * stride_;
+}
+
+BigNumber KeyTable::Modulus(size_t index) const {
+  return LoadLimbs(ModulusLimbs(index), stride_);
+}
+
+BigNumber KeyTable::PublicExponent(size_t index) const {
+  CheckIndex(index);
+  BigNumber e;
+  e.SetWord(exponents_.words[index]);
+  return e;
+}
+
+BigNumber KeyTable::PrivateExponent(size_t index) const {
+  CheckIndex(index);
+  BigNumber d = LoadLimbs(private_.words + index * stride_, stride_);
+  BN_set_flags(d.Get(), BN_FLG_CONSTTIME);
+  return d;
+}
+
+KeyStorageFootprint KeyTable::Footprint() const {
+  KeyStorageFootprint footprint;
+  footprint.keys = size_;
+  footprint.public_bytes = size_ * (stride_ + 1) * sizeof(uint64_t);
+  footprint.private_bytes = size_ * stride_ * sizeof(uint64_t);
+  footprint.reserved_bytes =
+      (moduli_.capacity + exponents_.capacity + private_.capacity) * sizeof(uint64_t);
+  if (size_) {
+    footprint.bytes_per_key =
+        static_cast<double>(footprint.public_bytes + footprint.private_bytes) /
+        static_cast<double>(size_);
+  }
+  return footprint;
+}
+
+size_t KeyPairBytes(const KeyPair& key_pair) {
+  return sizeof(KeyPair) + BigNumberBytes(key_pair.public_key.n) +
+         BigNumberBytes(key_pair.public_key.e) +
+         BigNumberBytes(key_pair.private_key.n) +
+         BigNumberBytes(key_pair.private_key.d);
+}
+
+BigNumber Encrypt(const BigNumber& message, KeyHandle key) {
+  if (!key.table) throw std::invalid_argument("Empty key handle");
+  PublicKey public_key{key.table->Modulus(key.index),
+                       key.table->PublicExponent(key.index)};
+  return Encrypt(message, public_key);
+}
+
+BigNumber Decrypt(const BigNumber& ciphertext, KeyHandle key) {
+  if (!key.table) throw std::invalid_argument("Empty key handle");
+  PrivateKey private_key{key.table->Modulus(key.index),
+                         key.table->PrivateExponent(key.index)};
+  try {
+    BigNumber plaintext = Decrypt(ciphertext, private_key);
+    BN_clear(private_key.d.Get());
+    return plaintext;
+  } catch (...) {
+    BN_clear(private_key.d.Get());
+    throw;
+  }
+}
+
+}  // namespace rsa_app
@@ -0,0 +1,215 @@
+#ifndef RSA_APP_KEY_TABLE_H_
+#define RSA_APP_KEY_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "bn_wrapper.h"
+#include "rsa.h"
+
+namespace rsa_app {
+
+class KeyTable;
+
+/**
+ * Refers to one key stored in a `KeyTable`.
+ *
+ * A handle is two words and owns nothing; it stays valid as long as the
+ * table does.
+ */
+struct KeyHandle {
+  const KeyTable* table = nullptr;  // The owning table.
+  size_t index = 0;                 // Position of the key in the table.
+};
+
+/**
+ * Memory used by a `KeyTable`.
+ */
+struct KeyStorageFootprint {
+  size_t keys = 0;             // Keys stored.
+  size_t public_bytes = 0;     // Moduli and public exponents of those keys.
+  size_t private_bytes = 0;    // Private exponents of those keys.
+  size_t reserved_bytes = 0;   // Mapped memory, spare capacity included.
+  double bytes_per_key = 0.0;  // (public_bytes + private_bytes) / keys.
+};
+
+/**
+ * Stores many keys of one size in contiguous limb arrays.
+ *
+ * Every key takes one row of 64-bit little-endian limbs in the modulus
+ * array and one in the private exponent array. Rows are padded to a whole
+ * number of 64-byte cache lines and the arrays are page aligned, so a key
+ * never shares a cache line with another. Public exponents, which must fit
+ * in 64 bits, are kept in a third array.
+ *
+ * The private exponents live in their own mapping that is locked into RAM
+ * with `mlock` and excluded from core dumps where the platform allows it;
+ * `PrivateLocked()` reports whether locking succeeded (it fails when the
+ * table exceeds `RLIMIT_MEMLOCK`). The private mapping is zeroed before it
+ * is released.
+ *
+ * `Add` may move the arrays, so it must not run concurrently with other
+ * calls. Reads and the `Encrypt`/`Decrypt` overloads below are safe to use
+ * from several threads at once.
+ */
+class KeyTable {
+ public:
+  /**
+   * Creates an empty table.
+   *
+   * @param bits The largest modulus size in bits the table accepts.
+   * @param capacity Keys to reserve space for up front.
+   * @throws std::invalid_argument If `bits` is not positive.
+   */
+  explicit KeyTable(int bits, size_t capacity = 0);
+
+  /**
+   * Zeroes the private exponents and releases the arrays.
+   */
+  ~KeyTable();
+
+  KeyTable(const KeyTable&) = delete;
+  KeyTable& operator=(const KeyTable&) = delete;
+
+  /**
+   * Copies a key pair into the table.
+   *
+   * @param key_pair The key; `n` must have at most `Bits()` bits and `e`
+   *                 at most 64.
+   * @return The handle of the new key.
+   * @throws std::invalid_argument If the key does not fit the table.
+   * @throws std::bad_alloc If the arrays cannot grow.
+   */
+  KeyHandle Add(const KeyPair& key_pair);
+
+  /**
+   * Copies a key from another table row by row.
+   *
+   * The copy is written by the calling thread, so with first-touch page
+   * placement a new table filled this way lives on the caller's node.
+   *
+   * @param key The key; its table must not have more bits than this one.
+   * @return The handle of the new key.
+   * @throws std::invalid_argument If the handle is empty or the key does
+   *         not fit the table.
+   * @throws std::out_of_range If the handle's index is out of range.
+   * @throws std::bad_alloc If the arrays cannot grow.
+   */
+  KeyHandle Add(KeyHandle key);
+
+  /**
+   * Returns the handle of the key at `index`.
+   *
+   * @throws std::out_of_range If `index >= Size()`.
+   */
+  KeyHandle Handle(size_t index) const;
+
+  /**
+   * Returns the number of keys stored.
+   */
+  size_t Size() const { return size_; }
+
+  /**
+   * Returns the largest modulus size the table accepts.
+   */
+  int Bits() const { return bits_; }
+
+  /**
+   * Returns the number of 64-bit words in each row, padding included.
+   */
+  size_t Stride() const { return stride_; }
+
+  /**
+   * Returns the limbs of the modulus at `index`.
+   */
+  const uint64_t* ModulusLimbs(size_t index) const;
+
+  /**
+   * Returns the modulus at `index` as a new BigNumber.
+   */
+  BigNumber Modulus(size_t index) const;
+
+  /**
+   * Returns the public exponent at `index` as a new BigNumber.
+   */
+  BigNumber PublicExponent(size_t index) const;
+
+  /**
+   * Returns the private exponent at `index` as a new BigNumber.
+   *
+   * The caller should `BN_clear` the copy once done with it.
+   */
+  BigNumber PrivateExponent(size_t index) const;
+
+  /**
+   * Returns true if the private exponents are locked into RAM.
+   */
+  bool PrivateLocked() const { return private_.locked; }
+
+  /**
+   * Returns the memory used by the table.
+   */
+  KeyStorageFootprint Footprint() const;
+
+ private:
+  // A page-aligned array of words.
+  struct Region {
+    uint64_t* words = nullptr;
+    size_t capacity = 0;  // In words.
+    bool locked = false;
+  };
+
+  static Region Allocate(size_t words, bool secret);
+  static void Release(Region& region, bool secret);
+  void Grow(size_t keys);
+  void CheckIndex(size_t index) const;
+
+  int bits_;
+  size_t stride_;        // Words per row, a multiple of 8.
+  size_t size_ = 0;      // Keys stored.
+  size_t capacity_ = 0;  // Keys that fit without growing.
+  Region moduli_;
+  Region exponents_;
+  Region private_;
+};
+
+/**
+ * Estimates the heap bytes of a `KeyPair`: the struct itself plus, for each
+ * of its four BIGNUMs, the OpenSSL header and limb array rounded up to
+ * glibc malloc chunks.
+ *
+ * @param key_pair The key pair.
+ * @return The estimated size in bytes.
+ */
+size_t KeyPairBytes(const KeyPair& key_pair);
+
+/**
+ * Encrypts a message with a key stored in a `KeyTable`.
+ *
+ * Behaves like `Encrypt(message, public_key)`.
+ *
+ * @param message The message; must be below the modulus.
+ * @param key The key handle.
+ * @return The ciphertext.
+ * @throws std::invalid_argument If the handle is empty or the message is too
+ *         large.
+ */
+BigNumber Encrypt(const BigNumber& message, KeyHandle key);
+
+/**
+ * Decrypts a ciphertext with a key stored in a `KeyTable`.
+ *
+ * Behaves like `Decrypt(ciphertext, private_key)`. The private exponent is
+ * copied into a temporary BIGNUM that is cleared before returning.
+ *
+ * @param ciphertext The ciphertext; must be below the modulus.
+ * @param key The key handle.
+ * @return The plaintext.
+ * @throws std::invalid_argument If the handle is empty or the ciphertext is
+ *         too large.
+ */
+BigNumber Decrypt(const BigNumber& ciphertext, KeyHandle key);
+
+}  // namespace rsa_app
+
+#endif  // RSA_APP_KEY_TABLE_H_
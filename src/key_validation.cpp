@@ -0,0 +1,320 @@
+#include "key_validation.h"
+
+#include <openssl/bn.h>
+
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include "drbg.h"
+
+namespace rsa_app {
+
+namespace {
+
+using CtxPtr = std::unique_ptr<BN_CTX, decltype(&BN_CTX_free)>;
+
+constexpr int kMinModulusBits = 512;
+// Random bases tried before the randomized factorization gives up; each
+// succeeds with probability at least 1/2 when e*d - 1 is a multiple of
+// lambda(n).
+constexpr int kFactorAttempts = 64;
+// FIPS 186-4 B.3.1: |p - q| must exceed 2^(nbits/2 - 100).
+constexpr int kMinFactorDistanceGap = 100;
+
+// A temporary derived from the private key, wiped before it is freed.
+class SecretNumber : public BigNumber {
+ public:
+  SecretNumber() = default;
+  explicit SecretNumber(BigNumber&& value) : BigNumber(std::move(value)) {}
+  ~SecretNumber() { BN_clear(Get()); }
+};
+
+void Check(int ok) {
+  if (!ok) throw std::runtime_error("OpenSSL BIGNUM operation failed");
+}
+
+// The product of `BigNumber::SmallPrimes()`, one gcd away from trial
+// division by all of them.
+const BIGNUM* SmallPrimeProduct() {
+  static const BigNumber product = [] {
+    BigNumber value;
+    value.SetWord(1);
+    for (uint32_t prime : BigNumber::SmallPrimes()) Check(BN_mul_word(value.Get(), prime));
+    return value;
+  }();
+  return product.Get();
+}
+
+// Floor of the square root of a non-negative `value`, by Newton's method
+// from an overestimate.
+void IntegerSqrt(BIGNUM* root, const BIGNUM* value, BN_CTX* ctx) {
+  if (BN_is_zero(value)) {
+    BN_zero(root);
+    return;
+  }
+  BigNumber x, y, quotient;
+  BN_zero(x.Get());
+  Check(BN_set_bit(x.Get(), (BN_num_bits(value) + 1) / 2));
+  while (true) {
+    Check(BN_div(quotient.Get(), nullptr, value, x.Get(), ctx));
+    Check(BN_add(y.Get(), x.Get(), quotient.Get()));
+    Check(BN_rshift1(y.Get(), y.Get()));
+    if (BN_cmp(y.Get(), x.Get()) >= 0) break;
+    std::swap(x, y);
+  }
+  Check(BN_copy(root, x.Get()) != nullptr);
+}
+
+// Derives p >= q from phi(n) = (e*d - 1) / k with the smallest k that can
+// hold for d = e^-1 mod phi(n). Returns false if it does not factor n.
+bool FactorFromPhi(const BIGNUM* n, const BIGNUM* ed1, BIGNUM* p, BIGNUM* q, BN_CTX* ctx) {
+  BigNumber k, four_n;
+  SecretNumber phi, remainder, sum, disc, root;
+  Check(BN_div(k.Get(), nullptr, ed1, n, ctx));
+  Check(BN_add_word(k.Get(), 1));
+  Check(BN_div(phi.Get(), remainder.Get(), ed1, k.Get(), ctx));
+  if (!BN_is_zero(remainder.Get()) || BN_cmp(phi.Get(), n) >= 0) return false;
+  // p + q = n - phi + 1, and (p - q)^2 = (p + q)^2 - 4n.
+  Check(BN_sub(sum.Get(), n, phi.Get()));
+  Check(BN_add_word(sum.Get(), 1));
+  Check(BN_sqr(disc.Get(), sum.Get(), ctx));
+  Check(BN_lshift(four_n.Get(), n, 2));
+  Check(BN_sub(disc.Get(), disc.Get(), four_n.Get()));
+  if (BN_is_negative(disc.Get())) return false;
+  IntegerSqrt(root.Get(), disc.Get(), ctx);
+  Check(BN_add(p, sum.Get(), root.Get()));
+  Check(BN_rshift1(p, p));
+  Check(BN_sub(q, sum.Get(), root.Get()));
+  Check(BN_rshift1(q, q));
+  BigNumber product;
+  Check(BN_mul(product.Get(), p, q, ctx));
+  return !BN_is_one(q) && !BN_is_zero(q) && BN_cmp(product.Get(), n) == 0;
+}
+
+// Miller's reduction: with e*d - 1 = 2^s * t a multiple of lambda(n), a
+// random g whose sequence g^t, g^2t, ... reaches 1 through a root other
+// than -1 yields a factor. Returns false if no base does.
+bool FactorFromMultiple(const BIGNUM* n, const BIGNUM* ed1, BIGNUM* p, BIGNUM* q, BN_CTX* ctx) {
+  BigNumber two, top, n_minus_1;
+  SecretNumber t, x, next, gcd;
+  Check(BN_copy(t.Get(), ed1) != nullptr);
+  int s = 0;
+  while (!BN_is_zero(t.Get()) && !BN_is_odd(t.Get())) {
+    Check(BN_rshift1(t.Get(), t.Get()));
+    ++s;
+  }
+  if (s == 0) return false;
+  two.SetWord(2);
+  Check(BN_sub(n_minus_1.Get(), n, BN_value_one()));
+  Check(BN_sub(top.Get(), n_minus_1.Get(), BN_value_one()));
+  for (int attempt = 0; attempt < kFactorAttempts; ++attempt) {
+    BigNumber g = BigNumber::GenerateInRange(two.Get(), top.Get(), ThreadDrbg());
+    Check(BN_mod_exp(x.Get(), g.Get(), t.Get(), n, ctx));
+    for (int i = 0; i < s; ++i) {
+      if (BN_is_one(x.Get()) || BN_cmp(x.Get(), n_minus_1.Get()) == 0) break;
+      Check(BN_mod_sqr(next.Get(), x.Get(), n, ctx));
+      if (BN_is_one(next.Get())) {
+        Check(BN_sub_word(x.Get(), 1));
+        Check(BN_gcd(gcd.Get(), x.Get(), n, ctx));
+        Check(BN_copy(p, gcd.Get()) != nullptr);
+        Check(BN_div(q, nullptr, n, p, ctx));
+        if (BN_cmp(p, q) < 0) BN_swap(p, q);
+        return true;
+      }
+      BN_swap(x.Get(), next.Get());
+    }
+  }
+  return false;
+}
+
+// c^d mod n through p and q: m_p = c^(d mod p-1) mod p, likewise for q,
+// recombined with Garner's formula.
+void DecryptWithFactors(BIGNUM* m, const BIGNUM* c, const BIGNUM* d, const BIGNUM* p,
+                        const BIGNUM* q, BN_CTX* ctx) {
+  SecretNumber p1, q1, dp, dq, mp, mq, q_inv, h;
+  Check(BN_sub(p1.Get(), p, BN_value_one()));
+  Check(BN_sub(q1.Get(), q, BN_value_one()));
+  Check(BN_mod(dp.Get(), d, p1.Get(), ctx));
+  Check(BN_mod(dq.Get(), d, q1.Get(), ctx));
+  BN_set_flags(dp.Get(), BN_FLG_CONSTTIME);
+  BN_set_flags(dq.Get(), BN_FLG_CONSTTIME);
+  Check(BN_mod_exp(mp.Get(), c, dp.Get(), p, ctx));
+  Check(BN_mod_exp(mq.Get(), c, dq.Get(), q, ctx));
+  if (!BN_mod_inverse(q_inv.Get(), q, p, ctx)) {
+    throw std::runtime_error("Recovered factors are not coprime");
+  }
+  Check(BN_mod_sub(h.Get(), mp.Get(), mq.Get(), p, ctx));
+  Check(BN_mod_mul(h.Get(), h.Get(), q_inv.Get(), p, ctx));
+  Check(BN_mul(m, h.Get(), q, ctx));
+  Check(BN_add(m, m, mq.Get()));
+}
+
+KeyDefect CheckComponents(const BIGNUM* n, const BIGNUM* private_n, const BIGNUM* e,
+                          const BIGNUM* d, KeyCheckLevel level) {
+  int bits = BN_num_bits(n);
+  if (!BN_is_odd(n) || bits < kMinModulusBits || BN_cmp(n, private_n) != 0) {
+    return KeyDefect::kBadModulus;
+  }
+  if (!BN_is_odd(e) || BN_is_one(e) || BN_cmp(e, n) >= 0 || BN_is_negative(e) ||
+      BN_is_negative(d) || BN_is_zero(d) || BN_is_one(d) || BN_cmp(d, n) >= 0) {
+    return KeyDefect::kBadExponent;
+  }
+
+  CtxPtr ctx(BN_CTX_new(), BN_CTX_free);
+  if (!ctx) throw std::runtime_error("Failed to create BN_CTX");
+  BigNumber reduced, gcd;
+  Check(BN_mod(reduced.Get(), SmallPrimeProduct(), n, ctx.get()));
+  Check(BN_gcd(gcd.Get(), reduced.Get(), n, ctx.get()));
+  if (!BN_is_one(gcd.Get())) return KeyDefect::kSmallFactor;
+
+  SecretNumber ed1, p, q;
+  Check(BN_mul(ed1.Get(), e, d, ctx.get()));
+  Check(BN_sub_word(ed1.Get(), 1));
+  bool factored = FactorFromPhi(n, ed1.Get(), p.Get(), q.Get(), ctx.get());
+
+  // Pairwise consistency on a random message.
+  BigNumber two, top, ciphertext;
+  SecretNumber plaintext;
+  two.SetWord(2);
+  Check(BN_sub(top.Get(), n, two.Get()));
+  SecretNumber message(BigNumber::GenerateInRange(two.Get(), top.Get(), ThreadDrbg()));
+  PublicKey public_key{BigNumber(BN_dup(n)), BigNumber(BN_dup(e))};
+  ciphertext = Encrypt(message, public_key);
+  if (factored) {
+    DecryptWithFactors(plaintext.Get(), ciphertext.Get(), d, p.Get(), q.Get(), ctx.get());
+  } else {
+    SecretNumber d_copy(BigNumber(BN_dup(d)));
+    BN_set_flags(d_copy.Get(), BN_FLG_CONSTTIME);
+    Check(BN_mod_exp(plaintext.Get(), ciphertext.Get(), d_copy.Get(), n, ctx.get()));
+  }
+  if (BN_cmp(plaintext.Get(), message.Get()) != 0) return KeyDefect::kRoundTripFailed;
+  if (level == KeyCheckLevel::kCheap) return KeyDefect::kNone;
+
+  if (!factored && !FactorFromMultiple(n, ed1.Get(), p.Get(), q.Get(), ctx.get())) {
+    return KeyDefect::kNoFactorization;
+  }
+  SecretNumber distance;
+  Check(BN_sub(distance.Get(), p.Get(), q.Get()));
+  if (BN_num_bits(distance.Get()) <= bits / 2 - kMinFactorDistanceGap) {
+    return KeyDefect::kCloseFactors;
+  }
+  // The gcd above already ruled out small factors of p and q.
+  for (const SecretNumber* factor : {&p, &q}) {
+    if (!factor->PassesMillerRabin(0, ThreadDrbg())) return KeyDefect::kCompositeFactor;
+  }
+  return KeyDefect::kNone;
+}
+
+template <typename CheckOne>
+KeyValidationReport ValidateAll(size_t count, ThreadPool& pool, CheckOne check_one) {
+  auto start = std::chrono::steady_clock::now();
+  std::vector<KeyDefect> defects(count, KeyDefect::kNone);
+  pool.ParallelFor(count, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) defects[i] = check_one(i);
+  });
+  KeyValidationReport report;
+  report.checked = count;
+  for (size_t i = 0; i < count; ++i) {
+    if (defects[i] != KeyDefect::kNone) report.failures.push_back({i, defects[i]});
+  }
+  report.seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return report;
+}
+
+}  // namespace
+
+const char* KeyDefectName(KeyDefect defect) {
+  switch (defect) {
+    case KeyDefect::kNone:
+      return "none";
+    case KeyDefect::kBadModulus:
+      return "bad_modulus";
+    case KeyDefect::kBadExponent:
+      return "bad_exponent";
+    case KeyDefect::kSmallFactor:
+      return "small_factor";
+    case KeyDefect::kRoundTripFailed:
+      return "round_trip_failed";
+    case KeyDefect::kNoFactorization:
+      return "no_factorization";
+    case KeyDefect::kCompositeFactor:
+      return "composite_factor";
+    case KeyDefect::kCloseFactors:
+      return "close_factors";
+  }
+  return "unknown";
+}
+
+KeyDefect CheckKeyPair(const KeyPair& key_pair, KeyCheckLevel level) {
+  return CheckComponents(key_pair.public_key.n.Get(), key_pair.private_key.n.Get(),
+                         key_pair.public_key.e.Get(), key_pair.private_key.d.Get(), level);
+}
+
+KeyDefect CheckKeyPair(const KeyTable& table, size_t index, KeyCheckLevel level) {
+  BigNumber n = table.Modulus(index);
+  BigNumber e = table.PublicExponent(index);
+  SecretNumber d(table.PrivateExponent(index));
+  return CheckComponents(n.Get(), n.Get(), e.Get(), d.Get(), level);
+}
+
+KeyValidationReport ValidateKeys(const KeyTable& table, KeyCheckLevel level, ThreadPool& pool) {
+  return ValidateAll(table.Size(), pool,
+                     [&](size_t i) { return CheckKeyPair(table, i, level); });
+}
+
+KeyValidationReport ValidateKeys(const std::vector<KeyPair>& keys, KeyCheckLevel level,
+                                 ThreadPool& pool) {
+  return ValidateAll(keys.size(), pool,
+                     [&](size_t i) { return CheckKeyPair(keys[i], level); });
+}
+
+KeyLoadReport LoadKeyTable(const std::vector<std::string>& paths, KeyTable& table,
+                           KeyCheckLevel level, ThreadPool& pool) {
+  auto start = std::chrono::steady_clock::now();
+  std::vector<KeyPair> keys(paths.size());
+  std::vector<std::string> errors(paths.size());
+  pool.ParallelFor(paths.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      try {
+        keys[i] = LoadKeyPair(paths[i]);
+        KeyDefect defect = CheckKeyPair(keys[i], level);
+        if (defect != KeyDefect::kNone) errors[i] = KeyDefectName(defect);
+      } catch (const std::exception& e) {
+        errors[i] = e.what();
+      }
+    }
+  });
+
+  KeyLoadReport report;
+  for (size_t i = 0; i < paths.size(); ++i) {
+    if (errors[i].empty()) {
+      try {
+        table.Add(keys[i]);
+        ++report.loaded;
+      } catch (const std::invalid_argument& e) {
+        errors[i] = e.what();
+      }
+    }
+    if (!errors[i].empty()) report.rejected.push_back({i, errors[i]});
+    BN_clear(keys[i].private_key.d.Get());
+  }
+  report.seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return report;
+}
+
+KeyPair LoadValidatedKeyPair(const std::string& path, KeyCheckLevel level) {
+  KeyPair key_pair = LoadKeyPair(path);
+  KeyDefect defect = CheckKeyPair(key_pair, level);
+  if (defect != KeyDefect::kNone) {
+    throw std::invalid_argument("Key file " + path + " failed validation: " +
+                                KeyDefectName(defect));
+  }
+  return key_pair;
+}
+
+}  // namespace rsa_app
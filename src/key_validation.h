@@ -0,0 +1,115 @@
+#ifndef RSA_APP_KEY_VALIDATION_H_
+#define RSA_APP_KEY_VALIDATION_H_
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "key_table.h"
+#include "rsa.h"
+#include "thread_pool.h"
+
+namespace rsa_app {
+
+/**
+ * How thoroughly a key is checked.
+ */
+enum class KeyCheckLevel {
+  kCheap,  // Sizes, small factors and an encrypt/decrypt round trip.
+  kFull,   // kCheap, then recovers p and q and tests them for primality.
+};
+
+/**
+ * The first check a key failed.
+ */
+enum class KeyDefect {
+  kNone,
+  kBadModulus,        // n is even, below 512 bits or differs between halves.
+  kBadExponent,       // e is even or not in (1, n), or d is not in (1, n).
+  kSmallFactor,       // n has a factor below 2^16.
+  kRoundTripFailed,   // Decrypting an encrypted random message gave another.
+  kNoFactorization,   // e*d - 1 does not reveal p and q.
+  kCompositeFactor,   // p or q is not prime.
+  kCloseFactors,      // |p - q| is small enough for Fermat factoring.
+};
+
+/**
+ * Returns a printable name such as "small_factor".
+ */
+const char* KeyDefectName(KeyDefect defect);
+
+/**
+ * Checks one key pair.
+ *
+ * A key from `GenerateKeyPair` has d = e^-1 mod phi(n), so the multiple
+ * k in e*d - 1 = k*phi(n) is ceil((e*d - 1) / n) or one more; phi(n) and
+ * then p + q and p, q follow in a few multiplications and one square root.
+ * Keys with d taken mod lambda(n) fall back to the randomized reduction
+ * from e*d - 1 that Miller's theorem allows. Once p and q are known the
+ * round trip decrypts with CRT, still exercising the stored d.
+ *
+ * @param key_pair The key to check.
+ * @param level The checks to run.
+ * @return `KeyDefect::kNone` or the first failed check.
+ */
+KeyDefect CheckKeyPair(const KeyPair& key_pair, KeyCheckLevel level);
+
+/**
+ * Checks the key stored at `index` of `table`.
+ */
+KeyDefect CheckKeyPair(const KeyTable& table, size_t index, KeyCheckLevel level);
+
+/**
+ * Outcome of validating many keys.
+ */
+struct KeyValidationReport {
+  size_t checked = 0;
+  std::vector<std::pair<size_t, KeyDefect>> failures;  // Index and defect, ascending.
+  double seconds = 0.0;
+};
+
+/**
+ * Checks every key of a table in parallel on `pool`.
+ */
+KeyValidationReport ValidateKeys(const KeyTable& table, KeyCheckLevel level, ThreadPool& pool);
+
+/**
+ * Checks key pairs in parallel on `pool`.
+ */
+KeyValidationReport ValidateKeys(const std::vector<KeyPair>& keys, KeyCheckLevel level,
+                                 ThreadPool& pool);
+
+/**
+ * Outcome of `LoadKeyTable`.
+ */
+struct KeyLoadReport {
+  size_t loaded = 0;  // Keys added to the table.
+  // Index into the path list and the reason the key was rejected: the
+  // loader's exception message or the `KeyDefectName`.
+  std::vector<std::pair<size_t, std::string>> rejected;
+  double seconds = 0.0;
+};
+
+/**
+ * Reads key files written by `SaveKeyPair`, validates them and adds the
+ * valid ones to `table` in path order.
+ *
+ * Reading and validation run in parallel on `pool`; the keys are added on
+ * the calling thread, since `KeyTable::Add` is not concurrent.
+ */
+KeyLoadReport LoadKeyTable(const std::vector<std::string>& paths, KeyTable& table,
+                           KeyCheckLevel level, ThreadPool& pool);
+
+/**
+ * Reads a key file like `LoadKeyPair` and validates it.
+ *
+ * @throws std::runtime_error If the file cannot be read.
+ * @throws std::invalid_argument If the file is malformed or the key fails
+ *         a check; the message names the defect.
+ */
+KeyPair LoadValidatedKeyPair(const std::string& path, KeyCheckLevel level);
+
+}  // namespace rsa_app
+
+#endif  // RSA_APP_KEY_VALIDATION_H_
@@ -0,0 +1,64 @@
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "key_validation.h"
+
+// Validates a keystore at both levels and projects the time a million keys
+// would take. The table repeats a few generated keys, since generating a
+// large keystore would dominate the run; validation cost does not depend
+// on whether keys repeat.
+
+int main(int argc, char** argv) {
+    int bits = 2048;
+    size_t distinct = 16;
+    size_t table_size = 1024;
+    size_t threads = rsa_app::ThreadPool::DefaultThreadCount();
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--bits") {
+            bits = std::stoi(argv[i + 1]);
+        } else if (flag == "--keys") {
+            distinct = std::stoul(argv[i + 1]);
+        } else if (flag == "--table") {
+            table_size = std::stoul(argv[i + 1]);
+        } else if (flag == "--threads") {
+            threads = std::stoul(argv[i + 1]);
+        } else {
+            std::cerr << "Unknown option " << flag
+                      << " (supported: --bits N, --keys N, --table N, --threads N)\n";
+            return 2;
+        }
+    }
+    if (distinct == 0 || table_size == 0 || threads == 0) {
+        std::cerr << "--keys, --table and --threads must be positive\n";
+        return 2;
+    }
+
+    std::vector<rsa_app::KeyPair> keys;
+    for (size_t i = 0; i < distinct; ++i) keys.push_back(rsa_app::GenerateKeyPair(bits));
+    rsa_app::KeyTable table(bits, table_size);
+    for (size_t i = 0; i < table_size; ++i) table.Add(keys[i % distinct]);
+
+    std::cout << table_size << " keys of " << bits << " bits (" << distinct << " distinct)\n\n"
+              << std::setw(8) << "level" << std::setw(9) << "threads" << std::setw(12) << "keys/s"
+              << std::setw(16) << "1M keys (s)\n";
+    std::vector<size_t> thread_counts = {1};
+    if (threads > 1) thread_counts.push_back(threads);
+    for (auto level : {rsa_app::KeyCheckLevel::kCheap, rsa_app::KeyCheckLevel::kFull}) {
+        for (size_t count : thread_counts) {
+            rsa_app::ThreadPool pool(count);
+            rsa_app::KeyValidationReport report = rsa_app::ValidateKeys(table, level, pool);
+            if (!report.failures.empty()) {
+                throw std::runtime_error(std::string("Generated key failed validation: ") +
+                                         rsa_app::KeyDefectName(report.failures[0].second));
+            }
+            double rate = static_cast<double>(report.checked) / report.seconds;
+            std::cout << std::setw(8) << (level == rsa_app::KeyCheckLevel::kCheap ? "cheap" : "full")
+                      << std::setw(9) << count << std::fixed << std::setprecision(1)
+                      << std::setw(12) << rate << std::setw(15) << 1e6 / rate << "\n";
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "drbg.h"
+#include "rsa.h"
+#include "thread_pool.h"
+
+// Where the prime search draws its randomness from
+enum class RngMode { kOpenSsl, kThreadDrbg, kSeeded };
+
+const char* RngModeName(RngMode mode) {
+    switch (mode) {
+        case RngMode::kOpenSsl:
+            return "openssl";
+        case RngMode::kThreadDrbg:
+            return "thread_drbg";
+        case RngMode::kSeeded:
+            return "seeded_drbg";
+    }
+    return "unknown";
+}
+
+// Generates `keys_per_thread` keys on each of `threads` workers and returns
+// keys per second.
+double MeasureKeysPerSecond(RngMode mode, int bits, size_t threads, size_t keys_per_thread) {
+    rsa_app::ThreadPool pool(threads);
+    size_t keys = threads * keys_per_thread;
+    auto start = std::chrono::steady_clock::now();
+    pool.ParallelFor(keys, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (mode == RngMode::kOpenSsl) {
+                rsa_app::GenerateKeyPair(bits);
+            } else if (mode == RngMode::kThreadDrbg) {
+                rsa_app::GenerateKeyPair(bits, rsa_app::ThreadDrbg());
+            } else {
+                // One stream per key: the same keys whatever the thread count.
+                rsa_app::Drbg drbg(2024, i);
+                rsa_app::GenerateKeyPair(bits, drbg);
+            }
+        }
+    });
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(keys) / elapsed.count();
+}
+
+int main(int argc, char** argv) {
+    int bits = 1024;
+    size_t keys_per_thread = 2;
+    size_t max_threads = 64;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--bits") {
+            bits = std::stoi(argv[i + 1]);
+        } else if (flag == "--keys") {
+            keys_per_thread = std::stoul(argv[i + 1]);
+        } else if (flag == "--max-threads") {
+            max_threads = std::stoul(argv[i + 1]);
+        } else {
+            std::cerr << "Unknown option " << flag
+                      << " (supported: --bits N, --keys N, --max-threads N)\n";
+            return 2;
+        }
+    }
+
+    std::cout << "Key generation throughput, " << bits << "-bit keys, " << keys_per_thread
+              << " keys per thread, " << rsa_app::ThreadPool::DefaultThreadCount()
+              << " hardware threads\n";
+    std::cout << std::left << std::setw(14) << "rng" << std::right << std::setw(8) << "threads"
+              << std::setw(12) << "keys/s" << std::setw(10) << "scaling\n";
+    for (RngMode mode : {RngMode::kOpenSsl, RngMode::kThreadDrbg, RngMode::kSeeded}) {
+        double baseline = 0.0;
+        for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+            double rate = MeasureKeysPerSecond(mode, bits, threads, keys_per_thread);
+            if (threads == 1) baseline = rate;
+            std::cout << std::left << std::setw(14) << RngModeName(mode) << std::right
+                      << std::setw(8) << threads << std::setw(12) << std::fixed
+                      << std::setprecision(2) << rate << std::setw(9) << rate / baseline
+                      << "x\n";
+        }
+    }
+    return 0;
+}
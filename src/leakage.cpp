@@ -0,0 +1,140 @@
+#include "leakage.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#include "stats.h"
+
+namespace rsa_app {
+
+namespace {
+
+// Test indices besides the cropped ones, which are 1..kCropCount.
+constexpr int kAllTest = 0;
+constexpr int kSecondOrderTest = static_cast<int>(LeakageTest::kCropCount) + 1;
+
+}  // namespace
+
+uint64_t ReadCycleCounter() {
+#if defined(__x86_64__)
+  _mm_lfence();
+  uint64_t cycles = __rdtsc();
+  _mm_lfence();
+  return cycles;
+#else
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now().time_since_epoch())
+                                   .count());
+#endif
+}
+
+const char* CycleCounterName() {
+#if defined(__x86_64__)
+  return "rdtsc";
+#else
+  return "steady_clock_ns";
+#endif
+}
+
+void OnlineWelchTest::Push(int cls, double value) {
+  ++count_[cls];
+  double delta = value - mean_[cls];
+  mean_[cls] += delta / static_cast<double>(count_[cls]);
+  m2_[cls] += delta * (value - mean_[cls]);
+}
+
+double OnlineWelchTest::T() const {
+  if (count_[0] < 2 || count_[1] < 2) return 0.0;
+  double var0 = m2_[0] / static_cast<double>(count_[0] - 1);
+  double var1 = m2_[1] / static_cast<double>(count_[1] - 1);
+  double se = std::sqrt(var0 / static_cast<double>(count_[0]) +
+                        var1 / static_cast<double>(count_[1]));
+  if (se == 0.0) return mean_[0] == mean_[1] ? 0.0 : HUGE_VAL;
+  return (mean_[0] - mean_[1]) / se;
+}
+
+LeakageTest::LeakageTest(size_t calibration) : calibration_(calibration) {
+  if (calibration == 0) throw std::invalid_argument("calibration must be positive");
+  pending_.reserve(calibration);
+}
+
+void LeakageTest::Push(int cls, uint64_t cycles) {
+  if (cls != 0 && cls != 1) throw std::invalid_argument("class must be 0 or 1");
+  if (Calibrated()) {
+    Record(cls, static_cast<double>(cycles));
+    return;
+  }
+  pending_.emplace_back(cls, cycles);
+  if (pending_.size() < calibration_) return;
+
+  std::vector<double> sorted;
+  sorted.reserve(pending_.size());
+  for (const auto& sample : pending_) sorted.push_back(static_cast<double>(sample.second));
+  std::sort(sorted.begin(), sorted.end());
+  for (size_t i = 0; i < kCropCount; ++i) {
+    double q = 1.0 - std::pow(0.5, 10.0 * static_cast<double>(i + 1) / kCropCount);
+    percentiles_.push_back(q);
+    thresholds_.push_back(Percentile(sorted, q));
+  }
+  tests_.assign(TestCount(), OnlineWelchTest());
+  for (const auto& sample : pending_) Record(sample.first, static_cast<double>(sample.second));
+  pending_.clear();
+  pending_.shrink_to_fit();
+}
+
+void LeakageTest::Record(int cls, double value) {
+  tests_[kAllTest].Push(cls, value);
+  for (size_t i = 0; i < kCropCount; ++i) {
+    if (value < thresholds_[i]) tests_[i + 1].Push(cls, value);
+  }
+  // The class mean is still settling during the first samples; their
+  // squared deviations would only add noise.
+  if (tests_[kAllTest].Count(cls) > 100) {
+    double centered = value - tests_[kAllTest].Mean(cls);
+    tests_[kSecondOrderTest].Push(cls, centered * centered);
+  }
+}
+
+LeakageResult LeakageTest::Result() const {
+  LeakageResult result;
+  if (!Calibrated()) {
+    result.measurements = pending_.size();
+    return result;
+  }
+  result.measurements = tests_[kAllTest].Count(0) + tests_[kAllTest].Count(1);
+  for (size_t i = 0; i < tests_.size(); ++i) {
+    double t = std::fabs(tests_[i].T());
+    if (result.worst_test >= 0 && t <= result.max_t) continue;
+    result.max_t = t;
+    result.worst_test = static_cast<int>(i);
+    double samples = static_cast<double>(tests_[i].Count(0) + tests_[i].Count(1));
+    result.max_tau = samples > 0.0 ? t / std::sqrt(samples) : 0.0;
+  }
+  result.leaks = result.max_t > kLeakageThreshold;
+  return result;
+}
+
+std::string LeakageTest::TestName(int index) const {
+  if (index == kAllTest) return "all";
+  if (index == kSecondOrderTest) return "second order";
+  if (index < kAllTest || index > kSecondOrderTest || !Calibrated()) {
+    throw std::out_of_range("No leakage test " + std::to_string(index));
+  }
+  char name[32];
+  std::snprintf(name, sizeof(name), "crop p%.3g", 100.0 * percentiles_[index - 1]);
+  return name;
+}
+
+double LeakageTest::TestT(int index) const {
+  if (!Calibrated()) return 0.0;
+  return tests_.at(static_cast<size_t>(index)).T();
+}
+
+}  // namespace rsa_app
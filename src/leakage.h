@@ -0,0 +1,157 @@
+#ifndef RSA_APP_LEAKAGE_H_
+#define RSA_APP_LEAKAGE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rsa_app {
+
+/**
+ * Returns a timestamp for timing one call.
+ *
+ * On x86-64 this is the time-stamp counter read between `lfence`s, so
+ * neighbouring instructions cannot drift across the read; elsewhere it is
+ * `steady_clock` in nanoseconds. Only differences between two reads on the
+ * same thread are meaningful.
+ */
+uint64_t ReadCycleCounter();
+
+/**
+ * Returns "rdtsc" or "steady_clock_ns", naming what `ReadCycleCounter`
+ * counts.
+ */
+const char* CycleCounterName();
+
+/**
+ * Welch's t-test between two classes, updated one sample at a time.
+ *
+ * Means and variances are kept with Welford's method, so millions of
+ * samples need constant memory and no catastrophic cancellation.
+ */
+class OnlineWelchTest {
+ public:
+  /**
+   * Adds a sample to class 0 or 1.
+   */
+  void Push(int cls, double value);
+
+  /**
+   * Returns the t statistic of class 0 against class 1, or 0 until both
+   * classes have two samples.
+   */
+  double T() const;
+
+  /**
+   * Returns the number of samples in a class.
+   */
+  uint64_t Count(int cls) const { return count_[cls]; }
+
+  /**
+   * Returns the mean of a class.
+   */
+  double Mean(int cls) const { return mean_[cls]; }
+
+ private:
+  double mean_[2] = {0.0, 0.0};
+  double m2_[2] = {0.0, 0.0};  // Sum of squared deviations from the mean.
+  uint64_t count_[2] = {0, 0};
+};
+
+/**
+ * Outcome of a `LeakageTest`.
+ */
+struct LeakageResult {
+  uint64_t measurements = 0;  // Samples pushed (both classes).
+  double max_t = 0.0;         // Largest |t| over all tests.
+  double max_tau = 0.0;       // max_t / sqrt(samples of that test).
+  int worst_test = -1;        // Index into `LeakageTest::TestName`; -1 before calibration.
+  bool leaks = false;         // max_t above `kLeakageThreshold`.
+};
+
+/**
+ * A |t| above this says the two classes have different timing
+ * distributions. dudect uses the same bound; 4.5 is the textbook 1e-5
+ * significance level, but with ~100 tests at once 10 keeps false alarms
+ * away.
+ */
+constexpr double kLeakageThreshold = 10.0;
+
+/**
+ * dudect-style fixed-versus-random timing test.
+ *
+ * Callers time a kernel on inputs of two classes, typically a fixed value
+ * against fresh random values, interleaved in random order, and push each
+ * timing with its class. The test keeps one Welch t-test on all samples,
+ * `kCropCount` t-tests on samples below increasing percentiles, which drop
+ * the long tail of interrupts and cache misses that would otherwise hide a
+ * small difference, and a second-order test on the squared deviation from
+ * the class mean, which catches kernels whose variance rather than mean
+ * depends on the class.
+ *
+ * The crop percentiles are taken from the first `calibration` samples,
+ * which are held back until then and counted afterwards. Percentile i is
+ * `1 - 0.5^(10 (i + 1) / kCropCount)`, dense near the top of the
+ * distribution where the tail starts.
+ *
+ * Not thread-safe.
+ */
+class LeakageTest {
+ public:
+  static constexpr size_t kCropCount = 100;
+
+  /**
+   * @param calibration Samples used to pick the crop thresholds.
+   * @throws std::invalid_argument If `calibration` is 0.
+   */
+  explicit LeakageTest(size_t calibration = 10000);
+
+  /**
+   * Adds the timing of one call.
+   *
+   * @param cls 0 for the fixed class, 1 for the random class.
+   * @param cycles The call's duration in `ReadCycleCounter` units.
+   */
+  void Push(int cls, uint64_t cycles);
+
+  /**
+   * Returns true once the crop thresholds are set.
+   */
+  bool Calibrated() const { return !thresholds_.empty(); }
+
+  /**
+   * Returns the verdict over everything pushed so far.
+   */
+  LeakageResult Result() const;
+
+  /**
+   * Returns the number of tests: one uncropped, `kCropCount` cropped and
+   * one second-order.
+   */
+  static size_t TestCount() { return kCropCount + 2; }
+
+  /**
+   * Describes test `index`, e.g. "all", "crop p99.3" or "second order".
+   */
+  std::string TestName(int index) const;
+
+  /**
+   * Returns the t statistic of test `index`, or 0 before calibration.
+   */
+  double TestT(int index) const;
+
+ private:
+  void Record(int cls, double value);
+
+  size_t calibration_;
+  std::vector<std::pair<int, uint64_t>> pending_;  // Samples before calibration.
+  std::vector<double> thresholds_;                  // One per cropped test.
+  std::vector<double> percentiles_;                 // Matching percentiles.
+  std::vector<OnlineWelchTest> tests_;
+};
+
+}  // namespace rsa_app
+
+#endif  // RSA_APP_LEAKAGE_H_
@@ -0,0 +1,250 @@
+#include "lz.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace rsa_app {
+
+namespace {
+
+constexpr unsigned char kFrameStored = 0;
+constexpr unsigned char kFrameCompressed = 1;
+constexpr size_t kStoredHeaderBytes = 4;
+constexpr size_t kCompressedHeaderBytes = 7;
+
+constexpr size_t kMinMatch = 4;
+constexpr size_t kMaxOffset = 0xffff;
+constexpr int kHashBits = 12;
+// After this many misses in a row the search skips ahead faster, so
+// incompressible input costs little.
+constexpr size_t kSkipShift = 6;
+
+uint32_t Load32(const unsigned char* p) {
+  uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+uint32_t Hash(uint32_t sequence) { return (sequence * 2654435761u) >> (32 - kHashBits); }
+
+void PutLength24(std::string& out, size_t value) {
+  out.push_back(static_cast<char>(value >> 16));
+  out.push_back(static_cast<char>(value >> 8 & 0xff));
+  out.push_back(static_cast<char>(value & 0xff));
+}
+
+size_t GetLength24(const unsigned char* p) {
+  return static_cast<size_t>(p[0]) << 16 | static_cast<size_t>(p[1]) << 8 | p[2];
+}
+
+// Writes the part of a length beyond the 15 that fits in a token nibble.
+void PutExtraLength(std::string& out, size_t extra) {
+  for (; extra >= 255; extra -= 255) out.push_back(static_cast<char>(255));
+  out.push_back(static_cast<char>(extra));
+}
+
+void PutSequence(std::string& out, const unsigned char* literals, size_t literal_count,
+                 size_t offset, size_t match_length) {
+  size_t match_code = match_length - kMinMatch;
+  auto token = static_cast<unsigned char>(std::min<size_t>(literal_count, 15) << 4 |
+                                          std::min<size_t>(match_code, 15));
+  out.push_back(static_cast<char>(token));
+  if (literal_count >= 15) PutExtraLength(out, literal_count - 15);
+  out.append(reinterpret_cast<const char*>(literals), literal_count);
+  out.push_back(static_cast<char>(offset & 0xff));
+  out.push_back(static_cast<char>(offset >> 8));
+  if (match_code >= 15) PutExtraLength(out, match_code - 15);
+}
+
+void PutLastLiterals(std::string& out, const unsigned char* literals, size_t literal_count) {
+  out.push_back(static_cast<char>(std::min<size_t>(literal_count, 15) << 4));
+  if (literal_count >= 15) PutExtraLength(out, literal_count - 15);
+  out.append(reinterpret_cast<const char*>(literals), literal_count);
+}
+
+// Appends one frame holding `length` (1..kLzFrameBytes) bytes of `input`.
+void CompressFrame(const unsigned char* input, size_t length, std::vector<uint32_t>& table,
+                   std::string& out) {
+  std::string body;
+  body.reserve(length);
+  std::fill(table.begin(), table.end(), 0);
+  size_t anchor = 0, pos = 0, misses = 0;
+  while (pos + kMinMatch <= length) {
+    uint32_t sequence = Load32(input + pos);
+    uint32_t& slot = table[Hash(sequence)];
+    size_t candidate = slot;  // Position + 1; 0 is empty.
+    slot = static_cast<uint32_t>(pos + 1);
+    if (candidate != 0 && pos - (candidate - 1) <= kMaxOffset &&
+        Load32(input + candidate - 1) == sequence) {
+      size_t match = candidate - 1;
+      size_t match_length = kMinMatch;
+      while (pos + match_length < length &&
+             input[match + match_length] == input[pos + match_length]) {
+        ++match_length;
+      }
+      PutSequence(body, input + anchor, pos - anchor, pos - match, match_length);
+      pos += match_length;
+      anchor = pos;
+      misses = 0;
+      // Stop once the body is no smaller than storing the frame.
+      if (body.size() + kCompressedHeaderBytes >= length + kStoredHeaderBytes) break;
+    } else {
+      pos += 1 + (misses++ >> kSkipShift);
+    }
+  }
+  // A literals-only sequence, possibly empty, ends the frame.
+  PutLastLiterals(body, input + anchor, length - anchor);
+
+  if (body.size() + kCompressedHeaderBytes < length + kStoredHeaderBytes) {
+    out.push_back(static_cast<char>(kFrameCompressed));
+    PutLength24(out, length);
+    PutLength24(out, body.size());
+    out += body;
+  } else {
+    out.push_back(static_cast<char>(kFrameStored));
+    PutLength24(out, length);
+    out.append(reinterpret_cast<const char*>(input), length);
+  }
+}
+
+// Reads the part of a length beyond 15; `limit` bounds the result.
+size_t GetExtraLength(const unsigned char*& in, const unsigned char* end, size_t limit) {
+  size_t extra = 0;
+  for (;;) {
+    if (in == end) throw std::invalid_argument("Truncated LZ length");
+    unsigned char byte = *in++;
+    extra += byte;
+    if (extra > limit) throw std::invalid_argument("LZ length exceeds the frame");
+    if (byte != 255) return extra;
+  }
+}
+
+void DecompressBody(const unsigned char* in, size_t size, size_t raw_length, std::string& out) {
+  const unsigned char* end = in + size;
+  size_t start = out.size();
+  size_t limit = start + raw_length;
+  out.reserve(limit);
+  for (;;) {
+    if (in == end) throw std::invalid_argument("Truncated LZ sequence");
+    unsigned char token = *in++;
+    size_t literal_count = token >> 4;
+    if (literal_count == 15) literal_count += GetExtraLength(in, end, raw_length);
+    if (literal_count > static_cast<size_t>(end - in) || out.size() + literal_count > limit) {
+      throw std::invalid_argument("LZ literals exceed the frame");
+    }
+    out.append(reinterpret_cast<const char*>(in), literal_count);
+    in += literal_count;
+    if (in == end) break;
+
+    if (end - in < 2) throw std::invalid_argument("Truncated LZ offset");
+    size_t offset = in[0] | static_cast<size_t>(in[1]) << 8;
+    in += 2;
+    size_t match_length = (token & 15) + kMinMatch;
+    if ((token & 15) == 15) match_length += GetExtraLength(in, end, raw_length);
+    if (offset == 0 || offset > out.size() - start || out.size() + match_length > limit) {
+      throw std::invalid_argument("LZ match outside the frame");
+    }
+    size_t from = out.size() - offset;
+    if (offset >= match_length) {
+      out.append(out, from, match_length);
+    } else {
+      // The match overlaps the bytes it produces.
+      for (size_t i = 0; i < match_length; ++i) out.push_back(out[from + i]);
+    }
+  }
+  if (out.size() != limit) throw std::invalid_argument("LZ frame length mismatch");
+}
+
+}  // namespace
+
+std::string LzCompress(const std::string& data) {
+  LzStreamCompressor compressor;
+  std::string out = compressor.Update(data);
+  out += compressor.Finish();
+  return out;
+}
+
+std::string LzDecompress(const std::string& frames) {
+  LzStreamDecompressor decompressor;
+  std::string out = decompressor.Update(frames);
+  decompressor.Finish();
+  return out;
+}
+
+LzStreamCompressor::LzStreamCompressor() : table_(size_t{1} << kHashBits) {}
+
+std::string LzStreamCompressor::Update(const char* data, size_t length) {
+  std::string out;
+  const auto* input = reinterpret_cast<const unsigned char*>(data);
+  while (length > 0) {
+    // Whole frames skip the buffer.
+    if (pending_.empty() && length >= kLzFrameBytes) {
+      CompressFrame(input, kLzFrameBytes, table_, out);
+      input += kLzFrameBytes;
+      length -= kLzFrameBytes;
+      continue;
+    }
+    size_t take = std::min(length, kLzFrameBytes - pending_.size());
+    pending_.append(reinterpret_cast<const char*>(input), take);
+    input += take;
+    length -= take;
+    if (pending_.size() == kLzFrameBytes) {
+      CompressFrame(reinterpret_cast<const unsigned char*>(pending_.data()), pending_.size(),
+                    table_, out);
+      pending_.clear();
+    }
+  }
+  return out;
+}
+
+std::string LzStreamCompressor::Finish() {
+  std::string out;
+  if (!pending_.empty()) {
+    CompressFrame(reinterpret_cast<const unsigned char*>(pending_.data()), pending_.size(),
+                  table_, out);
+    pending_.clear();
+  }
+  return out;
+}
+
+std::string LzStreamDecompressor::Update(const char* data, size_t length) {
+  pending_.append(data, length);
+  std::string out;
+  size_t pos = 0;
+  for (;;) {
+    const auto* frame = reinterpret_cast<const unsigned char*>(pending_.data()) + pos;
+    size_t available = pending_.size() - pos;
+    if (available < kStoredHeaderBytes) break;
+    unsigned char type = frame[0];
+    size_t raw_length = GetLength24(frame + 1);
+    if ((type != kFrameStored && type != kFrameCompressed) || raw_length == 0 ||
+        raw_length > kLzFrameBytes) {
+      throw std::invalid_argument("Malformed LZ frame header");
+    }
+    if (type == kFrameStored) {
+      if (available < kStoredHeaderBytes + raw_length) break;
+      out.append(reinterpret_cast<const char*>(frame) + kStoredHeaderBytes, raw_length);
+      pos += kStoredHeaderBytes + raw_length;
+      continue;
+    }
+    if (available < kCompressedHeaderBytes) break;
+    size_t stored_length = GetLength24(frame + 4);
+    if (stored_length == 0 || stored_length > kLzFrameBytes) {
+      throw std::invalid_argument("Malformed LZ frame header");
+    }
+    if (available < kCompressedHeaderBytes + stored_length) break;
+    DecompressBody(frame + kCompressedHeaderBytes, stored_length, raw_length, out);
+    pos += kCompressedHeaderBytes + stored_length;
+  }
+  pending_.erase(0, pos);
+  return out;
+}
+
+void LzStreamDecompressor::Finish() {
+  bool partial = !pending_.empty();
+  pending_.clear();
+  if (partial) throw std::invalid_argument("LZ stream ends inside a frame");
+}
+
+}  // namespace rsa_app
@@ -0,0 +1,101 @@
+#ifndef RSA_APP_LZ_H_
+#define RSA_APP_LZ_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace rsa_app {
+
+/**
+ * Most input bytes compressed as one frame. Frames are independent, so
+ * compressing or decompressing a stream never holds more than one frame of
+ * input and one of output.
+ */
+constexpr size_t kLzFrameBytes = 64 * 1024;
+
+/**
+ * Compresses `data` into LZ frames.
+ *
+ * The format is a sequence of frames. A frame header is a type byte
+ * followed by the frame's original length as a 24-bit big-endian integer.
+ * Stored frames (type 0) then hold the bytes as they are. Compressed frames
+ * (type 1) add the compressed length, also 24-bit, and LZ4-style
+ * sequences: a token whose high nibble is the literal count and low nibble
+ * the match length minus 4 (15 means more length bytes follow, each added
+ * until one is below 255), the literals, and a 16-bit little-endian
+ * back-reference offset. The last sequence of a frame has literals only.
+ * A frame is stored whenever compression would not make it smaller.
+ *
+ * Matches are found with a single-probe hash table of 4-byte prefixes, so
+ * compression is fast and greedy rather than tight.
+ *
+ * @param data The bytes to compress.
+ * @return The frames; empty input gives empty output.
+ */
+std::string LzCompress(const std::string& data);
+
+/**
+ * Decompresses the output of `LzCompress` or `LzStreamCompressor`.
+ *
+ * @param frames The frames.
+ * @return The original bytes.
+ * @throws std::invalid_argument If the frames are truncated or corrupt.
+ */
+std::string LzDecompress(const std::string& frames);
+
+/**
+ * Compresses a stream in `kLzFrameBytes` frames.
+ *
+ * Input is buffered until a frame is full; the concatenated output of
+ * `Update` and `Finish` equals `LzCompress` of the concatenated input.
+ */
+class LzStreamCompressor {
+ public:
+  LzStreamCompressor();
+
+  /**
+   * Adds input and returns the frames completed by it.
+   */
+  std::string Update(const char* data, size_t length);
+  std::string Update(const std::string& data) { return Update(data.data(), data.size()); }
+
+  /**
+   * Compresses the buffered input and resets the stream.
+   */
+  std::string Finish();
+
+ private:
+  std::string pending_;         // Input of the frame being filled.
+  std::vector<uint32_t> table_;  // Hash table reused across frames.
+};
+
+/**
+ * Decompresses a stream of LZ frames delivered in arbitrary pieces.
+ */
+class LzStreamDecompressor {
+ public:
+  /**
+   * Adds compressed bytes and returns the output of the frames they
+   * complete.
+   *
+   * @throws std::invalid_argument If a frame is corrupt.
+   */
+  std::string Update(const char* data, size_t length);
+  std::string Update(const std::string& data) { return Update(data.data(), data.size()); }
+
+  /**
+   * Ends the stream and resets it.
+   *
+   * @throws std::invalid_argument If the stream ends inside a frame.
+   */
+  void Finish();
+
+ private:
+  std::string pending_;  // Bytes of the incomplete frame.
+};
+
+}  // namespace rsa_app
+
+#endif  // RSA_APP_LZ_H_
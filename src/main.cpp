@@ -1,9 +1,386 @@
 #include "rsa.h"
+#include "codec.h"
+#include "key_validation.h"
+#include "trace.h"
+#include "tuner.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
+#include <stdexcept>
 #include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * How records are framed on stdin and stdout in batch mode.
+ */
+enum class RecordFormat {
+    kLines,   // One record per line; ciphertexts are text-encoded.
+    kLength,  // 4-byte big-endian length followed by the raw record bytes.
+};
+
+/**
+ * How ciphertexts are written in line mode.
+ */
+enum class TextEncoding {
+    kHex,
+    kBase64,
+};
+
+/**
+ * Parsed command-line options.
+ */
+struct Options {
+    std::string command;
+    std::string key_path;
+    std::string public_path;
+    std::string profile_path;
+    std::string trace_path;  // Empty: no trace.
+    int bits = 0;           // 0: 4096 for keygen, every tuned size for tune.
+    size_t threads = 0;     // 0: the profile's plan, else all cores.
+    size_t batch_size = 0;  // 0: the profile's plan, else kDefaultBatchSize.
+    bool variable_time = false;  // tune may pick non-constant-time kernels.
+    bool validate_key = true;    // decrypt checks the key before use.
+    rsa_app::KeyCheckLevel check_level = rsa_app::KeyCheckLevel::kCheap;
+    RecordFormat format = RecordFormat::kLines;
+    TextEncoding encoding = TextEncoding::kHex;
+};
+
+constexpr int kDefaultKeygenBits = 4096;
+constexpr size_t kDefaultBatchSize = 4096;
+
+void PrintUsage(std::ostream& out) {
+    out << "Usage:\n"
+           "  rsa_program                      Interactive demo\n"
+           "  rsa_program keygen --out FILE [--public FILE] [--bits N]\n"
+           "  rsa_program encrypt --key FILE [options] < records > ciphertexts\n"
+           "  rsa_program decrypt --key FILE [options] < ciphertexts > records\n"
+           "  rsa_program tune --profile FILE [--bits N] [--kernels K]\n"
+           "\n"
+           "Options:\n"
+           "  --bits N          Modulus size for keygen (default 4096); for tune, the\n"
+           "                    size to calibrate (default 2048, 3072 and 4096)\n"
+           "  --threads N       Worker threads (default: all cores)\n"
+           "  --format F        'lines' (default) or 'length' (4-byte big-endian\n"
+           "                    length prefix per record)\n"
+           "  --encoding E      Ciphertext text encoding in line mode: 'hex'\n"
+           "                    (default) or 'base64'\n"
+           "  --batch N         Records processed per parallel batch (default 4096)\n"
+           "  --profile FILE    Tuning profile; encrypt and decrypt use its plan for the\n"
+           "                    key size (threads, batch, kernel), calibrating and\n"
+           "                    saving one first if the file lacks a plan for this host.\n"
+           "                    --threads and --batch override the plan\n"
+           "  --kernels K       For tune: 'constant-time' (default) or 'any', which\n"
+           "                    also lets OpenSSL's variable-time exponentiation win\n"
+           "  --validate V      For decrypt: check the key before use, 'cheap' (default:\n"
+           "                    sizes, small factors, a round trip), 'full' (also the\n"
+           "                    primality of p and q) or 'none'\n"
+           "  --trace FILE      Record spans of key generation, exponentiation and the\n"
+           "                    thread pool and write them as Chrome trace JSON\n"
+           "                    (open in chrome://tracing or ui.perfetto.dev)\n"
+           "\n"
+           "Each record is encrypted as a single block, so it must be shorter than the\n"
+           "modulus. Leading zero bytes of a record are not preserved.\n";
+}
+
+size_t ParseCount(const std::string& flag, const std::string& value) {
+    size_t parsed = 0;
+    try {
+        parsed = std::stoul(value);
+    } catch (const std::exception&) {
+        throw std::invalid_argument(flag + " expects a number, got '" + value + "'");
+    }
+    if (parsed == 0) throw std::invalid_argument(flag + " must be positive");
+    return parsed;
+}
+
+Options ParseOptions(int argc, char** argv) {
+    Options options;
+    options.command = argv[1];
+    for (int i = 2; i < argc; ++i) {
+        std::string flag = argv[i];
+        if (i + 1 >= argc) throw std::invalid_argument("Missing value for " + flag);
+        std::string value = argv[++i];
+        if (flag == "--key" || flag == "--out") {
+            options.key_path = value;
+        } else if (flag == "--profile") {
+            options.profile_path = value;
+        } else if (flag == "--trace") {
+            options.trace_path = value;
+        } else if (flag == "--public") {
+            options.public_path = value;
+        } else if (flag == "--bits") {
+            options.bits = static_cast<int>(ParseCount(flag, value));
+        } else if (flag == "--threads") {
+            options.threads = ParseCount(flag, value);
+        } else if (flag == "--batch") {
+            options.batch_size = ParseCount(flag, value);
+        } else if (flag == "--kernels") {
+            if (value == "constant-time") {
+                options.variable_time = false;
+            } else if (value == "any") {
+                options.variable_time = true;
+            } else {
+                throw std::invalid_argument("Unknown kernel set '" + value + "'");
+            }
+        } else if (flag == "--validate") {
+            options.validate_key = value != "none";
+            if (value == "cheap") {
+                options.check_level = rsa_app::KeyCheckLevel::kCheap;
+            } else if (value == "full") {
+                options.check_level = rsa_app::KeyCheckLevel::kFull;
+            } else if (value != "none") {
+                throw std::invalid_argument("Unknown validation level '" + value + "'");
+            }
+        } else if (flag == "--format") {
+            if (value == "lines") {
+                options.format = RecordFormat::kLines;
+            } else if (value == "length") {
+                options.format = RecordFormat::kLength;
+            } else {
+                throw std::invalid_argument("Unknown format '" + value + "'");
+            }
+        } else if (flag == "--encoding") {
+            if (value == "hex") {
+                options.encoding = TextEncoding::kHex;
+            } else if (value == "base64") {
+                options.encoding = TextEncoding::kBase64;
+            } else {
+                throw std::invalid_argument("Unknown encoding '" + value + "'");
+            }
+        } else {
+            throw std::invalid_argument("Unknown option " + flag);
+        }
+    }
+    if (options.command == "tune") {
+        if (options.profile_path.empty()) throw std::invalid_argument("tune requires --profile");
+    } else if (options.key_path.empty()) {
+        throw std::invalid_argument(options.command == "keygen" ? "keygen requires --out"
+                                                                : "Missing --key");
+    }
+    return options;
+}
 
 /**
- * Main function demonstrating RSA encryption and decryption.
+ * Reads one record from `in`; returns false at a clean end of input.
+ *
+ * A length prefix above `max_length` is rejected before anything is
+ * allocated, so a misframed stream cannot request a 4 GiB record.
+ */
+bool ReadRecord(std::istream& in, RecordFormat format, size_t max_length, std::string* record) {
+    if (format == RecordFormat::kLines) {
+        if (!std::getline(in, *record)) return false;
+        if (!record->empty() && record->back() == '\r') record->pop_back();
+        return true;
+    }
+    unsigned char header[4];
+    if (!in.read(reinterpret_cast<char*>(header), 4)) {
+        if (in.gcount() == 0) return false;
+        throw std::runtime_error("Truncated record length prefix");
+    }
+    uint32_t length = (uint32_t{header[0]} << 24) | (uint32_t{header[1]} << 16) |
+                      (uint32_t{header[2]} << 8) | header[3];
+    if (length > max_length) {
+        throw std::runtime_error("Record length " + std::to_string(length) +
+                                 " exceeds the modulus size of " + std::to_string(max_length) +
+                                 " bytes");
+    }
+    record->resize(length);
+    if (!in.read(record->data(), length)) {
+        throw std::runtime_error("Truncated record payload");
+    }
+    return true;
+}
+
+void WriteRecord(std::ostream& out, RecordFormat format, const std::string& record) {
+    if (format == RecordFormat::kLines) {
+        out << record << '\n';
+        return;
+    }
+    uint32_t length = static_cast<uint32_t>(record.size());
+    char header[4] = {static_cast<char>(length >> 24), static_cast<char>(length >> 16),
+                      static_cast<char>(length >> 8), static_cast<char>(length)};
+    out.write(header, 4);
+    out.write(record.data(), static_cast<std::streamsize>(record.size()));
+}
+
+std::string EncodeCiphertext(const std::string& bytes, TextEncoding encoding) {
+    if (encoding == TextEncoding::kHex) return rsa_app::HexEncode(bytes);
+    return rsa_app::Base64Encode(bytes);
+}
+
+std::string DecodeCiphertext(const std::string& text, TextEncoding encoding) {
+    if (encoding == TextEncoding::kHex) return rsa_app::HexDecode(text);
+    return rsa_app::Base64Decode(text);
+}
+
+/**
+ * Generates a key pair and writes it (and optionally its public half) to disk.
+ */
+int RunKeygen(const Options& options) {
+    int bits = options.bits ? options.bits : kDefaultKeygenBits;
+    auto start = std::chrono::steady_clock::now();
+    rsa_app::KeyPair key_pair = rsa_app::GenerateKeyPair(bits);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    rsa_app::SaveKeyPair(key_pair, options.key_path);
+    if (!options.public_path.empty()) {
+        rsa_app::SavePublicKey(key_pair.public_key, options.public_path);
+    }
+    std::cerr << "keygen: " << bits << "-bit key written to " << options.key_path
+              << " in " << std::fixed << std::setprecision(3) << elapsed.count() << " s\n";
+    return 0;
+}
+
+/**
+ * Calibrates the requested key sizes and merges them into the profile.
+ *
+ * Plans for other sizes are kept if the profile was measured on this host.
+ */
+int RunTune(const Options& options) {
+    rsa_app::TuningOptions tuning;
+    if (options.bits) tuning.bits = {options.bits};
+    if (options.threads) tuning.max_threads = options.threads;
+    tuning.allow_variable_time = options.variable_time;
+
+    rsa_app::TuningProfile profile;
+    try {
+        profile = rsa_app::LoadTuningProfile(options.profile_path);
+    } catch (const std::exception&) {
+        // Start a new profile.
+    }
+    if (profile.host != rsa_app::HostSignature()) profile.plans.clear();
+    rsa_app::TuningProfile measured = rsa_app::Calibrate(tuning);
+    for (const rsa_app::TuningPlan& plan : measured.plans) {
+        std::cout << rsa_app::DescribeTuningPlan(plan) << "\n";
+        profile.plans.erase(std::remove_if(profile.plans.begin(), profile.plans.end(),
+                                           [&](const rsa_app::TuningPlan& old) {
+                                               return old.bits == plan.bits;
+                                           }),
+                            profile.plans.end());
+        profile.plans.push_back(plan);
+    }
+    std::sort(profile.plans.begin(), profile.plans.end(),
+              [](const rsa_app::TuningPlan& a, const rsa_app::TuningPlan& b) {
+                  return a.bits < b.bits;
+              });
+    profile.host = measured.host;
+    rsa_app::SaveTuningProfile(profile, options.profile_path);
+    std::cerr << "tune: profile for " << profile.host << " written to " << options.profile_path
+              << "\n";
+    return 0;
+}
+
+/**
+ * Streams records from stdin through encryption or decryption to stdout.
+ *
+ * Records are processed in batches; each batch is spread across the worker
+ * pool and written back in input order. A throughput summary goes to stderr.
+ */
+int RunBatch(const Options& options, bool encrypt) {
+    rsa_app::KeyPair key_pair{};
+    rsa_app::PublicKey public_key{};
+    if (encrypt) {
+        public_key = rsa_app::LoadPublicKey(options.key_path);
+    } else if (options.validate_key) {
+        key_pair = rsa_app::LoadValidatedKeyPair(options.key_path, options.check_level);
+    } else {
+        key_pair = rsa_app::LoadKeyPair(options.key_path);
+    }
+    const BigNumber& modulus = encrypt ? public_key.n : key_pair.private_key.n;
+    size_t modulus_bytes = static_cast<size_t>(BN_num_bytes(modulus.Get()));
+
+    size_t threads = options.threads;
+    size_t batch_size = options.batch_size;
+    if (!options.profile_path.empty()) {
+        bool calibrated = false;
+        rsa_app::TuningPlan plan = rsa_app::LoadOrCalibrate(
+            options.profile_path, modulus.NumBits(), rsa_app::TuningOptions(), &calibrated);
+        rsa_app::ApplyTuningPlan(plan);
+        if (threads == 0) threads = plan.threads;
+        if (batch_size == 0) batch_size = plan.batch_size;
+        std::cerr << "plan: " << rsa_app::DescribeTuningPlan(plan)
+                  << (calibrated ? " (calibrated now)" : "") << "\n";
+    }
+    if (batch_size == 0) batch_size = kDefaultBatchSize;
+
+    rsa_app::ThreadPool pool(threads);
+    std::ios::sync_with_stdio(false);
+    std::cin.tie(nullptr);
+
+    auto start = std::chrono::steady_clock::now();
+    size_t records = 0;
+    size_t bytes_in = 0;
+    size_t bytes_out = 0;
+
+    std::vector<std::string> batch;
+    std::vector<BigNumber> inputs;
+    std::string record;
+    bool more = true;
+    while (more) {
+        batch.clear();
+        while (batch.size() < batch_size &&
+               (more = ReadRecord(std::cin, options.format, modulus_bytes, &record))) {
+            bytes_in += record.size();
+            batch.push_back(std::move(record));
+        }
+        if (batch.empty()) break;
+
+        inputs.clear();
+        inputs.reserve(batch.size());
+        for (size_t i = 0; i < batch.size(); ++i) {
+            try {
+                if (encrypt) {
+                    inputs.push_back(rsa_app::StringToNumber(batch[i]));
+                } else if (options.format == RecordFormat::kLines) {
+                    inputs.push_back(
+                        BigNumber::FromBytes(DecodeCiphertext(batch[i], options.encoding)));
+                } else {
+                    inputs.push_back(BigNumber::FromBytes(batch[i]));
+                }
+            } catch (const std::exception& e) {
+                throw std::runtime_error("Record " + std::to_string(records + i + 1) + ": " +
+                                         e.what());
+            }
+        }
+
+        std::vector<BigNumber> outputs =
+            encrypt ? rsa_app::EncryptBatch(inputs, public_key, pool)
+                    : rsa_app::DecryptBatch(inputs, key_pair.private_key, pool);
+
+        for (const BigNumber& output : outputs) {
+            std::string bytes;
+            if (encrypt) {
+                bytes = output.ToBytes(modulus_bytes);
+                if (options.format == RecordFormat::kLines) {
+                    bytes = EncodeCiphertext(bytes, options.encoding);
+                }
+            } else {
+                bytes = rsa_app::NumberToString(output);
+            }
+            bytes_out += bytes.size();
+            WriteRecord(std::cout, options.format, bytes);
+        }
+        records += batch.size();
+    }
+    std::cout.flush();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double seconds = elapsed.count() > 0 ? elapsed.count() : 1e-9;
+    std::cerr << (encrypt ? "encrypt" : "decrypt") << ": " << records << " records, "
+              << bytes_in << " bytes in, " << bytes_out << " bytes out, " << std::fixed
+              << std::setprecision(3) << seconds << " s, " << std::setprecision(1)
+              << records / seconds << " records/s, " << std::setprecision(3)
+              << bytes_in / seconds / 1e6 << " MB/s in, " << pool.Size() << " threads\n";
+    return 0;
+}
+
+/**
+ * Interactive demonstration of RSA encryption and decryption.
  *
  * This program:
  * 1. Generates an RSA key pair (public and private keys).
@@ -14,42 +391,97 @@
  * 6. Converts the decrypted message back to its original format.
  * 7. Verifies that the decrypted message matches the original message.
  */
-int main() {
-    try {
-        // Step 1: Generate RSA keys
-        std::cout << "Generating RSA keys...\n";
-        rsa_app::KeyPair key_pair = rsa_app::GenerateKeyPair(4096);
+int RunInteractiveDemo() {
+    // Step 1: Generate RSA keys
+    std::cout << "Generating RSA keys...\n";
+    rsa_app::KeyPair key_pair = rsa_app::GenerateKeyPair(4096);
 
-        std::cout << "\nGenerated RSA Keys:\n";
-        rsa_app::PrintRsaKeys(key_pair);
+    std::cout << "\nGenerated RSA Keys:\n";
+    rsa_app::PrintRsaKeys(key_pair);
 
-        // Step 2: Accept user input for the message to encrypt
-        std::string message;
-        std::cout << "\nEnter a message to encrypt: ";
-        std::getline(std::cin, message);
+    // Step 2: Accept user input for the message to encrypt
+    std::string message;
+    std::cout << "\nEnter a message to encrypt: ";
+    std::getline(std::cin, message);
 
-        // Step 3: Convert the input message to a BigNumber representation
-        BigNumber number_message = rsa_app::StringToNumber(message);
-        std::cout << "Message as BigNumber: " << number_message.ToString() << "\n";
+    // Step 3: Convert the input message to a BigNumber representation
+    BigNumber number_message = rsa_app::StringToNumber(message);
+    std::cout << "Message as BigNumber: " << number_message.ToString() << "\n";
 
-        // Step 4: Encrypt the BigNumber message using the public key
-        BigNumber encrypted_message = rsa_app::Encrypt(number_message, key_pair.public_key);
-        std::cout << "Encrypted Message: " << encrypted_message.ToString() << "\n";
+    // Step 4: Encrypt the BigNumber message using the public key
+    BigNumber encrypted_message = rsa_app::Encrypt(number_message, key_pair.public_key);
+    std::cout << "Encrypted Message: " << encrypted_message.ToString() << "\n";
 
-        // Step 5: Decrypt the encrypted BigNumber message using the private key
-        BigNumber decrypted_message = rsa_app::Decrypt(encrypted_message, key_pair.private_key);
-        std::cout << "Decrypted BigNumber: " << decrypted_message.ToString() << "\n";
+    // Step 5: Decrypt the encrypted BigNumber message using the private key
+    BigNumber decrypted_message = rsa_app::Decrypt(encrypted_message, key_pair.private_key);
+    std::cout << "Decrypted BigNumber: " << decrypted_message.ToString() << "\n";
 
-        // Step 6: Convert the decrypted BigNumber back to the original string
-        std::string decrypted_text = rsa_app::NumberToString(decrypted_message);
-        std::cout << "Decrypted Message (original): " << decrypted_text << "\n";
+    // Step 6: Convert the decrypted BigNumber back to the original string
+    std::string decrypted_text = rsa_app::NumberToString(decrypted_message);
+    std::cout << "Decrypted Message (original): " << decrypted_text << "\n";
 
-        // Step 7: Verify that the encrypted and decrypted process was successful
-        if (decrypted_text == message) {
-            std::cout << "\nEncryption and decryption succeeded!\n";
-        } else {
-            std::cout << "\nEncryption and decryption failed. Something went wrong!\n";
+    // Step 7: Verify that the encrypted and decrypted process was successful
+    if (decrypted_text == message) {
+        std::cout << "\nEncryption and decryption succeeded!\n";
+    } else {
+        std::cout << "\nEncryption and decryption failed. Something went wrong!\n";
+    }
+    return 0;
+}
+
+/**
+ * Stops tracing, writes the spans to `path` and reports how many there were.
+ */
+void FinishTrace(const std::string& path) {
+    rsa_app::StopTracing();
+    rsa_app::WriteTrace(path);
+    rsa_app::TraceSummary summary = rsa_app::SummarizeTrace();
+    std::cerr << "trace: " << summary.spans << " spans from " << summary.threads
+              << " threads written to " << path;
+    if (summary.dropped) std::cerr << " (" << summary.dropped << " older spans overwritten)";
+    std::cerr << "\n";
+}
+
+}  // namespace
+
+/**
+ * Entry point.
+ *
+ * Without arguments the interactive demo runs. The `keygen`, `encrypt`,
+ * `decrypt` and `tune` subcommands provide a non-interactive interface for
+ * pipelines; see `PrintUsage` for the flags.
+ */
+int main(int argc, char** argv) {
+    try {
+        if (argc < 2) return RunInteractiveDemo();
+
+        std::string command = argv[1];
+        if (command == "--help" || command == "-h" || command == "help") {
+            PrintUsage(std::cout);
+            return 0;
         }
+        if (command != "keygen" && command != "encrypt" && command != "decrypt" &&
+            command != "tune") {
+            std::cerr << "Unknown command '" << command << "'\n";
+            PrintUsage(std::cerr);
+            return 2;
+        }
+
+        Options options;
+        try {
+            options = ParseOptions(argc, argv);
+        } catch (const std::invalid_argument& e) {
+            std::cerr << e.what() << "\n";
+            PrintUsage(std::cerr);
+            return 2;
+        }
+
+        if (!options.trace_path.empty()) rsa_app::StartTracing();
+        int status = command == "keygen" ? RunKeygen(options)
+                     : command == "tune" ? RunTune(options)
+                                         : RunBatch(options, command == "encrypt");
+        if (!options.trace_path.empty()) FinishTrace(options.trace_path);
+        return status;
     } catch (const std::exception& e) {
         // Handle any errors that occurred during the RSA operations
         std::cerr << "An error occurred: " << e.what() << "\n";
@@ -58,5 +490,5 @@ int main() {
         std::cerr << "An unknown error occurred.\n";
     }
 
-    return 0;
-}
\ No newline at end of file
+    return 1;
+}
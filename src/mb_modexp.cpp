@@ -0,0 +1,540 @@
+#include "mb_modexp.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define RSA_APP_MB_X86 1
+#include <immintrin.h>
+#endif
+
+namespace rsa_app {
+
+namespace {
+
+// Limbs are 52 bits so that IFMA can multiply them directly; the spare 12
+// bits of every 64-bit word absorb carries between normalizations.
+constexpr int kDigitBits = 52;
+constexpr uint64_t kDigitMask = (uint64_t{1} << kDigitBits) - 1;
+constexpr int kWindowBits = 5;
+constexpr uint64_t kTableSize = uint64_t{1} << kWindowBits;
+
+// Returns all ones if a == b and zero otherwise, without branching.
+// Both values must be below 2^63.
+inline uint64_t ConstantTimeEqualMask(uint64_t a, uint64_t b) {
+  return 0 - (((a ^ b) - 1) >> 63);
+}
+
+// Working set of one vector-wide group of lanes (see mb_modexp_kernel.inc).
+struct MbGroup {
+  int limbs = 0;                // 52-bit limbs per number.
+  int windows = 0;              // Exponent windows, most significant first.
+  const uint64_t* n = nullptr;  // Moduli.
+  const uint64_t* k0 = nullptr;  // -n^-1 mod 2^52, one word per lane.
+  const uint64_t* one = nullptr;   // R mod n.
+  const uint64_t* base = nullptr;  // base * R mod n.
+  const uint64_t* digits = nullptr;  // One word per window and lane.
+  uint64_t* table = nullptr;   // kTableSize powers of the base.
+  uint64_t* t = nullptr;       // MontMul accumulator.
+  uint64_t* select = nullptr;  // Selected table entry.
+  uint64_t* result = nullptr;  // Final result.
+};
+
+// ---------------------------------------------------------------------------
+// Vector primitives.
+//
+// MulAdd(lo, hi, a, b) adds the low and high 52-bit halves of the 104-bit
+// product a * b to lo and hi; MulLo returns the low half alone. Inputs to
+// both must be below 2^52.
+// ---------------------------------------------------------------------------
+
+struct ScalarOps {
+  using V = uint64_t;
+  static constexpr size_t kWidth = 1;
+
+  static V Load(const uint64_t* p) { return *p; }
+  static void Store(uint64_t* p, V v) { *p = v; }
+  static V Zero() { return 0; }
+  static V Set1(uint64_t v) { return v; }
+  static V Add(V a, V b) { return a + b; }
+  static V Sub(V a, V b) { return a - b; }
+  static V And(V a, V b) { return a & b; }
+  static V AndNot(V a, V b) { return ~a & b; }
+  static V Or(V a, V b) { return a | b; }
+  template <int kShift>
+  static V ShiftRight(V v) { return v >> kShift; }
+
+  static void MulAdd(V& lo, V& hi, V a, V b) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    lo += static_cast<uint64_t>(product) & kDigitMask;
+    hi += static_cast<uint64_t>(product >> kDigitBits);
+#else
+    // Split into 26-bit halves so every partial product fits in 64 bits.
+    const uint64_t mask26 = (uint64_t{1} << 26) - 1;
+    uint64_t a0 = a & mask26, a1 = a >> 26, b0 = b & mask26, b1 = b >> 26;
+    uint64_t middle = a0 * b1 + a1 * b0;
+    uint64_t low = a0 * b0 + ((middle & mask26) << 26);
+    lo += low & kDigitMask;
+    hi += a1 * b1 + (middle >> 26) + (low >> kDigitBits);
+#endif
+  }
+  static V MulLo(V a, V b) { return (a * b) & kDigitMask; }
+};
+
+#ifdef RSA_APP_MB_X86
+
+#define RSA_APP_MB_AVX2 __attribute__((target("avx2")))
+
+struct Avx2Ops {
+  using V = __m256i;
+  static constexpr size_t kWidth = 4;
+
+  RSA_APP_MB_AVX2 static V Load(const uint64_t* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  }
+  RSA_APP_MB_AVX2 static void Store(uint64_t* p, V v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+  }
+  RSA_APP_MB_AVX2 static V Zero() { return _mm256_setzero_si256(); }
+  RSA_APP_MB_AVX2 static V Set1(uint64_t v) {
+    return _mm256_set1_epi64x(static_cast<long long>(v));
+  }
+  RSA_APP_MB_AVX2 static V Add(V a, V b) { return _mm256_add_epi64(a, b); }
+  RSA_APP_MB_AVX2 static V Sub(V a, V b) { return _mm256_sub_epi64(a, b); }
+  RSA_APP_MB_AVX2 static V And(V a, V b) { return _mm256_and_si256(a, b); }
+  RSA_APP_MB_AVX2 static V AndNot(V a, V b) {
+    return _mm256_andnot_si256(a, b);
+  }
+  RSA_APP_MB_AVX2 static V Or(V a, V b) { return _mm256_or_si256(a, b); }
+  template <int kShift>
+  RSA_APP_MB_AVX2 static V ShiftRight(V v) {
+    return _mm256_srli_epi64(v, kShift);
+  }
+
+  // AVX2 has no 52-bit multiplier: build the product from four 26x26-bit
+  // VPMULUDQ partial products.
+  RSA_APP_MB_AVX2 static void MulAdd(V& lo, V& hi, V a, V b) {
+    const V mask26 = _mm256_set1_epi64x((1 << 26) - 1);
+    V a0 = _mm256_and_si256(a, mask26), a1 = _mm256_srli_epi64(a, 26);
+    V b0 = _mm256_and_si256(b, mask26), b1 = _mm256_srli_epi64(b, 26);
+    V middle = _mm256_add_epi64(_mm256_mul_epu32(a0, b1),
+                                _mm256_mul_epu32(a1, b0));
+    V low = _mm256_add_epi64(
+        _mm256_mul_epu32(a0, b0),
+        _mm256_slli_epi64(_mm256_and_si256(middle, mask26), 26));
+    lo = _mm256_add_epi64(lo, _mm256_and_si256(low, Set1(kDigitMask)));
+    hi = _mm256_add_epi64(
+        hi, _mm256_add_epi64(
+                _mm256_add_epi64(_mm256_mul_epu32(a1, b1),
+                                 _mm256_srli_epi64(middle, 26)),
+                _mm256_srli_epi64(low, kDigitBits)));
+  }
+  RSA_APP_MB_AVX2 static V MulLo(V a, V b) {
+    const V mask26 = _mm256_set1_epi64x((1 << 26) - 1);
+    V a0 = _mm256_and_si256(a, mask26), a1 = _mm256_srli_epi64(a, 26);
+    V b0 = _mm256_and_si256(b, mask26), b1 = _mm256_srli_epi64(b, 26);
+    V middle = _mm256_add_epi64(_mm256_mul_epu32(a0, b1),
+                                _mm256_mul_epu32(a1, b0));
+    V low = _mm256_add_epi64(_mm256_mul_epu32(a0, b0),
+                             _mm256_slli_epi64(middle, 26));
+    return _mm256_and_si256(low, Set1(kDigitMask));
+  }
+};
+
+#define RSA_APP_MB_IFMA __attribute__((target("avx512f,avx512ifma")))
+
+struct Avx512IfmaOps {
+  using V = __m512i;
+  static constexpr size_t kWidth = 8;
+
+  RSA_APP_MB_IFMA static V Load(const uint64_t* p) {
+    return _mm512_loadu_si512(p);
+  }
+  RSA_APP_MB_IFMA static void Store(uint64_t* p, V v) {
+    _mm512_storeu_si512(p, v);
+  }
+  RSA_APP_MB_IFMA static V Zero() { return _mm512_setzero_si512(); }
+  RSA_APP_MB_IFMA static V Set1(uint64_t v) {
+    return _mm512_set1_epi64(static_cast<long long>(v));
+  }
+  RSA_APP_MB_IFMA static V Add(V a, V b) { return _mm512_add_epi64(a, b); }
+  RSA_APP_MB_IFMA static V Sub(V a, V b) { return _mm512_sub_epi64(a, b); }
+  RSA_APP_MB_IFMA static V And(V a, V b) { return _mm512_and_si512(a, b); }
+  RSA_APP_MB_IFMA static V AndNot(V a, V b) {
+    return _mm512_andnot_si512(a, b);
+  }
+  RSA_APP_MB_IFMA static V Or(V a, V b) { return _mm512_or_si512(a, b); }
+  template <int kShift>
+  RSA_APP_MB_IFMA static V ShiftRight(V v) {
+    return _mm512_srli_epi64(v, kShift);
+  }
+
+  RSA_APP_MB_IFMA static void MulAdd(V& lo, V& hi, V a, V b) {
+    lo = _mm512_madd52lo_epu64(lo, a, b);
+    hi = _mm512_madd52hi_epu64(hi, a, b);
+  }
+  RSA_APP_MB_IFMA static V MulLo(V a, V b) {
+    return _mm512_madd52lo_epu64(_mm512_setzero_si512(), a, b);
+  }
+};
+
+// Two interleaved IFMA vectors: 16 lanes with independent dependency
+// chains for the out-of-order core to overlap.
+struct Avx512IfmaX2Ops {
+  struct V {
+    __m512i low;
+    __m512i high;
+  };
+  static constexpr size_t kWidth = 16;
+  using Half = Avx512IfmaOps;
+
+  RSA_APP_MB_IFMA static V Load(const uint64_t* p) {
+    return {Half::Load(p), Half::Load(p + 8)};
+  }
+  RSA_APP_MB_IFMA static void Store(uint64_t* p, V v) {
+    Half::Store(p, v.low);
+    Half::Store(p + 8, v.high);
+  }
+  RSA_APP_MB_IFMA static V Zero() { return {Half::Zero(), Half::Zero()}; }
+  RSA_APP_MB_IFMA static V Set1(uint64_t v) {
+    return {Half::Set1(v), Half::Set1(v)};
+  }
+  RSA_APP_MB_IFMA static V Add(V a, V b) {
+    return {Half::Add(a.low, b.low), Half::Add(a.high, b.high)};
+  }
+  RSA_APP_MB_IFMA static V Sub(V a, V b) {
+    return {Half::Sub(a.low, b.low), Half::Sub(a.high, b.high)};
+  }
+  RSA_APP_MB_IFMA static V And(V a, V b) {
+    return {Half::And(a.low, b.low), Half::And(a.high, b.high)};
+  }
+  RSA_APP_MB_IFMA static V AndNot(V a, V b) {
+    return {Half::AndNot(a.low, b.low), Half::AndNot(a.high, b.high)};
+  }
+  RSA_APP_MB_IFMA static V Or(V a, V b) {
+    return {Half::Or(a.low, b.low), Half::Or(a.high, b.high)};
+  }
+  template <int kShift>
+  RSA_APP_MB_IFMA static V ShiftRight(V v) {
+    return {Half::ShiftRight<kShift>(v.low), Half::ShiftRight<kShift>(v.high)};
+  }
+  RSA_APP_MB_IFMA static void MulAdd(V& lo, V& hi, V a, V b) {
+    Half::MulAdd(lo.low, hi.low, a.low, b.low);
+    Half::MulAdd(lo.high, hi.high, a.high, b.high);
+  }
+  RSA_APP_MB_IFMA static V MulLo(V a, V b) {
+    return {Half::MulLo(a.low, b.low), Half::MulLo(a.high, b.high)};
+  }
+};
+
+#endif  // RSA_APP_MB_X86
+
+// ---------------------------------------------------------------------------
+// Kernel instantiations.
+// ---------------------------------------------------------------------------
+
+namespace scalar_kernel {
+using Ops = ScalarOps;
+#define RSA_APP_MB_TARGET
+#include "mb_modexp_kernel.inc"
+#undef RSA_APP_MB_TARGET
+}  // namespace scalar_kernel
+
+#ifdef RSA_APP_MB_X86
+
+namespace avx2_kernel {
+using Ops = Avx2Ops;
+#define RSA_APP_MB_TARGET RSA_APP_MB_AVX2
+#include "mb_modexp_kernel.inc"
+#undef RSA_APP_MB_TARGET
+}  // namespace avx2_kernel
+
+namespace ifma_kernel {
+using Ops = Avx512IfmaOps;
+#define RSA_APP_MB_TARGET RSA_APP_MB_IFMA
+#include "mb_modexp_kernel.inc"
+#undef RSA_APP_MB_TARGET
+}  // namespace ifma_kernel
+
+namespace ifma_x2_kernel {
+using Ops = Avx512IfmaX2Ops;
+#define RSA_APP_MB_TARGET RSA_APP_MB_IFMA
+#include "mb_modexp_kernel.inc"
+#undef RSA_APP_MB_TARGET
+}  // namespace ifma_x2_kernel
+
+#endif  // RSA_APP_MB_X86
+
+// Returns the group width to use for `remaining` queued operations: one
+// vector, or two interleaved IFMA vectors once they would both be filled.
+size_t GroupWidth(MbKernel kernel, size_t remaining) {
+  switch (kernel) {
+    case MbKernel::kScalar:
+      return ScalarOps::kWidth;
+#ifdef RSA_APP_MB_X86
+    case MbKernel::kAvx2:
+      return Avx2Ops::kWidth;
+    case MbKernel::kAvx512Ifma:
+      return remaining > Avx512IfmaOps::kWidth ? Avx512IfmaX2Ops::kWidth
+                                               : Avx512IfmaOps::kWidth;
+#else
+    default:
+      break;
+#endif
+  }
+  return 1;
+}
+
+void RunGroup(MbKernel kernel, size_t width, const MbGroup& group) {
+  switch (kernel) {
+#ifdef RSA_APP_MB_X86
+    case MbKernel::kAvx2:
+      avx2_kernel::ModExpGroup(group);
+      return;
+    case MbKernel::kAvx512Ifma:
+      if (width == Avx512IfmaX2Ops::kWidth) {
+        ifma_x2_kernel::ModExpGroup(group);
+      } else {
+        ifma_kernel::ModExpGroup(group);
+      }
+      return;
+#endif
+    default:
+      scalar_kernel::ModExpGroup(group);
+      return;
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Conversions between BIGNUM and 52-bit limbs.
+// ---------------------------------------------------------------------------
+
+struct CtxDeleter {
+  void operator()(BN_CTX* ctx) const { BN_CTX_free(ctx); }
+};
+
+void Check(int result) {
+  if (result == 0) throw std::runtime_error("OpenSSL error in multi-buffer setup");
+}
+
+size_t LimbBytes(int limbs) {
+  return (static_cast<size_t>(limbs) * kDigitBits + 7) / 8;
+}
+
+// Writes `value` (which must fit in `limbs` limbs) to out[i * stride].
+void ToLimbs(const BIGNUM* value, int limbs, uint64_t* out, size_t stride) {
+  size_t length = LimbBytes(limbs);
+  std::vector<unsigned char> bytes(length + 8, 0);
+  Check(BN_bn2lebinpad(value, bytes.data(), static_cast<int>(length)) >= 0);
+  for (int i = 0; i < limbs; ++i) {
+    size_t bit = static_cast<size_t>(i) * kDigitBits;
+    uint64_t word = 0;
+    for (int k = 7; k >= 0; --k) word = (word << 8) | bytes[bit / 8 + k];
+    out[i * stride] = (word >> (bit % 8)) & kDigitMask;
+  }
+}
+
+BigNumber FromLimbs(const uint64_t* in, int limbs, size_t stride) {
+  size_t length = LimbBytes(limbs);
+  std::vector<unsigned char> bytes(length + 8, 0);
+  for (int i = 0; i < limbs; ++i) {
+    size_t bit = static_cast<size_t>(i) * kDigitBits;
+    uint64_t word = in[i * stride] << (bit % 8);
+    for (int k = 0; k < 8; ++k) {
+      bytes[bit / 8 + k] |= static_cast<unsigned char>(word >> (8 * k));
+    }
+  }
+  BIGNUM* value = BN_lebin2bn(bytes.data(), static_cast<int>(length), nullptr);
+  if (!value) throw std::runtime_error("OpenSSL error in multi-buffer setup");
+  return BigNumber(value);
+}
+
+// Returns -n^-1 mod 2^52 for the odd lowest limb of n.
+uint64_t MontgomeryK0(uint64_t n0) {
+  uint64_t inverse = n0;  // Correct to 3 bits since n0 * n0 = 1 mod 8.
+  for (int i = 0; i < 5; ++i) inverse *= 2 - n0 * inverse;
+  return (0 - inverse) & kDigitMask;
+}
+
+// 64-byte aligned word storage for one group.
+class AlignedWords {
+ public:
+  explicit AlignedWords(size_t words) : storage_(words + 8) {
+    auto address = reinterpret_cast<uintptr_t>(storage_.data());
+    data_ = storage_.data() + ((64 - address % 64) % 64) / sizeof(uint64_t);
+  }
+  uint64_t* Data() { return data_; }
+
+ private:
+  std::vector<uint64_t> storage_;
+  uint64_t* data_;
+};
+
+// Rounds a word count up to whole cache lines.
+size_t CacheLineWords(size_t words) { return (words + 7) / 8 * 8; }
+
+// Computes up to one vector of lanes; `ops[l]` indexes the operation of
+// lane l, and repeated indices pad unused lanes.
+void ModExpLanes(MbKernel kernel, const std::vector<const BIGNUM*>& bases,
+                 const std::vector<const BIGNUM*>& exponents,
+                 const std::vector<const BIGNUM*>& moduli,
+                 const std::vector<size_t>& ops, int limbs, BN_CTX* ctx,
+                 std::vector<BigNumber>& results) {
+  const size_t width = ops.size();
+  const size_t number_words = CacheLineWords(limbs * width);
+  int max_bits = 1;
+  for (size_t op : ops) max_bits = std::max(max_bits, BN_num_bits(exponents[op]));
+  const int windows = (max_bits + kWindowBits - 1) / kWindowBits;
+
+  // n, one, base, select, result, t and the table, plus k0 and digits.
+  const size_t digit_words = CacheLineWords(windows * width);
+  AlignedWords words((6 + kTableSize) * number_words + CacheLineWords(width) +
+                     digit_words);
+  uint64_t* cursor = words.Data();
+  auto take = [&cursor](size_t count) {
+    uint64_t* block = cursor;
+    cursor += count;
+    return block;
+  };
+  uint64_t* n = take(number_words);
+  uint64_t* one = take(number_words);
+  uint64_t* base = take(number_words);
+  uint64_t* k0 = take(CacheLineWords(width));
+  uint64_t* digits = take(digit_words);
+
+  BigNumber scratch;
+  BigNumber reduced;
+  for (size_t lane = 0; lane < width; ++lane) {
+    const BIGNUM* modulus = moduli[ops[lane]];
+    ToLimbs(modulus, limbs, n + lane, width);
+    k0[lane] = MontgomeryK0(n[lane]);
+
+    // R mod n, with R = 2^(52 * limbs).
+    BN_zero(scratch.Get());
+    Check(BN_set_bit(scratch.Get(), limbs * kDigitBits));
+    Check(BN_nnmod(scratch.Get(), scratch.Get(), modulus, ctx));
+    ToLimbs(scratch.Get(), limbs, one + lane, width);
+
+    // base * R mod n.
+    Check(BN_nnmod(reduced.Get(), bases[ops[lane]], modulus, ctx));
+    Check(BN_lshift(scratch.Get(), reduced.Get(), limbs * kDigitBits));
+    Check(BN_nnmod(scratch.Get(), scratch.Get(), modulus, ctx));
+    ToLimbs(scratch.Get(), limbs, base + lane, width);
+
+    const BIGNUM* exponent = exponents[ops[lane]];
+    for (int window = 0; window < windows; ++window) {
+      int low_bit = (windows - 1 - window) * kWindowBits;
+      uint64_t digit = 0;
+      for (int bit = kWindowBits - 1; bit >= 0; --bit) {
+        digit = (digit << 1) |
+                static_cast<uint64_t>(BN_is_bit_set(exponent, low_bit + bit));
+      }
+      digits[window * width + lane] = digit;
+    }
+  }
+
+  MbGroup group;
+  group.limbs = limbs;
+  group.windows = windows;
+  group.n = n;
+  group.k0 = k0;
+  group.one = one;
+  group.base = base;
+  group.digits = digits;
+  group.select = take(number_words);
+  group.result = take(number_words);
+  group.t = take(number_words);
+  group.table = take(kTableSize * number_words);
+  RunGroup(kernel, width, group);
+
+  for (size_t lane = 0; lane < width; ++lane) {
+    // Padding lanes repeat an earlier operation; keep the first copy.
+    if (lane > 0 && ops[lane] == ops[lane - 1]) continue;
+    results[ops[lane]] = FromLimbs(group.result + lane, limbs, width);
+  }
+}
+
+}  // namespace
+
+bool MbKernelSupported(MbKernel kernel) {
+#ifdef RSA_APP_MB_X86
+  switch (kernel) {
+    case MbKernel::kScalar:
+      return true;
+    case MbKernel::kAvx2:
+      return __builtin_cpu_supports("avx2");
+    case MbKernel::kAvx512Ifma:
+      return __builtin_cpu_supports("avx512f") &&
+             __builtin_cpu_supports("avx512ifma");
+  }
+  return false;
+#else
+  return kernel == MbKernel::kScalar;
+#endif
+}
+
+MbKernel BestMbKernel() {
+  static const MbKernel best = [] {
+    if (MbKernelSupported(MbKernel::kAvx512Ifma)) return MbKernel::kAvx512Ifma;
+    if (MbKernelSupported(MbKernel::kAvx2)) return MbKernel::kAvx2;
+    return MbKernel::kScalar;
+  }();
+  return best;
+}
+
+const char* MbKernelName(MbKernel kernel) {
+  switch (kernel) {
+    case MbKernel::kScalar:
+      return "scalar";
+    case MbKernel::kAvx2:
+      return "avx2";
+    case MbKernel::kAvx512Ifma:
+      return "avx512ifma";
+  }
+  return "unknown";
+}
+
+std::vector<BigNumber> MultiBufferModExp(
+    const std::vector<const BIGNUM*>& bases,
+    const std::vector<const BIGNUM*>& exponents,
+    const std::vector<const BIGNUM*>& moduli, MbKernel kernel) {
+  if (bases.size() != exponents.size() || bases.size() != moduli.size()) {
+    throw std::invalid_argument("Multi-buffer inputs differ in size");
+  }
+  int modulus_bits = 0;
+  for (size_t i = 0; i < moduli.size(); ++i) {
+    if (!BN_is_odd(moduli[i]) || BN_is_one(moduli[i]) ||
+        BN_is_negative(moduli[i])) {
+      throw std::invalid_argument("Multi-buffer modulus must be odd and > 1");
+    }
+    if (BN_is_negative(bases[i]) || BN_is_negative(exponents[i])) {
+      throw std::invalid_argument("Multi-buffer inputs must be non-negative");
+    }
+    modulus_bits = std::max(modulus_bits, BN_num_bits(moduli[i]));
+  }
+  if (!MbKernelSupported(kernel)) kernel = BestMbKernel();
+
+  std::vector<BigNumber> results(bases.size());
+  std::unique_ptr<BN_CTX, CtxDeleter> ctx(BN_CTX_new());
+  if (!ctx) throw std::runtime_error("Failed to allocate BN_CTX");
+
+  const int limbs = (modulus_bits + kDigitBits - 1) / kDigitBits;
+  for (size_t start = 0; start < bases.size();) {
+    const size_t width = GroupWidth(kernel, bases.size() - start);
+    // Lanes past the end repeat the last operation.
+    std::vector<size_t> ops(width);
+    for (size_t lane = 0; lane < width; ++lane) {
+      ops[lane] = std::min(start + lane, bases.size() - 1);
+    }
+    ModExpLanes(kernel, bases, exponents, moduli, ops, limbs, ctx.get(),
+                results);
+    start += width;
+  }
+  return results;
+}
+
+}  // namespace rsa_app
@@ -0,0 +1,73 @@
+#ifndef RSA_APP_MB_MODEXP_H_
+#define RSA_APP_MB_MODEXP_H_
+
+#include <cstddef>
+#include <vector>
+#include "bn_wrapper.h"
+
+namespace rsa_app {
+
+/**
+ * Identifies the SIMD kernel used by the multi-buffer exponentiation engine.
+ *
+ * All kernels work on 52-bit limbs stored structure-of-arrays (limb-major,
+ * one lane per independent exponentiation) and share the same Montgomery
+ * algorithm; they differ only in how a 52x52-bit product is formed.
+ */
+enum class MbKernel {
+  kScalar,      // One lane at a time with 64x64->128-bit multiplies.
+  kAvx2,        // 4 lanes per vector, products built from 32-bit multiplies.
+  kAvx512Ifma,  // 8 lanes per vector using VPMADD52LUQ/VPMADD52HUQ.
+};
+
+/**
+ * The largest number of exponentiations processed together in one group.
+ *
+ * AVX2 groups are 4 lanes wide; IFMA groups are 8 lanes, or 16 lanes in two
+ * interleaved vectors when at least 9 operations remain. Callers splitting
+ * work across threads should hand out multiples of this many operations.
+ */
+constexpr size_t kMbMaxLanes = 16;
+
+/**
+ * Returns true if the running CPU supports `kernel`.
+ */
+bool MbKernelSupported(MbKernel kernel);
+
+/**
+ * Returns the fastest kernel supported by the running CPU.
+ */
+MbKernel BestMbKernel();
+
+/**
+ * Returns a printable name for a kernel ("scalar", "avx2", "avx512ifma").
+ */
+const char* MbKernelName(MbKernel kernel);
+
+/**
+ * Computes `bases[i]^exponents[i] mod moduli[i]` for independent operations.
+ *
+ * Operations are packed into SIMD lanes in groups of up to `kMbMaxLanes`,
+ * in input order.
+ * Every lane runs the same fixed-window schedule, padded to the longest
+ * exponent of its group, and table lookups scan all entries, so timing does
+ * not depend on exponent bits.
+ *
+ * @param bases The bases; values >= the modulus are reduced first.
+ * @param exponents The non-negative exponents.
+ * @param moduli The odd moduli greater than one.
+ * @param kernel The kernel to use; unsupported kernels fall back to
+ *               `BestMbKernel()`.
+ * @return The results, in input order.
+ * @throws std::invalid_argument If the vectors differ in size, a modulus is
+ *         even or not greater than one, or a value is negative.
+ */
+std::vector<BigNumber> MultiBufferModExp(
+    const std::vector<const BIGNUM*>& bases,
+    const std::vector<const BIGNUM*>& exponents,
+    const std::vector<const BIGNUM*>& moduli,
+    MbKernel kernel = BestMbKernel());
+
+}  // namespace rsa_app
+
+#endif  // RSA_APP_MB_MODEXP_H_
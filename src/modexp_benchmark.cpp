@@ -0,0 +1,97 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <openssl/bn.h>
+#include "bn_wrapper.h"
+#include "fixed_modexp.h"
+#include "mb_modexp.h"
+
+// Runs `operation` (which performs `ops_per_call` exponentiations) for
+// roughly 300 ms and returns microseconds per exponentiation.
+template <typename Operation>
+double MeasureMicros(size_t ops_per_call, Operation operation) {
+    using Clock = std::chrono::steady_clock;
+    size_t calls = 0;
+    auto start = Clock::now();
+    std::chrono::duration<double> elapsed{};
+    do {
+        operation();
+        ++calls;
+        elapsed = Clock::now() - start;
+    } while (elapsed.count() < 0.3);
+    return elapsed.count() * 1e6 / static_cast<double>(calls * ops_per_call);
+}
+
+void PrintRow(const std::string& exponent, int bits, const std::string& path, double micros,
+              double baseline) {
+    std::cout << std::left << std::setw(10) << exponent << std::right << std::setw(6) << bits
+              << "  " << std::left << std::setw(20) << path << std::right << std::setw(12)
+              << std::fixed << std::setprecision(1) << micros << std::setw(10)
+              << std::setprecision(2) << baseline / micros << "x\n";
+}
+
+int main() {
+    std::cout << "Modular exponentiation (us per operation, speedup vs BN_mod_exp)\n";
+    std::cout << std::left << std::setw(10) << "exponent" << std::right << std::setw(6) << "bits"
+              << "  " << std::left << std::setw(20) << "path" << std::right << std::setw(12)
+              << "us/op" << std::setw(11) << "speedup\n";
+
+    BN_CTX* ctx = BN_CTX_new();
+    for (int bits : {2048, 3072, 4096}) {
+        BigNumber modulus, base, exponent, public_exponent, result;
+        BN_rand(modulus.Get(), bits, BN_RAND_TOP_ONE, BN_RAND_BOTTOM_ODD);
+        BN_rand_range(base.Get(), modulus.Get());
+        BN_rand(exponent.Get(), bits, BN_RAND_TOP_ONE, BN_RAND_BOTTOM_ANY);
+        public_exponent.SetWord(65537);
+
+        // Private-size exponent.
+        double bn = MeasureMicros(1, [&] {
+            BN_mod_exp(result.Get(), base.Get(), exponent.Get(), modulus.Get(), ctx);
+        });
+        PrintRow("private", bits, "bn_mod_exp", bn, bn);
+        double consttime = MeasureMicros(1, [&] {
+            BN_mod_exp_mont_consttime(result.Get(), base.Get(), exponent.Get(), modulus.Get(),
+                                      ctx, nullptr);
+        });
+        PrintRow("private", bits, "bn_consttime", consttime, bn);
+        for (auto kernel : {rsa_app::FixedKernel::kPortable, rsa_app::FixedKernel::kMulxAdx}) {
+            if (!rsa_app::FixedKernelSupported(kernel)) continue;
+            double micros = MeasureMicros(1, [&] {
+                rsa_app::FixedModExp(base.Get(), exponent.Get(), modulus.Get(), kernel);
+            });
+            PrintRow("private", bits, std::string("fixed/") + rsa_app::FixedKernelName(kernel),
+                     micros, bn);
+        }
+        for (auto kernel : {rsa_app::MbKernel::kScalar, rsa_app::MbKernel::kAvx2,
+                            rsa_app::MbKernel::kAvx512Ifma}) {
+            if (!rsa_app::MbKernelSupported(kernel)) continue;
+            std::vector<const BIGNUM*> bases(rsa_app::kMbMaxLanes, base.Get());
+            std::vector<const BIGNUM*> exponents(rsa_app::kMbMaxLanes, exponent.Get());
+            std::vector<const BIGNUM*> moduli(rsa_app::kMbMaxLanes, modulus.Get());
+            double micros = MeasureMicros(rsa_app::kMbMaxLanes, [&] {
+                rsa_app::MultiBufferModExp(bases, exponents, moduli, kernel);
+            });
+            PrintRow("private", bits, std::string("mb16/") + rsa_app::MbKernelName(kernel),
+                     micros, bn);
+        }
+
+        // Public exponent 65537.
+        bn = MeasureMicros(1, [&] {
+            BN_mod_exp(result.Get(), base.Get(), public_exponent.Get(), modulus.Get(), ctx);
+        });
+        PrintRow("65537", bits, "bn_mod_exp", bn, bn);
+        for (auto kernel : {rsa_app::FixedKernel::kPortable, rsa_app::FixedKernel::kMulxAdx}) {
+            if (!rsa_app::FixedKernelSupported(kernel)) continue;
+            double micros = MeasureMicros(1, [&] {
+                rsa_app::FixedModExpPublic(base.Get(), public_exponent.Get(), modulus.Get(),
+                                           kernel);
+            });
+            PrintRow("65537", bits, std::string("fixed/") + rsa_app::FixedKernelName(kernel),
+                     micros, bn);
+        }
+    }
+    BN_CTX_free(ctx);
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "bn_wrapper.h"
+#include "thread_pool.h"
+
+// Compares N individual `ModInverse` calls with `BatchModInverse` (one
+// inversion plus 3(N-1) multiplications), serial and on a thread pool, for
+// odd moduli (Montgomery multiplication) and even ones (BN_mod_mul).
+
+using Clock = std::chrono::steady_clock;
+
+template <typename Fn>
+double Seconds(Fn fn) {
+    auto start = Clock::now();
+    fn();
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    return elapsed.count();
+}
+
+std::vector<const BIGNUM*> Pointers(const std::vector<BigNumber>& values) {
+    std::vector<const BIGNUM*> pointers;
+    for (const auto& value : values) pointers.push_back(value.Get());
+    return pointers;
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> sizes = {1024, 2048, 4096};
+    std::vector<size_t> counts = {16, 256, 4096};
+    size_t threads = rsa_app::ThreadPool::DefaultThreadCount();
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--bits") {
+            sizes = {std::stoi(argv[i + 1])};
+        } else if (flag == "--count") {
+            counts = {std::stoul(argv[i + 1])};
+        } else if (flag == "--threads") {
+            threads = std::stoul(argv[i + 1]);
+        } else {
+            std::cerr << "Unknown option " << flag
+                      << " (supported: --bits N, --count N, --threads N)\n";
+            return 2;
+        }
+    }
+
+    rsa_app::ThreadPool pool(threads);
+    std::cout << threads << " threads; microseconds per inverse\n\n"
+              << std::setw(6) << "bits" << std::setw(8) << "mod" << std::setw(8) << "N"
+              << std::setw(12) << "single" << std::setw(12) << "batch" << std::setw(12)
+              << "parallel" << std::setw(10) << "speedup" << std::setw(10) << "par/ser\n";
+    for (int bits : sizes) {
+        BigNumber odd;
+        odd.GenerateRandom(bits);
+        BN_set_bit(odd.Get(), 0);
+        BigNumber even = odd.Sub(BN_value_one());
+        for (const BigNumber* m : {&odd, &even}) {
+            for (size_t count : counts) {
+                std::vector<BigNumber> values;
+                while (values.size() < count) {
+                    BigNumber value;
+                    value.GenerateRandom(bits - 1);
+                    if (BN_is_one(value.Gcd(m->Get()).Get())) values.push_back(std::move(value));
+                }
+                std::vector<const BIGNUM*> pointers = Pointers(values);
+
+                std::vector<BigNumber> single;
+                double single_s = Seconds([&] {
+                    for (const auto& value : values) single.push_back(value.ModInverse(m->Get()));
+                });
+                std::vector<BigNumber> batch, parallel;
+                double batch_s =
+                    Seconds([&] { batch = BigNumber::BatchModInverse(pointers, m->Get()); });
+                double parallel_s = Seconds(
+                    [&] { parallel = BigNumber::BatchModInverse(pointers, m->Get(), pool); });
+                for (size_t i = 0; i < count; ++i) {
+                    if (BN_cmp(single[i].Get(), batch[i].Get()) != 0 ||
+                        BN_cmp(single[i].Get(), parallel[i].Get()) != 0) {
+                        throw std::runtime_error("Batch inverse mismatch");
+                    }
+                }
+                double scale = 1e6 / static_cast<double>(count);
+                std::cout << std::setw(6) << bits << std::setw(8) << (m == &odd ? "odd" : "even")
+                          << std::setw(8) << count << std::fixed << std::setprecision(2)
+                          << std::setw(12) << single_s * scale << std::setw(12) << batch_s * scale
+                          << std::setw(12) << parallel_s * scale << std::setw(9)
+                          << single_s / batch_s << "x" << std::setw(9) << batch_s / parallel_s
+                          << "x\n";
+            }
+        }
+    }
+    return 0;
+}
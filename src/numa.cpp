@@ -0,0 +1,261 @@
+#include "numa.h"
+
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace rsa_app {
+
+namespace {
+
+// CPU ids the process may run on.
+std::vector<int> AllowedCpus() {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+    }
+    if (!cpus.empty()) return cpus;
+  }
+#endif
+  std::vector<int> cpus(ThreadPool::DefaultThreadCount());
+  for (size_t i = 0; i < cpus.size(); ++i) cpus[i] = static_cast<int>(i);
+  return cpus;
+}
+
+int ParseCpu(const std::string& text, const std::string& list) {
+  if (text.empty() || text.size() > 9 || text.find_first_not_of("0123456789") != std::string::npos) {
+    throw std::invalid_argument("Malformed CPU list '" + list + "'");
+  }
+  return std::stoi(text);
+}
+
+std::string FormatCpuList(const std::vector<int>& cpus) {
+  std::ostringstream out;
+  for (size_t i = 0; i < cpus.size();) {
+    size_t end = i + 1;
+    while (end < cpus.size() && cpus[end] == cpus[end - 1] + 1) ++end;
+    if (i > 0) out << ",";
+    out << cpus[i];
+    if (end - i > 1) out << "-" << cpus[end - 1];
+    i = end;
+  }
+  return out.str();
+}
+
+bool ReadFile(const std::string& path, std::string& contents) {
+  std::ifstream file(path);
+  if (!file) return false;
+  contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  return true;
+}
+
+// Waits for every node, then rethrows the first failure, so no task is
+// left referring to the caller's data.
+void WaitAll(NumaPool& pool) {
+  std::exception_ptr error;
+  for (size_t node = 0; node < pool.Nodes(); ++node) {
+    try {
+      pool.Node(node).Wait();
+    } catch (...) {
+      if (!error) error = std::current_exception();
+    }
+  }
+  if (error) std::rethrow_exception(error);
+}
+
+}  // namespace
+
+std::vector<int> ParseCpuList(const std::string& list) {
+  std::string trimmed = list;
+  trimmed.erase(trimmed.find_last_not_of(" \t\r\n") + 1);
+  std::vector<int> cpus;
+  if (trimmed.empty()) return cpus;
+  std::istringstream in(trimmed);
+  std::string range;
+  while (std::getline(in, range, ',')) {
+    size_t dash = range.find('-');
+    int first = ParseCpu(range.substr(0, dash), list);
+    int last = dash == std::string::npos ? first : ParseCpu(range.substr(dash + 1), list);
+    if (last < first) throw std::invalid_argument("Malformed CPU list '" + list + "'");
+    for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+  }
+  if (trimmed.back() == ',') throw std::invalid_argument("Malformed CPU list '" + list + "'");
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return cpus;
+}
+
+NumaTopology DetectNumaTopology(const std::string& sysfs_root) {
+  std::vector<int> allowed = AllowedCpus();
+  std::set<int> allowed_set(allowed.begin(), allowed.end());
+  NumaTopology topology;
+  std::string contents;
+  try {
+    if (ReadFile(sysfs_root + "/online", contents)) {
+      for (int node : ParseCpuList(contents)) {
+        if (!ReadFile(sysfs_root + "/node" + std::to_string(node) + "/cpulist", contents)) continue;
+        std::vector<int> cpus;
+        for (int cpu : ParseCpuList(contents)) {
+          if (allowed_set.count(cpu)) cpus.push_back(cpu);
+        }
+        if (!cpus.empty()) topology.node_cpus.push_back(std::move(cpus));
+      }
+    }
+  } catch (const std::invalid_argument&) {
+    topology.node_cpus.clear();
+  }
+  if (topology.node_cpus.empty()) topology.node_cpus.push_back(allowed);
+  return topology;
+}
+
+NumaTopology SimulateNumaTopology(size_t nodes) {
+  if (nodes == 0) throw std::invalid_argument("A topology needs at least one node");
+  std::vector<int> allowed = AllowedCpus();
+  NumaTopology topology;
+  topology.simulated = true;
+  topology.node_cpus.resize(nodes);
+  for (size_t node = 0; node < nodes; ++node) {
+    if (allowed.size() < nodes) {
+      topology.node_cpus[node].push_back(allowed[node % allowed.size()]);
+    } else {
+      topology.node_cpus[node].assign(allowed.begin() + node * allowed.size() / nodes,
+                                      allowed.begin() + (node + 1) * allowed.size() / nodes);
+    }
+  }
+  return topology;
+}
+
+std::string DescribeNumaTopology(const NumaTopology& topology) {
+  std::ostringstream out;
+  out << topology.Nodes() << (topology.Nodes() == 1 ? " node" : " nodes")
+      << (topology.simulated ? " (simulated)" : "") << ":";
+  for (size_t node = 0; node < topology.Nodes(); ++node) {
+    out << (node == 0 ? " " : " | ") << FormatCpuList(topology.node_cpus[node]);
+  }
+  return out.str();
+}
+
+NumaPool::NumaPool(const NumaTopology& topology, size_t threads_per_node)
+    : topology_(topology) {
+  if (topology_.Nodes() == 0) throw std::invalid_argument("NUMA topology has no nodes");
+  for (const std::vector<int>& cpus : topology_.node_cpus) {
+    size_t threads = threads_per_node != 0 ? threads_per_node : cpus.size();
+    if (topology_.Nodes() == 1) {
+      pools_.push_back(std::make_unique<ThreadPool>(threads));
+    } else {
+      pools_.push_back(std::make_unique<ThreadPool>(threads, cpus));
+    }
+  }
+}
+
+size_t NumaPool::Size() const {
+  size_t size = 0;
+  for (const auto& pool : pools_) size += pool->Size();
+  return size;
+}
+
+NumaKeyReplicas::NumaKeyReplicas(const KeyTable& source, NumaPool& pool,
+                                 const std::vector<size_t>& hot, size_t home_node)
+    : source_(source), home_node_(home_node), rows_(source.Size(), kNotReplicated) {
+  if (home_node >= pool.Nodes()) throw std::out_of_range("Home node out of range");
+  std::vector<size_t> indices = hot;
+  if (indices.empty()) {
+    indices.resize(source.Size());
+    for (size_t i = 0; i < indices.size(); ++i) indices[i] = i;
+  }
+  for (size_t index : indices) {
+    if (index >= source.Size()) throw std::out_of_range("Key index out of range");
+  }
+  if (pool.Nodes() == 1) return;
+
+  for (size_t row = 0; row < indices.size(); ++row) rows_[indices[row]] = row;
+  replicas_.resize(pool.Nodes());
+  for (size_t node = 0; node < pool.Nodes(); ++node) {
+    pool.Node(node).Submit([this, node, &indices] {
+      auto replica = std::make_unique<KeyTable>(source_.Bits(), indices.size());
+      for (size_t index : indices) replica->Add(source_.Handle(index));
+      replicas_[node] = std::move(replica);
+    });
+  }
+  WaitAll(pool);
+}
+
+KeyHandle NumaKeyReplicas::Handle(size_t node, size_t index) const {
+  if (index >= rows_.size()) throw std::out_of_range("Key index out of range");
+  if (rows_[index] == kNotReplicated) return source_.Handle(index);
+  return replicas_.at(node)->Handle(rows_[index]);
+}
+
+bool NumaKeyReplicas::Replicated(size_t index) const {
+  return index < rows_.size() && rows_[index] != kNotReplicated;
+}
+
+const KeyTable* NumaKeyReplicas::Replica(size_t node) const {
+  return replicas_.empty() ? nullptr : replicas_.at(node).get();
+}
+
+std::vector<BigNumber> DecryptBatch(const std::vector<BigNumber>& ciphertexts,
+                                    const std::vector<size_t>& key_indices,
+                                    const NumaKeyReplicas& keys, NumaPool& pool,
+                                    NumaBatchStats* stats) {
+  if (ciphertexts.size() != key_indices.size()) {
+    throw std::invalid_argument("Each ciphertext needs one key index");
+  }
+  std::vector<std::vector<size_t>> items(pool.Nodes());
+  std::vector<size_t> shared;
+  for (size_t i = 0; i < key_indices.size(); ++i) {
+    if (key_indices[i] >= keys.Source().Size()) throw std::out_of_range("Key index out of range");
+    if (keys.Replicated(key_indices[i])) {
+      shared.push_back(i);
+    } else {
+      items[keys.HomeNode()].push_back(i);
+    }
+  }
+  size_t workers = pool.Size();
+  size_t begin = 0;
+  size_t workers_before = 0;
+  for (size_t node = 0; node < pool.Nodes(); ++node) {
+    workers_before += pool.Node(node).Size();
+    size_t end = shared.size() * workers_before / workers;
+    items[node].insert(items[node].end(), shared.begin() + begin, shared.begin() + end);
+    begin = end;
+  }
+
+  std::vector<BigNumber> outputs(ciphertexts.size());
+  for (size_t node = 0; node < pool.Nodes(); ++node) {
+    const std::vector<size_t>& list = items[node];
+    ThreadPool& node_pool = pool.Node(node);
+    size_t chunks = std::min(list.size(), node_pool.Size() * 4);
+    if (chunks == 0) continue;
+    size_t chunk_size = (list.size() + chunks - 1) / chunks;
+    for (size_t first = 0; first < list.size(); first += chunk_size) {
+      size_t last = std::min(list.size(), first + chunk_size);
+      node_pool.Submit([&, node, first, last] {
+        for (size_t k = first; k < last; ++k) {
+          size_t i = list[k];
+          outputs[i] = Decrypt(ciphertexts[i], keys.Handle(node, key_indices[i]));
+        }
+      });
+    }
+  }
+  WaitAll(pool);
+  if (stats) {
+    stats->items_per_node.clear();
+    for (const auto& list : items) stats->items_per_node.push_back(list.size());
+  }
+  return outputs;
+}
+
+}  // namespace rsa_app
@@ -0,0 +1,197 @@
+#ifndef RSA_APP_NUMA_H_
+#define RSA_APP_NUMA_H_
+
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bn_wrapper.h"
+#include "key_table.h"
+#include "thread_pool.h"
+
+namespace rsa_app {
+
+/**
+ * The NUMA nodes of a host and the CPUs of each.
+ */
+struct NumaTopology {
+  std::vector<std::vector<int>> node_cpus;  // CPU ids per node; none is empty.
+  bool simulated = false;                   // Made by `SimulateNumaTopology`.
+
+  size_t Nodes() const { return node_cpus.size(); }
+};
+
+/**
+ * Parses a Linux CPU list such as "0-3,8,10-11" into ascending ids.
+ *
+ * @throws std::invalid_argument If the list is malformed.
+ */
+std::vector<int> ParseCpuList(const std::string& list);
+
+/**
+ * Reads the topology from `<sysfs_root>/node<N>/cpulist`.
+ *
+ * Only CPUs the process may run on are kept, and nodes left without any
+ * (memory-only nodes, or ones outside the affinity mask) are dropped. If
+ * no node can be read, as off Linux, the result is one node holding every
+ * allowed CPU, which turns the NUMA paths below into plain pools.
+ */
+NumaTopology DetectNumaTopology(const std::string& sysfs_root = "/sys/devices/system/node");
+
+/**
+ * Splits the CPUs the process may run on into `nodes` contiguous groups,
+ * so the NUMA paths can be exercised on a single-node machine. With fewer
+ * CPUs than nodes, the CPUs are shared round robin.
+ *
+ * @throws std::invalid_argument If `nodes` is 0.
+ */
+NumaTopology SimulateNumaTopology(size_t nodes);
+
+/**
+ * Returns a summary such as "2 nodes (simulated): 0-1 | 2-3".
+ */
+std::string DescribeNumaTopology(const NumaTopology& topology);
+
+/**
+ * One `ThreadPool` per NUMA node, its workers pinned to the node's CPUs.
+ *
+ * On a single node the pool is an ordinary unpinned `ThreadPool`.
+ */
+class NumaPool {
+ public:
+  /**
+   * Starts the per-node pools.
+   *
+   * @param topology The nodes to serve.
+   * @param threads_per_node Workers per node; 0 selects one per CPU of the
+   *                         node.
+   * @throws std::invalid_argument If the topology has no nodes.
+   */
+  explicit NumaPool(const NumaTopology& topology, size_t threads_per_node = 0);
+
+  NumaPool(const NumaPool&) = delete;
+  NumaPool& operator=(const NumaPool&) = delete;
+
+  /**
+   * Returns the number of nodes.
+   */
+  size_t Nodes() const { return pools_.size(); }
+
+  /**
+   * Returns the pool of `node`.
+   */
+  ThreadPool& Node(size_t node) { return *pools_.at(node); }
+
+  /**
+   * Returns the total number of workers.
+   */
+  size_t Size() const;
+
+  /**
+   * Returns the topology the pool was built for.
+   */
+  const NumaTopology& Topology() const { return topology_; }
+
+ private:
+  NumaTopology topology_;
+  std::vector<std::unique_ptr<ThreadPool>> pools_;
+};
+
+/**
+ * Node-local copies of the hot keys of a `KeyTable`.
+ *
+ * Each replica is allocated and filled by a worker of its node, so Linux's
+ * first-touch policy places its pages, including the locked private
+ * exponents, in that node's memory without libnuma. Keys that are not
+ * replicated stay in the source table, whose memory belongs to its home
+ * node. On a single node nothing is copied and every handle refers to the
+ * source table.
+ *
+ * The source table must outlive the replicas and must not grow while they
+ * are in use.
+ */
+class NumaKeyReplicas {
+ public:
+  /**
+   * Copies the keys at `hot` into one replica per node.
+   *
+   * @param source The table holding every key.
+   * @param pool The pool whose nodes receive replicas.
+   * @param hot Indices to replicate; empty replicates every key.
+   * @param home_node The node whose memory holds `source`.
+   * @throws std::out_of_range If an index or `home_node` is out of range.
+   */
+  NumaKeyReplicas(const KeyTable& source, NumaPool& pool, const std::vector<size_t>& hot = {},
+                  size_t home_node = 0);
+
+  NumaKeyReplicas(const NumaKeyReplicas&) = delete;
+  NumaKeyReplicas& operator=(const NumaKeyReplicas&) = delete;
+
+  /**
+   * Returns the handle a worker of `node` should use for key `index`: its
+   * replica if the key is replicated, else the source table's.
+   *
+   * @throws std::out_of_range If `index` is out of range.
+   */
+  KeyHandle Handle(size_t node, size_t index) const;
+
+  /**
+   * Returns true if key `index` has node-local copies.
+   */
+  bool Replicated(size_t index) const;
+
+  /**
+   * Returns the replica of `node`, or nullptr if nothing was copied.
+   */
+  const KeyTable* Replica(size_t node) const;
+
+  /**
+   * Returns the node whose memory holds the source table.
+   */
+  size_t HomeNode() const { return home_node_; }
+
+  /**
+   * Returns the table every key is in.
+   */
+  const KeyTable& Source() const { return source_; }
+
+ private:
+  static constexpr size_t kNotReplicated = std::numeric_limits<size_t>::max();
+
+  const KeyTable& source_;
+  size_t home_node_;
+  std::vector<std::unique_ptr<KeyTable>> replicas_;  // Per node; empty on one node.
+  std::vector<size_t> rows_;  // Replica row per source index, or kNotReplicated.
+};
+
+/**
+ * Where `DecryptBatch` sent its items.
+ */
+struct NumaBatchStats {
+  std::vector<size_t> items_per_node;
+};
+
+/**
+ * Decrypts `ciphertexts[i]` with key `key_indices[i]` of `keys`, each on
+ * the node that holds its key.
+ *
+ * Items whose key is replicated are split into contiguous runs, one per
+ * node and sized by the node's worker count, so a node also reads a
+ * contiguous part of the input. The others go to the home node. All nodes
+ * run at once; results come back in input order.
+ *
+ * @param stats Optional; receives the items run per node.
+ * @throws std::invalid_argument If the vectors differ in length, or as
+ *         `Decrypt(ciphertext, KeyHandle)`.
+ * @throws std::out_of_range If a key index is out of range.
+ */
+std::vector<BigNumber> DecryptBatch(const std::vector<BigNumber>& ciphertexts,
+                                    const std::vector<size_t>& key_indices,
+                                    const NumaKeyReplicas& keys, NumaPool& pool,
+                                    NumaBatchStats* stats = nullptr);
+
+}  // namespace rsa_app
+
+#endif  // RSA_APP_NUMA_H_
@@ -0,0 +1,105 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "numa.h"
+
+// Batch decryption throughput per topology: a plain pool reading every key
+// from one table, against per-node pinned pools decrypting from node-local
+// replicas. Simulated topologies only show the routing overhead; the gain
+// needs a host with several memory nodes.
+
+using Clock = std::chrono::steady_clock;
+
+template <typename Fn>
+double Seconds(Fn fn) {
+    auto start = Clock::now();
+    fn();
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    return elapsed.count();
+}
+
+int main(int argc, char** argv) {
+    int bits = 2048;
+    size_t key_count = 64;
+    size_t items = 512;
+    std::vector<size_t> simulated = {1, 2, 4};
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--bits") {
+            bits = std::stoi(argv[i + 1]);
+        } else if (flag == "--keys") {
+            key_count = std::stoul(argv[i + 1]);
+        } else if (flag == "--items") {
+            items = std::stoul(argv[i + 1]);
+        } else if (flag == "--nodes") {
+            simulated = {std::stoul(argv[i + 1])};
+        } else {
+            std::cerr << "Unknown option " << flag
+                      << " (supported: --bits N, --keys N, --items N, --nodes N)\n";
+            return 2;
+        }
+    }
+    if (key_count == 0) {
+        std::cerr << "--keys must be positive\n";
+        return 2;
+    }
+
+    std::vector<rsa_app::KeyPair> keys;
+    rsa_app::KeyTable table(bits, key_count);
+    for (size_t i = 0; i < key_count; ++i) {
+        keys.push_back(rsa_app::GenerateKeyPair(bits));
+        table.Add(keys.back());
+    }
+    std::vector<BigNumber> ciphertexts;
+    std::vector<size_t> key_indices;
+    for (size_t i = 0; i < items; ++i) {
+        BigNumber message;
+        message.GenerateRandom(bits - 8);
+        ciphertexts.push_back(rsa_app::Encrypt(message, keys[i % key_count].public_key));
+        key_indices.push_back(i % key_count);
+    }
+
+    std::vector<rsa_app::NumaTopology> topologies = {rsa_app::DetectNumaTopology()};
+    for (size_t nodes : simulated) topologies.push_back(rsa_app::SimulateNumaTopology(nodes));
+
+    std::cout << items << " decryptions, " << key_count << " keys of " << bits << " bits\n\n";
+    for (const rsa_app::NumaTopology& topology : topologies) {
+        rsa_app::NumaPool numa_pool(topology);
+        rsa_app::ThreadPool plain_pool(numa_pool.Size());
+        std::vector<BigNumber> expected(items), actual;
+
+        double plain_s = Seconds([&] {
+            plain_pool.ParallelFor(items, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    expected[i] = rsa_app::Decrypt(ciphertexts[i], table.Handle(key_indices[i]));
+                }
+            });
+        });
+        std::unique_ptr<rsa_app::NumaKeyReplicas> replicas;
+        double replicate_s = Seconds(
+            [&] { replicas = std::make_unique<rsa_app::NumaKeyReplicas>(table, numa_pool); });
+        rsa_app::NumaBatchStats stats;
+        double numa_s = Seconds([&] {
+            actual = rsa_app::DecryptBatch(ciphertexts, key_indices, *replicas, numa_pool, &stats);
+        });
+        for (size_t i = 0; i < items; ++i) {
+            if (BN_cmp(expected[i].Get(), actual[i].Get()) != 0) {
+                throw std::runtime_error("NUMA batch result mismatch");
+            }
+        }
+
+        std::cout << rsa_app::DescribeNumaTopology(topology) << "\n"
+                  << std::fixed << std::setprecision(1) << "  plain pool    "
+                  << std::setw(10) << items / plain_s << " decrypts/s\n"
+                  << "  numa routed   " << std::setw(10) << items / numa_s << " decrypts/s ("
+                  << std::setprecision(2) << plain_s / numa_s << "x), replicas built in "
+                  << replicate_s * 1e3 << " ms\n  items per node:";
+        for (size_t count : stats.items_per_node) std::cout << " " << count;
+        std::cout << "\n\n";
+    }
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include "perf_counters.h"
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace rsa_app {
+
+namespace {
+
+#ifdef __linux__
+
+// Type and config of each PerfEvent.
+struct EventConfig {
+  uint32_t type;
+  uint64_t config;
+};
+
+constexpr EventConfig kEventConfigs[kPerfEventCount] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+int OpenEvent(const EventConfig& event) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = event.type;
+  attr.config = event.config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+}
+
+#endif
+
+}  // namespace
+
+const char* PerfEventName(PerfEvent event) {
+  switch (event) {
+    case PerfEvent::kCycles:
+      return "cycles";
+    case PerfEvent::kInstructions:
+      return "instructions";
+    case PerfEvent::kL1dMisses:
+      return "l1d_misses";
+    case PerfEvent::kLlcMisses:
+      return "llc_misses";
+    case PerfEvent::kBranchMisses:
+      return "branch_misses";
+  }
+  return "unknown";
+}
+
+double PerfSample::Ipc() const {
+  if (!Has(PerfEvent::kCycles) || !Has(PerfEvent::kInstructions)) return 0.0;
+  uint64_t cycles = Get(PerfEvent::kCycles);
+  return cycles ? static_cast<double>(Get(PerfEvent::kInstructions)) / cycles : 0.0;
+}
+
+PerfCounters::PerfCounters() {
+  fds_.fill(-1);
+#ifdef __linux__
+  for (size_t i = 0; i < kPerfEventCount; ++i) {
+    fds_[i] = OpenEvent(kEventConfigs[i]);
+    if (fds_[i] < 0 && reason_.empty()) {
+      int error = errno;
+      reason_ = std::string("perf_event_open(") + PerfEventName(static_cast<PerfEvent>(i)) +
+                ") failed: " + std::strerror(error);
+      if (error == EACCES || error == EPERM) {
+        reason_ += " (check /proc/sys/kernel/perf_event_paranoid)";
+      } else if (error == ENOENT || error == EOPNOTSUPP) {
+        reason_ += " (event not supported by this CPU or hypervisor)";
+      }
+    }
+  }
+#else
+  reason_ = "hardware counters need Linux perf_event_open";
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+  for (int fd : fds_) {
+    if (fd >= 0) close(fd);
+  }
+#endif
+}
+
+bool PerfCounters::Available() const {
+  for (int fd : fds_) {
+    if (fd >= 0) return true;
+  }
+  return false;
+}
+
+void PerfCounters::Start() {
+#ifdef __linux__
+  for (int fd : fds_) {
+    if (fd < 0) continue;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+}
+
+PerfSample PerfCounters::Stop() {
+  PerfSample sample;
+#ifdef __linux__
+  for (int fd : fds_) {
+    if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+  }
+  for (size_t i = 0; i < kPerfEventCount; ++i) {
+    if (fds_[i] < 0) continue;
+    // value, time enabled, time running
+    uint64_t data[3] = {};
+    if (read(fds_[i], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)) || data[2] == 0) {
+      continue;
+    }
+    double scale = data[2] < data[1] ? static_cast<double>(data[1]) / data[2] : 1.0;
+    sample.values[i] = static_cast<uint64_t>(static_cast<double>(data[0]) * scale);
+    sample.valid[i] = true;
+  }
+#endif
+  return sample;
+}
+
+}  // namespace rsa_app
@@ -0,0 +1,100 @@
+#ifndef RSA_APP_PERF_COUNTERS_H_
+#define RSA_APP_PERF_COUNTERS_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace rsa_app {
+
+/**
+ * Hardware events counted by `PerfCounters`.
+ */
+enum class PerfEvent {
+  kCycles = 0,        ///< CPU cycles.
+  kInstructions = 1,  ///< Retired instructions.
+  kL1dMisses = 2,     ///< L1 data cache read misses.
+  kLlcMisses = 3,     ///< Last-level cache misses.
+  kBranchMisses = 4,  ///< Mispredicted branches.
+};
+
+constexpr size_t kPerfEventCount = 5;
+
+/**
+ * Returns the JSON key of an event ("cycles", "instructions", "l1d_misses",
+ * "llc_misses", "branch_misses").
+ */
+const char* PerfEventName(PerfEvent event);
+
+/**
+ * Counter values of one measured interval.
+ */
+struct PerfSample {
+  std::array<uint64_t, kPerfEventCount> values{};  // Indexed by PerfEvent.
+  std::array<bool, kPerfEventCount> valid{};       // False if the event was not counted.
+
+  uint64_t Get(PerfEvent event) const { return values[static_cast<size_t>(event)]; }
+  bool Has(PerfEvent event) const { return valid[static_cast<size_t>(event)]; }
+
+  /**
+   * Returns instructions per cycle, or 0 if either counter is missing.
+   */
+  double Ipc() const;
+};
+
+/**
+ * User-space hardware counters of the calling thread, via `perf_event_open`.
+ *
+ * Each event is opened on its own, so a CPU or hypervisor that lacks one
+ * event (virtual machines often expose none) only loses that event. Values
+ * are scaled by enabled/running time when the kernel multiplexes counters.
+ * Nothing here throws: when counting is impossible (non-Linux builds,
+ * `perf_event_paranoid` > 2, containers without the syscall) every event
+ * reports invalid and `UnavailableReason()` says why.
+ *
+ * An instance counts the thread that created it and must be used from that
+ * thread only.
+ */
+class PerfCounters {
+ public:
+  PerfCounters();
+  ~PerfCounters();
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  /**
+   * Returns true if at least one event is counted.
+   */
+  bool Available() const;
+
+  /**
+   * Returns true if `event` is counted.
+   */
+  bool Available(PerfEvent event) const { return fds_[static_cast<size_t>(event)] >= 0; }
+
+  /**
+   * Returns why the first missing event could not be opened, or an empty
+   * string if all are counted.
+   */
+  const std::string& UnavailableReason() const { return reason_; }
+
+  /**
+   * Resets and starts all counters.
+   */
+  void Start();
+
+  /**
+   * Stops the counters and returns the counts since `Start()`.
+   */
+  PerfSample Stop();
+
+ private:
+  std::array<int, kPerfEventCount> fds_;
+  std::string reason_;
+};
+
+}  // namespace rsa_app
+
+#endif  // RSA_APP_PERF_COUNTERS_H_
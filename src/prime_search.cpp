@@ -0,0 +1,374 @@
+#include "prime_search.h"
+
+#include <openssl/bn.h>
+#include <openssl/rand.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "drbg.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+namespace rsa_app {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kMinBits = 64;
+
+using CtxPtr = std::unique_ptr<BN_CTX, decltype(&BN_CTX_free)>;
+using MontPtr = std::unique_ptr<BN_MONT_CTX, decltype(&BN_MONT_CTX_free)>;
+
+void CheckError(int ok) {
+  if (!ok) throw std::runtime_error("OpenSSL call failed during prime search");
+}
+
+// Sets `start` to the first candidate of window `index`: `bits` bits with
+// the top two bits set (so that p * q has exactly 2 * bits bits) and odd.
+void WindowStart(int bits, uint64_t seed, uint64_t index, BigNumber& start) {
+  Drbg drbg(seed, 2 * index);
+  start.GenerateRandom(bits, drbg);
+  BIGNUM* value = start.Get();
+  CheckError(BN_set_bit(value, bits - 2));
+  CheckError(BN_set_bit(value, 0));
+}
+
+// State shared by the workers of one search.
+struct SearchState {
+  int bits = 0;  // Of the candidates: q for a safe-prime search.
+  uint64_t seed = 0;
+  size_t window = 0;
+  int rounds = 0;
+  std::atomic<uint64_t> next_window{0};
+  // Lowest window known to contain a prime; written under `mutex`.
+  std::atomic<uint64_t> best_window{std::numeric_limits<uint64_t>::max()};
+  std::atomic<bool> failed{false};
+  std::mutex mutex;
+  BigNumber best_prime;
+  std::atomic<uint64_t> windows{0};
+  std::atomic<uint64_t> candidates{0};
+  std::atomic<uint64_t> rejected{0};
+  std::atomic<uint64_t> mr_rounds{0};
+  // Safe-prime search only.
+  std::atomic<uint64_t> fermat_rejected{0};
+  std::atomic<uint64_t> pocklington_rejected{0};
+};
+
+// Per-worker scratch space and counters. Subclasses test the candidates of
+// one window; this class hands out the windows and publishes results.
+class Worker {
+ public:
+  explicit Worker(SearchState& state)
+      : state_(state),
+        ctx_(BN_CTX_new(), BN_CTX_free),
+        mont_(BN_MONT_CTX_new(), BN_MONT_CTX_free),
+        sieve_(state.window) {
+    if (!ctx_ || !mont_) throw std::bad_alloc();
+  }
+
+  virtual ~Worker() = default;
+
+  void Run() {
+    try {
+      while (!state_.failed.load(std::memory_order_relaxed)) {
+        uint64_t index = state_.next_window.fetch_add(1);
+        if (index > state_.best_window.load()) break;
+        ++windows_;
+        SearchWindow(index);
+      }
+    } catch (...) {
+      state_.failed = true;
+      Flush();
+      throw;
+    }
+    Flush();
+  }
+
+ protected:
+  // Tests the candidates of window `index` in order and publishes the first
+  // prime unless a lower window already has one.
+  virtual void SearchWindow(uint64_t index) = 0;
+
+  // True once the window need not be searched further.
+  bool Abandoned(uint64_t index) const {
+    return state_.best_window.load() < index || state_.failed.load();
+  }
+
+  // Offers `prime`, found in window `index`, as the result.
+  void Publish(uint64_t index, const BigNumber& prime) {
+    std::lock_guard<std::mutex> lock(state_.mutex);
+    if (index < state_.best_window.load()) {
+      state_.best_prime = prime.Copy();
+      state_.best_window = index;
+    }
+  }
+
+  // Miller-Rabin on `n` with `state_.rounds` rounds. The first witness is
+  // 2 if `base_two`, the others are drawn from the window's witness stream.
+  bool MillerRabin(const BIGNUM* n, Drbg& witnesses, bool base_two) {
+    BN_CTX* ctx = ctx_.get();
+    CheckError(BN_MONT_CTX_set(mont_.get(), n, ctx));
+    CheckError(BN_sub(n_minus_1_.Get(), n, BN_value_one()));
+    int s = 1;
+    while (!BN_is_bit_set(n_minus_1_.Get(), s)) ++s;
+    CheckError(BN_rshift(d_.Get(), n_minus_1_.Get(), s));
+    CheckError(BN_sub(upper_.Get(), n_minus_1_.Get(), BN_value_one()));
+    BigNumber two;
+    two.SetWord(2);
+
+    for (int round = 0; round < state_.rounds; ++round) {
+      ++mr_rounds_;
+      if (round == 0 && base_two) {
+        CheckError(BN_set_word(witness_.Get(), 2));
+      } else {
+        witness_ = BigNumber::GenerateInRange(two.Get(), upper_.Get(), witnesses);
+      }
+      CheckError(BN_mod_exp_mont(x_.Get(), witness_.Get(), d_.Get(), n, ctx,
+                                 mont_.get()));
+      if (BN_is_one(x_.Get()) || BN_cmp(x_.Get(), n_minus_1_.Get()) == 0) continue;
+      bool passed = false;
+      for (int j = 1; j < s && !passed; ++j) {
+        CheckError(BN_mod_sqr(x_.Get(), x_.Get(), n, ctx));
+        if (BN_is_one(x_.Get())) break;
+        passed = BN_cmp(x_.Get(), n_minus_1_.Get()) == 0;
+      }
+      if (!passed) return false;
+    }
+    return true;
+  }
+
+  // Sets `result` to 2^`exponent` mod `n` for odd `n`.
+  void PowerOfTwo(BIGNUM* result, const BIGNUM* exponent, const BIGNUM* n) {
+    CheckError(BN_MONT_CTX_set(mont_.get(), n, ctx_.get()));
+    CheckError(BN_mod_exp_mont_word(result, 2, exponent, n, ctx_.get(), mont_.get()));
+  }
+
+  void Flush() {
+    state_.windows += windows_;
+    state_.candidates += candidates_;
+    state_.rejected += rejected_;
+    state_.mr_rounds += mr_rounds_;
+    state_.fermat_rejected += fermat_rejected_;
+    state_.pocklington_rejected += pocklington_rejected_;
+    windows_ = candidates_ = rejected_ = mr_rounds_ = 0;
+    fermat_rejected_ = pocklington_rejected_ = 0;
+  }
+
+  SearchState& state_;
+  CtxPtr ctx_;
+  MontPtr mont_;
+  std::vector<unsigned char> sieve_;  // 1 = some candidate has a small factor.
+  BigNumber start_, candidate_, n_minus_1_, d_, upper_, witness_, x_;
+  uint64_t windows_ = 0;
+  uint64_t candidates_ = 0;
+  uint64_t rejected_ = 0;
+  uint64_t mr_rounds_ = 0;
+  uint64_t fermat_rejected_ = 0;
+  uint64_t pocklington_rejected_ = 0;
+};
+
+// Searches windows for a prime.
+class PrimeWorker : public Worker {
+ public:
+  using Worker::Worker;
+
+ private:
+  void SearchWindow(uint64_t index) override {
+    TraceSpan span("prime_window", "prime", static_cast<int64_t>(index));
+    WindowStart(state_.bits, state_.seed, index, start_);
+    std::fill(sieve_.begin(), sieve_.end(), 0);
+    for (uint32_t p : BigNumber::SmallPrimes()) {
+      BN_ULONG r = BN_mod_word(start_.Get(), p);
+      CheckError(r != static_cast<BN_ULONG>(-1));
+      // First i with start + 2i = 0 (mod p): i = -r / 2 (mod p).
+      uint64_t first = ((p - r) % p) * ((p + 1) / 2) % p;
+      for (uint64_t i = first; i < sieve_.size(); i += p) sieve_[i] = 1;
+    }
+
+    Drbg witnesses(state_.seed, 2 * index + 1);
+    for (size_t i = 0; i < sieve_.size(); ++i) {
+      if (Abandoned(index)) return;
+      if (sieve_[i]) continue;
+      CheckError(BN_copy(candidate_.Get(), start_.Get()) != nullptr);
+      CheckError(BN_add_word(candidate_.Get(), 2 * static_cast<BN_ULONG>(i)));
+      // The window ran past 2^bits.
+      if (BN_num_bits(candidate_.Get()) != state_.bits) return;
+      ++candidates_;
+      TraceSpan test("miller_rabin", "prime", static_cast<int64_t>(i));
+      if (!MillerRabin(candidate_.Get(), witnesses, true)) {
+        ++rejected_;
+        continue;
+      }
+      Publish(index, candidate_);
+      return;
+    }
+  }
+};
+
+// Searches windows of q for a safe prime 2q + 1.
+class SafePrimeWorker : public Worker {
+ public:
+  using Worker::Worker;
+
+ private:
+  void SearchWindow(uint64_t index) override {
+    TraceSpan span("safe_prime_window", "prime", static_cast<int64_t>(index));
+    WindowStart(state_.bits, state_.seed, index, start_);
+    std::fill(sieve_.begin(), sieve_.end(), 0);
+    for (uint32_t p : BigNumber::SmallPrimes()) {
+      BN_ULONG r = BN_mod_word(start_.Get(), p);
+      CheckError(r != static_cast<BN_ULONG>(-1));
+      uint64_t half = (p + 1) / 2;  // The inverse of 2 mod p.
+      // q = start + 2i is 0 (mod p) at i = -r / 2, and 2q + 1 is 0 at
+      // q = (p - 1) / 2, i.e. i = ((p - 1) / 2 - r) / 2 (mod p).
+      uint64_t q_first = ((p - r) % p) * half % p;
+      uint64_t p_first = ((p - 1) / 2 + p - r) % p * half % p;
+      for (uint64_t i = q_first; i < sieve_.size(); i += p) sieve_[i] = 1;
+      for (uint64_t i = p_first; i < sieve_.size(); i += p) sieve_[i] = 1;
+    }
+
+    Drbg witnesses(state_.seed, 2 * index + 1);
+    for (size_t i = 0; i < sieve_.size(); ++i) {
+      if (Abandoned(index)) return;
+      if (sieve_[i]) continue;
+      CheckError(BN_copy(candidate_.Get(), start_.Get()) != nullptr);
+      CheckError(BN_add_word(candidate_.Get(), 2 * static_cast<BN_ULONG>(i)));
+      // The window ran past 2^bits.
+      if (BN_num_bits(candidate_.Get()) != state_.bits) return;
+      ++candidates_;
+      if (!TestCandidate(witnesses)) continue;
+      Publish(index, safe_prime_);
+      return;
+    }
+  }
+
+  // Tests q = `candidate_`, cheapest test first, and leaves 2q + 1 in
+  // `safe_prime_`.
+  bool TestCandidate(Drbg& witnesses) {
+    const BIGNUM* q = candidate_.Get();
+    BIGNUM* p = safe_prime_.Get();
+    // Fermat to base 2 on q rejects nearly every composite q.
+    CheckError(BN_sub(n_minus_1_.Get(), q, BN_value_one()));
+    PowerOfTwo(x_.Get(), n_minus_1_.Get(), q);
+    if (!BN_is_one(x_.Get())) {
+      ++fermat_rejected_;
+      return false;
+    }
+    // Pocklington with the factor q of p - 1 = 2q: once q is prime, p is
+    // prime iff 2^(p-1) = 1 (mod p), as gcd(2^2 - 1, p) = 1 after the
+    // sieve. 2^q = +-1 (mod p) is that test, and the Euler criterion for
+    // 2 also makes it necessary, so p needs no Miller-Rabin of its own.
+    CheckError(BN_lshift1(p, q));
+    CheckError(BN_add_word(p, 1));
+    PowerOfTwo(x_.Get(), q, p);
+    CheckError(BN_sub(upper_.Get(), p, BN_value_one()));
+    if (!BN_is_one(x_.Get()) && BN_cmp(x_.Get(), upper_.Get()) != 0) {
+      ++pocklington_rejected_;
+      return false;
+    }
+    // Base 2 was covered by the Fermat test.
+    TraceSpan span("miller_rabin", "prime");
+    if (!MillerRabin(q, witnesses, false)) {
+      ++rejected_;
+      return false;
+    }
+    return true;
+  }
+
+  BigNumber safe_prime_;
+};
+
+// Fills the search parameters shared by both searches from `options`.
+void ConfigureSearch(int bits, const ParallelPrimeOptions& options, size_t default_window,
+                     SearchState& state) {
+  state.bits = bits;
+  if (options.seed) {
+    state.seed = *options.seed;
+  } else {
+    unsigned char bytes[8];
+    CheckError(RAND_bytes(bytes, sizeof(bytes)));
+    for (unsigned char byte : bytes) state.seed = (state.seed << 8) | byte;
+  }
+  state.window = options.window ? options.window : default_window;
+  state.rounds = options.rounds > 0 ? options.rounds : BigNumber::MillerRabinRounds(bits);
+}
+
+// Runs one `WorkerType` per thread until the lowest window with a prime is
+// known.
+template <typename WorkerType>
+size_t RunSearch(const ParallelPrimeOptions& options, SearchState& state) {
+  size_t threads = options.threads ? options.threads : ThreadPool::DefaultThreadCount();
+  ThreadPool pool(threads);
+  for (size_t i = 0; i < threads; ++i) {
+    pool.Submit([&state] { WorkerType(state).Run(); });
+  }
+  pool.Wait();
+  return threads;
+}
+
+}  // namespace
+
+BigNumber GeneratePrimeParallel(int bits, const ParallelPrimeOptions& options,
+                                ParallelPrimeStats* stats) {
+  if (bits < kMinBits) {
+    throw std::invalid_argument("Parallel prime search needs at least 64 bits");
+  }
+  auto start = Clock::now();
+
+  SearchState state;
+  // About one prime per 0.35 * bits odd numbers; this window holds one in
+  // roughly half of the cases.
+  ConfigureSearch(bits, options, std::max<size_t>(64, static_cast<size_t>(bits) / 4), state);
+  size_t threads = RunSearch<PrimeWorker>(options, state);
+
+  if (stats) {
+    stats->seed = state.seed;
+    stats->threads = threads;
+    stats->windows = state.windows;
+    stats->winning_window = state.best_window;
+    stats->candidates = state.candidates;
+    stats->rejected = state.rejected;
+    stats->mr_rounds = state.mr_rounds;
+    stats->seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  }
+  return std::move(state.best_prime);
+}
+
+BigNumber GenerateSafePrimeParallel(int bits, const ParallelPrimeOptions& options,
+                                    SafePrimeStats* stats) {
+  if (bits < kMinBits) {
+    throw std::invalid_argument("Parallel safe-prime search needs at least 64 bits");
+  }
+  auto start = Clock::now();
+
+  SearchState state;
+  // Safe primes are about bits / 4 times rarer than primes, so windows
+  // cover roughly a sixth of the expected distance to one. Sieving both q
+  // and 2q + 1 leaves about 0.7% of the odd q for the exponentiations.
+  ConfigureSearch(bits - 1, options, static_cast<size_t>(bits) * 32, state);
+  size_t threads = RunSearch<SafePrimeWorker>(options, state);
+
+  if (stats) {
+    stats->seed = state.seed;
+    stats->threads = threads;
+    stats->windows = state.windows;
+    stats->winning_window = state.best_window;
+    stats->candidates = state.candidates;
+    stats->fermat_rejected = state.fermat_rejected;
+    stats->pocklington_rejected = state.pocklington_rejected;
+    stats->mr_rejected = state.rejected;
+    stats->mr_rounds = state.mr_rounds;
+    stats->seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  }
+  return std::move(state.best_prime);
+}
+
+}  // namespace rsa_app
@@ -1,122 +1,380 @@
 #include "rsa.h"
 
+#include <algorithm>
 #include <stdexcept>
+#include <chrono>
 #include <numeric>
-#include <openssl/bio.h>
-#include <openssl/evp.h>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <sstream>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
+#include "codec.h"
+#include "drbg.h"
+#include "fixed_modexp.h"
+#include "mb_modexp.h"
+#include "prime_search.h"
+#include "trace.h"
 
 namespace rsa_app {
 
-KeyPair GenerateKeyPair(int bits) {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double SecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Generates a prime, from `drbg` if given and OpenSSL's RNG otherwise, and
+// accumulates the search counters into `stats`.
+void GeneratePrimeWithStats(BigNumber& prime, int bits, Drbg* drbg,
+                            PrimeSearchStats& stats,
+                            const BigNumber::PrimeCallback& progress = nullptr) {
+  TraceSpan span("prime_search", "keygen", bits);
+  auto start = Clock::now();
+  uint64_t candidates = 0;
+  uint64_t passed_rounds = 0;
+  BigNumber::PrimeCallback callback = [&](BigNumber::PrimeEvent event, int index) {
+    if (event == BigNumber::PrimeEvent::kCandidate) ++candidates;
+    if (event == BigNumber::PrimeEvent::kRound) ++passed_rounds;
+    return !progress || progress(event, index);
+  };
+  if (drbg) {
+    prime.GeneratePrime(bits, *drbg, callback);
+  } else {
+    prime.GeneratePrime(bits, callback);
+  }
+  // Every rejected candidate ran exactly one failing round that is not
+  // reported.
+  uint64_t rejected = candidates > 0 ? candidates - 1 : 0;
+  stats.candidates += candidates;
+  stats.rejected += rejected;
+  stats.mr_rounds += passed_rounds + rejected;
+  stats.seconds += SecondsSince(start);
+}
+
+// Generates a prime with `GeneratePrimeParallel` and accumulates the search
+// counters into `stats`.
+void GeneratePrimeParallelWithStats(BigNumber& prime, int bits,
+                                    const ParallelPrimeOptions& options,
+                                    PrimeSearchStats& stats) {
+  TraceSpan span("prime_search", "keygen", bits);
+  ParallelPrimeStats search;
+  prime = GeneratePrimeParallel(bits, options, &search);
+  stats.candidates += search.candidates;
+  stats.rejected += search.rejected;
+  stats.mr_rounds += search.mr_rounds;
+  stats.seconds += search.seconds;
+}
+
+// Derives n, the totient and d from the primes and finishes `phases`.
+KeyPair AssembleKeyPair(int bits, const BigNumber& p, const BigNumber& q,
+                        KeyGenStats& phases, Clock::time_point start) {
+  TraceSpan span("assemble_key", "keygen", bits);
   BigNumber e;
   e.SetWord(65537);
 
-  BigNumber p, q;
-  p.GeneratePrime(bits / 2);
-  do {
-    q.GeneratePrime(bits / 2);
-  } while (BN_cmp(p.Get(), q.Get()) == 0);
-
   if (!p.GetBit(bits / 2 - 1) || !q.GetBit(bits / 2 - 1)) {
     throw std::runtime_error("Generated primes do not have the required bit length");
   }
 
+  auto phase_start = Clock::now();
   BigNumber n = p.Mul(q.Get());
   BigNumber p_minus_1 = p.Sub(BN_value_one());
   BigNumber q_minus_1 = q.Sub(BN_value_one());
   BigNumber totient = p_minus_1.Mul(q_minus_1.Get());
+  phases.multiply_seconds = SecondsSince(phase_start);
 
+  phase_start = Clock::now();
   if (e.Gcd(totient.Get()).GetWord() != 1) {
     throw std::runtime_error("Public exponent not coprime with totient");
   }
+  phases.gcd_seconds = SecondsSince(phase_start);
 
+  phase_start = Clock::now();
   BigNumber d = e.ModInverse(totient.Get());
+  phases.inverse_seconds = SecondsSince(phase_start);
+  phases.total_seconds = SecondsSince(start);
 
   return KeyPair{
       PublicKey{n.Copy(), std::move(e)},
       PrivateKey{std::move(n), std::move(d)}};
 }
 
+}  // namespace
+
+KeyPair GenerateKeyPair(int bits, KeyGenStats* stats) {
+  KeyGenStats local_stats;
+  KeyGenStats& phases = stats ? *stats : local_stats;
+  phases = KeyGenStats{};
+  TraceSpan span("GenerateKeyPair", "keygen", bits);
+  auto start = Clock::now();
+
+  BigNumber p, q;
+  GeneratePrimeWithStats(p, bits / 2, nullptr, phases.p_search);
+  do {
+    GeneratePrimeWithStats(q, bits / 2, nullptr, phases.q_search);
+  } while (BN_cmp(p.Get(), q.Get()) == 0);
+  return AssembleKeyPair(bits, p, q, phases, start);
+}
+
+KeyPair GenerateKeyPair(int bits, Drbg& drbg, KeyGenStats* stats,
+                        const BigNumber::PrimeCallback& progress) {
+  KeyGenStats local_stats;
+  KeyGenStats& phases = stats ? *stats : local_stats;
+  phases = KeyGenStats{};
+  TraceSpan span("GenerateKeyPair", "keygen", bits);
+  auto start = Clock::now();
+
+  BigNumber p, q;
+  GeneratePrimeWithStats(p, bits / 2, &drbg, phases.p_search, progress);
+  do {
+    GeneratePrimeWithStats(q, bits / 2, &drbg, phases.q_search, progress);
+  } while (BN_cmp(p.Get(), q.Get()) == 0);
+  return AssembleKeyPair(bits, p, q, phases, start);
+}
+
+KeyPair GenerateKeyPair(int bits, const ParallelPrimeOptions& options,
+                        KeyGenStats* stats) {
+  KeyGenStats local_stats;
+  KeyGenStats& phases = stats ? *stats : local_stats;
+  phases = KeyGenStats{};
+  TraceSpan span("GenerateKeyPair", "keygen", bits);
+  auto start = Clock::now();
+
+  BigNumber p, q;
+  GeneratePrimeParallelWithStats(p, bits / 2, options, phases.p_search);
+  // A seeded q uses seeds stepped away from p's; a repeat of p steps again.
+  ParallelPrimeOptions q_options = options;
+  do {
+    if (q_options.seed) *q_options.seed += 0x9E3779B97F4A7C15u;
+    GeneratePrimeParallelWithStats(q, bits / 2, q_options, phases.q_search);
+  } while (BN_cmp(p.Get(), q.Get()) == 0);
+  return AssembleKeyPair(bits, p, q, phases, start);
+}
+
 BigNumber Encrypt(const BigNumber& message, const PublicKey& public_key) {
+  TraceSpan span("Encrypt", "modexp", public_key.n.NumBits());
   if (BN_cmp(message.Get(), public_key.n.Get()) >= 0) {
     throw std::invalid_argument("Message too large for key size");
   }
 
+  if (ActiveModExpBackend() == ModExpBackend::kFixed &&
+      FixedModExpSupports(public_key.n.Get())) {
+    return FixedModExpPublic(message.Get(), public_key.e.Get(),
+                             public_key.n.Get());
+  }
   return message.ModExp(public_key.e.Get(), public_key.n.Get());
 }
 
 BigNumber Decrypt(const BigNumber& ciphertext, const PrivateKey& private_key) {
+  TraceSpan span("Decrypt", "modexp", private_key.n.NumBits());
   if (BN_cmp(ciphertext.Get(), private_key.n.Get()) >= 0) {
     throw std::invalid_argument("Ciphertext too large for key size");
   }
 
+  if (ActiveModExpBackend() == ModExpBackend::kFixed &&
+      FixedModExpSupports(private_key.n.Get())) {
+    return FixedModExp(ciphertext.Get(), private_key.d.Get(),
+                       private_key.n.Get());
+  }
   return ciphertext.ModExp(private_key.d.Get(), private_key.n.Get());
 }
 
-BigNumber StringToNumber(const std::string& message) {
-  BigNumber result;
-  BigNumber base;
-  base.SetWord(256);
+std::vector<BigNumber> EncryptBatch(const std::vector<BigNumber>& messages,
+                                    const PublicKey& public_key,
+                                    ThreadPool& pool) {
+  TraceSpan span("EncryptBatch", "batch", static_cast<int64_t>(messages.size()));
+  std::vector<BigNumber> results(messages.size());
+  pool.ParallelFor(messages.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      results[i] = Encrypt(messages[i], public_key);
+    }
+  });
+  return results;
+}
 
-  result.SetWord(0);
-  for (unsigned char c : message) {
-    result = result.Mul(base.Get());
-    BigNumber char_value;
-    char_value.SetWord(c);
-    result = result.Add(char_value.Get());
-  }
+namespace {
 
-  return result;
+// The multi-buffer engine only beats BN_mod_exp with IFMA: the AVX2 and
+// scalar kernels emulate 52-bit products and lose to OpenSSL's MULX code.
+bool UseMultiBuffer(const BigNumber& modulus, size_t count) {
+  int bits = modulus.NumBits();
+  return count > 1 && (bits == 2048 || bits == 3072 || bits == 4096) &&
+         BestMbKernel() == MbKernel::kAvx512Ifma;
 }
 
-std::string NumberToString(const BigNumber& number) {
-  std::string result;
-  BigNumber remaining = number.Copy();
-  BigNumber base;
-  base.SetWord(256);
-  BigNumber zero;
-  zero.SetWord(0);
+}  // namespace
 
-  while (BN_cmp(remaining.Get(), zero.Get()) > 0) {
-    BigNumber quotient, remainder;
-    remainder = remaining.Mod(base.Get());
-    remaining = remaining.Div(base.Get());
+std::vector<BigNumber> DecryptBatch(const std::vector<BigNumber>& ciphertexts,
+                                    const PrivateKey& private_key,
+                                    ThreadPool& pool) {
+  TraceSpan span("DecryptBatch", "batch", static_cast<int64_t>(ciphertexts.size()));
+  std::vector<BigNumber> results(ciphertexts.size());
+  if (UseMultiBuffer(private_key.n, ciphertexts.size())) {
+    for (const auto& ciphertext : ciphertexts) {
+      if (BN_cmp(ciphertext.Get(), private_key.n.Get()) >= 0) {
+        throw std::invalid_argument("Ciphertext too large for key size");
+      }
+    }
+    size_t groups = (ciphertexts.size() + kMbMaxLanes - 1) / kMbMaxLanes;
+    pool.ParallelFor(groups, [&](size_t begin, size_t end) {
+      size_t first = begin * kMbMaxLanes;
+      size_t last = std::min(end * kMbMaxLanes, ciphertexts.size());
+      TraceSpan group("MultiBufferModExp", "modexp", static_cast<int64_t>(last - first));
+      std::vector<const BIGNUM*> bases;
+      for (size_t i = first; i < last; ++i) bases.push_back(ciphertexts[i].Get());
+      std::vector<const BIGNUM*> exponents(bases.size(), private_key.d.Get());
+      std::vector<const BIGNUM*> moduli(bases.size(), private_key.n.Get());
+      auto plaintexts = MultiBufferModExp(bases, exponents, moduli);
+      for (size_t i = first; i < last; ++i) {
+        results[i] = std::move(plaintexts[i - first]);
+      }
+    });
+    return results;
+  }
+  pool.ParallelFor(ciphertexts.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      results[i] = Decrypt(ciphertexts[i], private_key);
+    }
+  });
+  return results;
+}
+
+namespace {
 
-    unsigned long char_value = remainder.GetWord();
-    result.insert(result.begin(), static_cast<char>(char_value));
+constexpr char kKeyFileHeader[] = "rsa_app key v1";
+
+void WriteKeyFile(const std::string& path,
+                  const std::vector<std::pair<const char*, const BigNumber*>>&
+                      components) {
+  std::ostringstream contents;
+  contents << kKeyFileHeader << "\n";
+  for (const auto& component : components) {
+    contents << component.first << " " << component.second->ToString() << "\n";
+  }
+  std::string text = contents.str();
+#ifndef _WIN32
+  // Created as 0600 so no other user can open it before d is written; an
+  // existing file is narrowed before anything is written to it.
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+  if (fd < 0) throw std::runtime_error("Cannot open key file for writing: " + path);
+  if (fchmod(fd, S_IRUSR | S_IWUSR) != 0) {
+    close(fd);
+    throw std::runtime_error("Cannot restrict key file permissions: " + path);
   }
+  size_t written = 0;
+  while (written < text.size()) {
+    ssize_t result = write(fd, text.data() + written, text.size() - written);
+    if (result < 0 && errno == EINTR) continue;
+    if (result <= 0) {
+      close(fd);
+      throw std::runtime_error("Failed to write key file: " + path);
+    }
+    written += static_cast<size_t>(result);
+  }
+  if (close(fd) != 0) throw std::runtime_error("Failed to write key file: " + path);
+#else
+  std::ofstream file(path, std::ios::trunc);
+  if (!file.is_open()) {
+    throw std::runtime_error("Cannot open key file for writing: " + path);
+  }
+  file << text;
+  if (!file.good()) throw std::runtime_error("Failed to write key file: " + path);
+#endif
+}
 
-  return result;
+std::map<std::string, BigNumber> ReadKeyFile(const std::string& path) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    throw std::runtime_error("Cannot open key file: " + path);
+  }
+  std::string line;
+  if (!std::getline(file, line) || line != kKeyFileHeader) {
+    throw std::invalid_argument("Not an rsa_app key file: " + path);
+  }
+  std::map<std::string, BigNumber> components;
+  while (std::getline(file, line)) {
+    if (line.empty()) continue;
+    std::istringstream fields(line);
+    std::string name, hex;
+    if (!(fields >> name >> hex)) {
+      throw std::invalid_argument("Malformed key file line: " + line);
+    }
+    components[name] = BigNumber::FromString(hex);
+  }
+  return components;
 }
 
-std::string FormatBigNumber(const BigNumber& number) {
-  unsigned char* bin_data = nullptr;
-  int bin_length = BN_num_bytes(number.Get());
-  bin_data = new unsigned char[bin_length];
-  BN_bn2bin(number.Get(), bin_data);
+BigNumber TakeComponent(std::map<std::string, BigNumber>& components,
+                        const std::string& name, const std::string& path) {
+  auto it = components.find(name);
+  if (it == components.end()) {
+    throw std::invalid_argument("Key file " + path + " lacks component " +
+                                name);
+  }
+  return std::move(it->second);
+}
 
-  std::string binary_string(reinterpret_cast<char*>(bin_data), bin_length);
-  delete[] bin_data;
+}  // namespace
 
-  return Base64Encode(binary_string);
+void SaveKeyPair(const KeyPair& key_pair, const std::string& path) {
+  WriteKeyFile(path, {{"n", &key_pair.public_key.n},
+                      {"e", &key_pair.public_key.e},
+                      {"d", &key_pair.private_key.d}});
 }
 
-std::string Base64Encode(const std::string& input) {
-  BIO* bio = BIO_new(BIO_s_mem());
-  BIO* b64 = BIO_new(BIO_f_base64());
-  bio = BIO_push(b64, bio);
+void SavePublicKey(const PublicKey& public_key, const std::string& path) {
+  WriteKeyFile(path, {{"n", &public_key.n}, {"e", &public_key.e}});
+}
+
+KeyPair LoadKeyPair(const std::string& path) {
+  std::map<std::string, BigNumber> components = ReadKeyFile(path);
+  BigNumber n = TakeComponent(components, "n", path);
+  BigNumber e = TakeComponent(components, "e", path);
+  BigNumber d = TakeComponent(components, "d", path);
+  return KeyPair{PublicKey{n.Copy(), std::move(e)},
+                 PrivateKey{std::move(n), std::move(d)}};
+}
+
+PublicKey LoadPublicKey(const std::string& path) {
+  std::map<std::string, BigNumber> components = ReadKeyFile(path);
+  BigNumber n = TakeComponent(components, "n", path);
+  BigNumber e = TakeComponent(components, "e", path);
+  return PublicKey{std::move(n), std::move(e)};
+}
+
+BigNumber StringToNumber(const std::string& message) {
+  // Equivalent to accumulating result * 256 + byte, without the quadratic
+  // big-number arithmetic.
+  return BigNumber::FromBytes(message);
+}
 
-  BIO_set_flags(bio, BIO_FLAGS_BASE64_NO_NL);
-  BIO_write(bio, input.data(), input.size());
-  BIO_flush(bio);
+std::string NumberToString(const BigNumber& number) {
+  return number.ToBytes();
+}
 
-  char* encoded_data;
-  long len = BIO_get_mem_data(bio, &encoded_data);
+std::string FormatBigNumber(const BigNumber& number) {
+  std::string binary_string(BN_num_bytes(number.Get()), '\0');
+  BN_bn2bin(number.Get(),
+            reinterpret_cast<unsigned char*>(binary_string.data()));
 
-  std::string result(encoded_data, len);
-  BIO_free_all(bio);
+  return Base64Encode(binary_string);
+}
+
+std::string Base64Encode(const std::string& input) {
+  std::string result(Base64EncodedLength(input.size()), '\0');
+  Base64EncodeTo(reinterpret_cast<const unsigned char*>(input.data()),
+                 input.size(), result.data());
   return result;
 }
 
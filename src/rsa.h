@@ -1,8 +1,13 @@
 #ifndef RSA_APP_RSA_H_
 #define RSA_APP_RSA_H_
 
+#include <cstdint>
 #include <string>
+#include <vector>
 #include "bn_wrapper.h"  // Includes the BigNumber class definition.
+#include "drbg.h"
+#include "prime_search.h"
+#include "thread_pool.h"
 
 namespace rsa_app {
 
@@ -33,6 +38,28 @@ struct KeyPair {
   PrivateKey private_key;  // The RSA private key.
 };
 
+/**
+ * Work done while searching for one prime factor.
+ */
+struct PrimeSearchStats {
+  double seconds = 0.0;     // Wall time of the search.
+  uint64_t candidates = 0;  // Candidates that survived trial division.
+  uint64_t rejected = 0;    // Candidates rejected by Miller-Rabin.
+  uint64_t mr_rounds = 0;   // Miller-Rabin rounds executed, failed ones included.
+};
+
+/**
+ * Phase-level breakdown of one `GenerateKeyPair` call.
+ */
+struct KeyGenStats {
+  PrimeSearchStats p_search;      // Search for p.
+  PrimeSearchStats q_search;      // Search for q, including retries if q == p.
+  double multiply_seconds = 0.0;  // n = p * q and the totient.
+  double gcd_seconds = 0.0;       // gcd(e, totient) check.
+  double inverse_seconds = 0.0;   // d = e^-1 mod totient.
+  double total_seconds = 0.0;     // Wall time of the whole call.
+};
+
 /**
  * Generates an RSA key pair with the specified bit size.
  *
@@ -42,18 +69,63 @@ struct KeyPair {
  *
  * @param bits The bit size of the RSA modulus (must be a multiple of 2,
  *             minimum 512).
+ * @param stats Optional output for per-phase timings and prime search
+ *              counters.
  * @return A `KeyPair` containing the generated public and private keys.
  * @throws std::runtime_error if key generation fails or invalid input is
  *         provided.
  */
-KeyPair GenerateKeyPair(int bits);
+KeyPair GenerateKeyPair(int bits, KeyGenStats* stats = nullptr);
+
+/**
+ * Generates an RSA key pair, searching for `p` and `q` on several threads.
+ *
+ * Same as `GenerateKeyPair(bits, stats)` but the primes come from
+ * `GeneratePrimeParallel`. With a seed, `p` uses it and `q` uses seeds
+ * derived from it, so the key is the same for every thread count.
+ *
+ * @param bits The bit size of the RSA modulus (must be a multiple of 2,
+ *             minimum 512).
+ * @param options Threads, seed, window size and rounds of the prime search.
+ * @param stats Optional output for per-phase timings and prime search
+ *              counters.
+ * @return A `KeyPair` containing the generated public and private keys.
+ * @throws std::runtime_error if key generation fails or invalid input is
+ *         provided.
+ */
+KeyPair GenerateKeyPair(int bits, const ParallelPrimeOptions& options,
+                        KeyGenStats* stats = nullptr);
+
+/**
+ * Generates an RSA key pair with primes drawn from `drbg`.
+ *
+ * Same as `GenerateKeyPair(bits, stats)` but uses
+ * `BigNumber::GeneratePrime(bits, drbg)`, so threads that each pass their
+ * own generator (e.g. `ThreadDrbg()`) never share RNG state. A seeded
+ * `Drbg` makes the key reproducible.
+ *
+ * @param bits The bit size of the RSA modulus (must be a multiple of 2,
+ *             minimum 512).
+ * @param drbg The generator the prime search draws from.
+ * @param stats Optional output for per-phase timings and prime search
+ *              counters.
+ * @param progress Optional; called after every sieved candidate and every
+ *                 passed Miller-Rabin round of both prime searches.
+ *                 Returning false aborts key generation.
+ * @return A `KeyPair` containing the generated public and private keys.
+ * @throws std::runtime_error if key generation fails, is aborted by
+ *         `progress` or invalid input is provided.
+ */
+KeyPair GenerateKeyPair(int bits, Drbg& drbg, KeyGenStats* stats = nullptr,
+                        const BigNumber::PrimeCallback& progress = nullptr);
 
 /**
  * Encrypts a message using the RSA public key.
  *
  * The encryption is performed using the mathematical formula:
  * `ciphertext = (message^e) % n`, where `e` is the public exponent
- * and `n` is the modulus.
+ * and `n` is the modulus. 2048, 3072 and 4096-bit moduli use
+ * `FixedModExpPublic` unless `SetModExpBackend` chose OpenSSL.
  *
  * @param message The input message as a BigNumber to encrypt.
  * @param public_key The `PublicKey` used for encryption.
@@ -67,7 +139,8 @@ BigNumber Encrypt(const BigNumber& message, const PublicKey& public_key);
  *
  * The decryption is performed using the formula:
  * `plaintext = (ciphertext^d) % n`, where `d` is the private exponent
- * and `n` is the modulus.
+ * and `n` is the modulus. 2048, 3072 and 4096-bit moduli use the
+ * constant-time `FixedModExp` unless `SetModExpBackend` chose OpenSSL.
  *
  * @param ciphertext The encrypted BigNumber message to decrypt.
  * @param private_key The `PrivateKey` used for decryption.
@@ -76,11 +149,84 @@ BigNumber Encrypt(const BigNumber& message, const PublicKey& public_key);
  */
 BigNumber Decrypt(const BigNumber& ciphertext, const PrivateKey& private_key);
 
+/**
+ * Encrypts independent messages in parallel using the RSA public key.
+ *
+ * @param messages The messages to encrypt.
+ * @param public_key The `PublicKey` used for encryption.
+ * @param pool The thread pool that performs the exponentiations.
+ * @return The ciphertexts, in the same order as `messages`.
+ * @throws std::invalid_argument if any message exceeds the modulus.
+ */
+std::vector<BigNumber> EncryptBatch(const std::vector<BigNumber>& messages,
+                                    const PublicKey& public_key,
+                                    ThreadPool& pool);
+
+/**
+ * Decrypts independent ciphertexts in parallel using the RSA private key.
+ *
+ * For 2048, 3072 and 4096-bit moduli on CPUs with AVX-512 IFMA, groups of
+ * ciphertexts are exponentiated together by `MultiBufferModExp`; otherwise
+ * each ciphertext goes through `Decrypt`.
+ *
+ * @param ciphertexts The ciphertexts to decrypt.
+ * @param private_key The `PrivateKey` used for decryption.
+ * @param pool The thread pool that performs the exponentiations.
+ * @return The plaintexts, in the same order as `ciphertexts`.
+ * @throws std::invalid_argument if any ciphertext exceeds the modulus.
+ */
+std::vector<BigNumber> DecryptBatch(const std::vector<BigNumber>& ciphertexts,
+                                    const PrivateKey& private_key,
+                                    ThreadPool& pool);
+
+/**
+ * Writes a key pair to a text file.
+ *
+ * The file holds one `name hex` line per component (`n`, `e`, `d`) after a
+ * header line. On POSIX systems the file is made readable by the owner only.
+ *
+ * @param key_pair The key pair to save.
+ * @param path The destination file.
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void SaveKeyPair(const KeyPair& key_pair, const std::string& path);
+
+/**
+ * Writes only the public half of a key pair to a text file.
+ *
+ * @param public_key The public key to save.
+ * @param path The destination file.
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void SavePublicKey(const PublicKey& public_key, const std::string& path);
+
+/**
+ * Reads a key pair written by `SaveKeyPair`.
+ *
+ * @param path The key file.
+ * @return The loaded key pair.
+ * @throws std::runtime_error if the file cannot be read.
+ * @throws std::invalid_argument if the file is malformed or lacks `d`.
+ */
+KeyPair LoadKeyPair(const std::string& path);
+
+/**
+ * Reads the public key from a file written by `SaveKeyPair` or
+ * `SavePublicKey`.
+ *
+ * @param path The key file.
+ * @return The loaded public key.
+ * @throws std::runtime_error if the file cannot be read.
+ * @throws std::invalid_argument if the file is malformed.
+ */
+PublicKey LoadPublicKey(const std::string& path);
+
 /**
  * Converts a string into its BigNumber representation.
  *
  * Each character in the string is converted to its respective ASCII value
- * and concatenated to form a single large number.
+ * and concatenated to form a single large number. Leading zero bytes are
+ * lost; use `PackBlocks` for binary data and messages longer than a block.
  *
  * @param message The input string to convert.
  * @return A BigNumber representing the ASCII values of the string.
@@ -0,0 +1,337 @@
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "stats.h"
+
+namespace {
+
+/**
+ * A parsed JSON value; only what `rsa_analysis` writes is needed.
+ */
+struct JsonValue {
+    enum class Type { kNull, kBool, kNumber, kString, kArray, kObject };
+    Type type = Type::kNull;
+    bool boolean = false;
+    double number = 0.0;
+    std::string text;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    // Returns the member `key`, or nullptr if absent or not an object.
+    const JsonValue* Find(const std::string& key) const {
+        for (const auto& member : members) {
+            if (member.first == key) return &member.second;
+        }
+        return nullptr;
+    }
+};
+
+/**
+ * Recursive-descent parser for RFC 8259 JSON.
+ */
+class JsonParser {
+  public:
+    explicit JsonParser(const std::string& text) : text_(text) {}
+
+    JsonValue Parse() {
+        JsonValue value = ParseValue();
+        SkipSpace();
+        if (pos_ != text_.size()) Fail("trailing characters");
+        return value;
+    }
+
+  private:
+    [[noreturn]] void Fail(const std::string& what) {
+        throw std::runtime_error("JSON " + what + " at offset " + std::to_string(pos_));
+    }
+
+    void SkipSpace() {
+        while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) ++pos_;
+    }
+
+    bool Consume(const std::string& token) {
+        if (text_.compare(pos_, token.size(), token) != 0) return false;
+        pos_ += token.size();
+        return true;
+    }
+
+    JsonValue ParseValue() {
+        SkipSpace();
+        if (pos_ >= text_.size()) Fail("unexpected end");
+        JsonValue value;
+        char c = text_[pos_];
+        if (c == '{') {
+            value.type = JsonValue::Type::kObject;
+            ++pos_;
+            SkipSpace();
+            if (Consume("}")) return value;
+            do {
+                SkipSpace();
+                std::string key = ParseString();
+                SkipSpace();
+                if (!Consume(":")) Fail("expected ':'");
+                value.members.emplace_back(std::move(key), ParseValue());
+                SkipSpace();
+            } while (Consume(","));
+            if (!Consume("}")) Fail("expected '}'");
+        } else if (c == '[') {
+            value.type = JsonValue::Type::kArray;
+            ++pos_;
+            SkipSpace();
+            if (Consume("]")) return value;
+            do {
+                value.items.push_back(ParseValue());
+                SkipSpace();
+            } while (Consume(","));
+            if (!Consume("]")) Fail("expected ']'");
+        } else if (c == '"') {
+            value.type = JsonValue::Type::kString;
+            value.text = ParseString();
+        } else if (Consume("true")) {
+            value.type = JsonValue::Type::kBool;
+            value.boolean = true;
+        } else if (Consume("false")) {
+            value.type = JsonValue::Type::kBool;
+        } else if (Consume("null")) {
+            value.type = JsonValue::Type::kNull;
+        } else {
+            const char* start = text_.c_str() + pos_;
+            char* end = nullptr;
+            value.type = JsonValue::Type::kNumber;
+            value.number = std::strtod(start, &end);
+            if (end == start) Fail("unexpected character");
+            pos_ += static_cast<size_t>(end - start);
+        }
+        return value;
+    }
+
+    std::string ParseString() {
+        if (!Consume("\"")) Fail("expected string");
+        std::string out;
+        while (pos_ < text_.size() && text_[pos_] != '"') {
+            char c = text_[pos_++];
+            if (c != '\\') {
+                out.push_back(c);
+                continue;
+            }
+            if (pos_ >= text_.size()) break;
+            char escape = text_[pos_++];
+            switch (escape) {
+                case 'n': out.push_back('\n'); break;
+                case 't': out.push_back('\t'); break;
+                case 'r': out.push_back('\r'); break;
+                case 'b': out.push_back('\b'); break;
+                case 'f': out.push_back('\f'); break;
+                case 'u':
+                    // Benchmark names are ASCII; keep the escape verbatim.
+                    out += "\\u";
+                    break;
+                default: out.push_back(escape); break;
+            }
+        }
+        if (!Consume("\"")) Fail("unterminated string");
+        return out;
+    }
+
+    const std::string& text_;
+    size_t pos_ = 0;
+};
+
+// Raw samples of every benchmark in one result file, keyed by
+// "operation/key_size"
+using BenchmarkSamples = std::map<std::string, std::vector<double>>;
+
+std::vector<double> Numbers(const JsonValue* array) {
+    std::vector<double> values;
+    if (!array) return values;
+    for (const auto& item : array->items) {
+        if (item.type == JsonValue::Type::kNumber) values.push_back(item.number);
+    }
+    return values;
+}
+
+BenchmarkSamples LoadResults(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("Cannot open " + path);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    std::string text = buffer.str();
+    JsonValue root = JsonParser(text).Parse();
+
+    BenchmarkSamples benchmarks;
+    const JsonValue* keygen = root.Find("keygen");
+    if (!keygen) throw std::runtime_error(path + " has no \"keygen\" results");
+    for (const auto& entry : keygen->items) {
+        const JsonValue* size = entry.Find("key_size");
+        if (!size) continue;
+        std::string key_size = std::to_string(static_cast<int>(size->number));
+        std::vector<double> samples = Numbers(entry.Find("samples"));
+        if (!samples.empty()) benchmarks["keygen/" + key_size] = samples;
+        const JsonValue* operations = entry.Find("operations");
+        if (!operations) continue;
+        for (const auto& operation : operations->items) {
+            const JsonValue* name = operation.Find("name");
+            std::vector<double> op_samples = Numbers(operation.Find("samples"));
+            if (name && !op_samples.empty()) {
+                benchmarks[name->text + "/" + key_size] = op_samples;
+            }
+        }
+    }
+    if (benchmarks.empty()) {
+        throw std::runtime_error(path + " has no raw samples; rerun a current rsa_analysis");
+    }
+    return benchmarks;
+}
+
+/**
+ * Parsed command-line options.
+ */
+struct Options {
+    std::vector<std::string> files;
+    double alpha = 0.05;
+    double confidence = 0.95;
+    size_t resamples = 2000;
+    double fail_above = -1.0;  // Percent slowdown that fails the run; < 0 never fails.
+};
+
+void PrintUsage(std::ostream& out) {
+    out << "Usage:\n"
+           "  rsa_compare [options] BASELINE.json CANDIDATE.json [CANDIDATE.json...]\n"
+           "\n"
+           "Compares rsa_analysis results benchmark by benchmark against the first file.\n"
+           "\n"
+           "Options:\n"
+           "  --alpha P          Significance level of the Mann-Whitney U test (default 0.05)\n"
+           "  --confidence C     Coverage of the bootstrap interval (default 0.95)\n"
+           "  --resamples N      Bootstrap resamples (default 2000)\n"
+           "  --fail-above PCT   Exit with status 1 if a significant slowdown exceeds PCT%\n"
+           "\n"
+           "A change is significant when p < alpha and the interval excludes 0%.\n";
+}
+
+double ParseNumber(const std::string& flag, const std::string& value) {
+    try {
+        size_t used = 0;
+        double parsed = std::stod(value, &used);
+        if (used == value.size()) return parsed;
+    } catch (const std::exception&) {
+    }
+    throw std::invalid_argument(flag + " expects a number, got '" + value + "'");
+}
+
+Options ParseOptions(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string flag = argv[i];
+        if (flag.rfind("--", 0) != 0) {
+            options.files.push_back(flag);
+            continue;
+        }
+        if (i + 1 >= argc) throw std::invalid_argument("Missing value for " + flag);
+        double value = ParseNumber(flag, argv[++i]);
+        if (flag == "--alpha") {
+            options.alpha = value;
+        } else if (flag == "--confidence") {
+            if (value <= 0.0 || value >= 1.0) throw std::invalid_argument("--confidence must be in (0, 1)");
+            options.confidence = value;
+        } else if (flag == "--resamples") {
+            options.resamples = static_cast<size_t>(value);
+        } else if (flag == "--fail-above") {
+            options.fail_above = value;
+        } else {
+            throw std::invalid_argument("Unknown option " + flag);
+        }
+    }
+    if (options.files.size() < 2) throw std::invalid_argument("Need a baseline and a candidate");
+    return options;
+}
+
+// Prints one comparison table; returns true if a slowdown exceeds the threshold
+bool Compare(const std::string& baseline_name, const BenchmarkSamples& baseline,
+             const std::string& candidate_name, const BenchmarkSamples& candidate,
+             const Options& options) {
+    std::cout << "\n" << candidate_name << " vs " << baseline_name << "\n";
+    std::cout << std::left << std::setw(16) << "benchmark" << std::right << std::setw(13)
+              << "baseline ms" << std::setw(13) << "candidate ms" << std::setw(10) << "change"
+              << std::setw(22) << "interval" << std::setw(10) << "p" << "  verdict\n";
+    bool failed = false;
+    for (const auto& [name, base_samples] : baseline) {
+        auto found = candidate.find(name);
+        if (found == candidate.end()) {
+            std::cout << std::left << std::setw(16) << name << std::right
+                      << "  missing from candidate\n";
+            continue;
+        }
+        const std::vector<double>& cand_samples = found->second;
+        rsa_app::MannWhitneyResult test = rsa_app::MannWhitneyU(base_samples, cand_samples);
+        rsa_app::RatioInterval ratio = rsa_app::BootstrapMedianRatio(
+            base_samples, cand_samples, options.confidence, options.resamples);
+        double change = (ratio.ratio - 1.0) * 100.0;
+        double low = (ratio.low - 1.0) * 100.0;
+        double high = (ratio.high - 1.0) * 100.0;
+        bool significant = test.p_value < options.alpha && (low > 0.0 || high < 0.0);
+        const char* verdict = !significant ? "no change" : change > 0.0 ? "REGRESSION" : "improvement";
+        if (significant && change > 0.0 && options.fail_above >= 0.0 && change > options.fail_above) {
+            failed = true;
+            verdict = "REGRESSION (over threshold)";
+        }
+
+        std::ostringstream interval;
+        interval << std::fixed << std::setprecision(1) << "[" << std::showpos << low << "%, "
+                 << high << "%]";
+        std::cout << std::left << std::setw(16) << name << std::right << std::fixed
+                  << std::setprecision(3) << std::setw(13)
+                  << rsa_app::Summarize(base_samples).p50 * 1e3 << std::setw(13)
+                  << rsa_app::Summarize(cand_samples).p50 * 1e3 << std::setw(9)
+                  << std::setprecision(1) << std::showpos << change << "%" << std::noshowpos
+                  << std::setw(22) << interval.str() << std::setw(10) << std::setprecision(4)
+                  << test.p_value << "  " << verdict << "\n";
+    }
+    for (const auto& entry : candidate) {
+        if (baseline.count(entry.first) == 0) {
+            std::cout << std::left << std::setw(16) << entry.first << std::right
+                      << "  missing from baseline\n";
+        }
+    }
+    return failed;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    try {
+        options = ParseOptions(argc, argv);
+    } catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << "\n";
+        PrintUsage(std::cerr);
+        return 2;
+    }
+
+    try {
+        BenchmarkSamples baseline = LoadResults(options.files[0]);
+        bool failed = false;
+        for (size_t i = 1; i < options.files.size(); ++i) {
+            BenchmarkSamples candidate = LoadResults(options.files[i]);
+            failed |= Compare(options.files[0], baseline, options.files[i], candidate, options);
+        }
+        if (failed) {
+            std::cerr << "\nSlowdown above " << options.fail_above << "% detected.\n";
+            return 1;
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "An error occurred: " << e.what() << "\n";
+        return 2;
+    }
+}
@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <openssl/bn.h>
+#include "bn_wrapper.h"
+#include "fixed_modexp.h"
+#include "leakage.h"
+#include "rsa.h"
+
+// dudect-style timing leakage check of the exponentiation paths: each kernel
+// is timed on a fixed input class against a random one, interleaved at
+// random, and an incremental Welch t-test decides whether the two timing
+// distributions differ. A kernel passes if no test reaches
+// rsa_app::kLeakageThreshold within the measurement budget.
+//
+// For the exponent kernels the fixed class is a low-weight exponent (top and
+// bottom bit set) of the private exponent's length and the random class is a
+// fresh exponent of that length; a kernel whose work depends on the exponent
+// bits reacts most to exactly this pair. decrypt_input keeps the key and
+// varies the ciphertext instead.
+
+using Clock = std::chrono::steady_clock;
+
+// Command-line configuration of the harness
+struct LeakageOptions {
+    std::vector<int> key_sizes = {1024, 2048};
+    std::vector<std::string> kernels = {"modexp", "decrypt", "decrypt_input", "fixed"};
+    uint64_t measurements = 1000000;  // Per kernel and key size
+    double max_seconds = 60.0;        // Per kernel and key size; 0 means no limit
+    size_t calibration = 1000;        // Samples that set the crop thresholds
+    size_t batch = 1000;              // Inputs prepared ahead of each timed batch
+    uint64_t seed = 1;
+};
+
+// One kernel under test: times a call on the input of a class
+struct Kernel {
+    std::string name;
+    // Prepares one input per entry of `classes`, then times each call into `cycles`
+    std::function<void(const std::vector<int>& classes, std::vector<uint64_t>& cycles)> run;
+};
+
+std::vector<int> ParseSizes(const std::string& list) {
+    std::vector<int> sizes;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) sizes.push_back(std::stoi(item));
+    return sizes;
+}
+
+std::vector<std::string> ParseNames(const std::string& list) {
+    std::vector<std::string> names;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) names.push_back(item);
+    return names;
+}
+
+// An exponent of `bits` bits: low weight for the fixed class, random otherwise
+BigNumber MakeExponent(int cls, int bits) {
+    BigNumber exponent;
+    if (cls == 0) {
+        BN_set_bit(exponent.Get(), bits - 1);
+        BN_set_bit(exponent.Get(), 0);
+    } else if (BN_rand(exponent.Get(), bits, BN_RAND_TOP_ONE, BN_RAND_BOTTOM_ODD) != 1) {
+        throw std::runtime_error("BN_rand failed");
+    }
+    return exponent;
+}
+
+BigNumber RandomBelow(const BigNumber& modulus) {
+    BigNumber value;
+    if (BN_rand_range(value.Get(), modulus.Get()) != 1) {
+        throw std::runtime_error("BN_rand_range failed");
+    }
+    return value;
+}
+
+// Times `call(i)` for every prepared input i
+template <typename Call>
+void TimeEach(size_t count, std::vector<uint64_t>& cycles, Call call) {
+    cycles.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t start = rsa_app::ReadCycleCounter();
+        call(i);
+        cycles[i] = rsa_app::ReadCycleCounter() - start;
+    }
+}
+
+// Builds the kernels selected by `names` for one key; unknown names throw
+std::vector<Kernel> MakeKernels(const std::vector<std::string>& names,
+                                const rsa_app::KeyPair& key) {
+    const BigNumber& n = key.private_key.n;
+    int exponent_bits = key.private_key.d.NumBits();
+    // The exponent kernels share one base; decrypt_input's fixed class is
+    // one ciphertext.
+    auto base = std::make_shared<BigNumber>(RandomBelow(n));
+    auto fixed_ciphertext = std::make_shared<BigNumber>(RandomBelow(n));
+
+    auto exponent_kernel = [exponent_bits](
+                               std::function<void(const BigNumber& exponent)> exponentiate) {
+        return [exponent_bits, exponentiate](const std::vector<int>& classes,
+                                             std::vector<uint64_t>& cycles) {
+            std::vector<BigNumber> exponents;
+            exponents.reserve(classes.size());
+            for (int cls : classes) exponents.push_back(MakeExponent(cls, exponent_bits));
+            TimeEach(classes.size(), cycles, [&](size_t i) { exponentiate(exponents[i]); });
+        };
+    };
+
+    std::vector<Kernel> kernels;
+    for (const auto& name : names) {
+        if (name == "modexp") {
+            kernels.push_back({name, exponent_kernel([&n, base](const BigNumber& exponent) {
+                                   base->ModExp(exponent.Get(), n.Get());
+                               })});
+        } else if (name == "decrypt") {
+            kernels.push_back({name, exponent_kernel([&n, base](const BigNumber& exponent) {
+                                   rsa_app::PrivateKey trial{n.Copy(), exponent.Copy()};
+                                   rsa_app::Decrypt(*base, trial);
+                               })});
+        } else if (name == "decrypt_input") {
+            kernels.push_back({name, [&key, fixed_ciphertext](const std::vector<int>& classes,
+                                                              std::vector<uint64_t>& cycles) {
+                                   std::vector<BigNumber> inputs;
+                                   inputs.reserve(classes.size());
+                                   for (int cls : classes) {
+                                       inputs.push_back(cls == 0 ? fixed_ciphertext->Copy()
+                                                                 : RandomBelow(key.private_key.n));
+                                   }
+                                   TimeEach(classes.size(), cycles, [&](size_t i) {
+                                       rsa_app::Decrypt(inputs[i], key.private_key);
+                                   });
+                               }});
+        } else if (name == "fixed") {
+            // One entry per row kernel the CPU runs; sizes without a
+            // fixed-size engine have nothing to test.
+            if (!rsa_app::FixedModExpSupports(n.Get())) continue;
+            for (rsa_app::FixedKernel row : {rsa_app::FixedKernel::kPortable,
+                                             rsa_app::FixedKernel::kMulxAdx}) {
+                if (!rsa_app::FixedKernelSupported(row)) continue;
+                kernels.push_back(
+                    {std::string("fixed_") + rsa_app::FixedKernelName(row),
+                     exponent_kernel([&n, base, row](const BigNumber& exponent) {
+                         rsa_app::FixedModExp(base->Get(), exponent.Get(), n.Get(), row);
+                     })});
+            }
+        } else {
+            throw std::invalid_argument("Unknown kernel " + name);
+        }
+    }
+    return kernels;
+}
+
+// Measures one kernel until the budget runs out or the leak is beyond doubt
+rsa_app::LeakageResult RunKernel(const Kernel& kernel, const LeakageOptions& options,
+                                 std::mt19937_64& rng, std::string& worst_test) {
+    rsa_app::LeakageTest test(options.calibration);
+    std::vector<int> classes(options.batch);
+    std::vector<uint64_t> cycles;
+    auto start = Clock::now();
+    uint64_t done = 0;
+    while (done < options.measurements) {
+        size_t count = static_cast<size_t>(
+            std::min<uint64_t>(options.batch, options.measurements - done));
+        classes.resize(count);
+        for (int& cls : classes) cls = static_cast<int>(rng() & 1);
+        kernel.run(classes, cycles);
+        for (size_t i = 0; i < count; ++i) test.Push(classes[i], cycles[i]);
+        done += count;
+
+        std::chrono::duration<double> elapsed = Clock::now() - start;
+        if (options.max_seconds > 0.0 && elapsed.count() >= options.max_seconds) break;
+        if (test.Result().max_t > 10.0 * rsa_app::kLeakageThreshold) break;
+    }
+    rsa_app::LeakageResult result = test.Result();
+    worst_test = result.worst_test >= 0 ? test.TestName(result.worst_test) : "-";
+    return result;
+}
+
+int main(int argc, char** argv) {
+    LeakageOptions options;
+    for (int i = 1; i < argc; i += 2) {
+        std::string flag = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << flag << "\n";
+            return 2;
+        }
+        std::string value = argv[i + 1];
+        if (flag == "--sizes") {
+            options.key_sizes = ParseSizes(value);
+        } else if (flag == "--kernels") {
+            options.kernels = ParseNames(value);
+        } else if (flag == "--measurements") {
+            options.measurements = std::stoull(value);
+        } else if (flag == "--max-seconds") {
+            options.max_seconds = std::stod(value);
+        } else if (flag == "--calibration") {
+            options.calibration = std::stoul(value);
+        } else if (flag == "--batch") {
+            options.batch = std::stoul(value);
+        } else if (flag == "--seed") {
+            options.seed = std::stoull(value);
+        } else {
+            std::cerr << "Unknown option " << flag
+                      << " (supported: --sizes a,b,c, --kernels modexp,decrypt,decrypt_input,"
+                         "fixed, --measurements N, --max-seconds S, --calibration N,"
+                         " --batch N, --seed N)\n";
+            return 2;
+        }
+    }
+    if (options.calibration == 0 || options.batch == 0) {
+        std::cerr << "--calibration and --batch must be positive\n";
+        return 2;
+    }
+
+    std::mt19937_64 rng(options.seed);
+    std::cout << "Timing leakage, fixed vs random class, timer " << rsa_app::CycleCounterName()
+              << ", leak if |t| > " << rsa_app::kLeakageThreshold << "\n\n";
+    std::cout << std::left << std::setw(20) << "kernel" << std::right << std::setw(6) << "bits"
+              << std::setw(14) << "measurements" << std::setw(10) << "max |t|" << std::setw(10)
+              << "tau" << "  " << std::left << std::setw(16) << "worst test" << "verdict\n";
+    int leaking = 0;
+    try {
+        for (int bits : options.key_sizes) {
+            rsa_app::KeyPair key = rsa_app::GenerateKeyPair(bits);
+            for (const Kernel& kernel : MakeKernels(options.kernels, key)) {
+                std::string worst_test;
+                rsa_app::LeakageResult result = RunKernel(kernel, options, rng, worst_test);
+                bool calibrated = result.worst_test >= 0;
+                const char* verdict = !calibrated ? "TOO FEW SAMPLES"
+                                      : result.leaks ? "FAIL (leaks)"
+                                                     : "PASS";
+                leaking += result.leaks ? 1 : 0;
+                std::cout << std::left << std::setw(20) << kernel.name << std::right
+                          << std::setw(6) << bits << std::setw(14) << result.measurements
+                          << std::setw(10) << std::fixed << std::setprecision(2) << result.max_t
+                          << std::setw(10) << std::setprecision(5) << result.max_tau << "  "
+                          << std::left << std::setw(16) << worst_test << verdict << std::endl;
+            }
+        }
+    } catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << "\n";
+        return 2;
+    } catch (const std::exception& e) {
+        std::cerr << "An error occurred: " << e.what() << "\n";
+        return 1;
+    }
+    std::cout << "\n" << leaking << " kernel/size pair(s) leak timing\n";
+    return 0;
+}
@@ -3,91 +3,499 @@
 #include <chrono>
 #include <vector>
 #include <sstream>
+#include <string>
 #include <iomanip> // For JSON formatting
 #include <fstream> // For writing JSON to file
+#include <memory>
+#include "key_table.h"
+#include "perf_counters.h"
 #include "rsa.h"   // Include your updated RSA library
+#include "stats.h"
+#include "thread_pool.h"
+#include "trace.h"
 
-// Function to compute the median of a vector
-double ComputeMedian(std::vector<double>& runtimes) {
-    std::sort(runtimes.begin(), runtimes.end());
-    size_t size = runtimes.size();
-    if (size % 2 == 0) {
-        return (runtimes[size / 2 - 1] + runtimes[size / 2]) / 2.0; // Average of middle two
+// 1, 2, 4, ... up to the number of hardware threads, which is always last
+std::vector<int> DefaultPrimeThreads() {
+    int hardware = static_cast<int>(rsa_app::ThreadPool::DefaultThreadCount());
+    std::vector<int> threads;
+    for (int count = 1; count < hardware; count *= 2) threads.push_back(count);
+    threads.push_back(hardware);
+    return threads;
+}
+
+// Command-line configuration of the analysis
+struct AnalysisOptions {
+    // Key sizes as powers of 2 (from 512 to 16,384 bits)
+    std::vector<int> key_sizes = {512, 1024, 2048, 4096, 8192, 16384};
+    int num_trials = 10; // Run each key size 10 times
+    size_t histogram_bins = 10;
+    std::string output_path = "rsa_runtime.json";
+    // Thread counts for the parallel prime search; empty skips it
+    std::vector<int> prime_threads = DefaultPrimeThreads();
+    uint64_t prime_seed = 1;
+    // Hardware counters around every measured operation
+    bool perf_counters = true;
+    // Encryptions and decryptions timed per key size
+    int op_iterations = 10;
+    // Chrome trace of the whole run; empty disables tracing
+    std::string trace_path;
+};
+
+// Wall time and counters of repeated runs of one operation
+struct OperationResult {
+    std::string name;
+    std::vector<double> seconds;
+    std::vector<rsa_app::PerfSample> counters;
+};
+
+// All measurements for one key size
+struct KeySizeResult {
+    int key_size = 0;
+    int failures = 0;
+    std::vector<rsa_app::KeyGenStats> trials; // Successful trials only
+    std::vector<rsa_app::PerfSample> counters; // One per successful trial
+    std::vector<OperationResult> operations;  // Encrypt and decrypt with the first key
+    // Memory of the first generated key as a KeyPair and in a KeyTable
+    size_t keypair_bytes = 0;
+    rsa_app::KeyStorageFootprint table;
+    bool private_locked = false;
+};
+
+// One seeded parallel prime search per thread count, for bits / 2 primes
+struct PrimeScalingResult {
+    int prime_bits = 0;
+    std::vector<rsa_app::ParallelPrimeStats> runs;
+    std::vector<bool> same_prime; // Prime equals the one of the first run
+};
+
+// Extracts one per-trial metric as a sample vector
+template <typename Getter>
+std::vector<double> Collect(const KeySizeResult& result, Getter getter) {
+    std::vector<double> values;
+    for (const auto& trial : result.trials) values.push_back(static_cast<double>(getter(trial)));
+    return values;
+}
+
+void WriteSamples(std::ostream& out, const std::vector<double>& samples) {
+    out << "[";
+    for (size_t i = 0; i < samples.size(); ++i) {
+        out << (i ? ", " : "") << samples[i];
+    }
+    out << "]";
+}
+
+void WriteSummary(std::ostream& out, const std::vector<double>& samples) {
+    rsa_app::SampleSummary s = rsa_app::Summarize(samples);
+    out << "{ \"count\": " << s.count << ", \"min\": " << s.min << ", \"mean\": " << s.mean
+        << ", \"stddev\": " << s.stddev << ", \"p50\": " << s.p50 << ", \"p90\": " << s.p90
+        << ", \"p95\": " << s.p95 << ", \"p99\": " << s.p99 << ", \"max\": " << s.max << " }";
+}
+
+void WriteHistogram(std::ostream& out, const std::vector<double>& samples, size_t bins) {
+    rsa_app::Histogram histogram = rsa_app::BuildHistogram(samples, bins);
+    out << "{ \"min\": " << histogram.min << ", \"bin_width\": " << histogram.bin_width
+        << ", \"counts\": [";
+    for (size_t i = 0; i < histogram.counts.size(); ++i) {
+        out << (i ? ", " : "") << histogram.counts[i];
+    }
+    out << "] }";
+}
+
+void WriteCdf(std::ostream& out, const std::vector<double>& samples) {
+    auto cdf = rsa_app::EmpiricalCdf(samples);
+    out << "[";
+    for (size_t i = 0; i < cdf.size(); ++i) {
+        out << (i ? ", " : "") << "[" << cdf[i].first << ", " << cdf[i].second << "]";
+    }
+    out << "]";
+}
+
+void WritePrimeSearch(std::ostream& out, const KeySizeResult& result,
+                      rsa_app::PrimeSearchStats rsa_app::KeyGenStats::*search) {
+    out << "{\n          \"seconds\": ";
+    WriteSummary(out, Collect(result, [&](const auto& t) { return (t.*search).seconds; }));
+    out << ",\n          \"candidates\": ";
+    WriteSummary(out, Collect(result, [&](const auto& t) { return (t.*search).candidates; }));
+    out << ",\n          \"rejected\": ";
+    WriteSummary(out, Collect(result, [&](const auto& t) { return (t.*search).rejected; }));
+    out << ",\n          \"mr_rounds\": ";
+    WriteSummary(out, Collect(result, [&](const auto& t) { return (t.*search).mr_rounds; }));
+    out << "\n        }";
+}
+
+void WriteFit(std::ostream& out, const std::vector<double>& x, const std::vector<double>& y) {
+    rsa_app::PowerLawFit power = rsa_app::FitPowerLaw(x, y);
+    // Schoolbook prime generation is expected to grow with the 4th power of
+    // the key size: O(k) candidates times an O(k^3) primality test.
+    rsa_app::PowerLawFit quartic = rsa_app::FitFixedExponent(x, y, 4.0);
+    out << "{ \"power_law\": { \"coefficient\": " << std::scientific << power.coefficient
+        << ", \"exponent\": " << std::fixed << power.exponent
+        << ", \"r_squared\": " << power.r_squared << " }, \"quartic\": { \"coefficient\": "
+        << std::scientific << quartic.coefficient << std::fixed
+        << ", \"r_squared\": " << quartic.r_squared << " } }";
+}
+
+void WriteJsonString(std::ostream& out, const std::string& text) {
+    out << "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') out << '\\';
+        out << c;
+    }
+    out << "\"";
+}
+
+// Median per-operation count of every event and the median IPC; events the
+// CPU did not count are null
+void WriteCounters(std::ostream& out, const std::vector<rsa_app::PerfSample>& samples,
+                   const rsa_app::PerfCounters* counters) {
+    bool available = counters && counters->Available() && !samples.empty();
+    out << "{ \"available\": " << (available ? "true" : "false");
+    if (!counters || !counters->UnavailableReason().empty()) {
+        out << ", \"reason\": ";
+        WriteJsonString(out, counters ? counters->UnavailableReason() : "disabled");
+    }
+    if (!available) {
+        out << " }";
+        return;
+    }
+    out << ", \"per_op\": { ";
+    for (size_t e = 0; e < rsa_app::kPerfEventCount; ++e) {
+        auto event = static_cast<rsa_app::PerfEvent>(e);
+        std::vector<double> values;
+        for (const auto& sample : samples) {
+            if (sample.Has(event)) values.push_back(static_cast<double>(sample.Get(event)));
+        }
+        out << (e ? ", " : "") << "\"" << rsa_app::PerfEventName(event) << "\": ";
+        if (values.empty()) {
+            out << "null";
+        } else {
+            out << rsa_app::Summarize(values).p50;
+        }
+    }
+    std::vector<double> ipc;
+    for (const auto& sample : samples) {
+        if (sample.Ipc() > 0.0) ipc.push_back(sample.Ipc());
+    }
+    out << " }, \"ipc\": ";
+    if (ipc.empty()) {
+        out << "null";
     } else {
-        return runtimes[size / 2]; // Middle element
+        out << rsa_app::Summarize(ipc).p50;
     }
+    out << " }";
 }
 
-// RSA runtime analysis function
-void AnalyzeTimeComplexity() {
-    // Define the key sizes as powers of 2 (from 512 to 16,384 bits)
-    std::vector<int> key_sizes = {512, 1024, 2048, 4096, 8192, 16384};
+// Times `iterations` runs of `op`, with counters around each run
+template <typename Op>
+OperationResult MeasureOperation(const std::string& name, int iterations,
+                                 rsa_app::PerfCounters* counters, Op op) {
+    OperationResult result;
+    result.name = name;
+    for (int i = 0; i < iterations; ++i) {
+        if (counters) counters->Start();
+        auto start = std::chrono::steady_clock::now();
+        op();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (counters) result.counters.push_back(counters->Stop());
+        result.seconds.push_back(elapsed.count());
+    }
+    return result;
+}
+
+// Runs the seeded search for every thread count; the 1-thread run goes first
+PrimeScalingResult MeasurePrimeScaling(int key_size, const AnalysisOptions& options) {
+    PrimeScalingResult result;
+    result.prime_bits = key_size / 2;
+    std::vector<int> threads = options.prime_threads;
+    threads.erase(std::remove(threads.begin(), threads.end(), 1), threads.end());
+    threads.insert(threads.begin(), 1);
+
+    BigNumber first;
+    for (int count : threads) {
+        std::cout << "Parallel prime search: " << result.prime_bits << " bits, " << count
+                  << " thread(s)...\n";
+        rsa_app::ParallelPrimeOptions search;
+        search.threads = static_cast<size_t>(count);
+        search.seed = options.prime_seed;
+        rsa_app::ParallelPrimeStats stats;
+        BigNumber prime = rsa_app::GeneratePrimeParallel(result.prime_bits, search, &stats);
+        if (result.runs.empty()) first = prime.Copy();
+        result.same_prime.push_back(BN_cmp(prime.Get(), first.Get()) == 0);
+        result.runs.push_back(stats);
+    }
+    return result;
+}
+
+void WritePrimeScaling(std::ostream& out, const std::vector<PrimeScalingResult>& results,
+                       uint64_t seed) {
+    out << "{\n    \"seed\": " << seed << ",\n    \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const PrimeScalingResult& result = results[i];
+        double baseline = result.runs.front().seconds;
+        out << (i ? "," : "") << "\n      {\n        \"prime_bits\": " << result.prime_bits
+            << ",\n        \"runs\": [";
+        for (size_t j = 0; j < result.runs.size(); ++j) {
+            const rsa_app::ParallelPrimeStats& run = result.runs[j];
+            double speedup = run.seconds > 0.0 ? baseline / run.seconds : 0.0;
+            out << (j ? "," : "") << "\n          { \"threads\": " << run.threads
+                << ", \"seconds\": " << run.seconds << ", \"speedup\": " << speedup
+                << ", \"efficiency\": " << speedup / static_cast<double>(run.threads)
+                << ", \"windows\": " << run.windows
+                << ", \"winning_window\": " << run.winning_window
+                << ", \"candidates\": " << run.candidates
+                << ", \"mr_rounds\": " << run.mr_rounds
+                << ", \"same_prime\": " << (result.same_prime[j] ? "true" : "false") << " }";
+        }
+        out << "\n        ]\n      }";
+    }
+    out << "\n    ]\n  }";
+}
 
-    // Store runtime results for each key size
-    std::vector<double> medians;
+// Parses "512,1024,2048" into key sizes
+std::vector<int> ParseKeySizes(const std::string& list) {
+    std::vector<int> sizes;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) sizes.push_back(std::stoi(item));
+    return sizes;
+}
+
+// RSA runtime analysis function
+void AnalyzeTimeComplexity(const AnalysisOptions& options) {
+    std::vector<KeySizeResult> results;
+    std::unique_ptr<rsa_app::PerfCounters> counters;
+    if (options.perf_counters) {
+        counters = std::make_unique<rsa_app::PerfCounters>();
+        if (!counters->UnavailableReason().empty()) {
+            std::cerr << "Hardware counters: " << counters->UnavailableReason() << "\n";
+        }
+    }
 
     // Measure runtime for each key size
-    for (int bits : key_sizes) {
+    for (int bits : options.key_sizes) {
         std::cout << "Measuring for " << bits << " bits...\n";
-        int num_trials = 10; // Run each key size 10 times
-        std::vector<double> runtimes;
-
-        for (int trial = 0; trial < num_trials; ++trial) {
-            auto start = std::chrono::high_resolution_clock::now();
+        KeySizeResult result;
+        result.key_size = bits;
 
+        std::unique_ptr<rsa_app::KeyPair> first_key;
+        for (int trial = 0; trial < options.num_trials; ++trial) {
+            rsa_app::KeyGenStats stats;
+            rsa_app::PerfSample sample;
             try {
-                // Generate RSA key pair using the updated function
-                auto key_pair = rsa_app::GenerateKeyPair(bits);
+                // Generate RSA key pair, recording every phase
+                if (counters) counters->Start();
+                auto key_pair = rsa_app::GenerateKeyPair(bits, &stats);
+                if (counters) sample = counters->Stop();
+                if (result.keypair_bytes == 0) {
+                    rsa_app::KeyTable table(bits);
+                    table.Add(key_pair);
+                    result.keypair_bytes = rsa_app::KeyPairBytes(key_pair);
+                    result.table = table.Footprint();
+                    result.private_locked = table.PrivateLocked();
+                }
+                if (!first_key) first_key = std::make_unique<rsa_app::KeyPair>(std::move(key_pair));
             } catch (const std::exception& e) {
                 std::cerr << "Failed to generate keys for " << bits << " bits: " << e.what() << std::endl;
-                runtimes.push_back(-1.0); // Mark a failed run
+                ++result.failures; // Mark a failed run
                 continue;
             }
+            result.trials.push_back(stats);
+            if (counters) result.counters.push_back(sample);
+        }
 
-            auto end = std::chrono::high_resolution_clock::now();
-            std::chrono::duration<double> elapsed = end - start;
-            runtimes.push_back(elapsed.count()); // Record runtime
+        // Public and private exponentiation with the first key
+        if (first_key && options.op_iterations > 0) {
+            BigNumber message = rsa_app::StringToNumber("runtime analysis");
+            BigNumber ciphertext = rsa_app::Encrypt(message, first_key->public_key);
+            result.operations.push_back(
+                MeasureOperation("encrypt", options.op_iterations, counters.get(),
+                                 [&] { rsa_app::Encrypt(message, first_key->public_key); }));
+            result.operations.push_back(
+                MeasureOperation("decrypt", options.op_iterations, counters.get(),
+                                 [&] { rsa_app::Decrypt(ciphertext, first_key->private_key); }));
         }
+        results.push_back(std::move(result));
+    }
 
-        // Compute the median runtime
-        if (!runtimes.empty() && *std::max_element(runtimes.begin(), runtimes.end()) > 0) {
-            medians.push_back(ComputeMedian(runtimes));
-        } else {
-            medians.push_back(-1.0); // Use -1.0 if all runs failed
+    // Speedup of the seeded parallel prime search per thread count
+    std::vector<PrimeScalingResult> prime_scaling;
+    if (!options.prime_threads.empty()) {
+        for (int bits : options.key_sizes) {
+            prime_scaling.push_back(MeasurePrimeScaling(bits, options));
         }
     }
 
     // Generate JSON results and write them to a file
     std::ostringstream json_output;
+    json_output << std::fixed << std::setprecision(9);
     json_output << "{\n  \"time_complexity\": [\n";
 
-    for (size_t i = 0; i < key_sizes.size(); ++i) {
-        json_output << "    { \"key_size\": " << key_sizes[i]
-                    << ", \"median_runtime\": " << std::fixed << std::setprecision(6) << medians[i] << " }";
-        if (i != key_sizes.size() - 1) {
+    for (size_t i = 0; i < results.size(); ++i) {
+        std::vector<double> totals =
+            Collect(results[i], [](const auto& t) { return t.total_seconds; });
+        // Use -1.0 if all runs failed
+        double median = totals.empty() ? -1.0 : rsa_app::Summarize(totals).p50;
+        json_output << "    { \"key_size\": " << results[i].key_size
+                    << ", \"median_runtime\": " << median << " }";
+        if (i != results.size() - 1) {
             json_output << ",\n";
         }
     }
 
-    json_output << "\n  ]\n}";
+    json_output << "\n  ],\n  \"keygen\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const KeySizeResult& result = results[i];
+        std::vector<double> totals = Collect(result, [](const auto& t) { return t.total_seconds; });
+        json_output << "    {\n      \"key_size\": " << result.key_size
+                    << ",\n      \"trials\": " << options.num_trials
+                    << ",\n      \"failures\": " << result.failures
+                    << ",\n      \"samples\": ";
+        WriteSamples(json_output, totals);
+        json_output << ",\n      \"summary\": ";
+        WriteSummary(json_output, totals);
+        json_output << ",\n      \"histogram\": ";
+        WriteHistogram(json_output, totals, options.histogram_bins);
+        json_output << ",\n      \"cdf\": ";
+        WriteCdf(json_output, totals);
+        json_output << ",\n      \"phases\": {\n        \"p_search\": ";
+        WritePrimeSearch(json_output, result, &rsa_app::KeyGenStats::p_search);
+        json_output << ",\n        \"q_search\": ";
+        WritePrimeSearch(json_output, result, &rsa_app::KeyGenStats::q_search);
+        json_output << ",\n        \"multiply\": { \"seconds\": ";
+        WriteSummary(json_output, Collect(result, [](const auto& t) { return t.multiply_seconds; }));
+        json_output << " },\n        \"gcd\": { \"seconds\": ";
+        WriteSummary(json_output, Collect(result, [](const auto& t) { return t.gcd_seconds; }));
+        json_output << " },\n        \"inverse\": { \"seconds\": ";
+        WriteSummary(json_output, Collect(result, [](const auto& t) { return t.inverse_seconds; }));
+        json_output << " }\n      },\n      \"key_storage\": { \"keypair_bytes_per_key\": "
+                    << result.keypair_bytes << ", \"table_bytes_per_key\": "
+                    << result.table.bytes_per_key << ", \"table_public_bytes\": "
+                    << result.table.public_bytes << ", \"table_private_bytes\": "
+                    << result.table.private_bytes << ", \"private_locked\": "
+                    << (result.private_locked ? "true" : "false") << " },\n      \"counters\": ";
+        WriteCounters(json_output, result.counters, counters.get());
+        json_output << ",\n      \"operations\": [";
+        for (size_t j = 0; j < result.operations.size(); ++j) {
+            const OperationResult& operation = result.operations[j];
+            json_output << (j ? "," : "") << "\n        { \"name\": \"" << operation.name
+                        << "\", \"iterations\": " << operation.seconds.size()
+                        << ",\n          \"samples\": ";
+            WriteSamples(json_output, operation.seconds);
+            json_output << ",\n          \"seconds\": ";
+            WriteSummary(json_output, operation.seconds);
+            json_output << ",\n          \"counters\": ";
+            WriteCounters(json_output, operation.counters, counters.get());
+            json_output << " }";
+        }
+        json_output << (result.operations.empty() ? "]" : "\n      ]") << "\n    }";
+        if (i != results.size() - 1) {
+            json_output << ",\n";
+        }
+    }
+
+    // Fit median cost per phase against the key size
+    std::vector<double> sizes;
+    std::vector<double> total, p_search, q_search, multiply, inverse, candidates;
+    for (const auto& result : results) {
+        if (result.trials.empty()) continue;
+        sizes.push_back(result.key_size);
+        auto median = [&](auto getter) { return rsa_app::Summarize(Collect(result, getter)).p50; };
+        total.push_back(median([](const auto& t) { return t.total_seconds; }));
+        p_search.push_back(median([](const auto& t) { return t.p_search.seconds; }));
+        q_search.push_back(median([](const auto& t) { return t.q_search.seconds; }));
+        multiply.push_back(median([](const auto& t) { return t.multiply_seconds; }));
+        inverse.push_back(median([](const auto& t) { return t.inverse_seconds; }));
+        candidates.push_back(median([](const auto& t) {
+            return t.p_search.candidates + t.q_search.candidates;
+        }));
+    }
+    json_output << "\n  ],\n  \"fits\": {\n    \"total_seconds\": ";
+    WriteFit(json_output, sizes, total);
+    json_output << ",\n    \"p_search_seconds\": ";
+    WriteFit(json_output, sizes, p_search);
+    json_output << ",\n    \"q_search_seconds\": ";
+    WriteFit(json_output, sizes, q_search);
+    json_output << ",\n    \"multiply_seconds\": ";
+    WriteFit(json_output, sizes, multiply);
+    json_output << ",\n    \"inverse_seconds\": ";
+    WriteFit(json_output, sizes, inverse);
+    json_output << ",\n    \"candidates\": ";
+    WriteFit(json_output, sizes, candidates);
+    json_output << "\n  }";
+    if (!prime_scaling.empty()) {
+        json_output << ",\n  \"parallel_prime_search\": ";
+        WritePrimeScaling(json_output, prime_scaling, options.prime_seed);
+    }
+    json_output << "\n}";
 
     // Print results to console
     std::cout << json_output.str() << std::endl;
 
     // Save to a file
-    std::ofstream file("rsa_runtime.json");
+    std::ofstream file(options.output_path);
     if (file.is_open()) {
         file << json_output.str();
         file.close();
-        std::cout << "\nJSON file successfully written to rsa_runtime.json\n";
+        std::cout << "\nJSON file successfully written to " << options.output_path << "\n";
     } else {
         std::cerr << "\nFailed to write JSON file.\n";
     }
 }
 
-int main() {
+int main(int argc, char** argv) {
+    AnalysisOptions options;
+    for (int i = 1; i < argc; i += 2) {
+        std::string flag = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << flag << "\n";
+            return 2;
+        }
+        std::string value = argv[i + 1];
+        if (flag == "--trials") {
+            options.num_trials = std::max(1, std::stoi(value));
+        } else if (flag == "--sizes") {
+            options.key_sizes = ParseKeySizes(value);
+        } else if (flag == "--bins") {
+            options.histogram_bins = static_cast<size_t>(std::max(1, std::stoi(value)));
+        } else if (flag == "--output") {
+            options.output_path = value;
+        } else if (flag == "--prime-threads") {
+            // "0" disables the parallel prime search
+            options.prime_threads.clear();
+            for (int count : ParseKeySizes(value)) {
+                if (count > 0) options.prime_threads.push_back(count);
+            }
+        } else if (flag == "--prime-seed") {
+            options.prime_seed = std::stoull(value);
+        } else if (flag == "--perf-counters") {
+            if (value != "on" && value != "off") {
+                std::cerr << "--perf-counters expects 'on' or 'off'\n";
+                return 2;
+            }
+            options.perf_counters = value == "on";
+        } else if (flag == "--op-iterations") {
+            options.op_iterations = std::max(0, std::stoi(value));
+        } else if (flag == "--trace") {
+            options.trace_path = value;
+        } else {
+            std::cerr << "Unknown option " << flag
+                      << " (supported: --trials N, --sizes a,b,c, --bins N, --output FILE,"
+                      << " --prime-threads a,b,c, --prime-seed N, --perf-counters on|off,"
+                      << " --op-iterations N, --trace FILE)\n";
+            return 2;
+        }
+    }
+
     std::cout << "Starting RSA runtime analysis...\n";
-    AnalyzeTimeComplexity();
+    if (!options.trace_path.empty()) rsa_app::StartTracing();
+    AnalyzeTimeComplexity(options);
+    if (!options.trace_path.empty()) {
+        rsa_app::StopTracing();
+        rsa_app::WriteTrace(options.trace_path);
+        rsa_app::TraceSummary summary = rsa_app::SummarizeTrace();
+        std::cout << "Trace of " << summary.spans << " spans written to " << options.trace_path
+                  << "\n";
+    }
     std::cout << "Analysis complete.\n";
     return 0;
-}
\ No newline at end of file
+}
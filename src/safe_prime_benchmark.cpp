@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "bn_wrapper.h"
+#include "prime_search.h"
+#include "thread_pool.h"
+
+// Safe-prime generation: OpenSSL's BN_generate_prime_ex(safe = 1), as
+// wrapped by BigNumber::GenerateSafePrime, against the double-sieving
+// parallel engine.
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<int> ParseSizes(const std::string& text) {
+    std::vector<int> sizes;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) sizes.push_back(std::stoi(item));
+    return sizes;
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> sizes = {1024, 2048, 3072};
+    int trials = 3;
+    size_t threads = 0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--sizes") {
+            sizes = ParseSizes(argv[i + 1]);
+        } else if (flag == "--trials") {
+            trials = std::max(1, std::stoi(argv[i + 1]));
+        } else if (flag == "--threads") {
+            threads = std::stoul(argv[i + 1]);
+        } else {
+            std::cerr << "Unknown option " << flag
+                      << " (supported: --sizes a,b,c, --trials N, --threads N)\n";
+            return 2;
+        }
+    }
+    if (threads == 0) threads = rsa_app::ThreadPool::DefaultThreadCount();
+
+    std::cout << "Safe-prime generation, mean of " << trials << " primes, engine on " << threads
+              << " threads\n";
+    std::cout << std::setw(6) << "bits" << std::setw(12) << "openssl s" << std::setw(12)
+              << "engine s" << std::setw(10) << "speedup" << std::setw(12) << "sieved q"
+              << std::setw(10) << "fermat" << std::setw(13) << "pocklington" << std::setw(6)
+              << "mr" << "\n";
+    for (int bits : sizes) {
+        double openssl_seconds = 0.0;
+        for (int trial = 0; trial < trials; ++trial) {
+            BigNumber prime;
+            auto start = Clock::now();
+            prime.GenerateSafePrime(bits);
+            openssl_seconds += std::chrono::duration<double>(Clock::now() - start).count();
+        }
+
+        rsa_app::ParallelPrimeOptions options;
+        options.threads = threads;
+        rsa_app::SafePrimeStats total;
+        double engine_seconds = 0.0;
+        for (int trial = 0; trial < trials; ++trial) {
+            rsa_app::SafePrimeStats stats;
+            rsa_app::GenerateSafePrimeParallel(bits, options, &stats);
+            engine_seconds += stats.seconds;
+            total.candidates += stats.candidates;
+            total.fermat_rejected += stats.fermat_rejected;
+            total.pocklington_rejected += stats.pocklington_rejected;
+            total.mr_rejected += stats.mr_rejected;
+        }
+
+        std::cout << std::setw(6) << bits << std::fixed << std::setprecision(2) << std::setw(12)
+                  << openssl_seconds / trials << std::setw(12) << engine_seconds / trials
+                  << std::setw(9) << openssl_seconds / engine_seconds << "x" << std::setw(12)
+                  << total.candidates / trials << std::setw(10) << total.fermat_rejected / trials
+                  << std::setw(13) << total.pocklington_rejected / trials << std::setw(6)
+                  << total.mr_rejected / trials << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,204 @@
+#include "scheduler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "drbg.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+namespace rsa_app {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// The scheduler and class of the task running on this thread.
+struct CurrentTask {
+  const Scheduler* scheduler = nullptr;
+  size_t priority = kTaskPriorityCount;
+};
+
+thread_local CurrentTask current_task;
+
+}  // namespace
+
+const char* TaskPriorityName(TaskPriority priority) {
+  switch (priority) {
+    case TaskPriority::kInteractive:
+      return "interactive";
+    case TaskPriority::kBatch:
+      return "batch";
+    case TaskPriority::kBackground:
+      return "background";
+  }
+  return "unknown";
+}
+
+Scheduler::Scheduler(const SchedulerOptions& options)
+    : latency_samples_(options.latency_samples) {
+  if (latency_samples_ == 0) {
+    throw std::invalid_argument("Scheduler needs room for at least one latency sample");
+  }
+  for (size_t i = 0; i < kTaskPriorityCount; ++i) {
+    classes_[i].limit = options.max_running[i];
+  }
+  size_t threads = options.threads ? options.threads : ThreadPool::DefaultThreadCount();
+  workers_.reserve(threads);
+  for (size_t i = 0; i < threads; ++i) {
+    workers_.emplace_back([this] { WorkerLoop(); });
+  }
+}
+
+Scheduler::~Scheduler() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    all_done_.wait(lock, [this] { return active_ == 0 && PickClass(kTaskPriorityCount) < 0; });
+    stopping_ = true;
+  }
+  task_ready_.notify_all();
+  for (std::thread& worker : workers_) worker.join();
+}
+
+std::future<KeyPair> Scheduler::SubmitKeyGeneration(int bits, TaskPriority priority) {
+  return Submit(priority, [this, bits] {
+    return GenerateKeyPair(bits, ThreadDrbg(), nullptr, [this](BigNumber::PrimeEvent, int) {
+      if (ShouldYield()) Yield();
+      return true;
+    });
+  });
+}
+
+bool Scheduler::ShouldYield() const {
+  if (current_task.scheduler != this) return false;
+  for (size_t i = 0; i < current_task.priority; ++i) {
+    if (classes_[i].waiting.load(std::memory_order_relaxed) > 0) return true;
+  }
+  return false;
+}
+
+bool Scheduler::Yield() {
+  if (current_task.scheduler != this) return false;
+  size_t priority = current_task.priority;
+  bool ran = false;
+  for (;;) {
+    Task task;
+    size_t index = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      int picked = PickClass(priority);
+      if (picked < 0) break;
+      index = static_cast<size_t>(picked);
+      task = Start(index);
+    }
+    Run(index, task);
+    ran = true;
+  }
+  if (ran) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++classes_[priority].metrics.preemptions;
+  }
+  return ran;
+}
+
+void Scheduler::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  all_done_.wait(lock, [this] { return active_ == 0 && PickClass(kTaskPriorityCount) < 0; });
+}
+
+PriorityClassMetrics Scheduler::Metrics(TaskPriority priority) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const ClassState& state = classes_[static_cast<size_t>(priority)];
+  PriorityClassMetrics metrics = state.metrics;
+  metrics.queued = state.queue.size();
+  metrics.queue_seconds = Summarize(state.queue_samples);
+  return metrics;
+}
+
+void Scheduler::Enqueue(TaskPriority priority, std::function<bool()> run) {
+  size_t index = static_cast<size_t>(priority);
+  if (index >= kTaskPriorityCount) throw std::invalid_argument("Unknown task priority");
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ClassState& state = classes_[index];
+    state.queue.push_back(Task{std::move(run), Clock::now()});
+    state.waiting.store(state.queue.size(), std::memory_order_relaxed);
+    ++state.metrics.submitted;
+  }
+  task_ready_.notify_one();
+}
+
+int Scheduler::PickClass(size_t below) const {
+  for (size_t i = 0; i < below; ++i) {
+    const ClassState& state = classes_[i];
+    if (state.queue.empty()) continue;
+    if (state.limit == 0 || state.metrics.running < state.limit) return static_cast<int>(i);
+  }
+  return -1;
+}
+
+Scheduler::Task Scheduler::Start(size_t index) {
+  ClassState& state = classes_[index];
+  Task task = std::move(state.queue.front());
+  state.queue.pop_front();
+  state.waiting.store(state.queue.size(), std::memory_order_relaxed);
+
+  auto now = Clock::now();
+  TraceComplete("queue_wait", "scheduler", task.queued_at, now, static_cast<int64_t>(index));
+  double waited = std::chrono::duration<double>(now - task.queued_at).count();
+  if (state.queue_samples.size() < latency_samples_) {
+    state.queue_samples.push_back(waited);
+  } else {
+    state.queue_samples[state.next_sample] = waited;
+  }
+  state.next_sample = (state.next_sample + 1) % latency_samples_;
+
+  ++state.metrics.running;
+  state.metrics.peak_running = std::max(state.metrics.peak_running, state.metrics.running);
+  ++active_;
+  return task;
+}
+
+void Scheduler::Run(size_t index, Task& task) {
+  CurrentTask previous = current_task;
+  current_task = CurrentTask{this, index};
+  bool ok;
+  {
+    TraceSpan span("task", "scheduler", static_cast<int64_t>(index));
+    ok = task.run();
+  }
+  current_task = previous;
+  task.run = nullptr;  // Release captured state before reporting completion.
+
+  bool limited = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ClassState& state = classes_[index];
+    --state.metrics.running;
+    ++state.metrics.completed;
+    if (!ok) ++state.metrics.failed;
+    --active_;
+    limited = state.limit != 0 && !state.queue.empty();
+    if (active_ == 0 && PickClass(kTaskPriorityCount) < 0) all_done_.notify_all();
+  }
+  // A freed slot may unblock a task that was held back by its limit.
+  if (limited) task_ready_.notify_all();
+}
+
+void Scheduler::WorkerLoop() {
+  for (;;) {
+    Task task;
+    size_t index = 0;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      task_ready_.wait(lock, [this] { return stopping_ || PickClass(kTaskPriorityCount) >= 0; });
+      int picked = PickClass(kTaskPriorityCount);
+      if (picked < 0) return;
+      index = static_cast<size_t>(picked);
+      task = Start(index);
+    }
+    Run(index, task);
+  }
+}
+
+}  // namespace rsa_app
@@ -0,0 +1,199 @@
+#ifndef RSA_APP_SCHEDULER_H_
+#define RSA_APP_SCHEDULER_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "rsa.h"
+#include "stats.h"
+
+namespace rsa_app {
+
+/**
+ * Scheduling classes, most urgent first.
+ */
+enum class TaskPriority {
+  kInteractive = 0,  ///< Latency-critical work such as decrypt and verify.
+  kBatch = 1,        ///< Throughput work such as bulk encryption.
+  kBackground = 2,   ///< Work that may be delayed, such as key generation.
+};
+
+constexpr size_t kTaskPriorityCount = 3;
+
+/**
+ * Returns "interactive", "batch" or "background".
+ */
+const char* TaskPriorityName(TaskPriority priority);
+
+/**
+ * Configuration of a `Scheduler`.
+ */
+struct SchedulerOptions {
+  size_t threads = 0;  // Workers; 0 selects ThreadPool::DefaultThreadCount().
+  // Tasks of each class allowed to run at once, indexed by TaskPriority;
+  // 0 means no limit beyond the worker count.
+  std::array<size_t, kTaskPriorityCount> max_running = {0, 0, 0};
+  size_t latency_samples = 4096;  // Queue times kept per class for the summary.
+};
+
+/**
+ * Counters of one scheduling class.
+ */
+struct PriorityClassMetrics {
+  uint64_t submitted = 0;    // Tasks submitted.
+  uint64_t completed = 0;    // Tasks finished, failed ones included.
+  uint64_t failed = 0;       // Tasks that threw.
+  uint64_t preemptions = 0;  // Yields of this class that ran more urgent tasks.
+  size_t queued = 0;         // Tasks waiting now.
+  size_t running = 0;        // Tasks started and not finished, parked ones included.
+  size_t peak_running = 0;   // Highest `running` seen.
+  SampleSummary queue_seconds;  // Submit-to-start delay of recent tasks.
+};
+
+/**
+ * A worker pool that runs tasks by priority class.
+ *
+ * A free worker always starts the oldest task of the most urgent class that
+ * is below its `max_running` limit. Long tasks are preempted cooperatively:
+ * they call `Yield()` at safe points, which runs any queued task of a more
+ * urgent class on the calling thread before returning. Key generation
+ * submitted through `SubmitKeyGeneration` yields from the prime search
+ * callback, so an interactive task waits at most one sieve step or
+ * Miller-Rabin round even when every worker is generating keys.
+ *
+ * All methods are thread-safe.
+ */
+class Scheduler {
+ public:
+  /**
+   * Starts the workers.
+   *
+   * @throws std::invalid_argument If `latency_samples` is 0.
+   */
+  explicit Scheduler(const SchedulerOptions& options = {});
+
+  /**
+   * Runs the queued tasks to completion and joins the workers.
+   */
+  ~Scheduler();
+
+  Scheduler(const Scheduler&) = delete;
+  Scheduler& operator=(const Scheduler&) = delete;
+
+  /**
+   * Returns the number of worker threads.
+   */
+  size_t Size() const { return workers_.size(); }
+
+  /**
+   * Queues `task` in class `priority`.
+   *
+   * @return A future for the task's result or exception.
+   */
+  template <typename Callable>
+  std::future<std::invoke_result_t<Callable>> Submit(TaskPriority priority, Callable task) {
+    using Result = std::invoke_result_t<Callable>;
+    auto callable = std::make_shared<Callable>(std::move(task));
+    auto promise = std::make_shared<std::promise<Result>>();
+    std::future<Result> result = promise->get_future();
+    Enqueue(priority, [callable, promise]() -> bool {
+      try {
+        if constexpr (std::is_void_v<Result>) {
+          (*callable)();
+          promise->set_value();
+        } else {
+          promise->set_value((*callable)());
+        }
+        return true;
+      } catch (...) {
+        promise->set_exception(std::current_exception());
+        return false;
+      }
+    });
+    return result;
+  }
+
+  /**
+   * Generates a key pair in class `priority`, yielding to more urgent tasks
+   * between prime search steps.
+   *
+   * @param bits The bit size of the RSA modulus.
+   * @param priority The scheduling class; background by default.
+   * @return A future for the key pair.
+   */
+  std::future<KeyPair> SubmitKeyGeneration(int bits,
+                                           TaskPriority priority = TaskPriority::kBackground);
+
+  /**
+   * Returns true if the calling task should call `Yield()`: it runs on this
+   * scheduler and a more urgent task is waiting. Cheap enough for inner loops.
+   */
+  bool ShouldYield() const;
+
+  /**
+   * Runs queued tasks more urgent than the calling task on the calling
+   * thread until none is left. Does nothing outside a task of this scheduler.
+   *
+   * @return True if a task was run.
+   */
+  bool Yield();
+
+  /**
+   * Blocks until no task is queued or running.
+   */
+  void Wait();
+
+  /**
+   * Returns the counters of class `priority`.
+   */
+  PriorityClassMetrics Metrics(TaskPriority priority) const;
+
+ private:
+  struct Task {
+    std::function<bool()> run;  // Returns false if the task threw.
+    std::chrono::steady_clock::time_point queued_at;
+  };
+
+  struct ClassState {
+    std::deque<Task> queue;
+    std::atomic<size_t> waiting{0};  // queue.size(), readable without the lock.
+    size_t limit = 0;
+    PriorityClassMetrics metrics;
+    std::vector<double> queue_samples;  // Ring buffer of queue times.
+    size_t next_sample = 0;
+  };
+
+  void Enqueue(TaskPriority priority, std::function<bool()> run);
+  // Returns the most urgent runnable class below `below`, or -1; needs `mutex_`.
+  int PickClass(size_t below) const;
+  // Dequeues a task of class `index` and marks it running; needs `mutex_`.
+  Task Start(size_t index);
+  void Run(size_t index, Task& task);
+  void WorkerLoop();
+
+  std::vector<std::thread> workers_;
+  mutable std::mutex mutex_;
+  std::condition_variable task_ready_;
+  std::condition_variable all_done_;
+  std::array<ClassState, kTaskPriorityCount> classes_;
+  size_t latency_samples_;
+  size_t active_ = 0;  // Tasks running, parked ones included.
+  bool stopping_ = false;
+};
+
+}  // namespace rsa_app
+
+#endif  // RSA_APP_SCHEDULER_H_
@@ -0,0 +1,124 @@
+#include <chrono>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "rsa.h"
+#include "scheduler.h"
+#include "stats.h"
+#include "thread_pool.h"
+
+using Clock = std::chrono::steady_clock;
+
+// How background key generation shares the workers with decryption
+enum class Mode { kIdle, kFifo, kPriority };
+
+const char* ModeName(Mode mode) {
+    switch (mode) {
+        case Mode::kIdle:
+            return "idle";
+        case Mode::kFifo:
+            return "fifo";
+        case Mode::kPriority:
+            return "priority";
+    }
+    return "unknown";
+}
+
+struct Result {
+    rsa_app::SampleSummary latency;  // Submit-to-completion of each decrypt, seconds.
+    double keys_per_second = 0.0;    // Keys finished while decrypts were issued.
+};
+
+// Issues `requests` decrypts, one every `interval`, while `keygens` keys are
+// being generated, and measures each decrypt from submission to completion.
+Result Measure(Mode mode, size_t threads, const rsa_app::KeyPair& key, int keygen_bits,
+               size_t keygens, size_t requests, std::chrono::microseconds interval) {
+    rsa_app::Scheduler scheduler({threads});
+    std::vector<std::future<rsa_app::KeyPair>> keys;
+    if (mode == Mode::kFifo) {
+        // One queue for everything, as with a plain thread pool.
+        for (size_t i = 0; i < keygens; ++i) {
+            keys.push_back(scheduler.Submit(rsa_app::TaskPriority::kInteractive,
+                                            [keygen_bits] { return rsa_app::GenerateKeyPair(keygen_bits); }));
+        }
+    } else if (mode == Mode::kPriority) {
+        for (size_t i = 0; i < keygens; ++i) keys.push_back(scheduler.SubmitKeyGeneration(keygen_bits));
+    }
+
+    BigNumber ciphertext = rsa_app::Encrypt(rsa_app::StringToNumber("latency probe"), key.public_key);
+    std::vector<std::future<double>> latencies;
+    auto start = Clock::now();
+    for (size_t i = 0; i < requests; ++i) {
+        std::this_thread::sleep_until(start + interval * static_cast<int64_t>(i));
+        auto submitted = Clock::now();
+        latencies.push_back(scheduler.Submit(rsa_app::TaskPriority::kInteractive, [&, submitted] {
+            rsa_app::Decrypt(ciphertext, key.private_key);
+            return std::chrono::duration<double>(Clock::now() - submitted).count();
+        }));
+    }
+    std::vector<double> samples;
+    for (auto& latency : latencies) samples.push_back(latency.get());
+    double window = std::chrono::duration<double>(Clock::now() - start).count();
+
+    size_t finished = 0;
+    for (auto& generated : keys) {
+        if (generated.wait_for(std::chrono::seconds(0)) == std::future_status::ready) ++finished;
+    }
+    Result result;
+    result.latency = rsa_app::Summarize(samples);
+    result.keys_per_second = static_cast<double>(finished) / window;
+    // Remaining key generations finish in the scheduler's destructor.
+    return result;
+}
+
+int main(int argc, char** argv) {
+    size_t threads = 0;
+    int bits = 2048;
+    int keygen_bits = 2048;
+    size_t requests = 100;
+    long interval_us = 20000;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--threads") {
+            threads = std::stoul(argv[i + 1]);
+        } else if (flag == "--bits") {
+            bits = std::stoi(argv[i + 1]);
+        } else if (flag == "--keygen-bits") {
+            keygen_bits = std::stoi(argv[i + 1]);
+        } else if (flag == "--requests") {
+            requests = std::stoul(argv[i + 1]);
+        } else if (flag == "--interval-us") {
+            interval_us = std::stol(argv[i + 1]);
+        } else {
+            std::cerr << "Unknown option " << flag
+                      << " (supported: --threads N, --bits N, --keygen-bits N, --requests N,"
+                         " --interval-us N)\n";
+            return 2;
+        }
+    }
+    if (threads == 0) threads = rsa_app::ThreadPool::DefaultThreadCount();
+    // Enough key generations to keep every worker busy for the whole run.
+    size_t keygens = threads * 16;
+
+    rsa_app::KeyPair key = rsa_app::GenerateKeyPair(bits);
+    std::cout << "Decrypt latency under background key generation: " << bits << "-bit decrypts every "
+              << interval_us << " us, " << keygen_bits << "-bit keygen, " << threads
+              << " threads\n";
+    std::cout << std::left << std::setw(10) << "mode" << std::right << std::setw(12) << "p50 ms"
+              << std::setw(12) << "p99 ms" << std::setw(12) << "max ms" << std::setw(10)
+              << "keys/s\n";
+    for (Mode mode : {Mode::kIdle, Mode::kFifo, Mode::kPriority}) {
+        Result result = Measure(mode, threads, key, keygen_bits, keygens, requests,
+                                std::chrono::microseconds(interval_us));
+        std::cout << std::left << std::setw(10) << ModeName(mode) << std::right << std::fixed
+                  << std::setprecision(3) << std::setw(12) << result.latency.p50 * 1e3
+                  << std::setw(12) << result.latency.p99 * 1e3 << std::setw(12)
+                  << result.latency.max * 1e3 << std::setw(9) << std::setprecision(2)
+                  << result.keys_per_second << "\n";
+    }
+    return 0;
+}
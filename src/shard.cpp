@@ -0,0 +1,761 @@
+#include "shard.h"
+
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <functional>
+#include <set>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#include "threshold.h"
+
+namespace rsa_app {
+
+namespace {
+
+// Response status codes.
+enum Status : uint8_t {
+  kStatusOk = 0,
+  kStatusInvalid = 1,  // The handler threw std::invalid_argument.
+  kStatusError = 2,    // Any other failure.
+};
+
+// Frames larger than this are treated as a protocol error.
+constexpr uint32_t kMaxFrameBytes = 64u << 20;
+// Pause before accepting again after running out of descriptors or memory.
+constexpr std::chrono::milliseconds kAcceptBackoff(100);
+
+std::runtime_error SystemError(const std::string& what) {
+  return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+// Wire format helpers: big-endian integers and u32-length-prefixed fields.
+
+void PutU32(std::string& out, uint32_t value) {
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    out.push_back(static_cast<char>(value >> shift));
+  }
+}
+
+void PutU64(std::string& out, uint64_t value) {
+  PutU32(out, static_cast<uint32_t>(value >> 32));
+  PutU32(out, static_cast<uint32_t>(value));
+}
+
+uint64_t GetUint(const std::string& in, size_t& pos, size_t bytes) {
+  if (pos > in.size() || in.size() - pos < bytes) {
+    throw std::invalid_argument("Truncated shard message");
+  }
+  uint64_t value = 0;
+  for (size_t i = 0; i < bytes; ++i) {
+    value = value << 8 | static_cast<uint8_t>(in[pos++]);
+  }
+  return value;
+}
+
+std::string EncodeKeyPair(const KeyPair& key_pair) {
+  std::string out;
+  AppendShardField(out, key_pair.public_key.n.ToBytes());
+  AppendShardField(out, key_pair.public_key.e.ToBytes());
+  AppendShardField(out, key_pair.private_key.d.ToBytes());
+  return out;
+}
+
+KeyPair DecodeKeyPair(const std::string& in) {
+  size_t pos = 0;
+  KeyPair key_pair;
+  key_pair.public_key.n = BigNumber::FromBytes(ReadShardField(in, pos));
+  key_pair.public_key.e = BigNumber::FromBytes(ReadShardField(in, pos));
+  key_pair.private_key.d = BigNumber::FromBytes(ReadShardField(in, pos));
+  key_pair.private_key.n = key_pair.public_key.n.Copy();
+  return key_pair;
+}
+
+std::string EncodeMetrics(const ClusterMetrics& metrics) {
+  std::string out;
+  PutU32(out, static_cast<uint32_t>(metrics.shards.size()));
+  for (const auto& shard : metrics.shards) {
+    AppendShardField(out, shard.worker);
+    PutU64(out, shard.keys);
+    PutU64(out, shard.encrypts);
+    PutU64(out, shard.decrypts);
+    PutU64(out, shard.errors);
+    PutU64(out, static_cast<uint64_t>(shard.busy_seconds * 1e9));
+  }
+  PutU64(out, metrics.keys_moved);
+  PutU64(out, static_cast<uint64_t>(metrics.uptime_seconds * 1e9));
+  return out;
+}
+
+// Fills in the totals from the shards.
+void AddTotals(ClusterMetrics& metrics) {
+  metrics.requests = metrics.errors = metrics.keys = 0;
+  for (const auto& shard : metrics.shards) {
+    metrics.requests += shard.encrypts + shard.decrypts;
+    metrics.errors += shard.errors;
+    metrics.keys += shard.keys;
+  }
+  metrics.requests_per_second =
+      metrics.uptime_seconds > 0.0 ? metrics.requests / metrics.uptime_seconds : 0.0;
+}
+
+ClusterMetrics DecodeMetrics(const std::string& in) {
+  size_t pos = 0;
+  ClusterMetrics metrics;
+  // An encoded shard is at least an empty worker name and five counters.
+  constexpr size_t kMinShardBytes = 4 + 5 * 8;
+  size_t count = GetUint(in, pos, 4);
+  if (count > (in.size() - pos) / kMinShardBytes) {
+    throw std::invalid_argument("Truncated shard message");
+  }
+  metrics.shards.resize(count);
+  for (auto& shard : metrics.shards) {
+    shard.worker = ReadShardField(in, pos);
+    shard.keys = GetUint(in, pos, 8);
+    shard.encrypts = GetUint(in, pos, 8);
+    shard.decrypts = GetUint(in, pos, 8);
+    shard.errors = GetUint(in, pos, 8);
+    shard.busy_seconds = GetUint(in, pos, 8) * 1e-9;
+  }
+  metrics.keys_moved = GetUint(in, pos, 8);
+  metrics.uptime_seconds = GetUint(in, pos, 8) * 1e-9;
+  AddTotals(metrics);
+  return metrics;
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Socket helpers.
+
+sockaddr_un SocketAddress(const std::string& path) {
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+    throw std::invalid_argument("Socket path is empty or too long: " + path);
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size());
+  return address;
+}
+
+bool WriteAll(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t written = send(fd, data, size, MSG_NOSIGNAL);
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) return false;
+    data += written;
+    size -= static_cast<size_t>(written);
+  }
+  return true;
+}
+
+bool ReadAll(int fd, char* data, size_t size) {
+  while (size > 0) {
+    ssize_t got = recv(fd, data, size, 0);
+    if (got < 0 && errno == EINTR) continue;
+    if (got <= 0) return false;
+    data += got;
+    size -= static_cast<size_t>(got);
+  }
+  return true;
+}
+
+bool WriteFrame(int fd, const std::string& body) {
+  std::string frame;
+  frame.reserve(4 + body.size());
+  PutU32(frame, static_cast<uint32_t>(body.size()));
+  frame += body;
+  return WriteAll(fd, frame.data(), frame.size());
+}
+
+// Returns false on end of stream or a malformed length.
+bool ReadFrame(int fd, std::string& body) {
+  char header[4];
+  if (!ReadAll(fd, header, sizeof(header))) return false;
+  size_t pos = 0;
+  uint32_t length = static_cast<uint32_t>(GetUint(std::string(header, 4), pos, 4));
+  if (length > kMaxFrameBytes) return false;
+  body.resize(length);
+  return length == 0 || ReadAll(fd, &body[0], length);
+}
+
+using Handler = std::function<std::string(uint8_t op, const std::string& key_id,
+                                          const std::string& payload)>;
+
+// Serves one connection until the peer hangs up; returns true if the peer
+// asked the server to shut down.
+bool ServeConnection(int fd, const Handler& handler) {
+  std::string request;
+  while (ReadFrame(fd, request)) {
+    std::string response(1, static_cast<char>(kStatusOk));
+    uint8_t op = 0;
+    try {
+      size_t pos = 0;
+      op = static_cast<uint8_t>(GetUint(request, pos, 1));
+      std::string key_id = ReadShardField(request, pos);
+      if (op != kShardShutdown) response += handler(op, key_id, request.substr(pos));
+    } catch (const std::invalid_argument& e) {
+      response.assign(1, static_cast<char>(kStatusInvalid));
+      response += e.what();
+    } catch (const std::exception& e) {
+      response.assign(1, static_cast<char>(kStatusError));
+      response += e.what();
+    }
+    if (!WriteFrame(fd, response)) return false;
+    if (op == kShardShutdown) return true;
+  }
+  return false;
+}
+
+// Listens on `path` and serves every connection on its own thread until a
+// shutdown request; then disconnects the remaining clients. A connection
+// closes its descriptor when its peer hangs up, and running out of
+// descriptors or memory pauses accepting until one does.
+void ServeSocket(const std::string& path, const Handler& handler) {
+  sockaddr_un address = SocketAddress(path);
+  int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listener < 0) throw SystemError("socket");
+  unlink(path.c_str());
+  if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+      chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0 || listen(listener, 64) != 0) {
+    std::runtime_error error = SystemError("Cannot listen on " + path);
+    close(listener);
+    throw error;
+  }
+
+  std::mutex mutex;
+  std::condition_variable finished;  // Signals a closed connection.
+  std::set<int> clients;             // Open connections.
+  bool stopping = false;
+  int accept_error = 0;
+  for (;;) {
+    int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    int error = fd < 0 ? errno : 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    if (stopping) {
+      if (fd >= 0) close(fd);
+      break;
+    }
+    if (fd < 0) {
+      if (error == EINTR || error == ECONNABORTED) continue;
+      if (error == EMFILE || error == ENFILE || error == ENOMEM || error == ENOBUFS) {
+        finished.wait_for(lock, kAcceptBackoff);
+        continue;
+      }
+      accept_error = error;
+      break;
+    }
+    clients.insert(fd);
+    try {
+      std::thread([&, fd] {
+        bool shutdown_requested = ServeConnection(fd, handler);
+        // Notified under the lock: ServeSocket may return once it sees the
+        // last connection gone.
+        std::lock_guard<std::mutex> done_lock(mutex);
+        if (shutdown_requested) {
+          stopping = true;
+          // Wakes the accept() above.
+          shutdown(listener, SHUT_RDWR);
+        }
+        clients.erase(fd);
+        close(fd);
+        finished.notify_all();
+      }).detach();
+    } catch (const std::system_error&) {
+      // No thread to serve it: drop the connection and retry later.
+      clients.erase(fd);
+      close(fd);
+      finished.wait_for(lock, kAcceptBackoff);
+    }
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (int fd : clients) shutdown(fd, SHUT_RDWR);
+    finished.wait(lock, [&clients] { return clients.empty(); });
+  }
+  close(listener);
+  unlink(path.c_str());
+  if (accept_error) {
+    errno = accept_error;
+    throw SystemError("accept on " + path);
+  }
+}
+
+std::vector<std::string> DecodeKeyIds(const std::string& in) {
+  std::vector<std::string> ids;
+  size_t pos = 0;
+  while (pos < in.size()) ids.push_back(ReadShardField(in, pos));
+  return ids;
+}
+
+}  // namespace
+
+void AppendShardField(std::string& out, const std::string& field) {
+  PutU32(out, static_cast<uint32_t>(field.size()));
+  out += field;
+}
+
+std::string ReadShardField(const std::string& in, size_t& pos) {
+  size_t length = GetUint(in, pos, 4);
+  if (in.size() - pos < length) throw std::invalid_argument("Truncated shard message");
+  std::string field = in.substr(pos, length);
+  pos += length;
+  return field;
+}
+
+ShardConnection::ShardConnection(const std::string& socket_path) {
+  sockaddr_un address = SocketAddress(socket_path);
+  fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd_ < 0) throw SystemError("socket");
+  if (connect(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+    std::runtime_error error = SystemError("Cannot connect to " + socket_path);
+    close(fd_);
+    throw error;
+  }
+}
+
+ShardConnection::~ShardConnection() { close(fd_); }
+
+std::string ShardConnection::Call(ShardOp op, const std::string& key_id,
+                                  const std::string& payload) {
+  if (key_id.size() > kMaxFrameBytes) throw std::invalid_argument("Key id too long");
+  std::string request(1, static_cast<char>(op));
+  AppendShardField(request, key_id);
+  request += payload;
+  std::string response;
+  if (broken_ || !WriteFrame(fd_, request) || !ReadFrame(fd_, response) || response.empty()) {
+    broken_ = true;
+    throw std::runtime_error("Shard connection lost");
+  }
+  auto status = static_cast<uint8_t>(response[0]);
+  if (status == kStatusInvalid) throw std::invalid_argument(response.substr(1));
+  if (status != kStatusOk) throw std::runtime_error(response.substr(1));
+  return response.substr(1);
+}
+
+HashRing::HashRing(size_t replicas) : replicas_(replicas) {
+  if (replicas == 0) throw std::invalid_argument("HashRing needs at least one replica");
+}
+
+uint64_t HashRing::Hash(const std::string& text) {
+  // FNV-1a, then the SplitMix64 finalizer: FNV alone clusters the points of
+  // names that differ only in a trailing counter.
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (unsigned char c : text) {
+    hash ^= c;
+    hash *= 0x100000001b3ULL;
+  }
+  hash ^= hash >> 30;
+  hash *= 0xbf58476d1ce4e5b9ULL;
+  hash ^= hash >> 27;
+  hash *= 0x94d049bb133111ebULL;
+  return hash ^ (hash >> 31);
+}
+
+void HashRing::AddNode(const std::string& node) {
+  for (const auto& existing : nodes_) {
+    if (existing == node) return;
+  }
+  nodes_.push_back(node);
+  for (size_t i = 0; i < replicas_; ++i) {
+    // On a (vanishingly rare) collision the earlier node keeps the point.
+    points_.emplace(Hash(node + "#" + std::to_string(i)), node);
+  }
+}
+
+void HashRing::RemoveNode(const std::string& node) {
+  for (auto it = nodes_.begin(); it != nodes_.end(); ++it) {
+    if (*it != node) continue;
+    nodes_.erase(it);
+    for (auto point = points_.begin(); point != points_.end();) {
+      point = point->second == node ? points_.erase(point) : std::next(point);
+    }
+    return;
+  }
+}
+
+const std::string& HashRing::NodeFor(const std::string& key) const {
+  if (points_.empty()) throw std::logic_error("HashRing has no nodes");
+  auto point = points_.lower_bound(Hash(key));
+  return point == points_.end() ? points_.begin()->second : point->second;
+}
+
+void RunShardWorker(const std::string& socket_path) {
+  std::shared_mutex mutex;  // Guards keys and shares.
+  std::map<std::string, KeyPair> keys;
+  std::map<std::string, KeyShare> shares;  // Threshold key shares.
+  std::atomic<uint64_t> encrypts{0}, decrypts{0}, errors{0}, busy_nanos{0};
+  auto start = std::chrono::steady_clock::now();
+
+  ServeSocket(socket_path, [&](uint8_t op, const std::string& key_id,
+                               const std::string& payload) -> std::string {
+    // Runs an encrypt or decrypt with the key, counting time and failures.
+    auto run = [&](bool decrypt) {
+      std::shared_lock<std::shared_mutex> lock(mutex);
+      auto found = keys.find(key_id);
+      if (found == keys.end()) {
+        ++errors;
+        throw std::invalid_argument("Unknown key id " + key_id);
+      }
+      auto begin = std::chrono::steady_clock::now();
+      try {
+        BigNumber input = BigNumber::FromBytes(payload);
+        BigNumber output = decrypt ? Decrypt(input, found->second.private_key)
+                                   : Encrypt(input, found->second.public_key);
+        busy_nanos += static_cast<uint64_t>(SecondsSince(begin) * 1e9);
+        ++(decrypt ? decrypts : encrypts);
+        return output.ToBytes();
+      } catch (...) {
+        ++errors;
+        throw;
+      }
+    };
+
+    switch (op) {
+      case kShardEncrypt:
+        return run(false);
+      case kShardDecrypt:
+        return run(true);
+      case kShardPutKey: {
+        KeyPair key_pair = DecodeKeyPair(payload);
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        keys[key_id] = std::move(key_pair);
+        return std::string();
+      }
+      case kShardGetKey: {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto found = keys.find(key_id);
+        if (found == keys.end()) throw std::invalid_argument("Unknown key id " + key_id);
+        return EncodeKeyPair(found->second);
+      }
+      case kShardDropKey: {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        auto found = keys.find(key_id);
+        if (found != keys.end()) {
+          BN_clear(found->second.private_key.d.Get());
+          keys.erase(found);
+        }
+        auto share = shares.find(key_id);
+        if (share != shares.end()) {
+          BN_clear(share->second.d.Get());
+          shares.erase(share);
+        }
+        return std::string();
+      }
+      case kShardPutShare: {
+        KeyShare share = DecodeKeyShare(payload);
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        shares[key_id] = std::move(share);
+        return std::string();
+      }
+      case kShardPartialDecrypt: {
+        auto begin = std::chrono::steady_clock::now();
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        std::string partials = PartialDecryptBatch(shares, payload);
+        busy_nanos += static_cast<uint64_t>(SecondsSince(begin) * 1e9);
+        return partials;
+      }
+      case kShardListKeys: {
+        std::string out;
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        for (const auto& entry : keys) AppendShardField(out, entry.first);
+        return out;
+      }
+      case kShardMetrics: {
+        ClusterMetrics metrics;
+        metrics.shards.resize(1);
+        {
+          std::shared_lock<std::shared_mutex> lock(mutex);
+          metrics.shards[0].keys = keys.size();
+        }
+        metrics.shards[0].encrypts = encrypts;
+        metrics.shards[0].decrypts = decrypts;
+        metrics.shards[0].errors = errors;
+        metrics.shards[0].busy_seconds = busy_nanos * 1e-9;
+        metrics.uptime_seconds = SecondsSince(start);
+        return EncodeMetrics(metrics);
+      }
+      default:
+        throw std::invalid_argument("Unknown shard request " + std::to_string(op));
+    }
+  });
+
+  for (auto& entry : keys) BN_clear(entry.second.private_key.d.Get());
+  for (auto& entry : shares) BN_clear(entry.second.d.Get());
+}
+
+pid_t SpawnShardWorker(const std::string& socket_path) {
+  SocketAddress(socket_path);  // Validates the path before forking.
+  pid_t pid = fork();
+  if (pid < 0) throw SystemError("fork");
+  if (pid == 0) {
+#ifdef __linux__
+    // Exit with the parent rather than linger as an orphan.
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    if (getppid() == 1) _exit(1);
+#endif
+    int status = 0;
+    try {
+      RunShardWorker(socket_path);
+    } catch (...) {
+      status = 1;
+    }
+    _exit(status);
+  }
+
+  // The child unlinks any stale socket before binding, so a successful
+  // connect means the new worker is up.
+  for (int attempt = 0; attempt < 500; ++attempt) {
+    int status = 0;
+    if (waitpid(pid, &status, WNOHANG) == pid) {
+      throw std::runtime_error("Shard worker exited during startup: " + socket_path);
+    }
+    if (attempt > 0) {
+      try {
+        ShardConnection probe(socket_path);
+        return pid;
+      } catch (const std::runtime_error&) {
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  kill(pid, SIGKILL);
+  waitpid(pid, nullptr, 0);
+  throw std::runtime_error("Shard worker did not start: " + socket_path);
+}
+
+/**
+ * A registered worker and its idle connections.
+ */
+struct ShardRouter::Worker {
+  std::string id;
+  std::string socket_path;
+  std::mutex mutex;  // Guards idle.
+  std::vector<std::unique_ptr<ShardConnection>> idle;
+};
+
+ShardRouter::ShardRouter(size_t replicas)
+    : ring_(replicas), start_(std::chrono::steady_clock::now()) {}
+
+ShardRouter::~ShardRouter() = default;
+
+std::string ShardRouter::Call(Worker& worker, ShardOp op, const std::string& key_id,
+                              const std::string& payload) {
+  std::unique_ptr<ShardConnection> connection;
+  {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (!worker.idle.empty()) {
+      connection = std::move(worker.idle.back());
+      worker.idle.pop_back();
+    }
+  }
+  if (!connection) connection = std::make_unique<ShardConnection>(worker.socket_path);
+
+  // Returns the connection to the pool unless it broke.
+  struct Release {
+    Worker& worker;
+    std::unique_ptr<ShardConnection>& connection;
+    ~Release() {
+      if (connection->Broken()) return;
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      worker.idle.push_back(std::move(connection));
+    }
+  } release{worker, connection};
+  return connection->Call(op, key_id, payload);
+}
+
+ShardRouter::Worker& ShardRouter::Find(const std::string& id) {
+  auto found = workers_.find(id);
+  if (found == workers_.end()) throw std::invalid_argument("Unknown shard worker " + id);
+  return *found->second;
+}
+
+std::string ShardRouter::Forward(ShardOp op, const std::string& key_id,
+                                 const std::string& payload) {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  if (workers_.empty()) throw std::runtime_error("No shard workers registered");
+  return Call(Find(ring_.NodeFor(key_id)), op, key_id, payload);
+}
+
+void ShardRouter::Move(Worker& from, const std::vector<std::string>& key_ids,
+                       std::vector<MovedKey>& moved) {
+  for (const auto& key_id : key_ids) {
+    Worker& to = Find(ring_.NodeFor(key_id));
+    if (&to == &from) continue;
+    // Copy, then drop: a failure in between leaves the key on both
+    // workers rather than on neither.
+    std::string key_pair = Call(from, kShardGetKey, key_id, std::string());
+    Call(to, kShardPutKey, key_id, key_pair);
+    moved.push_back(MovedKey{key_id, &from, &to, std::move(key_pair)});
+    Call(from, kShardDropKey, key_id, std::string());
+  }
+}
+
+void ShardRouter::Restore(const std::vector<MovedKey>& moved) {
+  for (const auto& key : moved) {
+    try {
+      Call(*key.from, kShardPutKey, key.key_id, key.key_pair);
+    } catch (const std::exception&) {
+      continue;  // The new copy is the only one left; keep it.
+    }
+    try {
+      Call(*key.to, kShardDropKey, key.key_id, std::string());
+    } catch (const std::exception&) {
+      // An unreachable new owner no longer serves the key anyway.
+    }
+  }
+}
+
+size_t ShardRouter::AddWorker(const std::string& id, const std::string& socket_path) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  if (workers_.count(id)) throw std::invalid_argument("Shard worker already registered: " + id);
+  auto worker = std::make_unique<Worker>();
+  worker->id = id;
+  worker->socket_path = socket_path;
+  Call(*worker, kShardMetrics, std::string(), std::string());  // Fails early if unreachable.
+
+  std::vector<Worker*> others;
+  for (auto& entry : workers_) others.push_back(entry.second.get());
+  workers_.emplace(id, std::move(worker));
+  ring_.AddNode(id);
+  std::vector<MovedKey> moved;
+  try {
+    for (Worker* other : others) {
+      Move(*other, DecodeKeyIds(Call(*other, kShardListKeys, std::string(), std::string())),
+           moved);
+    }
+  } catch (...) {
+    // Route every key to its old owner again, which holds it once more.
+    Restore(moved);
+    ring_.RemoveNode(id);
+    workers_.erase(id);
+    throw;
+  }
+  keys_moved_ += moved.size();
+  return moved.size();
+}
+
+size_t ShardRouter::Remove(const std::string& id, bool shutdown) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  Worker& worker = Find(id);
+  std::vector<std::string> key_ids =
+      DecodeKeyIds(Call(worker, kShardListKeys, std::string(), std::string()));
+  if (workers_.size() == 1 && !key_ids.empty()) {
+    throw std::invalid_argument("Cannot remove the last shard worker while it holds keys");
+  }
+  ring_.RemoveNode(id);
+  std::vector<MovedKey> moved;
+  try {
+    Move(worker, key_ids, moved);
+  } catch (...) {
+    // Bring the moved keys back so that the worker holds all of its keys
+    // again, then keep routing to it.
+    Restore(moved);
+    ring_.AddNode(id);
+    throw;
+  }
+  keys_moved_ += moved.size();
+  if (shutdown) Call(worker, kShardShutdown, std::string(), std::string());
+  workers_.erase(id);
+  return moved.size();
+}
+
+size_t ShardRouter::RemoveWorker(const std::string& id) { return Remove(id, false); }
+
+size_t ShardRouter::ShutdownWorker(const std::string& id) { return Remove(id, true); }
+
+void ShardRouter::PutKey(const std::string& key_id, const KeyPair& key_pair) {
+  Forward(kShardPutKey, key_id, EncodeKeyPair(key_pair));
+}
+
+std::string ShardRouter::WorkerFor(const std::string& key_id) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return ring_.NodeFor(key_id);
+}
+
+BigNumber ShardRouter::Encrypt(const std::string& key_id, const BigNumber& message) {
+  return BigNumber::FromBytes(Forward(kShardEncrypt, key_id, message.ToBytes()));
+}
+
+BigNumber ShardRouter::Decrypt(const std::string& key_id, const BigNumber& ciphertext) {
+  return BigNumber::FromBytes(Forward(kShardDecrypt, key_id, ciphertext.ToBytes()));
+}
+
+std::vector<std::string> ShardRouter::ListKeys(const std::string& id) {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return DecodeKeyIds(Call(Find(id), kShardListKeys, std::string(), std::string()));
+}
+
+ClusterMetrics ShardRouter::Metrics() {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  ClusterMetrics metrics;
+  for (const auto& id : ring_.Nodes()) {
+    ClusterMetrics worker = DecodeMetrics(Call(Find(id), kShardMetrics, std::string(), std::string()));
+    for (auto& shard : worker.shards) {
+      shard.worker = id;
+      metrics.shards.push_back(std::move(shard));
+    }
+  }
+  metrics.keys_moved = keys_moved_;
+  metrics.uptime_seconds = SecondsSince(start_);
+  AddTotals(metrics);
+  return metrics;
+}
+
+void ShardRouter::Serve(const std::string& socket_path) {
+  ServeSocket(socket_path, [this](uint8_t op, const std::string& key_id,
+                                  const std::string& payload) -> std::string {
+    switch (op) {
+      case kShardEncrypt:
+      case kShardDecrypt:
+      case kShardPutKey:
+        return Forward(static_cast<ShardOp>(op), key_id, payload);
+      case kShardMetrics:
+        return EncodeMetrics(Metrics());
+      default:
+        throw std::invalid_argument("Unsupported router request " + std::to_string(op));
+    }
+  });
+}
+
+ShardClient::ShardClient(const std::string& socket_path)
+    : connection_(std::make_unique<ShardConnection>(socket_path)) {}
+
+ShardClient::~ShardClient() = default;
+
+void ShardClient::PutKey(const std::string& key_id, const KeyPair& key_pair) {
+  connection_->Call(kShardPutKey, key_id, EncodeKeyPair(key_pair));
+}
+
+BigNumber ShardClient::Encrypt(const std::string& key_id, const BigNumber& message) {
+  return BigNumber::FromBytes(connection_->Call(kShardEncrypt, key_id, message.ToBytes()));
+}
+
+BigNumber ShardClient::Decrypt(const std::string& key_id, const BigNumber& ciphertext) {
+  return BigNumber::FromBytes(connection_->Call(kShardDecrypt, key_id, ciphertext.ToBytes()));
+}
+
+ClusterMetrics ShardClient::Metrics() {
+  return DecodeMetrics(connection_->Call(kShardMetrics, std::string(), std::string()));
+}
+
+void ShardClient::Shutdown() { connection_->Call(kShardShutdown, std::string(), std::string()); }
+
+}  // namespace rsa_app
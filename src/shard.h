@@ -0,0 +1,372 @@
+#ifndef RSA_APP_SHARD_H_
+#define RSA_APP_SHARD_H_
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "bn_wrapper.h"
+#include "rsa.h"
+
+namespace rsa_app {
+
+/**
+ * Request codes of the shard protocol.
+ */
+enum ShardOp : uint8_t {
+  kShardEncrypt = 1,         ///< Encrypt with a stored key.
+  kShardDecrypt = 2,         ///< Decrypt with a stored key.
+  kShardPutKey = 3,          ///< Store a key pair.
+  kShardGetKey = 4,          ///< Export a key pair.
+  kShardDropKey = 5,         ///< Remove a key pair.
+  kShardListKeys = 6,        ///< List the stored key ids.
+  kShardMetrics = 7,         ///< Return the counters.
+  kShardShutdown = 8,        ///< Exit after answering.
+  kShardPutShare = 9,        ///< Store a share of a private exponent.
+  kShardPartialDecrypt = 10, ///< Exponentiate a batch of ciphertexts by shares.
+};
+
+/**
+ * Appends a u32-length-prefixed field to a request or response payload.
+ */
+void AppendShardField(std::string& out, const std::string& field);
+
+/**
+ * Reads the field at `pos` written by `AppendShardField` and advances `pos`.
+ *
+ * @throws std::invalid_argument If the payload is truncated.
+ */
+std::string ReadShardField(const std::string& in, size_t& pos);
+
+/**
+ * One client connection speaking the shard protocol.
+ *
+ * Each request is answered before the next is sent. Not thread-safe.
+ */
+class ShardConnection {
+ public:
+  /**
+   * Connects to a worker or router socket.
+   *
+   * @throws std::runtime_error If the connection fails.
+   */
+  explicit ShardConnection(const std::string& socket_path);
+  ~ShardConnection();
+
+  ShardConnection(const ShardConnection&) = delete;
+  ShardConnection& operator=(const ShardConnection&) = delete;
+
+  /**
+   * Sends a request and returns the response payload.
+   *
+   * @throws std::invalid_argument If the peer rejected the request as
+   *         invalid (for example an unknown key id).
+   * @throws std::runtime_error If the peer failed, or the connection broke;
+   *         a broken connection fails every later call.
+   */
+  std::string Call(ShardOp op, const std::string& key_id, const std::string& payload);
+
+  /**
+   * Returns true once an I/O error has broken the connection.
+   */
+  bool Broken() const { return broken_; }
+
+ private:
+  int fd_ = -1;
+  bool broken_ = false;
+};
+
+/**
+ * Maps key ids to nodes by consistent hashing.
+ *
+ * Every node owns `replicas` points on a 64-bit ring; a key belongs to the
+ * node of the first point at or after the key's hash. Adding or removing a
+ * node therefore only moves the keys of the ring arcs that change hands,
+ * about 1/N of them, instead of reshuffling everything as `hash % N` would.
+ *
+ * Not thread-safe; `ShardRouter` guards its ring with its own lock.
+ */
+class HashRing {
+ public:
+  /**
+   * @param replicas Virtual points per node; more points spread keys more
+   *                 evenly at the cost of a larger ring.
+   * @throws std::invalid_argument If `replicas` is 0.
+   */
+  explicit HashRing(size_t replicas = 128);
+
+  /**
+   * Adds a node. Adding a node that is already present does nothing.
+   */
+  void AddNode(const std::string& node);
+
+  /**
+   * Removes a node. Removing an unknown node does nothing.
+   */
+  void RemoveNode(const std::string& node);
+
+  /**
+   * Returns the node that owns `key`.
+   *
+   * @throws std::logic_error If the ring has no nodes.
+   */
+  const std::string& NodeFor(const std::string& key) const;
+
+  /**
+   * Returns the nodes in the order they were added.
+   */
+  const std::vector<std::string>& Nodes() const { return nodes_; }
+
+  /**
+   * Returns the 64-bit hash used to place keys and points on the ring.
+   */
+  static uint64_t Hash(const std::string& text);
+
+ private:
+  size_t replicas_;
+  std::vector<std::string> nodes_;
+  std::map<uint64_t, std::string> points_;
+};
+
+/**
+ * Counters of one worker process.
+ */
+struct ShardMetrics {
+  std::string worker;         // Worker id, as registered with the router.
+  uint64_t keys = 0;          // Keys the worker holds.
+  uint64_t encrypts = 0;      // Encrypt requests served.
+  uint64_t decrypts = 0;      // Decrypt requests served.
+  uint64_t errors = 0;        // Requests answered with an error.
+  double busy_seconds = 0.0;  // Time spent encrypting and decrypting.
+};
+
+/**
+ * Counters of a whole sharded deployment.
+ */
+struct ClusterMetrics {
+  std::vector<ShardMetrics> shards;  // One entry per worker.
+  uint64_t requests = 0;             // Encrypts and decrypts of all workers.
+  uint64_t errors = 0;               // Errors of all workers.
+  uint64_t keys = 0;                 // Keys of all workers.
+  uint64_t keys_moved = 0;           // Keys migrated by rebalancing so far.
+  double uptime_seconds = 0.0;       // Since the router was created.
+  double requests_per_second = 0.0;  // requests / uptime_seconds.
+};
+
+/**
+ * Serves keys over a Unix domain socket until asked to shut down.
+ *
+ * The worker keeps its keys in memory and answers the requests a
+ * `ShardRouter` sends: encrypt, decrypt, key upload, export and removal,
+ * key listing, metrics and shutdown. It also holds key shares for a
+ * `ThresholdCoordinator` and answers its batched partial decryptions.
+ * Each connection is served on its own thread. The socket is created with mode 0600 because key export carries
+ * private exponents.
+ *
+ * @param socket_path Where to listen; an existing socket file is replaced.
+ * @throws std::runtime_error If the socket cannot be created.
+ */
+void RunShardWorker(const std::string& socket_path);
+
+/**
+ * Forks a process that runs `RunShardWorker(socket_path)`.
+ *
+ * Returns once the worker accepts connections. Call it before the parent
+ * starts threads: only the forking thread survives in the child.
+ *
+ * @param socket_path Where the worker listens.
+ * @return The worker's process id.
+ * @throws std::runtime_error If the fork fails or the worker does not come
+ *         up within a few seconds.
+ */
+pid_t SpawnShardWorker(const std::string& socket_path);
+
+/**
+ * Routes key operations to worker processes by consistent hashing.
+ *
+ * Each key id lives on exactly one worker, the one `HashRing` assigns it
+ * to. `AddWorker` and `RemoveWorker` rebalance by moving only the keys
+ * whose owner changed; requests wait while a rebalance runs, so none is
+ * sent to a worker that no longer (or not yet) holds its key.
+ *
+ * Connections to each worker are pooled, so concurrent callers do not
+ * serialize on one socket. All methods are thread-safe.
+ */
+class ShardRouter {
+ public:
+  /**
+   * @param replicas Virtual ring points per worker.
+   */
+  explicit ShardRouter(size_t replicas = 128);
+  ~ShardRouter();
+
+  ShardRouter(const ShardRouter&) = delete;
+  ShardRouter& operator=(const ShardRouter&) = delete;
+
+  /**
+   * Adds a worker and moves to it the keys it now owns.
+   *
+   * @param id Name of the worker on the ring.
+   * @param socket_path The worker's socket.
+   * @return Keys moved to the new worker.
+   * @throws std::invalid_argument If `id` is already registered.
+   * @throws std::runtime_error If a worker cannot be reached. Keys already
+   *         moved are put back and the worker is not registered.
+   */
+  size_t AddWorker(const std::string& id, const std::string& socket_path);
+
+  /**
+   * Moves a worker's keys to the remaining workers and forgets it.
+   *
+   * The worker process keeps running; call `ShutdownWorker` first if it
+   * should exit once drained.
+   *
+   * @param id The worker to remove.
+   * @return Keys moved off the worker.
+   * @throws std::invalid_argument If `id` is unknown, or it is the last
+   *         worker and still holds keys.
+   * @throws std::runtime_error If a worker cannot be reached. Keys already
+   *         moved are put back and the worker stays registered.
+   */
+  size_t RemoveWorker(const std::string& id);
+
+  /**
+   * Asks a worker to exit after answering; it is removed from the router
+   * first, so its keys are not lost.
+   *
+   * @return Keys moved off the worker.
+   */
+  size_t ShutdownWorker(const std::string& id);
+
+  /**
+   * Stores a key pair on the worker that owns `key_id`, replacing any key
+   * with the same id.
+   */
+  void PutKey(const std::string& key_id, const KeyPair& key_pair);
+
+  /**
+   * Returns the worker id that owns `key_id`.
+   */
+  std::string WorkerFor(const std::string& key_id) const;
+
+  /**
+   * Encrypts `message` with the public key `key_id` on its worker.
+   *
+   * @throws std::invalid_argument If the worker does not know the key or
+   *         rejects the message.
+   * @throws std::runtime_error If the worker cannot be reached.
+   */
+  BigNumber Encrypt(const std::string& key_id, const BigNumber& message);
+
+  /**
+   * Decrypts `ciphertext` with the private key `key_id` on its worker.
+   *
+   * @throws std::invalid_argument If the worker does not know the key or
+   *         rejects the ciphertext.
+   * @throws std::runtime_error If the worker cannot be reached.
+   */
+  BigNumber Decrypt(const std::string& key_id, const BigNumber& ciphertext);
+
+  /**
+   * Returns the key ids held by worker `id`.
+   */
+  std::vector<std::string> ListKeys(const std::string& id);
+
+  /**
+   * Collects the counters of every worker.
+   */
+  ClusterMetrics Metrics();
+
+  /**
+   * Serves the worker protocol on `socket_path`, forwarding every key
+   * request to the owning worker, until a shutdown request arrives.
+   *
+   * Clients can then talk to the whole deployment through one socket; a
+   * metrics request returns the aggregated `ClusterMetrics`.
+   */
+  void Serve(const std::string& socket_path);
+
+ private:
+  struct Worker;
+  // A key copied to its new owner during a rebalance, with the key pair as
+  // read from its old owner so that a failed rebalance can put it back.
+  struct MovedKey {
+    std::string key_id;
+    Worker* from;
+    Worker* to;
+    std::string key_pair;
+  };
+
+  // Sends one request to `worker`; returns the response payload.
+  static std::string Call(Worker& worker, ShardOp op, const std::string& key_id,
+                          const std::string& payload);
+  // Sends a key request to the owner of `key_id`; takes the shared lock.
+  std::string Forward(ShardOp op, const std::string& key_id, const std::string& payload);
+  Worker& Find(const std::string& id);
+  // Moves the keys among `key_ids` that the ring assigns elsewhere off
+  // `from`, appending each to `moved` once its new owner holds it.
+  void Move(Worker& from, const std::vector<std::string>& key_ids,
+            std::vector<MovedKey>& moved);
+  // Returns moved keys to their old owners and drops the new copies, as far
+  // as the workers can be reached.
+  void Restore(const std::vector<MovedKey>& moved);
+  size_t Remove(const std::string& id, bool shutdown);
+
+  mutable std::shared_mutex mutex_;  // Exclusive while rebalancing.
+  HashRing ring_;
+  std::map<std::string, std::unique_ptr<Worker>> workers_;
+  std::atomic<uint64_t> keys_moved_{0};
+  std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * A client of a worker or router socket speaking the shard protocol.
+ *
+ * Lets processes other than the router's use a deployment served with
+ * `ShardRouter::Serve` (or a single `RunShardWorker`). Not thread-safe; use
+ * one client per thread.
+ */
+class ShardClient {
+ public:
+  /**
+   * Connects to `socket_path`.
+   *
+   * @throws std::runtime_error If the connection fails.
+   */
+  explicit ShardClient(const std::string& socket_path);
+  ~ShardClient();
+
+  ShardClient(const ShardClient&) = delete;
+  ShardClient& operator=(const ShardClient&) = delete;
+
+  void PutKey(const std::string& key_id, const KeyPair& key_pair);
+  BigNumber Encrypt(const std::string& key_id, const BigNumber& message);
+  BigNumber Decrypt(const std::string& key_id, const BigNumber& ciphertext);
+
+  /**
+   * Returns the worker's counters, or the aggregated counters of every
+   * worker when connected to a router.
+   */
+  ClusterMetrics Metrics();
+
+  /**
+   * Asks the worker or router to exit.
+   */
+  void Shutdown();
+
+ private:
+  std::unique_ptr<ShardConnection> connection_;
+};
+
+}  // namespace rsa_app
+
+#endif  // RSA_APP_SHARD_H_
@@ -0,0 +1,179 @@
+#include "shard.h"
+#include "rsa.h"
+#include "thread_pool.h"
+#include <openssl/bn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+void PrintUsage(std::ostream& out) {
+    out << "Usage:\n"
+           "  rsa_shard worker SOCKET\n"
+           "      Serves keys on SOCKET until a shutdown request.\n"
+           "  rsa_shard router SOCKET ID=WORKER_SOCKET...\n"
+           "      Serves SOCKET, routing each key to its worker by consistent hashing.\n"
+           "  rsa_shard demo [--workers N] [--keys N] [--bits N] [--threads N] [--seconds S]\n"
+           "      Forks N local workers (default 4), loads keys (default 64), runs decrypt\n"
+           "      load, then adds and removes a worker and prints the metrics.\n";
+}
+
+void PrintMetrics(const rsa_app::ClusterMetrics& metrics) {
+    std::cout << std::left << std::setw(10) << "worker" << std::right << std::setw(8) << "keys"
+              << std::setw(10) << "encrypts" << std::setw(10) << "decrypts" << std::setw(8)
+              << "errors" << std::setw(10) << "busy s\n";
+    for (const auto& shard : metrics.shards) {
+        std::cout << std::left << std::setw(10) << shard.worker << std::right << std::setw(8)
+                  << shard.keys << std::setw(10) << shard.encrypts << std::setw(10)
+                  << shard.decrypts << std::setw(8) << shard.errors << std::setw(9)
+                  << std::fixed << std::setprecision(2) << shard.busy_seconds << "\n";
+    }
+    std::cout << "total: " << metrics.keys << " keys, " << metrics.requests << " requests, "
+              << metrics.errors << " errors, " << metrics.keys_moved << " keys moved, "
+              << std::setprecision(1) << metrics.requests_per_second << " requests/s over "
+              << metrics.uptime_seconds << " s\n";
+}
+
+// Decrypts with random keys from `threads` threads for `seconds`; returns
+// decrypts per second.
+double RunLoad(rsa_app::ShardRouter& router, const std::vector<std::string>& key_ids,
+               const std::vector<BigNumber>& ciphertexts, size_t threads, double seconds) {
+    rsa_app::ThreadPool pool(threads);
+    std::atomic<size_t> done{0};
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration<double>(seconds);
+    pool.ParallelFor(threads, [&](size_t begin, size_t end) {
+        for (size_t worker = begin; worker < end; ++worker) {
+            size_t count = 0;
+            for (size_t i = worker; std::chrono::steady_clock::now() < deadline; i += threads) {
+                size_t key = i * 7919 % key_ids.size();
+                router.Decrypt(key_ids[key], ciphertexts[key]);
+                ++count;
+            }
+            done += count;
+        }
+    });
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(done) / elapsed.count();
+}
+
+int RunDemo(int argc, char** argv) {
+    size_t workers = 4, keys = 64, threads = rsa_app::ThreadPool::DefaultThreadCount();
+    int bits = 2048;
+    double seconds = 2.0;
+    for (int i = 2; i < argc; i += 2) {
+        std::string flag = argv[i];
+        if (i + 1 >= argc) throw std::invalid_argument("Missing value for " + flag);
+        std::string value = argv[i + 1];
+        if (flag == "--workers") {
+            workers = std::stoul(value);
+        } else if (flag == "--keys") {
+            keys = std::stoul(value);
+        } else if (flag == "--bits") {
+            bits = std::stoi(value);
+        } else if (flag == "--threads") {
+            threads = std::stoul(value);
+        } else if (flag == "--seconds") {
+            seconds = std::stod(value);
+        } else {
+            throw std::invalid_argument("Unknown option " + flag);
+        }
+    }
+    if (workers < 2 || keys == 0 || threads == 0) {
+        throw std::invalid_argument("demo needs at least 2 workers, 1 key and 1 thread");
+    }
+
+    // All workers, the spare included, are forked before any thread starts.
+    std::string prefix = "/tmp/rsa_shard_" + std::to_string(getpid()) + "_";
+    std::vector<std::string> sockets;
+    std::vector<pid_t> pids;
+    for (size_t i = 0; i <= workers; ++i) {
+        sockets.push_back(prefix + std::to_string(i) + ".sock");
+        pids.push_back(rsa_app::SpawnShardWorker(sockets.back()));
+    }
+
+    rsa_app::ShardRouter router;
+    for (size_t i = 0; i < workers; ++i) router.AddWorker("w" + std::to_string(i), sockets[i]);
+
+    std::cout << "Loading " << keys << " " << bits << "-bit keys into " << workers
+              << " workers\n";
+    std::vector<std::string> key_ids;
+    std::vector<BigNumber> ciphertexts;
+    BigNumber message = rsa_app::StringToNumber("sharded key service");
+    // A few distinct keys stand in for many tenants to keep setup short.
+    std::vector<rsa_app::KeyPair> pairs;
+    for (size_t i = 0; i < keys; ++i) {
+        if (pairs.size() < 8) pairs.push_back(rsa_app::GenerateKeyPair(bits));
+        const rsa_app::KeyPair& pair = pairs[i % pairs.size()];
+        key_ids.push_back("tenant-" + std::to_string(i));
+        router.PutKey(key_ids.back(), pair);
+        ciphertexts.push_back(rsa_app::Encrypt(message, pair.public_key));
+    }
+
+    std::cout << "\n" << workers << " workers: " << std::fixed << std::setprecision(1)
+              << RunLoad(router, key_ids, ciphertexts, threads, seconds) << " decrypts/s\n";
+    std::string spare = "w" + std::to_string(workers);
+    size_t moved = router.AddWorker(spare, sockets[workers]);
+    std::cout << "added " << spare << ", moved " << moved << " keys\n";
+    std::cout << workers + 1 << " workers: "
+              << RunLoad(router, key_ids, ciphertexts, threads, seconds) << " decrypts/s\n";
+    moved = router.ShutdownWorker("w0");
+    std::cout << "removed w0, moved " << moved << " keys\n";
+    std::cout << workers << " workers: "
+              << RunLoad(router, key_ids, ciphertexts, threads, seconds) << " decrypts/s\n\n";
+    PrintMetrics(router.Metrics());
+
+    for (size_t i = 1; i <= workers; ++i) {
+        std::string id = "w" + std::to_string(i);
+        // The last worker keeps its keys; stop it directly.
+        if (i == workers) {
+            rsa_app::ShardClient(sockets[i]).Shutdown();
+        } else {
+            router.ShutdownWorker(id);
+        }
+    }
+    for (pid_t pid : pids) waitpid(pid, nullptr, 0);
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    try {
+        if (mode == "worker" && argc == 3) {
+            rsa_app::RunShardWorker(argv[2]);
+            return 0;
+        }
+        if (mode == "router" && argc >= 4) {
+            rsa_app::ShardRouter router;
+            for (int i = 3; i < argc; ++i) {
+                std::string worker = argv[i];
+                size_t equals = worker.find('=');
+                if (equals == std::string::npos) {
+                    throw std::invalid_argument("Expected ID=WORKER_SOCKET, got " + worker);
+                }
+                router.AddWorker(worker.substr(0, equals), worker.substr(equals + 1));
+            }
+            router.Serve(argv[2]);
+            return 0;
+        }
+        if (mode == "demo") return RunDemo(argc, argv);
+    } catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << "\n";
+        PrintUsage(std::cerr);
+        return 2;
+    } catch (const std::exception& e) {
+        std::cerr << "An error occurred: " << e.what() << "\n";
+        return 1;
+    }
+    PrintUsage(std::cerr);
+    return 2;
+}
@@ -0,0 +1,221 @@
+#include "stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+namespace rsa_app {
+
+double Percentile(const std::vector<double>& sorted, double q) {
+  if (sorted.size() == 1) return sorted[0];
+  double position = q * static_cast<double>(sorted.size() - 1);
+  size_t lower = static_cast<size_t>(std::floor(position));
+  size_t upper = std::min(lower + 1, sorted.size() - 1);
+  double fraction = position - static_cast<double>(lower);
+  return sorted[lower] + (sorted[upper] - sorted[lower]) * fraction;
+}
+
+SampleSummary Summarize(std::vector<double> samples) {
+  SampleSummary summary;
+  if (samples.empty()) return summary;
+  std::sort(samples.begin(), samples.end());
+
+  summary.count = samples.size();
+  summary.min = samples.front();
+  summary.max = samples.back();
+  summary.mean = std::accumulate(samples.begin(), samples.end(), 0.0) /
+                 static_cast<double>(samples.size());
+  if (samples.size() > 1) {
+    double squares = 0.0;
+    for (double value : samples) {
+      squares += (value - summary.mean) * (value - summary.mean);
+    }
+    summary.stddev =
+        std::sqrt(squares / static_cast<double>(samples.size() - 1));
+  }
+  summary.p50 = Percentile(samples, 0.50);
+  summary.p90 = Percentile(samples, 0.90);
+  summary.p95 = Percentile(samples, 0.95);
+  summary.p99 = Percentile(samples, 0.99);
+  return summary;
+}
+
+Histogram BuildHistogram(const std::vector<double>& samples, size_t bins) {
+  Histogram histogram;
+  if (bins == 0) bins = 1;
+  histogram.counts.assign(bins, 0);
+  if (samples.empty()) return histogram;
+
+  auto [min_it, max_it] = std::minmax_element(samples.begin(), samples.end());
+  histogram.min = *min_it;
+  double range = *max_it - *min_it;
+  histogram.bin_width = range > 0 ? range / static_cast<double>(bins) : 0.0;
+  for (double value : samples) {
+    size_t bin = 0;
+    if (histogram.bin_width > 0) {
+      bin = static_cast<size_t>((value - histogram.min) / histogram.bin_width);
+      bin = std::min(bin, bins - 1);  // The maximum belongs to the last bin.
+    }
+    ++histogram.counts[bin];
+  }
+  return histogram;
+}
+
+std::vector<std::pair<double, double>> EmpiricalCdf(
+    std::vector<double> samples) {
+  std::vector<std::pair<double, double>> cdf;
+  std::sort(samples.begin(), samples.end());
+  double total = static_cast<double>(samples.size());
+  for (size_t i = 0; i < samples.size(); ++i) {
+    if (i + 1 < samples.size() && samples[i + 1] == samples[i]) continue;
+    cdf.emplace_back(samples[i], static_cast<double>(i + 1) / total);
+  }
+  return cdf;
+}
+
+PowerLawFit FitPowerLaw(const std::vector<double>& x,
+                        const std::vector<double>& y) {
+  std::vector<double> log_x, log_y;
+  for (size_t i = 0; i < x.size() && i < y.size(); ++i) {
+    if (x[i] > 0 && y[i] > 0) {
+      log_x.push_back(std::log(x[i]));
+      log_y.push_back(std::log(y[i]));
+    }
+  }
+  PowerLawFit fit;
+  size_t n = log_x.size();
+  if (n < 2) return fit;
+
+  double mean_x = std::accumulate(log_x.begin(), log_x.end(), 0.0) / n;
+  double mean_y = std::accumulate(log_y.begin(), log_y.end(), 0.0) / n;
+  double sxx = 0.0, sxy = 0.0, syy = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    sxx += (log_x[i] - mean_x) * (log_x[i] - mean_x);
+    sxy += (log_x[i] - mean_x) * (log_y[i] - mean_y);
+    syy += (log_y[i] - mean_y) * (log_y[i] - mean_y);
+  }
+  if (sxx == 0) return fit;
+  fit.exponent = sxy / sxx;
+  fit.coefficient = std::exp(mean_y - fit.exponent * mean_x);
+  fit.r_squared = syy > 0 ? (sxy * sxy) / (sxx * syy) : 1.0;
+  return fit;
+}
+
+PowerLawFit FitFixedExponent(const std::vector<double>& x,
+                             const std::vector<double>& y, double exponent) {
+  PowerLawFit fit;
+  fit.exponent = exponent;
+  size_t n = std::min(x.size(), y.size());
+  if (n == 0) return fit;
+
+  // Minimizing sum (y - a * x^k)^2 gives a = sum(y x^k) / sum(x^2k).
+  double numerator = 0.0, denominator = 0.0, mean_y = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    double basis = std::pow(x[i], exponent);
+    numerator += y[i] * basis;
+    denominator += basis * basis;
+    mean_y += y[i];
+  }
+  mean_y /= static_cast<double>(n);
+  if (denominator == 0) return fit;
+  fit.coefficient = numerator / denominator;
+
+  double residual = 0.0, total = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    double predicted = fit.coefficient * std::pow(x[i], exponent);
+    residual += (y[i] - predicted) * (y[i] - predicted);
+    total += (y[i] - mean_y) * (y[i] - mean_y);
+  }
+  fit.r_squared = total > 0 ? 1.0 - residual / total : 1.0;
+  return fit;
+}
+
+namespace {
+
+double Median(std::vector<double> samples) {
+  std::sort(samples.begin(), samples.end());
+  return Percentile(samples, 0.5);
+}
+
+}  // namespace
+
+MannWhitneyResult MannWhitneyU(const std::vector<double>& a,
+                               const std::vector<double>& b) {
+  MannWhitneyResult result;
+  if (a.empty() || b.empty()) return result;
+
+  // Pooled values tagged with their sample, ranked with ties averaged.
+  std::vector<std::pair<double, bool>> pooled;
+  for (double value : a) pooled.emplace_back(value, true);
+  for (double value : b) pooled.emplace_back(value, false);
+  std::sort(pooled.begin(), pooled.end());
+  double n = static_cast<double>(pooled.size());
+  double rank_sum_a = 0.0;
+  double tie_term = 0.0;  // Sum of t^3 - t over groups of t ties.
+  for (size_t i = 0; i < pooled.size();) {
+    size_t j = i;
+    while (j < pooled.size() && pooled[j].first == pooled[i].first) ++j;
+    double rank = (static_cast<double>(i + 1) + static_cast<double>(j)) / 2.0;
+    double ties = static_cast<double>(j - i);
+    tie_term += ties * ties * ties - ties;
+    for (size_t k = i; k < j; ++k) {
+      if (pooled[k].second) rank_sum_a += rank;
+    }
+    i = j;
+  }
+
+  double na = static_cast<double>(a.size());
+  double nb = static_cast<double>(b.size());
+  result.u = rank_sum_a - na * (na + 1.0) / 2.0;
+  double mean = na * nb / 2.0;
+  double variance = na * nb / 12.0 * ((n + 1.0) - tie_term / (n * (n - 1.0)));
+  if (variance <= 0.0) return result;
+  double difference = result.u - mean;
+  // Continuity correction towards the mean.
+  difference = difference > 0 ? std::max(0.0, difference - 0.5)
+                              : std::min(0.0, difference + 0.5);
+  result.z = difference / std::sqrt(variance);
+  result.p_value = std::erfc(std::fabs(result.z) / std::sqrt(2.0));
+  return result;
+}
+
+RatioInterval BootstrapMedianRatio(const std::vector<double>& baseline,
+                                   const std::vector<double>& candidate,
+                                   double confidence, size_t resamples,
+                                   uint64_t seed) {
+  RatioInterval interval;
+  if (baseline.empty() || candidate.empty()) return interval;
+  double base = Median(baseline);
+  if (base == 0.0) return interval;
+  interval.ratio = Median(candidate) / base;
+  interval.low = interval.high = interval.ratio;
+  if (resamples == 0) return interval;
+
+  std::mt19937_64 rng(seed);
+  auto resample = [&rng](const std::vector<double>& samples,
+                         std::vector<double>& out) {
+    std::uniform_int_distribution<size_t> pick(0, samples.size() - 1);
+    out.resize(samples.size());
+    for (double& value : out) value = samples[pick(rng)];
+    return Median(out);
+  };
+  std::vector<double> ratios;
+  ratios.reserve(resamples);
+  std::vector<double> scratch;
+  for (size_t i = 0; i < resamples; ++i) {
+    double resampled_base = resample(baseline, scratch);
+    double resampled_candidate = resample(candidate, scratch);
+    if (resampled_base > 0.0) {
+      ratios.push_back(resampled_candidate / resampled_base);
+    }
+  }
+  if (ratios.empty()) return interval;
+  std::sort(ratios.begin(), ratios.end());
+  double tail = (1.0 - confidence) / 2.0;
+  interval.low = Percentile(ratios, tail);
+  interval.high = Percentile(ratios, 1.0 - tail);
+  return interval;
+}
+
+}  // namespace rsa_app
@@ -0,0 +1,152 @@
+#ifndef RSA_APP_STATS_H_
+#define RSA_APP_STATS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace rsa_app {
+
+/**
+ * Descriptive statistics of a sample.
+ */
+struct SampleSummary {
+  size_t count = 0;
+  double min = 0.0;
+  double max = 0.0;
+  double mean = 0.0;
+  double stddev = 0.0;  // Sample standard deviation (n - 1 denominator).
+  double p50 = 0.0;
+  double p90 = 0.0;
+  double p95 = 0.0;
+  double p99 = 0.0;
+};
+
+/**
+ * Equal-width histogram between the sample minimum and maximum.
+ */
+struct Histogram {
+  double min = 0.0;        // Lower edge of the first bin.
+  double bin_width = 0.0;  // Width of every bin.
+  std::vector<size_t> counts;
+};
+
+/**
+ * Least-squares fit of `y = coefficient * x^exponent`.
+ */
+struct PowerLawFit {
+  double coefficient = 0.0;
+  double exponent = 0.0;
+  double r_squared = 0.0;  // Goodness of fit in log-log space.
+};
+
+/**
+ * Computes the `q`-quantile of a sorted sample with linear interpolation.
+ *
+ * @param sorted The sample in ascending order (must not be empty).
+ * @param q The quantile in [0, 1].
+ * @return The interpolated quantile.
+ */
+double Percentile(const std::vector<double>& sorted, double q);
+
+/**
+ * Computes descriptive statistics of a sample.
+ *
+ * @param samples The sample; may be empty, in which case all fields are 0.
+ * @return The summary.
+ */
+SampleSummary Summarize(std::vector<double> samples);
+
+/**
+ * Bins a sample into `bins` equal-width buckets.
+ *
+ * @param samples The sample.
+ * @param bins The number of buckets (at least 1).
+ * @return The histogram; all samples land in one bucket if they are equal.
+ */
+Histogram BuildHistogram(const std::vector<double>& samples, size_t bins);
+
+/**
+ * Computes the empirical CDF of a sample.
+ *
+ * @param samples The sample.
+ * @return `(value, fraction of samples <= value)` pairs in ascending order,
+ *         one per distinct value.
+ */
+std::vector<std::pair<double, double>> EmpiricalCdf(
+    std::vector<double> samples);
+
+/**
+ * Fits `y = a * x^k` by linear regression of `log y` on `log x`.
+ *
+ * Points with non-positive coordinates are ignored.
+ *
+ * @param x The independent variable.
+ * @param y The dependent variable, same size as `x`.
+ * @return The fit; all zeros if fewer than two usable points remain.
+ */
+PowerLawFit FitPowerLaw(const std::vector<double>& x,
+                        const std::vector<double>& y);
+
+/**
+ * Fits `y = a * x^exponent` for a fixed exponent by least squares.
+ *
+ * @param x The independent variable.
+ * @param y The dependent variable, same size as `x`.
+ * @param exponent The fixed exponent.
+ * @return The fit with the given exponent; `r_squared` is computed on `y`.
+ */
+PowerLawFit FitFixedExponent(const std::vector<double>& x,
+                             const std::vector<double>& y, double exponent);
+
+/**
+ * Result of a two-sided Mann-Whitney U test.
+ */
+struct MannWhitneyResult {
+  double u = 0.0;        // U statistic of the first sample.
+  double z = 0.0;        // Normal approximation, tie- and continuity-corrected.
+  double p_value = 1.0;  // Two-sided; 1 if either sample is empty.
+};
+
+/**
+ * Bootstrap estimate of `median(candidate) / median(baseline)`.
+ */
+struct RatioInterval {
+  double ratio = 0.0;  // Ratio of the sample medians.
+  double low = 0.0;    // Lower end of the confidence interval.
+  double high = 0.0;   // Upper end of the confidence interval.
+};
+
+/**
+ * Tests whether two samples come from the same distribution.
+ *
+ * Ranks the pooled samples, averaging ranks of ties, and uses the normal
+ * approximation of U, which is accurate from about eight samples each.
+ *
+ * @param a The first sample.
+ * @param b The second sample.
+ * @return U of `a`, its z-score and the two-sided p-value.
+ */
+MannWhitneyResult MannWhitneyU(const std::vector<double>& a,
+                               const std::vector<double>& b);
+
+/**
+ * Computes a percentile bootstrap confidence interval for the ratio of
+ * medians.
+ *
+ * @param baseline The reference sample (must not be empty).
+ * @param candidate The compared sample (must not be empty).
+ * @param confidence The interval's coverage, e.g. 0.95.
+ * @param resamples Bootstrap iterations.
+ * @param seed Seeds the resampling so results are reproducible.
+ * @return The ratio and its interval; all zeros if the baseline median is 0.
+ */
+RatioInterval BootstrapMedianRatio(const std::vector<double>& baseline,
+                                   const std::vector<double>& candidate,
+                                   double confidence = 0.95,
+                                   size_t resamples = 2000, uint64_t seed = 1);
+
+}  // namespace rsa_app
+
+#endif  // RSA_APP_STATS_H_
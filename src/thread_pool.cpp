@@ -0,0 +1,166 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "trace.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace rsa_app {
+
+namespace {
+
+// The pool whose worker is running on this thread, if any.
+thread_local const ThreadPool* current_pool = nullptr;
+
+// Completion of one ParallelFor call, independent of other pool users.
+struct ChunkLatch {
+  std::mutex mutex;
+  std::condition_variable done;
+  size_t remaining = 0;
+  std::exception_ptr error;
+};
+
+}  // namespace
+
+ThreadPool::ThreadPool(size_t num_threads) {
+  if (num_threads == 0) num_threads = DefaultThreadCount();
+  workers_.reserve(num_threads);
+  for (size_t i = 0; i < num_threads; ++i) {
+    workers_.emplace_back([this] { WorkerLoop(); });
+  }
+}
+
+ThreadPool::ThreadPool(size_t num_threads, const std::vector<int>& cpus)
+    : ThreadPool(num_threads != 0 ? num_threads : std::max<size_t>(cpus.size(), 1)) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+  }
+  pinned_ = CPU_COUNT(&set) > 0;
+  for (std::thread& worker : workers_) {
+    if (!pinned_) break;
+    pinned_ = pthread_setaffinity_np(worker.native_handle(), sizeof(set), &set) == 0;
+  }
+#else
+  (void)cpus;
+#endif
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    all_done_.wait(lock, [this] { return tasks_.empty() && active_ == 0; });
+    stopping_ = true;
+  }
+  task_ready_.notify_all();
+  for (std::thread& worker : workers_) worker.join();
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+  if (TracingEnabled()) {
+    // Time spent queued behind other tasks, then the task itself.
+    task = [task = std::move(task), queued_at = TraceClock::now()] {
+      TraceComplete("queue_wait", "pool", queued_at, TraceClock::now());
+      TraceSpan span("task", "pool");
+      task();
+    };
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  task_ready_.notify_one();
+}
+
+void ThreadPool::Wait() {
+  if (current_pool == this) {
+    throw std::logic_error("ThreadPool::Wait called from one of the pool's own tasks");
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  all_done_.wait(lock, [this] { return tasks_.empty() && active_ == 0; });
+  if (first_error_) {
+    std::exception_ptr error = first_error_;
+    first_error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void ThreadPool::ParallelFor(
+    size_t count, const std::function<void(size_t, size_t)>& body) {
+  if (count == 0) return;
+  TraceSpan span("ParallelFor", "pool", static_cast<int64_t>(count));
+  // Chunks queued from a worker could wait behind the task that queued
+  // them, so a nested call runs inline.
+  if (current_pool == this) {
+    body(0, count);
+    return;
+  }
+  // A few chunks per worker keeps the load balanced when items vary in cost.
+  size_t chunks = std::min(count, Size() * 4);
+  size_t chunk_size = (count + chunks - 1) / chunks;
+  ChunkLatch latch;
+  latch.remaining = (count + chunk_size - 1) / chunk_size;
+  for (size_t begin = 0; begin < count; begin += chunk_size) {
+    size_t end = std::min(count, begin + chunk_size);
+    Submit([&body, &latch, begin, end] {
+      std::exception_ptr error;
+      try {
+        body(begin, end);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      // Notify under the lock: the caller may destroy the latch once it
+      // sees zero.
+      std::lock_guard<std::mutex> lock(latch.mutex);
+      if (error && !latch.error) latch.error = error;
+      if (--latch.remaining == 0) latch.done.notify_all();
+    });
+  }
+  std::unique_lock<std::mutex> lock(latch.mutex);
+  latch.done.wait(lock, [&latch] { return latch.remaining == 0; });
+  if (latch.error) std::rethrow_exception(latch.error);
+}
+
+size_t ThreadPool::DefaultThreadCount() {
+  unsigned int count = std::thread::hardware_concurrency();
+  return count == 0 ? 1 : count;
+}
+
+void ThreadPool::WorkerLoop() {
+  current_pool = this;
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      task_ready_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) return;
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+      ++active_;
+    }
+
+    std::exception_ptr error;
+    try {
+      task();
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (error && !first_error_) first_error_ = error;
+      --active_;
+      if (tasks_.empty() && active_ == 0) all_done_.notify_all();
+    }
+  }
+}
+
+}  // namespace rsa_app
@@ -0,0 +1,118 @@
+#ifndef RSA_APP_THREAD_POOL_H_
+#define RSA_APP_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rsa_app {
+
+/**
+ * A fixed-size pool of worker threads executing queued tasks in FIFO order.
+ *
+ * Used by the batch encryption/decryption paths to spread independent
+ * modular exponentiations across cores.
+ */
+class ThreadPool {
+ public:
+  /**
+   * Starts `num_threads` workers.
+   *
+   * @param num_threads The number of workers; 0 selects
+   *                    `DefaultThreadCount()`.
+   */
+  explicit ThreadPool(size_t num_threads = 0);
+
+  /**
+   * Starts `num_threads` workers that may only run on `cpus`.
+   *
+   * Pinning uses the Linux affinity API; elsewhere, or if the kernel
+   * refuses it, the workers are left unpinned and `Pinned()` says so.
+   *
+   * @param num_threads The number of workers; 0 selects one per CPU.
+   * @param cpus CPU ids as numbered by the kernel.
+   */
+  ThreadPool(size_t num_threads, const std::vector<int>& cpus);
+
+  /**
+   * Waits for queued tasks to finish and joins the workers.
+   */
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+   * Returns the number of worker threads.
+   */
+  size_t Size() const { return workers_.size(); }
+
+  /**
+   * Returns true if every worker is pinned to the CPUs it was given.
+   */
+  bool Pinned() const { return pinned_; }
+
+  /**
+   * Queues a task for execution on a worker.
+   *
+   * @param task The task to run. Exceptions it throws are captured and
+   *             rethrown by the next `Wait()`.
+   */
+  void Submit(std::function<void()> task);
+
+  /**
+   * Blocks until every task submitted to the pool has completed.
+   *
+   * Completion and errors are pool-wide: with several callers submitting
+   * to one pool, each waits for the others' tasks and may receive their
+   * exceptions. Such callers should use `ParallelFor` instead.
+   *
+   * @throws Rethrows the first exception raised by a task since the last
+   *         call to `Wait()`.
+   * @throws std::logic_error If called from one of the pool's tasks, which
+   *         would wait for itself.
+   */
+  void Wait();
+
+  /**
+   * Runs `body` over `[0, count)` split into contiguous chunks and waits for
+   * completion.
+   *
+   * Each call waits only for its own chunks and rethrows only their
+   * exceptions, so any number of threads may call it on one pool. Called
+   * from one of the pool's own tasks, it runs `body(0, count)` inline.
+   *
+   * @param count The number of items.
+   * @param body Called as `body(begin, end)` for each chunk.
+   * @throws Rethrows the first exception raised by `body`.
+   */
+  void ParallelFor(size_t count,
+                   const std::function<void(size_t, size_t)>& body);
+
+  /**
+   * Returns the number of hardware threads, or 1 if it cannot be detected.
+   */
+  static size_t DefaultThreadCount();
+
+ private:
+  void WorkerLoop();
+
+  std::vector<std::thread> workers_;        ///< The worker threads.
+  bool pinned_ = false;                     ///< Workers have a CPU affinity.
+  std::deque<std::function<void()>> tasks_; ///< Pending tasks.
+  std::mutex mutex_;                        ///< Guards all members below.
+  std::condition_variable task_ready_;      ///< Signals new tasks or stop.
+  std::condition_variable all_done_;        ///< Signals an idle pool.
+  size_t active_ = 0;                       ///< Tasks currently running.
+  bool stopping_ = false;                   ///< Set by the destructor.
+  std::exception_ptr first_error_;          ///< First task failure.
+};
+
+}  // namespace rsa_app
+
+#endif  // RSA_APP_THREAD_POOL_H_
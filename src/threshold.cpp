@@ -0,0 +1,361 @@
+#include "threshold.h"
+
+#include <openssl/crypto.h>
+#include <openssl/err.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <future>
+#include <stdexcept>
+#include <utility>
+
+namespace rsa_app {
+
+namespace {
+
+// Marks entries of a partial decryption response.
+constexpr char kEntryOk = 0;
+constexpr char kEntryFailed = 1;
+
+}  // namespace
+
+std::vector<KeyShare> SplitPrivateKey(const PrivateKey& private_key, size_t count) {
+  if (count == 0) throw std::invalid_argument("A key needs at least one share");
+  std::vector<KeyShare> shares(count);
+  BigNumber rest = private_key.d.Copy();
+  int bits = private_key.d.NumBits() + kShareSlackBits;
+  for (size_t i = 0; i + 1 < count; ++i) {
+    shares[i].n = private_key.n.Copy();
+    if (!shares[i].d.GenerateRandom(bits)) {
+      throw std::runtime_error("Failed to generate a key share");
+    }
+    rest = rest.Sub(shares[i].d.Get());
+  }
+  KeyShare& last = shares.back();
+  last.n = private_key.n.Copy();
+  last.negative = BN_is_negative(rest.Get()) != 0;
+  rest.SetNegative(0);
+  last.d = std::move(rest);
+  return shares;
+}
+
+BigNumber PartialDecrypt(const BigNumber& ciphertext, const KeyShare& share) {
+  PrivateKey key{share.n.Copy(), share.d.Copy()};
+  BigNumber partial = Decrypt(ciphertext, key);
+  BN_clear(key.d.Get());
+  if (!share.negative) return partial;
+  BigNumber inverse;
+  BN_CTX* ctx = BN_CTX_new();
+  bool ok = ctx && BN_mod_inverse(inverse.Get(), partial.Get(), share.n.Get(), ctx) != nullptr;
+  BN_CTX_free(ctx);
+  if (!ok) {
+    ERR_clear_error();
+    throw std::invalid_argument("Ciphertext has no inverse modulo n");
+  }
+  return inverse;
+}
+
+BigNumber CombinePartials(const std::vector<BigNumber>& partials, const BIGNUM* modulus) {
+  BigNumber product;
+  product.SetWord(1);
+  BN_CTX* ctx = BN_CTX_new();
+  for (const auto& partial : partials) {
+    if (!ctx || !BN_mod_mul(product.Get(), product.Get(), partial.Get(), modulus, ctx)) {
+      BN_CTX_free(ctx);
+      throw std::runtime_error("BN_mod_mul failed");
+    }
+  }
+  BN_CTX_free(ctx);
+  return product;
+}
+
+std::string EncodeKeyShare(const KeyShare& share) {
+  std::string out;
+  AppendShardField(out, share.n.ToBytes());
+  AppendShardField(out, share.d.ToBytes());
+  out.push_back(share.negative ? 1 : 0);
+  return out;
+}
+
+KeyShare DecodeKeyShare(const std::string& payload) {
+  size_t pos = 0;
+  KeyShare share;
+  share.n = BigNumber::FromBytes(ReadShardField(payload, pos));
+  share.d = BigNumber::FromBytes(ReadShardField(payload, pos));
+  if (payload.size() != pos + 1) throw std::invalid_argument("Malformed key share");
+  share.negative = payload[pos] != 0;
+  return share;
+}
+
+std::string PartialDecryptBatch(const std::map<std::string, KeyShare>& shares,
+                                const std::string& payload) {
+  std::string out;
+  size_t pos = 0;
+  while (pos < payload.size()) {
+    std::string key_id = ReadShardField(payload, pos);
+    BigNumber ciphertext = BigNumber::FromBytes(ReadShardField(payload, pos));
+    std::string entry(1, kEntryOk);
+    try {
+      auto found = shares.find(key_id);
+      if (found == shares.end()) throw std::invalid_argument("Unknown key id " + key_id);
+      entry += PartialDecrypt(ciphertext, found->second).ToBytes();
+    } catch (const std::exception& e) {
+      entry.assign(1, kEntryFailed);
+      entry += e.what();
+    }
+    AppendShardField(out, entry);
+  }
+  return out;
+}
+
+/**
+ * A share holder and the connection the coordinator uses for it.
+ */
+struct ThresholdCoordinator::Holder {
+  std::string socket_path;
+  std::mutex mutex;  // Serializes use of the connection.
+  std::unique_ptr<ShardConnection> connection;
+
+  std::string Call(ShardOp op, const std::string& key_id, const std::string& payload) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!connection || connection->Broken()) {
+      connection = std::make_unique<ShardConnection>(socket_path);
+    }
+    return connection->Call(op, key_id, payload);
+  }
+};
+
+/**
+ * One queued ciphertext.
+ */
+struct ThresholdCoordinator::Request {
+  std::string key_id;
+  const BigNumber* ciphertext = nullptr;  // Owned by the waiting caller.
+  std::promise<BigNumber> result;
+};
+
+ThresholdCoordinator::ThresholdCoordinator(const std::vector<std::string>& holder_sockets,
+                                           size_t max_batch)
+    : max_batch_(max_batch), pool_(holder_sockets.empty() ? 1 : holder_sockets.size()) {
+  if (holder_sockets.empty()) throw std::invalid_argument("No share holders given");
+  if (max_batch == 0) throw std::invalid_argument("max_batch must be positive");
+  for (const auto& path : holder_sockets) {
+    auto holder = std::make_unique<Holder>();
+    holder->socket_path = path;
+    holder->connection = std::make_unique<ShardConnection>(path);
+    holders_.push_back(std::move(holder));
+  }
+  dispatcher_ = std::thread([this] { DispatchLoop(); });
+}
+
+ThresholdCoordinator::~ThresholdCoordinator() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_ready_.notify_all();
+  dispatcher_.join();
+}
+
+void ThresholdCoordinator::AddKey(const std::string& key_id, const KeyPair& key_pair) {
+  // Uploaded inline: the fan-out pool belongs to the dispatcher, and keys
+  // are added rarely enough that one round trip per holder is fine.
+  std::vector<KeyShare> shares = SplitPrivateKey(key_pair.private_key, holders_.size());
+  try {
+    for (size_t i = 0; i < holders_.size(); ++i) {
+      std::string payload = EncodeKeyShare(shares[i]);
+      BN_clear(shares[i].d.Get());
+      try {
+        holders_[i]->Call(kShardPutShare, key_id, payload);
+      } catch (...) {
+        OPENSSL_cleanse(&payload[0], payload.size());
+        throw;
+      }
+      OPENSSL_cleanse(&payload[0], payload.size());
+    }
+  } catch (...) {
+    for (auto& share : shares) BN_clear(share.d.Get());
+    throw;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  public_keys_[key_id] = PublicKey{key_pair.public_key.n.Copy(), key_pair.public_key.e.Copy()};
+}
+
+BigNumber ThresholdCoordinator::Decrypt(const std::string& key_id, const BigNumber& ciphertext) {
+  auto request = std::make_shared<Request>();
+  request->key_id = key_id;
+  request->ciphertext = &ciphertext;
+  std::future<BigNumber> result = request->result.get_future();
+  Submit({request});
+  return result.get();
+}
+
+std::vector<BigNumber> ThresholdCoordinator::DecryptBatch(
+    const std::string& key_id, const std::vector<BigNumber>& ciphertexts) {
+  std::vector<std::shared_ptr<Request>> requests;
+  std::vector<std::future<BigNumber>> futures;
+  for (const auto& ciphertext : ciphertexts) {
+    requests.push_back(std::make_shared<Request>());
+    requests.back()->key_id = key_id;
+    requests.back()->ciphertext = &ciphertext;
+    futures.push_back(requests.back()->result.get_future());
+  }
+  Submit(requests);
+  std::vector<BigNumber> plaintexts;
+  plaintexts.reserve(futures.size());
+  for (auto& future : futures) plaintexts.push_back(future.get());
+  return plaintexts;
+}
+
+void ThresholdCoordinator::Submit(const std::vector<std::shared_ptr<Request>>& requests) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.insert(queue_.end(), requests.begin(), requests.end());
+  }
+  work_ready_.notify_one();
+}
+
+void ThresholdCoordinator::DispatchLoop() {
+  for (;;) {
+    std::vector<std::shared_ptr<Request>> batch;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_ready_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (stopping_) {
+        batch.swap(queue_);
+        lock.unlock();
+        FailRequests(batch, std::make_exception_ptr(
+                                std::runtime_error("Threshold coordinator shut down")));
+        return;
+      }
+      size_t take = std::min(max_batch_, queue_.size());
+      batch.assign(queue_.begin(), queue_.begin() + static_cast<std::ptrdiff_t>(take));
+      queue_.erase(queue_.begin(), queue_.begin() + static_cast<std::ptrdiff_t>(take));
+    }
+    try {
+      RunRound(batch);
+    } catch (...) {
+      // Whatever the round did not answer fails instead of waiting forever.
+      FailRequests(batch, std::current_exception());
+    }
+  }
+}
+
+void ThresholdCoordinator::FailRequests(const std::vector<std::shared_ptr<Request>>& requests,
+                                        std::exception_ptr error) {
+  for (const auto& request : requests) {
+    try {
+      request->result.set_exception(error);
+    } catch (const std::future_error&) {
+      // Already answered.
+    }
+  }
+}
+
+void ThresholdCoordinator::RunRound(const std::vector<std::shared_ptr<Request>>& batch) {
+  // Requests for unknown keys or oversized ciphertexts fail here; the rest
+  // go to the holders.
+  std::vector<std::shared_ptr<Request>> sent;
+  std::vector<PublicKey> keys;
+  std::string payload;
+  std::vector<std::pair<std::shared_ptr<Request>, std::exception_ptr>> rejected;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& request : batch) {
+      auto found = public_keys_.find(request->key_id);
+      if (found == public_keys_.end() ||
+          BN_cmp(request->ciphertext->Get(), found->second.n.Get()) >= 0) {
+        const char* what = found == public_keys_.end() ? "Unknown key id "
+                                                       : "Ciphertext too large for key ";
+        rejected.emplace_back(
+            request, std::make_exception_ptr(std::invalid_argument(what + request->key_id)));
+        continue;
+      }
+      keys.push_back(PublicKey{found->second.n.Copy(), found->second.e.Copy()});
+      sent.push_back(request);
+      AppendShardField(payload, request->key_id);
+      AppendShardField(payload, request->ciphertext->ToBytes());
+    }
+  }
+
+  // Fan out: one message per holder carrying the whole batch.
+  std::vector<std::string> responses(holders_.size());
+  std::vector<std::exception_ptr> errors(holders_.size());
+  if (!sent.empty()) {
+    pool_.ParallelFor(holders_.size(), [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        try {
+          responses[i] = holders_[i]->Call(kShardPartialDecrypt, std::string(), payload);
+        } catch (...) {
+          errors[i] = std::current_exception();
+        }
+      }
+    });
+  }
+
+  std::vector<size_t> positions(holders_.size(), 0);
+  std::vector<BigNumber> plaintexts(sent.size());
+  std::vector<std::exception_ptr> failed(sent.size());
+  size_t failures = rejected.size();
+  for (size_t j = 0; j < sent.size(); ++j) {
+    std::exception_ptr error;
+    std::vector<BigNumber> partials;
+    for (size_t i = 0; i < holders_.size(); ++i) {
+      if (errors[i]) {
+        if (!error) error = errors[i];
+        continue;
+      }
+      try {
+        std::string entry = ReadShardField(responses[i], positions[i]);
+        if (entry.empty() || entry[0] != kEntryOk) {
+          std::string what = entry.empty() ? "Malformed share holder response" : entry.substr(1);
+          throw std::invalid_argument(what);
+        }
+        partials.push_back(BigNumber::FromBytes(entry.substr(1)));
+      } catch (...) {
+        if (!error) error = std::current_exception();
+      }
+    }
+    if (!error) {
+      try {
+        BigNumber plaintext = CombinePartials(partials, keys[j].n.Get());
+        BigNumber check = Encrypt(plaintext, keys[j]);
+        if (BN_cmp(check.Get(), sent[j]->ciphertext->Get()) != 0) {
+          throw std::runtime_error("Combined decryption does not verify for key " +
+                                   sent[j]->key_id);
+        }
+        plaintexts[j] = std::move(plaintext);
+        continue;
+      } catch (...) {
+        error = std::current_exception();
+      }
+    }
+    failed[j] = error;
+    ++failures;
+  }
+
+  // Counted before answering, so that a caller sees its own request in the
+  // metrics.
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    metrics_.requests += batch.size();
+    metrics_.failures += failures;
+    if (!sent.empty()) ++metrics_.rounds;
+    metrics_.largest_batch = std::max(metrics_.largest_batch, sent.size());
+  }
+  for (auto& entry : rejected) entry.first->result.set_exception(entry.second);
+  for (size_t j = 0; j < sent.size(); ++j) {
+    if (failed[j]) {
+      sent[j]->result.set_exception(failed[j]);
+    } else {
+      sent[j]->result.set_value(std::move(plaintexts[j]));
+    }
+  }
+}
+
+ThresholdMetrics ThresholdCoordinator::Metrics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return metrics_;
+}
+
+}  // namespace rsa_app
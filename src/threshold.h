@@ -0,0 +1,213 @@
+#ifndef RSA_APP_THRESHOLD_H_
+#define RSA_APP_THRESHOLD_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bn_wrapper.h"
+#include "rsa.h"
+#include "shard.h"
+#include "thread_pool.h"
+
+namespace rsa_app {
+
+/**
+ * Extra random bits of each share beyond the private exponent, so the
+ * shares are statistically independent of `d`.
+ */
+constexpr int kShareSlackBits = 128;
+
+/**
+ * One additive share of a private exponent.
+ *
+ * The shares of a key satisfy `d = d_1 + ... + d_k` over the integers; the
+ * last one is usually negative, which is stored as its magnitude and a
+ * flag. Any k - 1 shares reveal nothing about `d`.
+ */
+struct KeyShare {
+  BigNumber n;            // The modulus.
+  BigNumber d;            // The magnitude of the share.
+  bool negative = false;  // True if the share is -d.
+};
+
+/**
+ * Splits a private exponent into `count` additive shares.
+ *
+ * All but the last share are uniformly random integers of
+ * `d.NumBits() + kShareSlackBits` bits from OpenSSL's RNG; the last makes
+ * the sum equal `d`. No totient is needed, so this works on the
+ * `PrivateKey` alone. Each share costs about as much to apply as `d`
+ * itself.
+ *
+ * @param private_key The key to split.
+ * @param count Number of shares; 1 returns `d` itself.
+ * @return The shares, in holder order.
+ * @throws std::invalid_argument If `count` is 0.
+ */
+std::vector<KeyShare> SplitPrivateKey(const PrivateKey& private_key, size_t count);
+
+/**
+ * Raises a ciphertext to one share: `c^d_i mod n`, or its inverse for a
+ * negative share. Uses the constant-time exponentiation `Decrypt` uses.
+ *
+ * @throws std::invalid_argument If `ciphertext >= n`, or a negative share
+ *         meets a ciphertext with no inverse mod `n`.
+ */
+BigNumber PartialDecrypt(const BigNumber& ciphertext, const KeyShare& share);
+
+/**
+ * Multiplies the partial results of all shares mod `n`, giving `c^d`.
+ */
+BigNumber CombinePartials(const std::vector<BigNumber>& partials, const BIGNUM* modulus);
+
+/**
+ * Serializes a share for `kShardPutShare`.
+ */
+std::string EncodeKeyShare(const KeyShare& share);
+
+/**
+ * Parses a share written by `EncodeKeyShare`.
+ *
+ * @throws std::invalid_argument If the payload is malformed.
+ */
+KeyShare DecodeKeyShare(const std::string& payload);
+
+/**
+ * Answers a `kShardPartialDecrypt` request on a share holder.
+ *
+ * The request lists (key id, ciphertext) pairs; the response has one entry
+ * per pair, either the partial result or why it failed, so one bad
+ * ciphertext does not fail the rest of the batch.
+ *
+ * @param shares The holder's shares by key id.
+ * @param payload The request payload.
+ * @return The response payload.
+ * @throws std::invalid_argument If the payload is malformed.
+ */
+std::string PartialDecryptBatch(const std::map<std::string, KeyShare>& shares,
+                                const std::string& payload);
+
+/**
+ * Counters of a `ThresholdCoordinator`.
+ */
+struct ThresholdMetrics {
+  uint64_t requests = 0;    // Ciphertexts decrypted or failed.
+  uint64_t failures = 0;    // Ciphertexts that failed.
+  uint64_t rounds = 0;      // Fan-outs to the share holders.
+  size_t largest_batch = 0; // Most ciphertexts sent in one round.
+
+  double MeanBatch() const { return rounds ? static_cast<double>(requests) / rounds : 0.0; }
+};
+
+/**
+ * Decrypts with keys whose private exponent is split across worker
+ * processes.
+ *
+ * `AddKey` splits `d` into one share per holder (a `RunShardWorker`
+ * process) and uploads it; the coordinator itself keeps only the public
+ * key. A decryption sends the ciphertext to every holder at once, gathers
+ * the partial exponentiations and multiplies them. The result is checked
+ * against the ciphertext with the public exponent, so a faulty holder
+ * yields an error instead of a wrong plaintext.
+ *
+ * Requests are batched per holder: a dispatcher thread runs the rounds,
+ * and while one is in flight new requests queue; the next round sends all
+ * of them (up to `max_batch`) to each holder in one message. A lone caller
+ * pays one round trip; under load the round trips are shared, and no
+ * caller runs rounds for others. A round that fails outright fails its
+ * requests, and the destructor fails any still queued.
+ *
+ * All methods are thread-safe.
+ */
+class ThresholdCoordinator {
+ public:
+  /**
+   * Connects to the share holders.
+   *
+   * @param holder_sockets One socket per holder; a key gets one share per
+   *                       holder.
+   * @param max_batch Most ciphertexts per round.
+   * @throws std::invalid_argument If there are no holders or `max_batch`
+   *         is 0.
+   * @throws std::runtime_error If a holder cannot be reached.
+   */
+  explicit ThresholdCoordinator(const std::vector<std::string>& holder_sockets,
+                                size_t max_batch = 64);
+  ~ThresholdCoordinator();
+
+  ThresholdCoordinator(const ThresholdCoordinator&) = delete;
+  ThresholdCoordinator& operator=(const ThresholdCoordinator&) = delete;
+
+  /**
+   * Splits the private key across the holders under `key_id`, replacing
+   * any key with that id.
+   */
+  void AddKey(const std::string& key_id, const KeyPair& key_pair);
+
+  /**
+   * Decrypts one ciphertext.
+   *
+   * @throws std::invalid_argument If the key is unknown or the ciphertext
+   *         is not below the modulus.
+   * @throws std::runtime_error If a holder fails or the combined result
+   *         does not verify.
+   */
+  BigNumber Decrypt(const std::string& key_id, const BigNumber& ciphertext);
+
+  /**
+   * Decrypts several ciphertexts of one key; they share rounds with each
+   * other and with concurrent `Decrypt` calls.
+   *
+   * @throws Like `Decrypt`, for the first ciphertext that fails.
+   */
+  std::vector<BigNumber> DecryptBatch(const std::string& key_id,
+                                      const std::vector<BigNumber>& ciphertexts);
+
+  /**
+   * Returns the number of share holders.
+   */
+  size_t Holders() const { return holders_.size(); }
+
+  /**
+   * Returns the request and round counters.
+   */
+  ThresholdMetrics Metrics() const;
+
+ private:
+  struct Holder;
+  struct Request;
+
+  // Queues requests for the dispatcher.
+  void Submit(const std::vector<std::shared_ptr<Request>>& requests);
+  // Runs rounds on the dispatcher thread until the destructor stops it.
+  void DispatchLoop();
+  void RunRound(const std::vector<std::shared_ptr<Request>>& batch);
+  // Fails every request of `requests` that has no result yet.
+  static void FailRequests(const std::vector<std::shared_ptr<Request>>& requests,
+                           std::exception_ptr error);
+
+  std::vector<std::unique_ptr<Holder>> holders_;
+  size_t max_batch_;
+  ThreadPool pool_;  // One thread per holder for the fan-out.
+
+  mutable std::mutex mutex_;  // Guards everything below.
+  std::condition_variable work_ready_;  // Signals queued requests or stop.
+  std::map<std::string, PublicKey> public_keys_;
+  std::vector<std::shared_ptr<Request>> queue_;
+  bool stopping_ = false;
+  ThresholdMetrics metrics_;
+
+  std::thread dispatcher_;  // Runs every round; started last.
+};
+
+}  // namespace rsa_app
+
+#endif  // RSA_APP_THRESHOLD_H_
@@ -0,0 +1,171 @@
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <openssl/bn.h>
+#include "rsa.h"
+#include "shard.h"
+#include "stats.h"
+#include "threshold.h"
+
+// Compares threshold decryption, with the private exponent split across
+// share-holder processes, against plain single-process Decrypt on the same
+// key: sequential latency, and throughput with several client threads whose
+// requests the coordinator batches per holder.
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<size_t> ParseCounts(const std::string& list) {
+    std::vector<size_t> counts;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) counts.push_back(std::stoul(item));
+    return counts;
+}
+
+// Times `iterations` sequential calls of `decrypt`; returns microseconds per call.
+template <typename DecryptFn>
+rsa_app::SampleSummary MeasureLatency(const std::vector<BigNumber>& ciphertexts,
+                                      size_t iterations, DecryptFn decrypt) {
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    for (size_t i = 0; i < iterations; ++i) {
+        auto start = Clock::now();
+        decrypt(ciphertexts[i % ciphertexts.size()]);
+        std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+        samples.push_back(elapsed.count());
+    }
+    return rsa_app::Summarize(samples);
+}
+
+// Runs `decrypt` from `threads` client threads for `seconds`; returns decrypts per second.
+template <typename DecryptFn>
+double MeasureThroughput(const std::vector<BigNumber>& ciphertexts, size_t threads,
+                         double seconds, DecryptFn decrypt) {
+    std::atomic<size_t> done{0};
+    auto start = Clock::now();
+    auto deadline = start + std::chrono::duration<double>(seconds);
+    std::vector<std::thread> clients;
+    for (size_t t = 0; t < threads; ++t) {
+        clients.emplace_back([&, t] {
+            size_t count = 0;
+            for (size_t i = t; Clock::now() < deadline; i += threads) {
+                decrypt(ciphertexts[i % ciphertexts.size()]);
+                ++count;
+            }
+            done += count;
+        });
+    }
+    for (auto& client : clients) client.join();
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    return static_cast<double>(done) / elapsed.count();
+}
+
+void PrintRow(const std::string& path, const rsa_app::SampleSummary& latency, double rate,
+              const std::string& batch) {
+    std::cout << std::left << std::setw(16) << path << std::right << std::fixed
+              << std::setprecision(1) << std::setw(12) << latency.p50 << std::setw(12)
+              << latency.p99 << std::setw(12) << rate << std::setw(12) << batch << "\n";
+}
+
+int main(int argc, char** argv) {
+    int bits = 2048;
+    std::vector<size_t> holder_counts = {2, 3};
+    size_t threads = 8, iterations = 100, max_batch = 64;
+    double seconds = 2.0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--bits") {
+            bits = std::stoi(argv[i + 1]);
+        } else if (flag == "--holders") {
+            holder_counts = ParseCounts(argv[i + 1]);
+        } else if (flag == "--threads") {
+            threads = std::stoul(argv[i + 1]);
+        } else if (flag == "--iterations") {
+            iterations = std::stoul(argv[i + 1]);
+        } else if (flag == "--max-batch") {
+            max_batch = std::stoul(argv[i + 1]);
+        } else if (flag == "--seconds") {
+            seconds = std::stod(argv[i + 1]);
+        } else {
+            std::cerr << "Unknown option " << flag
+                      << " (supported: --bits N, --holders LIST, --threads N, --iterations N,"
+                         " --max-batch N, --seconds S)\n";
+            return 2;
+        }
+    }
+    if (holder_counts.empty() || threads == 0 || iterations == 0 || max_batch == 0 ||
+        *std::min_element(holder_counts.begin(), holder_counts.end()) == 0) {
+        std::cerr << "Holder counts, threads, iterations and max batch must be positive\n";
+        return 2;
+    }
+
+    // Every holder is forked before the first thread starts.
+    size_t most = *std::max_element(holder_counts.begin(), holder_counts.end());
+    std::string prefix = "/tmp/rsa_threshold_" + std::to_string(getpid()) + "_";
+    std::vector<std::string> sockets;
+    std::vector<pid_t> pids;
+    int status = 0;
+    try {
+        for (size_t i = 0; i < most; ++i) {
+            sockets.push_back(prefix + std::to_string(i) + ".sock");
+            pids.push_back(rsa_app::SpawnShardWorker(sockets.back()));
+        }
+
+        rsa_app::KeyPair key = rsa_app::GenerateKeyPair(bits);
+        std::vector<BigNumber> ciphertexts;
+        for (int i = 0; i < 32; ++i) {
+            BigNumber message;
+            BN_rand_range(message.Get(), key.public_key.n.Get());
+            ciphertexts.push_back(rsa_app::Encrypt(message, key.public_key));
+        }
+
+        std::cout << "Threshold decryption, " << bits << "-bit key, " << threads
+                  << " client threads, max batch " << max_batch << "\n";
+        std::cout << std::left << std::setw(16) << "path" << std::right << std::setw(12)
+                  << "p50 us" << std::setw(12) << "p99 us" << std::setw(12) << "ops/s"
+                  << std::setw(12) << "mean batch" << "\n";
+        auto local = [&](const BigNumber& c) { rsa_app::Decrypt(c, key.private_key); };
+        PrintRow("single-process", MeasureLatency(ciphertexts, iterations, local),
+                 MeasureThroughput(ciphertexts, threads, seconds, local), "-");
+
+        for (size_t count : holder_counts) {
+            std::vector<std::string> holders(sockets.begin(),
+                                             sockets.begin() + static_cast<long>(count));
+            rsa_app::ThresholdCoordinator coordinator(holders, max_batch);
+            coordinator.AddKey("bench", key);
+            auto threshold = [&](const BigNumber& c) { coordinator.Decrypt("bench", c); };
+            rsa_app::SampleSummary latency = MeasureLatency(ciphertexts, iterations, threshold);
+            rsa_app::ThresholdMetrics before = coordinator.Metrics();
+            double rate = MeasureThroughput(ciphertexts, threads, seconds, threshold);
+            rsa_app::ThresholdMetrics after = coordinator.Metrics();
+            uint64_t rounds = after.rounds - before.rounds;
+            double batch = rounds ? static_cast<double>(after.requests - before.requests) / rounds
+                                  : 0.0;
+            std::ostringstream mean_batch;
+            mean_batch << std::fixed << std::setprecision(1) << batch;
+            PrintRow("threshold k=" + std::to_string(count), latency, rate, mean_batch.str());
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "An error occurred: " << e.what() << "\n";
+        status = 1;
+    }
+
+    for (const auto& socket : sockets) {
+        try {
+            rsa_app::ShardClient(socket).Shutdown();
+        } catch (const std::exception&) {
+            // The holder is already gone.
+        }
+    }
+    for (pid_t pid : pids) waitpid(pid, nullptr, 0);
+    return status;
+}
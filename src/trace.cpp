@@ -0,0 +1,251 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace rsa_app {
+
+namespace trace_internal {
+std::atomic<bool> enabled{false};
+}  // namespace trace_internal
+
+namespace {
+
+// One recorded span. The fields are relaxed atomics so an export can read
+// a ring its thread is still writing; on common targets they compile to
+// plain loads and stores.
+struct Slot {
+  std::atomic<const char*> name{nullptr};
+  std::atomic<const char*> category{nullptr};
+  std::atomic<int64_t> start_ns{0};
+  std::atomic<int64_t> duration_ns{0};
+  std::atomic<int64_t> arg{kNoTraceArg};
+  std::atomic<uint32_t> tid{0};
+};
+
+// A single-producer ring: only the owning thread writes `slots` and
+// `head`; exports read them concurrently.
+struct Ring {
+  std::unique_ptr<Slot[]> slots;
+  size_t capacity = 0;
+  std::atomic<uint64_t> head{0};     // Spans written this session.
+  std::atomic<uint64_t> session{0};  // Session the contents belong to.
+};
+
+struct Registry {
+  std::mutex mutex;  // Guards `rings` and `free_rings`.
+  std::vector<std::unique_ptr<Ring>> rings;
+  std::vector<Ring*> free_rings;  // Rings of exited threads, spans kept.
+  std::atomic<uint64_t> session{0};
+  std::atomic<size_t> capacity{0};
+  std::atomic<int64_t> origin_ns{0};
+  std::atomic<uint32_t> next_tid{1};
+};
+
+// Never destroyed, so threads exiting after main() can still return rings.
+Registry& GetRegistry() {
+  static Registry* registry = new Registry;
+  return *registry;
+}
+
+int64_t Nanoseconds(TraceClock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+// The calling thread's ring, taken from the registry at its first span and
+// handed back when the thread exits.
+class ThreadRing {
+ public:
+  ~ThreadRing() {
+    if (!ring_) return;
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.free_rings.push_back(ring_);
+  }
+
+  Ring& Get() {
+    if (!ring_) {
+      Registry& registry = GetRegistry();
+      tid_ = registry.next_tid.fetch_add(1, std::memory_order_relaxed);
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      if (registry.free_rings.empty()) {
+        registry.rings.push_back(std::make_unique<Ring>());
+        ring_ = registry.rings.back().get();
+      } else {
+        ring_ = registry.free_rings.back();
+        registry.free_rings.pop_back();
+      }
+    }
+    return *ring_;
+  }
+
+  uint32_t Tid() const { return tid_; }
+
+ private:
+  Ring* ring_ = nullptr;
+  uint32_t tid_ = 0;
+};
+
+thread_local ThreadRing thread_ring;
+
+struct Event {
+  const char* name;
+  const char* category;
+  int64_t start_ns;
+  int64_t duration_ns;
+  int64_t arg;
+  uint32_t tid;
+};
+
+// Copies the spans of the current session out of every ring.
+std::vector<Event> Collect(size_t* dropped) {
+  Registry& registry = GetRegistry();
+  uint64_t session = registry.session.load(std::memory_order_acquire);
+  std::vector<Event> events;
+  *dropped = 0;
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (const auto& ring : registry.rings) {
+    if (session == 0 || ring->session.load(std::memory_order_acquire) != session) continue;
+    uint64_t capacity = ring->capacity;
+    uint64_t end = ring->head.load(std::memory_order_acquire);
+    uint64_t begin = end > capacity ? end - capacity : 0;
+    size_t first = events.size();
+    for (uint64_t i = begin; i < end; ++i) {
+      const Slot& slot = ring->slots[i % capacity];
+      events.push_back(Event{slot.name.load(std::memory_order_relaxed),
+                             slot.category.load(std::memory_order_relaxed),
+                             slot.start_ns.load(std::memory_order_relaxed),
+                             slot.duration_ns.load(std::memory_order_relaxed),
+                             slot.arg.load(std::memory_order_relaxed),
+                             slot.tid.load(std::memory_order_relaxed)});
+    }
+    // Slots the owner reused while they were copied are no longer valid.
+    uint64_t after = ring->head.load(std::memory_order_acquire);
+    uint64_t valid = after > capacity ? after - capacity : 0;
+    if (valid > begin) {
+      size_t stale = static_cast<size_t>(std::min(valid, end) - begin);
+      events.erase(events.begin() + first, events.begin() + first + stale);
+    }
+    *dropped += static_cast<size_t>(valid);
+  }
+  return events;
+}
+
+void WriteJsonString(std::ostream& out, const char* text) {
+  out << '"';
+  for (const char* c = text ? text : ""; *c; ++c) {
+    if (*c == '"' || *c == '\\') {
+      out << '\\' << *c;
+    } else if (static_cast<unsigned char>(*c) < 0x20) {
+      out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+          << static_cast<int>(*c) << std::dec << std::setfill(' ');
+    } else {
+      out << *c;
+    }
+  }
+  out << '"';
+}
+
+}  // namespace
+
+void StartTracing(size_t events_per_thread) {
+  if (events_per_thread == 0) throw std::invalid_argument("Trace rings need at least one slot");
+  Registry& registry = GetRegistry();
+  registry.capacity.store(events_per_thread, std::memory_order_relaxed);
+  registry.origin_ns.store(Nanoseconds(TraceClock::now()), std::memory_order_relaxed);
+  registry.session.fetch_add(1, std::memory_order_release);
+  trace_internal::enabled.store(true, std::memory_order_release);
+}
+
+void StopTracing() {
+  trace_internal::enabled.store(false, std::memory_order_release);
+}
+
+void TraceComplete(const char* name, const char* category, TraceClock::time_point start,
+                   TraceClock::time_point end, int64_t arg) {
+  if (!TracingEnabled()) return;
+  Registry& registry = GetRegistry();
+  Ring& ring = thread_ring.Get();
+  uint64_t session = registry.session.load(std::memory_order_acquire);
+  if (ring.session.load(std::memory_order_relaxed) != session) {
+    size_t capacity = registry.capacity.load(std::memory_order_relaxed);
+    if (ring.capacity != capacity) {
+      ring.slots.reset(new Slot[capacity]);
+      ring.capacity = capacity;
+    }
+    ring.head.store(0, std::memory_order_relaxed);
+    ring.session.store(session, std::memory_order_release);
+  }
+  uint64_t head = ring.head.load(std::memory_order_relaxed);
+  Slot& slot = ring.slots[head % ring.capacity];
+  int64_t start_ns = Nanoseconds(start);
+  slot.name.store(name, std::memory_order_relaxed);
+  slot.category.store(category, std::memory_order_relaxed);
+  slot.start_ns.store(start_ns, std::memory_order_relaxed);
+  slot.duration_ns.store(Nanoseconds(end) - start_ns, std::memory_order_relaxed);
+  slot.arg.store(arg, std::memory_order_relaxed);
+  slot.tid.store(thread_ring.Tid(), std::memory_order_relaxed);
+  ring.head.store(head + 1, std::memory_order_release);
+}
+
+TraceSummary SummarizeTrace() {
+  TraceSummary summary;
+  std::vector<Event> events = Collect(&summary.dropped);
+  std::set<uint32_t> threads;
+  for (const Event& event : events) threads.insert(event.tid);
+  summary.spans = events.size();
+  summary.threads = threads.size();
+  return summary;
+}
+
+void WriteTrace(std::ostream& out) {
+  size_t dropped = 0;
+  std::vector<Event> events = Collect(&dropped);
+  std::sort(events.begin(), events.end(),
+            [](const Event& a, const Event& b) { return a.start_ns < b.start_ns; });
+  int64_t origin = GetRegistry().origin_ns.load(std::memory_order_relaxed);
+#ifndef _WIN32
+  long pid = static_cast<long>(getpid());
+#else
+  long pid = 1;
+#endif
+
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+      << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid
+      << ",\"args\":{\"name\":\"rsa_app\"}}";
+  out << std::fixed << std::setprecision(3);
+  for (const Event& event : events) {
+    // A span that began before StartTracing is cut at the origin.
+    int64_t start = std::max(event.start_ns, origin);
+    int64_t duration = std::max<int64_t>(0, event.start_ns + event.duration_ns - start);
+    out << ",\n{\"name\":";
+    WriteJsonString(out, event.name);
+    out << ",\"cat\":";
+    WriteJsonString(out, event.category);
+    out << ",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << event.tid
+        << ",\"ts\":" << static_cast<double>(start - origin) / 1e3
+        << ",\"dur\":" << static_cast<double>(duration) / 1e3;
+    if (event.arg != kNoTraceArg) out << ",\"args\":{\"value\":" << event.arg << "}";
+    out << "}";
+  }
+  out << "\n],\"otherData\":{\"dropped_spans\":" << dropped << "}}\n";
+}
+
+void WriteTrace(const std::string& path) {
+  std::ofstream file(path, std::ios::trunc);
+  if (!file) throw std::runtime_error("Failed to open trace file " + path);
+  WriteTrace(file);
+  if (!file) throw std::runtime_error("Failed to write trace file " + path);
+}
+
+}  // namespace rsa_app
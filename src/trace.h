@@ -0,0 +1,127 @@
+#ifndef RSA_APP_TRACE_H_
+#define RSA_APP_TRACE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <string>
+
+namespace rsa_app {
+
+using TraceClock = std::chrono::steady_clock;
+
+/**
+ * The argument of a span that has none.
+ */
+constexpr int64_t kNoTraceArg = std::numeric_limits<int64_t>::min();
+
+namespace trace_internal {
+extern std::atomic<bool> enabled;
+}  // namespace trace_internal
+
+/**
+ * Returns true while spans are recorded.
+ *
+ * A relaxed atomic load, so instrumented code pays one load and a branch
+ * when tracing is off.
+ */
+inline bool TracingEnabled() {
+  return trace_internal::enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * Starts recording spans and discards those of an earlier session.
+ *
+ * Every thread records into its own ring of `events_per_thread` spans,
+ * allocated at its first span, with no lock on the recording path. A full
+ * ring overwrites its oldest spans; `SummarizeTrace` counts them.
+ *
+ * Must not run concurrently with `WriteTrace`.
+ *
+ * @throws std::invalid_argument If `events_per_thread` is 0.
+ */
+void StartTracing(size_t events_per_thread = size_t{1} << 16);
+
+/**
+ * Stops recording. The spans stay available to `WriteTrace`.
+ */
+void StopTracing();
+
+/**
+ * Records a span from `start` to `end` on the calling thread, if tracing is
+ * on.
+ *
+ * @param name The span name; must outlive the trace, e.g. a literal.
+ * @param category The Chrome trace category, likewise.
+ * @param arg Shown as the span's "value" argument unless `kNoTraceArg`.
+ */
+void TraceComplete(const char* name, const char* category, TraceClock::time_point start,
+                   TraceClock::time_point end, int64_t arg = kNoTraceArg);
+
+/**
+ * Records the lifetime of a scope as a span.
+ */
+class TraceSpan {
+ public:
+  TraceSpan(const char* name, const char* category, int64_t arg = kNoTraceArg)
+      : name_(name), category_(category), arg_(arg), active_(TracingEnabled()) {
+    if (active_) start_ = TraceClock::now();
+  }
+
+  ~TraceSpan() {
+    if (active_) TraceComplete(name_, category_, start_, TraceClock::now(), arg_);
+  }
+
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+  /**
+   * Replaces the argument, for values known only at the end of the scope.
+   */
+  void SetArg(int64_t arg) { arg_ = arg; }
+
+ private:
+  const char* name_;
+  const char* category_;
+  int64_t arg_;
+  bool active_;
+  TraceClock::time_point start_;
+};
+
+/**
+ * Counts for the current tracing session.
+ */
+struct TraceSummary {
+  size_t spans = 0;    // Spans still held in the rings.
+  size_t dropped = 0;  // Spans overwritten by newer ones.
+  size_t threads = 0;  // Threads that recorded at least one span.
+};
+
+/**
+ * Returns the counts for the current session.
+ */
+TraceSummary SummarizeTrace();
+
+/**
+ * Writes the recorded spans as Chrome trace-event JSON, which
+ * chrome://tracing and ui.perfetto.dev load.
+ *
+ * Spans become complete ("X") events with timestamps in microseconds since
+ * `StartTracing`. Calling this while tracing is on gives a consistent
+ * snapshot: spans overwritten during the export are left out.
+ */
+void WriteTrace(std::ostream& out);
+
+/**
+ * Writes the trace to `path`.
+ *
+ * @throws std::runtime_error If the file cannot be written.
+ */
+void WriteTrace(const std::string& path);
+
+}  // namespace rsa_app
+
+#endif  // RSA_APP_TRACE_H_
@@ -0,0 +1,81 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "rsa.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+// Cost of tracing: an empty span with tracing off and on, and batch
+// decryption throughput with tracing off and on.
+
+using Clock = std::chrono::steady_clock;
+
+template <typename Fn>
+double Seconds(Fn fn) {
+    auto start = Clock::now();
+    fn();
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    return elapsed.count();
+}
+
+int main(int argc, char** argv) {
+    int bits = 2048;
+    size_t spans = 10000000;
+    size_t batch = 256;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--bits") {
+            bits = std::stoi(argv[i + 1]);
+        } else if (flag == "--spans") {
+            spans = std::stoul(argv[i + 1]);
+        } else if (flag == "--batch") {
+            batch = std::stoul(argv[i + 1]);
+        } else {
+            std::cerr << "Unknown option " << flag
+                      << " (supported: --bits N, --spans N, --batch N)\n";
+            return 2;
+        }
+    }
+
+    auto span_ns = [&] {
+        return Seconds([&] {
+                   for (size_t i = 0; i < spans; ++i) {
+                       rsa_app::TraceSpan span("empty", "benchmark", static_cast<int64_t>(i));
+                   }
+               }) *
+               1e9 / static_cast<double>(spans);
+    };
+    double off_ns = span_ns();
+    rsa_app::StartTracing();
+    double on_ns = span_ns();
+    rsa_app::StopTracing();
+
+    rsa_app::KeyPair key_pair = rsa_app::GenerateKeyPair(bits);
+    std::vector<BigNumber> ciphertexts;
+    for (size_t i = 0; i < batch; ++i) {
+        BigNumber message;
+        message.GenerateRandom(bits - 8);
+        ciphertexts.push_back(rsa_app::Encrypt(message, key_pair.public_key));
+    }
+    rsa_app::ThreadPool pool;
+    auto decrypts_per_second = [&] {
+        return static_cast<double>(batch) /
+               Seconds([&] { rsa_app::DecryptBatch(ciphertexts, key_pair.private_key, pool); });
+    };
+    decrypts_per_second();  // Warm-up.
+    double off_rate = decrypts_per_second();
+    rsa_app::StartTracing();
+    double on_rate = decrypts_per_second();
+    rsa_app::StopTracing();
+    rsa_app::TraceSummary summary = rsa_app::SummarizeTrace();
+
+    std::cout << std::fixed << std::setprecision(2) << "empty span, tracing off: " << off_ns
+              << " ns\nempty span, tracing on:  " << on_ns << " ns\n"
+              << std::setprecision(1) << bits << "-bit DecryptBatch of " << batch << " on "
+              << pool.Size() << " threads: " << off_rate << " decrypts/s off, " << on_rate
+              << " on (" << std::setprecision(2) << 100.0 * (off_rate - on_rate) / off_rate
+              << "% slower), " << summary.spans << " spans recorded\n";
+    return 0;
+}
@@ -0,0 +1,367 @@
+#include "tuner.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "rsa.h"
+#include "thread_pool.h"
+
+namespace rsa_app {
+
+namespace {
+
+constexpr char kProfileHeader[] = "rsa_app tuning v1";
+// A candidate within this fraction of the best counts as a tie.
+constexpr double kTieTolerance = 0.97;
+// Distinct inputs cycled through every batch.
+constexpr size_t kDistinctInputs = 64;
+
+using Clock = std::chrono::steady_clock;
+
+struct Measurement {
+  double ops_per_second = 0.0;
+  double seconds_per_run = 0.0;
+};
+
+// Repeats `run` (at least once) until `seconds` have passed.
+Measurement Measure(size_t ops_per_run, double seconds, const std::function<void()>& run) {
+  auto start = Clock::now();
+  size_t runs = 0;
+  double elapsed = 0.0;
+  do {
+    run();
+    ++runs;
+    elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+  } while (elapsed < seconds);
+  return {static_cast<double>(runs * ops_per_run) / elapsed, elapsed / runs};
+}
+
+// Index of the first candidate within `kTieTolerance` of the best.
+size_t PickSmallest(const std::vector<double>& throughputs) {
+  double best = *std::max_element(throughputs.begin(), throughputs.end());
+  for (size_t i = 0; i < throughputs.size(); ++i) {
+    if (throughputs[i] >= kTieTolerance * best) return i;
+  }
+  return 0;
+}
+
+std::vector<BigNumber> Cycle(const std::vector<BigNumber>& inputs, size_t count) {
+  std::vector<BigNumber> out;
+  out.reserve(count);
+  for (size_t i = 0; i < count; ++i) out.push_back(inputs[i % inputs.size()].Copy());
+  return out;
+}
+
+// Restores the process-wide exponentiation settings on scope exit.
+class ModExpSettingsGuard {
+ public:
+  ModExpSettingsGuard() : backend_(ActiveModExpBackend()), kernel_(ActiveFixedKernel()) {}
+  ~ModExpSettingsGuard() {
+    SetModExpBackend(backend_);
+    SetFixedKernel(kernel_);
+  }
+
+ private:
+  ModExpBackend backend_;
+  FixedKernel kernel_;
+};
+
+const char* BackendName(ModExpBackend backend) {
+  return backend == ModExpBackend::kOpenSsl ? "openssl" : "fixed";
+}
+
+std::string FormatPlan(const TuningPlan& plan) {
+  std::ostringstream line;
+  line << std::fixed << std::setprecision(1) << "plan bits=" << plan.bits
+       << " threads=" << plan.threads << " batch=" << plan.batch_size
+       << " backend=" << BackendName(plan.backend) << " kernel=" << FixedKernelName(plan.kernel)
+       << " decrypts_per_second=" << plan.decrypts_per_second
+       << " encrypts_per_second=" << plan.encrypts_per_second;
+  return line.str();
+}
+
+TuningPlan ParsePlan(const std::string& line) {
+  std::istringstream fields(line);
+  std::string word;
+  fields >> word;
+  std::map<std::string, std::string> values;
+  while (fields >> word) {
+    size_t equals = word.find('=');
+    if (equals == std::string::npos) {
+      throw std::invalid_argument("Malformed tuning profile line: " + line);
+    }
+    values[word.substr(0, equals)] = word.substr(equals + 1);
+  }
+  auto take = [&](const char* name) {
+    auto it = values.find(name);
+    if (it == values.end()) {
+      throw std::invalid_argument("Tuning profile plan lacks " + std::string(name) + ": " + line);
+    }
+    return it->second;
+  };
+
+  auto number = [&](const char* name) {
+    std::string value = take(name);
+    try {
+      return std::stod(value);
+    } catch (const std::exception&) {
+      throw std::invalid_argument("Malformed tuning profile line: " + line);
+    }
+  };
+
+  // Plain digits only: stoull would accept a sign and wrap it around.
+  auto integer = [&](const char* name, unsigned long long max) {
+    std::string value = take(name);
+    size_t used = 0;
+    unsigned long long parsed = 0;
+    try {
+      if (!value.empty() && std::isdigit(static_cast<unsigned char>(value[0]))) {
+        parsed = std::stoull(value, &used);
+      }
+    } catch (const std::exception&) {
+      used = 0;
+    }
+    if (used == 0 || used != value.size() || parsed > max) {
+      throw std::invalid_argument("Invalid " + std::string(name) + " in tuning profile: " + line);
+    }
+    return parsed;
+  };
+
+  TuningPlan plan;
+  plan.bits = static_cast<int>(integer("bits", std::numeric_limits<int>::max()));
+  plan.threads = static_cast<size_t>(integer("threads", std::numeric_limits<size_t>::max()));
+  plan.batch_size = static_cast<size_t>(integer("batch", std::numeric_limits<size_t>::max()));
+  plan.decrypts_per_second = number("decrypts_per_second");
+  plan.encrypts_per_second = number("encrypts_per_second");
+  std::string backend = take("backend");
+  if (backend == "openssl") {
+    plan.backend = ModExpBackend::kOpenSsl;
+  } else if (backend == "fixed") {
+    plan.backend = ModExpBackend::kFixed;
+  } else {
+    throw std::invalid_argument("Unknown backend in tuning profile: " + backend);
+  }
+  std::string kernel = take("kernel");
+  if (kernel == FixedKernelName(FixedKernel::kPortable)) {
+    plan.kernel = FixedKernel::kPortable;
+  } else if (kernel == FixedKernelName(FixedKernel::kMulxAdx)) {
+    plan.kernel = FixedKernel::kMulxAdx;
+  } else {
+    throw std::invalid_argument("Unknown kernel in tuning profile: " + kernel);
+  }
+  if (plan.bits <= 0 || plan.threads == 0 || plan.batch_size == 0) {
+    throw std::invalid_argument("Malformed tuning profile line: " + line);
+  }
+  return plan;
+}
+
+}  // namespace
+
+const TuningPlan* TuningProfile::Find(int bits) const {
+  for (const auto& plan : plans) {
+    if (plan.bits == bits) return &plan;
+  }
+  return nullptr;
+}
+
+std::string HostSignature() {
+  std::string model = "unknown cpu";
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.rfind("model name", 0) != 0) continue;
+    size_t colon = line.find(':');
+    if (colon != std::string::npos && colon + 2 <= line.size()) model = line.substr(colon + 2);
+    break;
+  }
+  return model + " x" + std::to_string(ThreadPool::DefaultThreadCount());
+}
+
+TuningPlan CalibrateKeySize(int bits, const TuningOptions& options) {
+  if (options.trial_seconds <= 0.0 || options.max_batch == 0) {
+    throw std::invalid_argument("Tuning needs a positive trial time and batch size");
+  }
+  size_t max_threads =
+      options.max_threads == 0 ? ThreadPool::DefaultThreadCount() : options.max_threads;
+  ModExpSettingsGuard guard;
+
+  KeyPair key = GenerateKeyPair(bits);
+  BigNumber one;
+  one.SetWord(1);
+  BigNumber top = key.public_key.n.Sub(one.Get());
+  std::vector<BigNumber> messages;
+  for (size_t i = 0; i < kDistinctInputs; ++i) {
+    messages.push_back(BigNumber::GenerateInRange(one.Get(), top.Get()));
+  }
+  std::vector<BigNumber> ciphertexts;
+  for (const auto& message : messages) ciphertexts.push_back(Encrypt(message, key.public_key));
+
+  TuningPlan plan;
+  plan.bits = bits;
+
+  // Stage 1: the exponentiation kernel, on one thread.
+  std::vector<std::pair<ModExpBackend, FixedKernel>> kernels;
+  if (FixedModExpSupports(key.private_key.n.Get())) {
+    for (FixedKernel kernel : {FixedKernel::kPortable, FixedKernel::kMulxAdx}) {
+      if (FixedKernelSupported(kernel)) kernels.push_back({ModExpBackend::kFixed, kernel});
+    }
+  }
+  if (kernels.empty() || options.allow_variable_time) {
+    kernels.push_back({ModExpBackend::kOpenSsl, BestFixedKernel()});
+  }
+  double best = 0.0;
+  for (const auto& candidate : kernels) {
+    SetModExpBackend(candidate.first);
+    SetFixedKernel(candidate.second);
+    size_t next = 0;
+    auto decrypt = [&] { Decrypt(ciphertexts[next++ % ciphertexts.size()], key.private_key); };
+    decrypt();  // Warm caches and lazily built tables.
+    double rate = Measure(1, options.trial_seconds, decrypt).ops_per_second;
+    if (rate > best) {
+      best = rate;
+      plan.backend = candidate.first;
+      plan.kernel = candidate.second;
+    }
+  }
+  SetModExpBackend(plan.backend);
+  SetFixedKernel(plan.kernel);
+
+  // Stage 2: the pool size, with a few operations per worker.
+  std::vector<size_t> thread_counts;
+  for (size_t threads = 1; threads < max_threads; threads *= 2) thread_counts.push_back(threads);
+  thread_counts.push_back(max_threads);
+  std::vector<double> rates;
+  for (size_t threads : thread_counts) {
+    ThreadPool pool(threads);
+    std::vector<BigNumber> batch = Cycle(ciphertexts, 4 * threads);
+    rates.push_back(Measure(batch.size(), options.trial_seconds, [&] {
+                      DecryptBatch(batch, key.private_key, pool);
+                    }).ops_per_second);
+  }
+  plan.threads = thread_counts[PickSmallest(rates)];
+
+  // Stage 3: the batch size. Larger batches amortize the pool hand-off and
+  // the idle tail of each batch; stop once one batch outlasts a few trials.
+  ThreadPool pool(plan.threads);
+  std::vector<size_t> batch_sizes;
+  rates.clear();
+  for (size_t size = plan.threads; size <= options.max_batch; size *= 2) {
+    std::vector<BigNumber> batch = Cycle(ciphertexts, size);
+    Measurement measured = Measure(size, options.trial_seconds,
+                                   [&] { DecryptBatch(batch, key.private_key, pool); });
+    batch_sizes.push_back(size);
+    rates.push_back(measured.ops_per_second);
+    if (measured.seconds_per_run > 4 * options.trial_seconds) break;
+  }
+  if (batch_sizes.empty()) {
+    batch_sizes.push_back(options.max_batch);
+    std::vector<BigNumber> batch = Cycle(ciphertexts, options.max_batch);
+    rates.push_back(Measure(batch.size(), options.trial_seconds, [&] {
+                      DecryptBatch(batch, key.private_key, pool);
+                    }).ops_per_second);
+  }
+  size_t chosen = PickSmallest(rates);
+  plan.batch_size = batch_sizes[chosen];
+  plan.decrypts_per_second = rates[chosen];
+
+  std::vector<BigNumber> batch = Cycle(messages, plan.batch_size);
+  plan.encrypts_per_second = Measure(batch.size(), options.trial_seconds, [&] {
+                               EncryptBatch(batch, key.public_key, pool);
+                             }).ops_per_second;
+  return plan;
+}
+
+TuningProfile Calibrate(const TuningOptions& options) {
+  TuningProfile profile;
+  profile.host = HostSignature();
+  for (int bits : options.bits) profile.plans.push_back(CalibrateKeySize(bits, options));
+  return profile;
+}
+
+void SaveTuningProfile(const TuningProfile& profile, const std::string& path) {
+  std::ofstream file(path, std::ios::trunc);
+  if (!file.is_open()) {
+    throw std::runtime_error("Cannot open tuning profile for writing: " + path);
+  }
+  file << kProfileHeader << "\n" << "host " << profile.host << "\n";
+  for (const auto& plan : profile.plans) file << FormatPlan(plan) << "\n";
+  if (!file.good()) throw std::runtime_error("Failed to write tuning profile: " + path);
+}
+
+TuningProfile LoadTuningProfile(const std::string& path) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    throw std::runtime_error("Cannot open tuning profile: " + path);
+  }
+  std::string line;
+  if (!std::getline(file, line) || line != kProfileHeader) {
+    throw std::invalid_argument("Not an rsa_app tuning profile: " + path);
+  }
+  TuningProfile profile;
+  bool has_host = false;
+  while (std::getline(file, line)) {
+    if (line.empty()) continue;
+    if (line.rfind("host ", 0) == 0) {
+      profile.host = line.substr(5);
+      has_host = true;
+    } else if (line.rfind("plan ", 0) == 0) {
+      profile.plans.push_back(ParsePlan(line));
+    } else {
+      throw std::invalid_argument("Malformed tuning profile line: " + line);
+    }
+  }
+  if (!has_host) throw std::invalid_argument("Tuning profile " + path + " lacks a host line");
+  return profile;
+}
+
+TuningPlan LoadOrCalibrate(const std::string& path, int bits, const TuningOptions& options,
+                           bool* calibrated) {
+  std::string host = HostSignature();
+  TuningProfile profile;
+  try {
+    profile = LoadTuningProfile(path);
+  } catch (const std::exception&) {
+    // Missing or unreadable: calibrate from scratch.
+  }
+  if (profile.host != host) {
+    profile.host = host;
+    profile.plans.clear();
+  }
+  if (calibrated) *calibrated = false;
+  if (const TuningPlan* plan = profile.Find(bits)) return *plan;
+
+  TuningPlan plan = CalibrateKeySize(bits, options);
+  profile.plans.push_back(plan);
+  std::sort(profile.plans.begin(), profile.plans.end(),
+            [](const TuningPlan& a, const TuningPlan& b) { return a.bits < b.bits; });
+  SaveTuningProfile(profile, path);
+  if (calibrated) *calibrated = true;
+  return plan;
+}
+
+void ApplyTuningPlan(const TuningPlan& plan) {
+  SetModExpBackend(plan.backend);
+  SetFixedKernel(plan.kernel);
+}
+
+std::string DescribeTuningPlan(const TuningPlan& plan) {
+  std::ostringstream out;
+  out << plan.bits << "-bit: " << BackendName(plan.backend);
+  if (plan.backend == ModExpBackend::kFixed) out << "/" << FixedKernelName(plan.kernel);
+  out << ", " << plan.threads << (plan.threads == 1 ? " thread" : " threads") << ", batch "
+      << plan.batch_size << ", " << std::fixed << std::setprecision(1)
+      << plan.decrypts_per_second << " decrypts/s, " << plan.encrypts_per_second
+      << " encrypts/s";
+  return out.str();
+}
+
+}  // namespace rsa_app
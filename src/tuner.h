@@ -0,0 +1,127 @@
+#ifndef RSA_APP_TUNER_H_
+#define RSA_APP_TUNER_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "fixed_modexp.h"
+
+namespace rsa_app {
+
+/**
+ * The configuration measured fastest for one key size.
+ */
+struct TuningPlan {
+  int bits = 0;
+  size_t threads = 1;     // Pool size for batch work.
+  size_t batch_size = 1;  // Operations handed to the pool at once.
+  ModExpBackend backend = ModExpBackend::kFixed;
+  FixedKernel kernel = FixedKernel::kPortable;  // Used with `kFixed`.
+  double decrypts_per_second = 0.0;  // Batch throughput with this plan.
+  double encrypts_per_second = 0.0;
+};
+
+/**
+ * Plans for several key sizes, valid on the host they were measured on.
+ */
+struct TuningProfile {
+  std::string host;  // `HostSignature()` at calibration time.
+  std::vector<TuningPlan> plans;
+
+  /**
+   * Returns the plan for `bits`, or nullptr.
+   */
+  const TuningPlan* Find(int bits) const;
+};
+
+/**
+ * Bounds of a calibration run.
+ */
+struct TuningOptions {
+  std::vector<int> bits = {2048, 3072, 4096};
+  size_t max_threads = 0;      // 0 selects ThreadPool::DefaultThreadCount().
+  size_t max_batch = 4096;     // Largest batch size tried.
+  double trial_seconds = 0.1;  // Minimum duration of each measurement.
+  // Lets stage 1 pick OpenSSL's exponentiation for sizes `FixedModExp`
+  // covers. `rsa_leakage` shows its private-key timing depends on the
+  // operands, so a faster plan would trade away constant-time decryption.
+  bool allow_variable_time = false;
+};
+
+/**
+ * Describes the CPU model and hardware thread count.
+ *
+ * A profile is only reused on a host with the same signature.
+ */
+std::string HostSignature();
+
+/**
+ * Measures the candidate configurations for one key size.
+ *
+ * Runs three short stages on a freshly generated key, each keeping the
+ * winner of the one before:
+ *   1. kernel: single-threaded `Decrypt` with every supported
+ *      `FixedModExp` kernel, and with OpenSSL if the size has no kernel or
+ *      `allow_variable_time` is set;
+ *   2. threads: `DecryptBatch` on pools of 1, 2, 4, ... up to
+ *      `max_threads` workers;
+ *   3. batch size: `DecryptBatch` with multiples of the thread count up to
+ *      `max_batch`.
+ * Stages 2 and 3 keep the smallest value within 3% of the best, since
+ * fewer threads and smaller batches cost less latency and memory.
+ *
+ * The process-wide backend and kernel are restored before returning.
+ *
+ * @throws std::invalid_argument If an option is out of range.
+ */
+TuningPlan CalibrateKeySize(int bits, const TuningOptions& options = {});
+
+/**
+ * Calibrates every size in `options.bits` for this host.
+ */
+TuningProfile Calibrate(const TuningOptions& options = {});
+
+/**
+ * Writes a profile as text: a header line, a `host` line and one
+ * `plan key=value ...` line per key size.
+ *
+ * @throws std::runtime_error If the file cannot be written.
+ */
+void SaveTuningProfile(const TuningProfile& profile, const std::string& path);
+
+/**
+ * Reads a profile written by `SaveTuningProfile`.
+ *
+ * @throws std::runtime_error If the file cannot be read.
+ * @throws std::invalid_argument If the file is malformed.
+ */
+TuningProfile LoadTuningProfile(const std::string& path);
+
+/**
+ * Returns the plan for `bits` from the profile at `path`, calibrating and
+ * saving it first if the file is missing, unreadable, from another host or
+ * lacks that key size. Plans for other sizes are kept when the host
+ * matches.
+ *
+ * @param calibrated Optional; set to true if a calibration ran.
+ * @throws std::runtime_error If the updated profile cannot be written.
+ */
+TuningPlan LoadOrCalibrate(const std::string& path, int bits, const TuningOptions& options = {},
+                           bool* calibrated = nullptr);
+
+/**
+ * Makes `Encrypt` and `Decrypt` use the plan's backend and kernel for the
+ * whole process. Thread count and batch size are up to the caller.
+ */
+void ApplyTuningPlan(const TuningPlan& plan);
+
+/**
+ * Returns a one-line summary such as
+ * "2048-bit: fixed/mulx_adx, 4 threads, batch 64, 2310.5 dec/s, ...".
+ */
+std::string DescribeTuningPlan(const TuningPlan& plan);
+
+}  // namespace rsa_app
+
+#endif  // RSA_APP_TUNER_H_
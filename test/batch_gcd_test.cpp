@@ -0,0 +1,130 @@
+#include "../src/batch_gcd.h"
+#include "../src/rsa.h"
+#include <openssl/bn.h>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+BigNumber Product(const BigNumber& a, const BigNumber& b) {
+    BigNumber result;
+    BN_CTX* ctx = BN_CTX_new();
+    BN_mul(result.Get(), a.Get(), b.Get(), ctx);
+    BN_CTX_free(ctx);
+    return result;
+}
+
+BigNumber Prime(int bits, uint64_t stream) {
+    rsa_app::Drbg drbg(34, stream);
+    BigNumber prime;
+    prime.GeneratePrime(bits, drbg);
+    return prime;
+}
+
+// Moduli 0..7 from distinct primes, except that 2 and 5 share a prime, 6
+// and 7 share another and 3 repeats modulus 1.
+std::vector<BigNumber> PlantedModuli() {
+    std::vector<BigNumber> primes;
+    for (uint64_t i = 0; i < 16; ++i) primes.push_back(Prime(256, i));
+    std::vector<BigNumber> moduli;
+    for (size_t i = 0; i < 8; ++i) moduli.push_back(Product(primes[2 * i], primes[2 * i + 1]));
+    moduli[5] = Product(primes[4], primes[11]);
+    moduli[7] = Product(primes[13], primes[14]);
+    moduli[3] = moduli[1].Copy();
+    return moduli;
+}
+
+void CheckPlanted(const std::vector<BigNumber>& moduli,
+                  const std::vector<rsa_app::WeakKey>& weak) {
+    assert(weak.size() == 6);
+    const size_t expected_index[] = {1, 2, 3, 5, 6, 7};
+    const size_t expected_partner[] = {3, 5, 1, 2, 7, 6};
+    for (size_t k = 0; k < weak.size(); ++k) {
+        assert(weak[k].index == expected_index[k]);
+        assert(weak[k].shared_with == std::vector<size_t>{expected_partner[k]});
+    }
+    // Duplicates expose the whole modulus, shared primes the prime itself.
+    assert(BN_cmp(weak[0].factor.Get(), moduli[1].Get()) == 0);
+    assert(BN_cmp(weak[1].factor.Get(), weak[3].factor.Get()) == 0);
+    assert(BN_num_bits(weak[1].factor.Get()) == 256);
+    assert(BN_cmp(weak[4].factor.Get(), weak[5].factor.Get()) == 0);
+}
+
+}  // namespace
+
+void TestBatchGcdFindsSharedPrimes() {
+    try {
+        std::vector<BigNumber> moduli = PlantedModuli();
+        rsa_app::BatchGcdStats stats;
+        std::vector<rsa_app::WeakKey> weak = rsa_app::FindSharedFactors(moduli, {}, &stats);
+        CheckPlanted(moduli, weak);
+        assert(stats.moduli == 8 && stats.levels == 4);
+        assert(stats.spilled_levels == 0 && stats.peak_resident_bytes > 0);
+
+        // Real keys are pairwise coprime; an odd count exercises the carried node.
+        std::vector<BigNumber> keys;
+        for (int i = 0; i < 5; ++i) keys.push_back(std::move(rsa_app::GenerateKeyPair(512).public_key.n));
+        assert(rsa_app::FindSharedFactors(keys).empty());
+        std::vector<BigNumber> single;
+        single.push_back(keys[0].Copy());
+        assert(rsa_app::FindSharedFactors(single).empty());
+        assert(rsa_app::FindSharedFactors({}).empty());
+
+        bool caught = false;
+        keys.push_back(BigNumber());
+        try {
+            rsa_app::FindSharedFactors(keys);
+        } catch (const std::invalid_argument&) {
+            caught = true;
+        }
+        assert(caught);
+        std::cout << "TestBatchGcdFindsSharedPrimes passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestBatchGcdFindsSharedPrimes failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestBatchGcdSpillsLevels() {
+    try {
+        std::vector<BigNumber> moduli = PlantedModuli();
+        rsa_app::BatchGcdOptions options;
+        options.threads = 3;
+        options.memory_limit = 1;
+        rsa_app::BatchGcdStats stats;
+        std::vector<rsa_app::WeakKey> weak = rsa_app::FindSharedFactors(moduli, options, &stats);
+        CheckPlanted(moduli, weak);
+#ifndef _WIN32
+        // Everything but the level being built ends up on disk.
+        assert(stats.spilled_levels == stats.levels - 1);
+        assert(stats.spilled_bytes > 0);
+#endif
+
+        // Without the pairwise search partners are left empty.
+        options.max_partner_search = 2;
+        weak = rsa_app::FindSharedFactors(moduli, options);
+        assert(weak.size() == 6);
+        for (const auto& key : weak) assert(key.shared_with.empty());
+
+        bool caught = false;
+        options.spill_directory = "/nonexistent/batch_gcd";
+        try {
+            rsa_app::FindSharedFactors(moduli, options);
+        } catch (const std::runtime_error&) {
+            caught = true;
+        }
+#ifndef _WIN32
+        assert(caught);
+#endif
+        std::cout << "TestBatchGcdSpillsLevels passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestBatchGcdSpillsLevels failed with exception: " << e.what() << std::endl;
+    }
+}
+
+int main() {
+    TestBatchGcdFindsSharedPrimes();
+    TestBatchGcdSpillsLevels();
+    return 0;
+}
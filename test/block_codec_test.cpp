@@ -0,0 +1,235 @@
+#include "../src/block_codec.h"
+#include <openssl/bn.h>
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+bool Rejects(const std::vector<BigNumber>& blocks, int modulus_bits) {
+    try {
+        rsa_app::UnpackBlocks(blocks, modulus_bits);
+    } catch (const std::invalid_argument&) {
+        return true;
+    }
+    return false;
+}
+
+}  // namespace
+
+void TestBlockCodecRoundTrip() {
+    try {
+        assert(rsa_app::BlockCapacity(2048) == 252);
+        assert(rsa_app::BlockCapacity(2047) == 252);
+        assert(rsa_app::BlockCapacity(4096) == 508);
+        assert(rsa_app::BlockCount(0, 2048) == 1);
+        assert(rsa_app::BlockCount(252, 2048) == 1);
+        assert(rsa_app::BlockCount(253, 2048) == 2);
+
+        std::string binary;
+        for (int i = 0; i < 1000; ++i) binary.push_back(static_cast<char>(i * 7 % 256));
+        std::vector<std::string> messages = {
+            "", std::string(1, '\0'), std::string(5, '\0') + "zeros", std::string(252, '\xff'),
+            std::string(253, 'a'), binary};
+        for (int bits : {512, 1000, 2048}) {
+            for (const auto& message : messages) {
+                std::vector<BigNumber> blocks = rsa_app::PackBlocks(message, bits);
+                assert(blocks.size() == rsa_app::BlockCount(message.size(), bits));
+                for (const auto& block : blocks) assert(block.NumBits() < bits);
+                assert(rsa_app::UnpackBlocks(blocks, bits) == message);
+            }
+        }
+
+        rsa_app::KeyPair key = rsa_app::GenerateKeyPair(1024);
+        assert(rsa_app::BlockCapacity(key.public_key) == 124);
+        rsa_app::ThreadPool pool(2);
+        std::vector<BigNumber> ciphertexts = rsa_app::EncryptMessage(binary, key.public_key, pool);
+        assert(ciphertexts.size() == 9);
+        assert(rsa_app::DecryptMessage(ciphertexts, key.private_key, pool) == binary);
+        std::cout << "TestBlockCodecRoundTrip passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestBlockCodecRoundTrip failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestBlockCodecRejectsMalformedBlocks() {
+    try {
+        std::vector<BigNumber> blocks = rsa_app::PackBlocks(std::string(300, 'x'), 1024);
+        assert(blocks.size() == 3);
+        assert(Rejects({}, 1024));
+
+        // Missing and misplaced final flags.
+        std::vector<BigNumber> truncated;
+        truncated.push_back(blocks[0].Copy());
+        assert(Rejects(truncated, 1024));
+        std::vector<BigNumber> reordered;
+        reordered.push_back(blocks[2].Copy());
+        reordered.push_back(blocks[0].Copy());
+        assert(Rejects(reordered, 1024));
+
+        // Length beyond the capacity, unknown flags, non-zero padding and
+        // blocks wider than the key.
+        BigNumber bad = BigNumber::FromBytes(std::string("\x01\xff\xff", 3) + std::string(124, 'a'));
+        std::vector<BigNumber> single;
+        single.push_back(std::move(bad));
+        assert(Rejects(single, 1024));
+        single[0] = BigNumber::FromBytes(std::string("\x03\x00\x01", 3) + std::string(124, 'a'));
+        assert(Rejects(single, 1024));
+        single[0] = BigNumber::FromBytes(std::string("\x05\x00\x01", 3) + std::string(124, 'a'));
+        assert(Rejects(single, 1024));
+        single[0] = BigNumber::FromBytes(std::string("\x01\x00\x01", 3) + std::string(124, 'a'));
+        assert(Rejects(single, 1024));
+        single[0] = BigNumber::FromBytes(std::string("\x01\x00\x01", 3) + std::string(124, '\0'));
+        assert(rsa_app::UnpackBlocks(single, 1024) == std::string(1, '\0'));
+        assert(Rejects(single, 512));
+
+        bool caught = false;
+        try {
+            rsa_app::BlockCapacity(32);
+        } catch (const std::invalid_argument&) {
+            caught = true;
+        }
+        assert(caught);
+        std::cout << "TestBlockCodecRejectsMalformedBlocks passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestBlockCodecRejectsMalformedBlocks failed with exception: " << e.what()
+                  << std::endl;
+    }
+}
+
+void TestBlockCodecCompression() {
+    try {
+        std::string text;
+        for (int i = 0; i < 200; ++i) {
+            text += "{\"event\":\"login\",\"user\":\"u" + std::to_string(i % 10) + "\"}\n";
+        }
+        std::mt19937_64 rng(5);
+        std::string random;
+        for (int i = 0; i < 1000; ++i) random.push_back(static_cast<char>(rng()));
+
+        // Compressible text takes fewer blocks, flagged as compressed.
+        std::vector<BigNumber> plain = rsa_app::PackBlocks(text, 1024);
+        std::vector<BigNumber> packed =
+            rsa_app::PackBlocks(text, 1024, rsa_app::BlockCompression::kAuto);
+        assert(packed.size() * 3 < plain.size());
+        for (const auto& block : packed) {
+            std::string bytes = block.ToBytes(127);
+            assert((bytes[0] & rsa_app::kBlockCompressed) != 0);
+        }
+        assert(rsa_app::UnpackBlocks(packed, 1024) == text);
+
+        // Data that does not compress, and short messages, are packed as is.
+        for (const std::string& message : {random, std::string("hi"), std::string()}) {
+            std::vector<BigNumber> blocks =
+                rsa_app::PackBlocks(message, 1024, rsa_app::BlockCompression::kAuto);
+            assert(blocks.size() == rsa_app::BlockCount(message.size(), 1024));
+            assert((blocks[0].ToBytes(127)[0] & rsa_app::kBlockCompressed) == 0);
+            assert(rsa_app::UnpackBlocks(blocks, 1024) == message);
+        }
+
+        // Mixed compression flags are rejected.
+        std::vector<BigNumber> mixed;
+        mixed.push_back(plain[0].Copy());
+        mixed.push_back(packed.back().Copy());
+        assert(Rejects(mixed, 1024));
+
+        rsa_app::KeyPair key = rsa_app::GenerateKeyPair(1024);
+        rsa_app::ThreadPool pool(2);
+        std::vector<BigNumber> ciphertexts = rsa_app::EncryptMessage(
+            text, key.public_key, pool, rsa_app::BlockCompression::kAuto);
+        assert(ciphertexts.size() == packed.size());
+        assert(rsa_app::DecryptMessage(ciphertexts, key.private_key, pool) == text);
+        std::cout << "TestBlockCodecCompression passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestBlockCodecCompression failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestBlockStreamRoundTrip() {
+    try {
+        rsa_app::KeyPair key = rsa_app::GenerateKeyPair(1024);
+        rsa_app::ThreadPool pool(2);
+        std::string message;
+        for (int i = 0; i < 3000; ++i) message += "line " + std::to_string(i % 50) + "\n";
+
+        for (auto compression : {rsa_app::BlockCompression::kNone,
+                                 rsa_app::BlockCompression::kAuto}) {
+            for (size_t piece : {1, 124, 125, 5000}) {
+                rsa_app::BlockStreamEncryptor encryptor(key.public_key, pool, compression);
+                std::vector<BigNumber> ciphertexts;
+                for (size_t pos = 0; pos < message.size(); pos += piece) {
+                    for (auto& c : encryptor.Update(message.substr(pos, piece))) {
+                        ciphertexts.push_back(std::move(c));
+                    }
+                }
+                for (auto& c : encryptor.Finish()) ciphertexts.push_back(std::move(c));
+                if (compression == rsa_app::BlockCompression::kNone) {
+                    assert(ciphertexts.size() == rsa_app::BlockCount(message.size(), 1024));
+                } else {
+                    assert(ciphertexts.size() * 3 < rsa_app::BlockCount(message.size(), 1024));
+                }
+                // Whole-message decryption reads the streamed format.
+                assert(rsa_app::DecryptMessage(ciphertexts, key.private_key, pool) == message);
+
+                rsa_app::BlockStreamDecryptor decryptor(key.private_key, pool);
+                std::string output;
+                for (size_t i = 0; i < ciphertexts.size(); i += 3) {
+                    std::vector<BigNumber> group;
+                    for (size_t j = i; j < std::min(i + 3, ciphertexts.size()); ++j) {
+                        group.push_back(ciphertexts[j].Copy());
+                    }
+                    output += decryptor.Update(group);
+                }
+                decryptor.Finish();
+                assert(output == message);
+            }
+        }
+
+        // An empty stream is one final block.
+        rsa_app::BlockStreamEncryptor empty(key.public_key, pool);
+        assert(empty.Update("").empty());
+        std::vector<BigNumber> last = empty.Finish();
+        assert(last.size() == 1);
+        assert(rsa_app::DecryptMessage(last, key.private_key, pool).empty());
+
+        // Missing final block and blocks after it.
+        std::vector<BigNumber> ciphertexts =
+            rsa_app::EncryptMessage(message, key.public_key, pool);
+        rsa_app::BlockStreamDecryptor decryptor(key.private_key, pool);
+        std::vector<BigNumber> first;
+        first.push_back(ciphertexts[0].Copy());
+        decryptor.Update(first);
+        bool caught = false;
+        try {
+            decryptor.Finish();
+        } catch (const std::invalid_argument&) {
+            caught = true;
+        }
+        assert(caught);
+        caught = false;
+        try {
+            std::vector<BigNumber> after_final;
+            after_final.push_back(ciphertexts.back().Copy());
+            after_final.push_back(ciphertexts[0].Copy());
+            decryptor.Update(after_final);
+        } catch (const std::invalid_argument&) {
+            caught = true;
+        }
+        assert(caught);
+        std::cout << "TestBlockStreamRoundTrip passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestBlockStreamRoundTrip failed with exception: " << e.what() << std::endl;
+    }
+}
+
+int main() {
+    TestBlockCodecRoundTrip();
+    TestBlockCodecRejectsMalformedBlocks();
+    TestBlockCodecCompression();
+    TestBlockStreamRoundTrip();
+    return 0;
+}
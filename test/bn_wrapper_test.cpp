@@ -1,6 +1,9 @@
 #include "../src/bn_wrapper.h"
+#include "../src/thread_pool.h"
 #include <iostream>
 #include <cassert>
+#include <string>
+#include <vector>
 
 void TestBNPtrBasicCreation() {
     try {
@@ -277,6 +280,106 @@ void TestBNPtrModInverse() {
     }
 }
 
+// Checks `inverses` against one `ModInverse` per value.
+bool MatchesModInverse(const std::vector<BigNumber>& values, const BigNumber& m,
+                       const std::vector<BigNumber>& inverses) {
+    if (inverses.size() != values.size()) return false;
+    BN_CTX* ctx = BN_CTX_new();
+    bool match = true;
+    for (size_t i = 0; i < values.size() && match; ++i) {
+        BigNumber reduced;
+        BN_nnmod(reduced.Get(), values[i].Get(), m.Get(), ctx);
+        BigNumber expected = reduced.ModInverse(m.Get());
+        match = BN_cmp(expected.Get(), inverses[i].Get()) == 0;
+    }
+    BN_CTX_free(ctx);
+    return match;
+}
+
+std::vector<const BIGNUM*> Pointers(const std::vector<BigNumber>& values) {
+    std::vector<const BIGNUM*> pointers;
+    for (const auto& value : values) pointers.push_back(value.Get());
+    return pointers;
+}
+
+void TestBNPtrBatchModInverse() {
+    try {
+        rsa_app::ThreadPool pool(3);
+        BigNumber prime, even;
+        prime.GeneratePrime(256);
+        even = prime.Sub(BN_value_one());  // Even: no Montgomery form
+        for (const BigNumber* m : {&prime, &even}) {
+            std::vector<BigNumber> values;
+            while (values.size() < 200) {
+                BigNumber value;
+                value.GenerateRandom(300);  // Mostly above m
+                if (BN_is_one(value.Mod(m->Get()).Gcd(m->Get()).Get())) {
+                    values.push_back(std::move(value));
+                }
+            }
+            values[7].SetNegative(1);
+            for (size_t n : {size_t{1}, size_t{2}, size_t{17}, size_t{200}}) {
+                std::vector<BigNumber> subset;
+                for (size_t i = 0; i < n; ++i) subset.push_back(values[i].Copy());
+                std::vector<size_t> bad = {99};
+                assert(MatchesModInverse(
+                    subset, *m, BigNumber::BatchModInverse(Pointers(subset), m->Get(), &bad)));
+                assert(bad.empty());
+                assert(MatchesModInverse(
+                    subset, *m, BigNumber::BatchModInverse(Pointers(subset), m->Get(), pool)));
+            }
+        }
+        assert(BigNumber::BatchModInverse({}, prime.Get(), pool).empty());
+
+        // Non-invertible values are reported, the rest still inverted.
+        BigNumber m, three, nine, zero, five, seven;
+        m.SetWord(3 * 1000003);
+        three.SetWord(3);
+        nine.SetWord(9);
+        zero.SetWord(0);
+        five.SetWord(5);
+        seven.SetWord(7);
+        std::vector<const BIGNUM*> mixed;
+        for (int i = 0; i < 40; ++i) {
+            mixed.push_back(i == 3 ? three.Get() : i == 20 ? zero.Get() : i == 39 ? nine.Get()
+                                                 : i % 2 ? five.Get() : seven.Get());
+        }
+        for (bool parallel : {false, true}) {
+            std::vector<size_t> bad;
+            std::vector<BigNumber> inverses =
+                parallel ? BigNumber::BatchModInverse(mixed, m.Get(), pool, &bad)
+                         : BigNumber::BatchModInverse(mixed, m.Get(), &bad);
+            assert((bad == std::vector<size_t>{3, 20, 39}));
+            for (size_t i = 0; i < mixed.size(); ++i) {
+                if (i == 3 || i == 20 || i == 39) {
+                    assert(BN_is_zero(inverses[i].Get()));
+                } else {
+                    BigNumber expected = (i % 2 ? five : seven).ModInverse(m.Get());
+                    assert(BN_cmp(expected.Get(), inverses[i].Get()) == 0);
+                }
+            }
+        }
+        bool caught = false;
+        try {
+            BigNumber::BatchModInverse(mixed, m.Get());
+        } catch (const std::runtime_error& e) {
+            caught = std::string(e.what()).find("Value 3 ") != std::string::npos;
+        }
+        assert(caught);
+        caught = false;
+        try {
+            BigNumber::BatchModInverse(mixed, BN_value_one());
+        } catch (const std::invalid_argument&) {
+            caught = true;
+        }
+        assert(caught);
+
+        std::cout << "TestBNPtrBatchModInverse passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestBNPtrBatchModInverse failed with exception: " << e.what() << std::endl;
+    }
+}
+
 void TestBNPtrGenerateSafePrime() {
     try {
         BigNumber prime;
@@ -418,6 +521,31 @@ void TestBNPtrToString() {
     }
 }
 
+void TestBNPtrToStringMatchesBn2hex() {
+    try {
+        BigNumber num;
+        num.SetWord(0);
+        assert(num.ToString() == "0");
+
+        num.SetWord(0xABC);
+        assert(num.ToString() == "0ABC");  // Whole bytes, like BN_bn2hex
+        num.SetNegative(1);
+        assert(num.ToString() == "-0ABC");
+
+        for (int bits : {8, 63, 64, 65, 255, 1024, 4096}) {
+            BigNumber random;
+            random.GenerateRandom(bits);
+            char* hex_str = BN_bn2hex(random.Get());
+            assert(random.ToString() == hex_str);
+            OPENSSL_free(hex_str);
+        }
+
+        std::cout << "TestBNPtrToStringMatchesBn2hex passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestBNPtrToStringMatchesBn2hex failed with exception: " << e.what() << std::endl;
+    }
+}
+
 int main() {
     TestBNPtrBasicCreation();
     TestBNPtrValue();
@@ -439,6 +567,7 @@ int main() {
     TestBNPtrGenerateRandomPrime512();
     TestBNPtrGCD();
     TestBNPtrModInverse();
+    TestBNPtrBatchModInverse();
     TestBNPtrGenerateSafePrime();
     TestBNPtrIsRelativelyPrime();
     TestBNPtrLargePrimeLength();
@@ -447,5 +576,6 @@ int main() {
     TestBNPtrRSAKeySize();
     TestBNPtrCopy();
     TestBNPtrToString();
+    TestBNPtrToStringMatchesBn2hex();
     return 0;
 }
\ No newline at end of file
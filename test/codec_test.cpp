@@ -0,0 +1,236 @@
+#include "../src/codec.h"
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<rsa_app::CodecKernel> SupportedKernels() {
+    std::vector<rsa_app::CodecKernel> kernels;
+    for (auto kernel : {rsa_app::CodecKernel::kScalar, rsa_app::CodecKernel::kSsse3,
+                        rsa_app::CodecKernel::kAvx2}) {
+        rsa_app::SetCodecKernel(kernel);
+        if (rsa_app::ActiveCodecKernel() == kernel) kernels.push_back(kernel);
+    }
+    rsa_app::SetCodecKernel(rsa_app::BestCodecKernel());
+    return kernels;
+}
+
+std::string RandomBytes(std::mt19937& rng, size_t length) {
+    std::string bytes(length, '\0');
+    for (char& c : bytes) c = static_cast<char>(rng() & 0xFF);
+    return bytes;
+}
+
+template <typename Function>
+bool Throws(Function function) {
+    try {
+        function();
+    } catch (const std::invalid_argument&) {
+        return true;
+    }
+    return false;
+}
+
+}  // namespace
+
+void TestBase64KnownVectors() {
+    try {
+        // RFC 4648, section 10.
+        const char* vectors[][2] = {{"", ""},          {"f", "Zg=="},
+                                    {"fo", "Zm8="},    {"foo", "Zm9v"},
+                                    {"foob", "Zm9vYg=="}, {"fooba", "Zm9vYmE="},
+                                    {"foobar", "Zm9vYmFy"}};
+        for (auto kernel : SupportedKernels()) {
+            rsa_app::SetCodecKernel(kernel);
+            for (auto& vector : vectors) {
+                std::string plain = vector[0];
+                std::string encoded(rsa_app::Base64EncodedLength(plain.size()), '\0');
+                rsa_app::Base64EncodeTo(reinterpret_cast<const unsigned char*>(plain.data()),
+                                        plain.size(), encoded.data());
+                assert(encoded == vector[1]);
+                assert(rsa_app::Base64Decode(vector[1]) == plain);
+            }
+        }
+        rsa_app::SetCodecKernel(rsa_app::BestCodecKernel());
+        std::cout << "TestBase64KnownVectors passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestBase64KnownVectors failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestBase64KernelsAgree() {
+    try {
+        std::mt19937 rng(26);
+        std::vector<rsa_app::CodecKernel> kernels = SupportedKernels();
+        for (size_t length = 0; length < 300; ++length) {
+            std::string plain = RandomBytes(rng, length);
+            std::string reference;
+            for (auto kernel : kernels) {
+                rsa_app::SetCodecKernel(kernel);
+                std::string encoded(rsa_app::Base64EncodedLength(length), '\0');
+                size_t written = rsa_app::Base64EncodeTo(
+                    reinterpret_cast<const unsigned char*>(plain.data()), length,
+                    encoded.data());
+                assert(written == encoded.size());
+                if (reference.empty()) reference = encoded;
+                assert(encoded == reference);
+                assert(rsa_app::Base64Decode(encoded) == plain);
+            }
+        }
+        rsa_app::SetCodecKernel(rsa_app::BestCodecKernel());
+        std::cout << "TestBase64KernelsAgree passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestBase64KernelsAgree failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestBase64RejectsInvalidInput() {
+    try {
+        std::mt19937 rng(27);
+        for (auto kernel : SupportedKernels()) {
+            rsa_app::SetCodecKernel(kernel);
+            assert(Throws([] { rsa_app::Base64Decode("Zm9"); }));
+            assert(Throws([] { rsa_app::Base64Decode("Zg==Zm9v"); }));
+            assert(Throws([] { rsa_app::Base64Decode("Z==="); }));
+            assert(Throws([] { rsa_app::Base64Decode("Zm9v YmFy"); }));
+
+            // A bad character anywhere in a long input must be caught, including
+            // positions covered by the vector kernels.
+            std::string plain = RandomBytes(rng, 150);
+            std::string encoded(rsa_app::Base64EncodedLength(plain.size()), '\0');
+            rsa_app::Base64EncodeTo(reinterpret_cast<const unsigned char*>(plain.data()),
+                                    plain.size(), encoded.data());
+            for (size_t i = 0; i < encoded.size(); ++i) {
+                for (char bad : {'*', '=', '\n', '\x80'}) {
+                    std::string corrupted = encoded;
+                    corrupted[i] = bad;
+                    // A '=' at the end replaces existing padding and stays valid.
+                    if (bad == '=' && i + 1 == encoded.size()) continue;
+                    assert(Throws([&] { rsa_app::Base64Decode(corrupted); }));
+                }
+            }
+        }
+        rsa_app::SetCodecKernel(rsa_app::BestCodecKernel());
+        std::cout << "TestBase64RejectsInvalidInput passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestBase64RejectsInvalidInput failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestHexRoundTrip() {
+    try {
+        std::mt19937 rng(28);
+        for (auto kernel : SupportedKernels()) {
+            rsa_app::SetCodecKernel(kernel);
+            assert(rsa_app::HexEncode("\x01\xab\xff") == "01abff");
+            assert(rsa_app::HexEncode("\x01\xab\xff", true) == "01ABFF");
+            assert(rsa_app::HexDecode("01AbfF") == "\x01\xab\xff");
+            for (size_t length = 0; length < 200; ++length) {
+                std::string plain = RandomBytes(rng, length);
+                std::string lower = rsa_app::HexEncode(plain);
+                std::string upper = rsa_app::HexEncode(plain, true);
+                assert(rsa_app::HexDecode(lower) == plain);
+                assert(rsa_app::HexDecode(upper) == plain);
+                for (size_t i = 0; i < lower.size(); ++i) {
+                    assert(upper[i] == static_cast<char>(std::toupper(lower[i])));
+                }
+            }
+        }
+        rsa_app::SetCodecKernel(rsa_app::BestCodecKernel());
+        std::cout << "TestHexRoundTrip passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestHexRoundTrip failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestHexRejectsInvalidInput() {
+    try {
+        for (auto kernel : SupportedKernels()) {
+            rsa_app::SetCodecKernel(kernel);
+            assert(Throws([] { rsa_app::HexDecode("abc"); }));
+            std::string valid(128, 'a');
+            for (size_t i = 0; i < valid.size(); ++i) {
+                for (char bad : {'g', 'G', '/', ':', '@', '`', ' ', '\xff'}) {
+                    std::string corrupted = valid;
+                    corrupted[i] = bad;
+                    assert(Throws([&] { rsa_app::HexDecode(corrupted); }));
+                }
+            }
+        }
+        rsa_app::SetCodecKernel(rsa_app::BestCodecKernel());
+        std::cout << "TestHexRejectsInvalidInput passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestHexRejectsInvalidInput failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestBase64Streaming() {
+    try {
+        std::mt19937 rng(29);
+        for (int round = 0; round < 50; ++round) {
+            std::string plain = RandomBytes(rng, rng() % 500);
+            std::string expected(rsa_app::Base64EncodedLength(plain.size()), '\0');
+            rsa_app::Base64EncodeTo(reinterpret_cast<const unsigned char*>(plain.data()),
+                                    plain.size(), expected.data());
+
+            // Encode in random chunks.
+            rsa_app::Base64StreamEncoder encoder;
+            std::string encoded;
+            size_t offset = 0;
+            while (offset < plain.size()) {
+                size_t chunk = std::min<size_t>(rng() % 40, plain.size() - offset);
+                std::string buffer(rsa_app::Base64StreamEncoder::MaxUpdateLength(chunk), '\0');
+                size_t written = encoder.Update(
+                    reinterpret_cast<const unsigned char*>(plain.data()) + offset, chunk,
+                    buffer.data());
+                encoded.append(buffer.data(), written);
+                offset += chunk;
+            }
+            char tail[4];
+            encoded.append(tail, encoder.Finish(tail));
+            assert(encoded == expected);
+
+            // Decode in random chunks.
+            rsa_app::Base64StreamDecoder decoder;
+            std::string decoded;
+            offset = 0;
+            while (offset < encoded.size()) {
+                size_t chunk = std::min<size_t>(rng() % 50, encoded.size() - offset);
+                std::string buffer(rsa_app::Base64StreamDecoder::MaxUpdateLength(chunk), '\0');
+                size_t written = decoder.Update(
+                    encoded.data() + offset, chunk,
+                    reinterpret_cast<unsigned char*>(buffer.data()));
+                decoded.append(buffer.data(), written);
+                offset += chunk;
+            }
+            decoder.Finish();
+            assert(decoded == plain);
+        }
+
+        rsa_app::Base64StreamDecoder decoder;
+        unsigned char buffer[8];
+        decoder.Update("Zm9", 3, buffer);
+        assert(Throws([&] { decoder.Finish(); }));
+        assert(Throws([&] { decoder.Update("Zg==Zg==", 8, buffer); }));
+
+        std::cout << "TestBase64Streaming passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestBase64Streaming failed with exception: " << e.what() << std::endl;
+    }
+}
+
+int main() {
+    TestBase64KnownVectors();
+    TestBase64KernelsAgree();
+    TestBase64RejectsInvalidInput();
+    TestHexRoundTrip();
+    TestHexRejectsInvalidInput();
+    TestBase64Streaming();
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include "../src/block_codec.h"
+#include "../src/container.h"
+#include <unistd.h>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string TempPath(const std::string& name) {
+    return "/tmp/rsa_container_test_" + std::to_string(getpid()) + "_" + name;
+}
+
+std::string RandomText(size_t length, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::string text(length, '\0');
+    for (char& c : text) c = static_cast<char>(rng());
+    return text;
+}
+
+// Writes `data` in pieces of `piece` bytes; returns the header info.
+rsa_app::ContainerInfo WriteContainer(const std::string& path, const std::string& data,
+                                      const rsa_app::PublicKey& key, rsa_app::ThreadPool& pool,
+                                      size_t piece) {
+    rsa_app::ContainerWriter writer(path, key, pool, 4);
+    for (size_t pos = 0; pos < data.size(); pos += piece) writer.Append(data.substr(pos, piece));
+    return writer.Finish();
+}
+
+template <typename Exception, typename Fn>
+bool Throws(Fn fn) {
+    try {
+        fn();
+    } catch (const Exception&) {
+        return true;
+    }
+    return false;
+}
+
+void Patch(const std::string& path, size_t offset, char value) {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(static_cast<std::streamoff>(offset));
+    file.put(value);
+}
+
+}  // namespace
+
+void TestContainerRandomAccess() {
+    try {
+        rsa_app::KeyPair key = rsa_app::GenerateKeyPair(1024);
+        rsa_app::ThreadPool pool(3);
+        size_t capacity = rsa_app::BlockCapacity(key.public_key);
+        std::string path = TempPath("access");
+
+        for (size_t size : {size_t{0}, size_t{1}, capacity, capacity + 1, 20 * capacity + 7}) {
+            std::string data = RandomText(size, size);
+            for (size_t piece : {size_t{1}, size_t{100}, size_t{100000}}) {
+                if (piece == 1 && size > capacity + 1) continue;
+                rsa_app::ContainerInfo written =
+                    WriteContainer(path, data, key.public_key, pool, piece);
+                rsa_app::ContainerReader reader(path);
+                const rsa_app::ContainerInfo& info = reader.Info();
+                assert(info.plaintext_size == size && reader.Size() == size);
+                assert(info.block_count == (size + capacity - 1) / capacity);
+                assert(info.block_count == written.block_count);
+                assert(info.block_bytes == 128 && info.block_capacity == capacity);
+                assert(info.fingerprint == rsa_app::KeyFingerprint(key.public_key.n));
+                assert(reader.Read(0, size, key.private_key, pool) == data);
+            }
+        }
+
+        // Arbitrary ranges touch only the blocks that cover them.
+        std::string data = RandomText(20 * capacity + 7, 20);
+        WriteContainer(path, data, key.public_key, pool, 1000);
+        rsa_app::ContainerReader reader(path);
+        std::mt19937_64 rng(1);
+        for (int i = 0; i < 40; ++i) {
+            uint64_t offset = rng() % data.size();
+            uint64_t length = rng() % (data.size() - offset + 1);
+            std::pair<uint64_t, uint64_t> blocks = reader.CoveringBlocks(offset, length);
+            if (length > 0) {
+                assert(blocks.first == offset / capacity);
+                assert(blocks.second == (offset + length - 1) / capacity + 1);
+            }
+            assert(reader.Read(offset, length, key.private_key, pool) ==
+                   data.substr(offset, length));
+        }
+        assert(reader.CoveringBlocks(capacity, 1) == std::make_pair(uint64_t{1}, uint64_t{2}));
+        assert(reader.CoveringBlocks(capacity - 1, 2) == std::make_pair(uint64_t{0}, uint64_t{2}));
+        assert(reader.Read(data.size(), 0, key.private_key, pool).empty());
+
+        assert(Throws<std::out_of_range>([&] { reader.CoveringBlocks(data.size(), 1); }));
+        assert(Throws<std::out_of_range>(
+            [&] { reader.Read(1, data.size(), key.private_key, pool); }));
+        rsa_app::KeyPair other = rsa_app::GenerateKeyPair(1024);
+        assert(Throws<std::invalid_argument>(
+            [&] { reader.Read(0, 10, other.private_key, pool); }));
+        std::remove(path.c_str());
+        std::cout << "TestContainerRandomAccess passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestContainerRandomAccess failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestContainerRejectsDamage() {
+    try {
+        rsa_app::KeyPair key = rsa_app::GenerateKeyPair(1024);
+        rsa_app::ThreadPool pool(2);
+        size_t capacity = rsa_app::BlockCapacity(key.public_key);
+        std::string data = RandomText(5 * capacity, 5);
+        std::string path = TempPath("damage");
+
+        // An unfinished writer leaves no magic behind.
+        {
+            rsa_app::ContainerWriter writer(path, key.public_key, pool, 1);
+            writer.Append(data);
+        }
+        assert(Throws<std::invalid_argument>([&] { rsa_app::ContainerReader reader(path); }));
+        assert(Throws<std::runtime_error>(
+            [&] { rsa_app::ContainerReader reader(TempPath("missing")); }));
+
+        rsa_app::ContainerWriter writer(path, key.public_key, pool);
+        writer.Append(data);
+        writer.Finish();
+        assert(Throws<std::logic_error>([&] { writer.Append("x"); }));
+        assert(Throws<std::logic_error>([&] { writer.Finish(); }));
+
+        // A truncated file fails the size check.
+        std::string truncated = TempPath("truncated");
+        {
+            std::ifstream in(path, std::ios::binary);
+            std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            std::ofstream out(truncated, std::ios::binary);
+            out.write(bytes.data(), static_cast<std::streamsize>(bytes.size() - 1));
+        }
+        assert(Throws<std::invalid_argument>([&] { rsa_app::ContainerReader reader(truncated); }));
+        std::remove(truncated.c_str());
+
+        // A damaged block fails only the reads that cover it.
+        size_t block_start = rsa_app::kContainerHeaderBytes + 2 * 128;
+        Patch(path, block_start + 60, 0x5a);
+        {
+            rsa_app::ContainerReader reader(path);
+            assert(reader.Read(0, 2 * capacity, key.private_key, pool) == data.substr(0, 2 * capacity));
+            assert(Throws<std::invalid_argument>(
+                [&] { reader.Read(2 * capacity, 1, key.private_key, pool); }));
+        }
+
+        // So does a damaged index entry.
+        WriteContainer(path, data, key.public_key, pool, data.size());
+        size_t index_start = rsa_app::kContainerHeaderBytes + 5 * 128;
+        Patch(path, index_start + 3 * 8 + 7, 0x01);
+        {
+            rsa_app::ContainerReader reader(path);
+            assert(reader.Read(0, capacity, key.private_key, pool) == data.substr(0, capacity));
+            assert(Throws<std::invalid_argument>(
+                [&] { reader.Read(3 * capacity, capacity, key.private_key, pool); }));
+        }
+        std::remove(path.c_str());
+        std::cout << "TestContainerRejectsDamage passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestContainerRejectsDamage failed with exception: " << e.what() << std::endl;
+    }
+}
+
+int main() {
+    TestContainerRandomAccess();
+    TestContainerRejectsDamage();
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include "../src/drbg.h"
+#include "../src/bn_wrapper.h"
+#include <openssl/bn.h>
+#include <openssl/evp.h>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+bool IsProbablePrime(const BigNumber& value) {
+    BN_CTX* ctx = BN_CTX_new();
+    int result = BN_check_prime(value.Get(), ctx, nullptr);
+    BN_CTX_free(ctx);
+    return result == 1;
+}
+
+}  // namespace
+
+void TestDrbgMatchesChaCha20() {
+    try {
+        // A seeded generator starts from the key seed || stream || "rsa_app drbg" || 0
+        // and hands out bytes 32..511 of the first 512-byte ChaCha20 keystream.
+        uint64_t seed = 0x0123456789abcdefULL, stream = 7;
+        unsigned char key[32] = {};
+        for (int i = 0; i < 8; ++i) {
+            key[i] = static_cast<unsigned char>(seed >> (8 * i));
+            key[8 + i] = static_cast<unsigned char>(stream >> (8 * i));
+        }
+        std::memcpy(key + 16, "rsa_app drbg", 12);
+        unsigned char iv[16] = {};
+        unsigned char zeros[512] = {};
+        unsigned char keystream[512];
+        int length = 0;
+        EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+        assert(EVP_EncryptInit_ex(ctx, EVP_chacha20(), nullptr, key, iv) == 1);
+        assert(EVP_EncryptUpdate(ctx, keystream, &length, zeros, sizeof(zeros)) == 1);
+        EVP_CIPHER_CTX_free(ctx);
+
+        rsa_app::Drbg drbg(seed, stream);
+        assert(drbg.Deterministic());
+        unsigned char output[480];
+        drbg.Generate(output, sizeof(output));
+        assert(std::memcmp(output, keystream + 32, sizeof(output)) == 0);
+        std::cout << "TestDrbgMatchesChaCha20 passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestDrbgMatchesChaCha20 failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestDrbgStreams() {
+    try {
+        rsa_app::Drbg first(42, 0), again(42, 0), other_stream(42, 1);
+        std::vector<uint64_t> a, b, c;
+        // Crosses several buffer refills.
+        for (int i = 0; i < 1000; ++i) {
+            a.push_back(first.NextWord());
+            b.push_back(again.NextWord());
+            c.push_back(other_stream.NextWord());
+        }
+        assert(a == b);
+        assert(a != c);
+
+        rsa_app::Drbg system_a, system_b;
+        assert(!system_a.Deterministic());
+        assert(system_a.NextWord() != system_b.NextWord());
+
+        uint64_t from_thread[2] = {};
+        std::thread t1([&] { from_thread[0] = rsa_app::ThreadDrbg().NextWord(); });
+        std::thread t2([&] { from_thread[1] = rsa_app::ThreadDrbg().NextWord(); });
+        t1.join();
+        t2.join();
+        assert(from_thread[0] != from_thread[1]);
+        std::cout << "TestDrbgStreams passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestDrbgStreams failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestDrbgRandomNumbers() {
+    try {
+        rsa_app::Drbg drbg(1, 0);
+        for (int bits : {1, 7, 8, 9, 64, 521}) {
+            BigNumber value;
+            value.GenerateRandom(bits, drbg);
+            assert(BN_num_bits(value.Get()) == bits);
+        }
+
+        BigNumber min, max;
+        min.SetWord(5);
+        max.SetWord(7);
+        std::set<unsigned long> seen;
+        for (int i = 0; i < 200; ++i) {
+            seen.insert(BigNumber::GenerateInRange(min.Get(), max.Get(), drbg).GetWord());
+        }
+        assert(seen == (std::set<unsigned long>{5, 6, 7}));
+
+        bool caught = false;
+        try {
+            BigNumber::GenerateInRange(max.Get(), min.Get(), drbg);
+        } catch (const std::invalid_argument&) {
+            caught = true;
+        }
+        assert(caught);
+        std::cout << "TestDrbgRandomNumbers passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestDrbgRandomNumbers failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestDrbgPrimes() {
+    try {
+        rsa_app::Drbg drbg(2, 0);
+        BigNumber value;
+        for (unsigned long prime : {2UL, 3UL, 65521UL, 4294967291UL}) {
+            value.SetWord(prime);
+            assert(value.IsPrime(0, drbg));
+        }
+        // 561 is a Carmichael number; the last one is 65521 * 65537.
+        for (unsigned long composite : {0UL, 1UL, 561UL, 4294049777UL}) {
+            value.SetWord(composite);
+            assert(!value.IsPrime(0, drbg));
+        }
+        BN_set_bit(value.Get(), 127);
+        assert(!value.IsPrime(0, drbg));
+
+        // Without trial division, Miller-Rabin alone rejects a semiprime.
+        BigNumber factor, other;
+        factor.GeneratePrime(256, drbg);
+        other.GeneratePrime(256, drbg);
+        assert(factor.PassesMillerRabin(0, drbg));
+        assert(!factor.Mul(other.Get()).PassesMillerRabin(0, drbg));
+        value.SetWord(65521);
+        assert(value.PassesMillerRabin(0, drbg));
+
+        for (int bits : {2, 10, 17, 18, 256, 1024}) {
+            rsa_app::Drbg first(3, static_cast<uint64_t>(bits));
+            rsa_app::Drbg second(3, static_cast<uint64_t>(bits));
+            BigNumber p, q;
+            int candidates = 0;
+            p.GeneratePrime(bits, first, [&](BigNumber::PrimeEvent event, int) {
+                if (event == BigNumber::PrimeEvent::kCandidate) ++candidates;
+                return true;
+            });
+            q.GeneratePrime(bits, second);
+            assert(BN_num_bits(p.Get()) == bits);
+            assert(BN_cmp(p.Get(), q.Get()) == 0);
+            assert(candidates > 0);
+            assert(IsProbablePrime(p));
+        }
+
+        bool aborted = false;
+        try {
+            value.GeneratePrime(512, drbg, [](BigNumber::PrimeEvent, int) { return false; });
+        } catch (const std::runtime_error&) {
+            aborted = true;
+        }
+        assert(aborted);
+        std::cout << "TestDrbgPrimes passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestDrbgPrimes failed with exception: " << e.what() << std::endl;
+    }
+}
+
+int main() {
+    TestDrbgMatchesChaCha20();
+    TestDrbgStreams();
+    TestDrbgRandomNumbers();
+    TestDrbgPrimes();
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include "../src/fixed_modexp.h"
+#include <openssl/bn.h>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+BigNumber RandomOddModulus(int bits) {
+    BigNumber modulus;
+    BN_rand(modulus.Get(), bits, BN_RAND_TOP_ONE, BN_RAND_BOTTOM_ODD);
+    return modulus;
+}
+
+BigNumber RandomBits(int bits) {
+    BigNumber value;
+    if (bits > 0) BN_rand(value.Get(), bits, BN_RAND_TOP_ANY, BN_RAND_BOTTOM_ANY);
+    return value;
+}
+
+std::vector<rsa_app::FixedKernel> SupportedKernels() {
+    std::vector<rsa_app::FixedKernel> kernels;
+    for (auto kernel : {rsa_app::FixedKernel::kPortable, rsa_app::FixedKernel::kMulxAdx}) {
+        if (rsa_app::FixedKernelSupported(kernel)) kernels.push_back(kernel);
+    }
+    return kernels;
+}
+
+}  // namespace
+
+void TestFixedModExpMatchesOpenSsl() {
+    try {
+        for (auto kernel : SupportedKernels()) {
+            // Both ends of every supported limb count.
+            for (int bits : {1985, 2048, 3009, 3072, 4033, 4096}) {
+                BigNumber modulus = RandomOddModulus(bits);
+                assert(rsa_app::FixedModExpSupports(modulus.Get()));
+                for (int exponent_bits : {0, 1, 17, 333, bits}) {
+                    // Bases up to twice the modulus size exercise reduction.
+                    BigNumber base = RandomBits(exponent_bits % 2 ? bits : 2 * bits);
+                    BigNumber exponent = RandomBits(exponent_bits);
+                    BigNumber expected = base.ModExp(exponent.Get(), modulus.Get());
+
+                    BigNumber windowed =
+                        rsa_app::FixedModExp(base.Get(), exponent.Get(), modulus.Get(), kernel);
+                    assert(BN_cmp(windowed.Get(), expected.Get()) == 0);
+                    BigNumber binary = rsa_app::FixedModExpPublic(base.Get(), exponent.Get(),
+                                                                  modulus.Get(), kernel);
+                    assert(BN_cmp(binary.Get(), expected.Get()) == 0);
+                }
+            }
+            std::cout << "TestFixedModExpMatchesOpenSsl (" << rsa_app::FixedKernelName(kernel)
+                      << ") passed!" << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "TestFixedModExpMatchesOpenSsl failed with exception: " << e.what()
+                  << std::endl;
+    }
+}
+
+void TestFixedModExpRejectsUnsupportedModuli() {
+    try {
+        BigNumber small = RandomOddModulus(1024);
+        BigNumber even = RandomOddModulus(2048);
+        BN_sub_word(even.Get(), 1);
+        assert(!rsa_app::FixedModExpSupports(small.Get()));
+        assert(!rsa_app::FixedModExpSupports(even.Get()));
+
+        BigNumber one;
+        one.SetWord(1);
+        bool caught_error = false;
+        try {
+            rsa_app::FixedModExp(one.Get(), one.Get(), small.Get());
+        } catch (const std::invalid_argument&) {
+            caught_error = true;
+        }
+        assert(caught_error);
+
+        std::cout << "TestFixedModExpRejectsUnsupportedModuli passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestFixedModExpRejectsUnsupportedModuli failed with exception: " << e.what()
+                  << std::endl;
+    }
+}
+
+int main() {
+    TestFixedModExpMatchesOpenSsl();
+    TestFixedModExpRejectsUnsupportedModuli();
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include "../src/key_table.h"
+#include <openssl/bn.h>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+void TestKeyTableMatchesKeyPairs() {
+    try {
+        std::vector<rsa_app::KeyPair> keys;
+        keys.push_back(rsa_app::GenerateKeyPair(1024));
+        keys.push_back(rsa_app::GenerateKeyPair(1024));
+        // A smaller key still fits a 1024-bit table.
+        keys.push_back(rsa_app::GenerateKeyPair(512));
+
+        rsa_app::KeyTable table(1024, 2);
+        std::vector<rsa_app::KeyHandle> handles;
+        for (const auto& key : keys) handles.push_back(table.Add(key));
+        assert(table.Size() == keys.size());
+        assert(table.Stride() % 8 == 0);
+
+        BigNumber message = rsa_app::StringToNumber("resident keys");
+        for (size_t i = 0; i < keys.size(); ++i) {
+            assert(handles[i].index == i && handles[i].table == &table);
+            // Every row starts on its own cache line.
+            assert(reinterpret_cast<uintptr_t>(table.ModulusLimbs(i)) % 64 == 0);
+            assert(BN_cmp(table.Modulus(i).Get(), keys[i].public_key.n.Get()) == 0);
+            assert(BN_cmp(table.PublicExponent(i).Get(), keys[i].public_key.e.Get()) == 0);
+            assert(BN_cmp(table.PrivateExponent(i).Get(), keys[i].private_key.d.Get()) == 0);
+
+            BigNumber expected = rsa_app::Encrypt(message, keys[i].public_key);
+            BigNumber ciphertext = rsa_app::Encrypt(message, handles[i]);
+            assert(BN_cmp(ciphertext.Get(), expected.Get()) == 0);
+            BigNumber plaintext = rsa_app::Decrypt(ciphertext, table.Handle(i));
+            assert(BN_cmp(plaintext.Get(), message.Get()) == 0);
+        }
+
+        // Growing past the reserved capacity keeps the stored keys.
+        for (int i = 0; i < 300; ++i) table.Add(keys[0]);
+        assert(BN_cmp(table.Modulus(1).Get(), keys[1].public_key.n.Get()) == 0);
+        BigNumber ciphertext = rsa_app::Encrypt(message, table.Handle(250));
+        assert(BN_cmp(rsa_app::Decrypt(ciphertext, handles[0]).Get(), message.Get()) == 0);
+
+        rsa_app::KeyStorageFootprint footprint = table.Footprint();
+        assert(footprint.keys == table.Size());
+        assert(footprint.reserved_bytes >= footprint.public_bytes + footprint.private_bytes);
+        assert(footprint.bytes_per_key < static_cast<double>(rsa_app::KeyPairBytes(keys[0])));
+
+        std::cout << "TestKeyTableMatchesKeyPairs passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestKeyTableMatchesKeyPairs failed with exception: " << e.what()
+                  << std::endl;
+    }
+}
+
+void TestKeyTableRejectsInvalidKeys() {
+    try {
+        rsa_app::KeyPair key_pair = rsa_app::GenerateKeyPair(1024);
+        rsa_app::KeyTable small(512);
+        bool caught_size = false;
+        try {
+            small.Add(key_pair);
+        } catch (const std::invalid_argument&) {
+            caught_size = true;
+        }
+        assert(caught_size);
+
+        rsa_app::KeyTable table(1024);
+        BN_set_bit(key_pair.public_key.e.Get(), 70);
+        bool caught_exponent = false;
+        try {
+            table.Add(key_pair);
+        } catch (const std::invalid_argument&) {
+            caught_exponent = true;
+        }
+        assert(caught_exponent);
+        assert(table.Size() == 0);
+
+        bool caught_index = false;
+        try {
+            table.Handle(0);
+        } catch (const std::out_of_range&) {
+            caught_index = true;
+        }
+        assert(caught_index);
+
+        bool caught_handle = false;
+        try {
+            rsa_app::Encrypt(rsa_app::StringToNumber("x"), rsa_app::KeyHandle{});
+        } catch (const std::invalid_argument&) {
+            caught_handle = true;
+        }
+        assert(caught_handle);
+
+        std::cout << "TestKeyTableRejectsInvalidKeys passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestKeyTableRejectsInvalidKeys failed with exception: " << e.what()
+                  << std::endl;
+    }
+}
+
+void TestKeyTableCopiesRows() {
+    try {
+        rsa_app::KeyPair small_key = rsa_app::GenerateKeyPair(512);
+        rsa_app::KeyPair large_key = rsa_app::GenerateKeyPair(1024);
+        rsa_app::KeyTable small(512);
+        rsa_app::KeyTable large(1024, 1);
+        small.Add(small_key);
+        large.Add(large_key);
+
+        // Narrower rows fit a wider table; copying within a table survives
+        // the growth it causes.
+        rsa_app::KeyHandle copied = large.Add(small.Handle(0));
+        rsa_app::KeyHandle self = large.Add(large.Handle(0));
+        assert(copied.index == 1 && self.index == 2 && large.Size() == 3);
+        assert(BN_cmp(large.Modulus(1).Get(), small_key.public_key.n.Get()) == 0);
+        assert(BN_cmp(large.PrivateExponent(1).Get(), small_key.private_key.d.Get()) == 0);
+        assert(BN_cmp(large.PublicExponent(2).Get(), large_key.public_key.e.Get()) == 0);
+        BigNumber message = rsa_app::StringToNumber("copied row");
+        BigNumber ciphertext = rsa_app::Encrypt(message, large_key.public_key);
+        assert(BN_cmp(rsa_app::Decrypt(ciphertext, self).Get(), message.Get()) == 0);
+
+        bool caught_size = false;
+        try {
+            small.Add(large.Handle(0));
+        } catch (const std::invalid_argument&) {
+            caught_size = true;
+        }
+        assert(caught_size && small.Size() == 1);
+
+        bool caught_index = false;
+        try {
+            small.Add(rsa_app::KeyHandle{&large, 3});
+        } catch (const std::out_of_range&) {
+            caught_index = true;
+        }
+        assert(caught_index);
+        std::cout << "TestKeyTableCopiesRows passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestKeyTableCopiesRows failed with exception: " << e.what() << std::endl;
+    }
+}
+
+int main() {
+    TestKeyTableMatchesKeyPairs();
+    TestKeyTableRejectsInvalidKeys();
+    TestKeyTableCopiesRows();
+    return 0;
+}
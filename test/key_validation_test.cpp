@@ -0,0 +1,190 @@
+#include "../src/key_validation.h"
+#include <unistd.h>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string TempPath(const std::string& name) {
+    return "/tmp/rsa_key_validation_test_" + std::to_string(getpid()) + "_" + name;
+}
+
+BigNumber Prime(int bits) {
+    BigNumber prime;
+    prime.GeneratePrime(bits);
+    return prime;
+}
+
+// Builds a key with e = 65537 over the product of `primes`, with d taken mod
+// lcm(p_i - 1) if `lambda` is set and mod prod(p_i - 1) otherwise.
+rsa_app::KeyPair MakeKey(const std::vector<const BigNumber*>& primes, bool lambda) {
+    BigNumber n, order, e;
+    n.SetWord(1);
+    order.SetWord(1);
+    e.SetWord(65537);
+    BN_CTX* ctx = BN_CTX_new();
+    for (const BigNumber* prime : primes) {
+        BigNumber minus_one = prime->Sub(BN_value_one());
+        BN_mul(n.Get(), n.Get(), prime->Get(), ctx);
+        if (lambda) {
+            BigNumber gcd = order.Gcd(minus_one.Get());
+            BN_mul(order.Get(), order.Get(), minus_one.Get(), ctx);
+            BN_div(order.Get(), nullptr, order.Get(), gcd.Get(), ctx);
+        } else {
+            BN_mul(order.Get(), order.Get(), minus_one.Get(), ctx);
+        }
+    }
+    BN_CTX_free(ctx);
+    BigNumber d = e.ModInverse(order.Get());
+    rsa_app::KeyPair key_pair;
+    key_pair.public_key = rsa_app::PublicKey{n.Copy(), std::move(e)};
+    key_pair.private_key = rsa_app::PrivateKey{std::move(n), std::move(d)};
+    return key_pair;
+}
+
+void Corrupt(rsa_app::KeyPair& key_pair) {
+    BN_add_word(key_pair.private_key.d.Get(), 2);
+}
+
+}  // namespace
+
+void TestKeyValidationAcceptsValidKeys() {
+    try {
+        rsa_app::KeyPair generated = rsa_app::GenerateKeyPair(1024);
+        assert(rsa_app::CheckKeyPair(generated, rsa_app::KeyCheckLevel::kCheap) ==
+               rsa_app::KeyDefect::kNone);
+        assert(rsa_app::CheckKeyPair(generated, rsa_app::KeyCheckLevel::kFull) ==
+               rsa_app::KeyDefect::kNone);
+
+        // d mod lambda(n) instead of phi(n) needs the randomized factoring.
+        BigNumber p = Prime(512), q = Prime(512);
+        rsa_app::KeyPair lambda = MakeKey({&p, &q}, true);
+        assert(rsa_app::CheckKeyPair(lambda, rsa_app::KeyCheckLevel::kFull) ==
+               rsa_app::KeyDefect::kNone);
+        assert(std::string(rsa_app::KeyDefectName(rsa_app::KeyDefect::kSmallFactor)) ==
+               "small_factor");
+        std::cout << "TestKeyValidationAcceptsValidKeys passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestKeyValidationAcceptsValidKeys failed with exception: " << e.what()
+                  << std::endl;
+    }
+}
+
+void TestKeyValidationFindsDefects() {
+    try {
+        const auto cheap = rsa_app::KeyCheckLevel::kCheap;
+        const auto full = rsa_app::KeyCheckLevel::kFull;
+        BigNumber p = Prime(512), q = Prime(512);
+
+        rsa_app::KeyPair key = MakeKey({&p, &q}, false);
+        Corrupt(key);
+        assert(rsa_app::CheckKeyPair(key, cheap) == rsa_app::KeyDefect::kRoundTripFailed);
+
+        key = MakeKey({&p, &q}, false);
+        key.public_key.e.SetWord(65536);
+        assert(rsa_app::CheckKeyPair(key, cheap) == rsa_app::KeyDefect::kBadExponent);
+
+        key = MakeKey({&p, &q}, false);
+        BN_add_word(key.private_key.n.Get(), 2);
+        assert(rsa_app::CheckKeyPair(key, cheap) == rsa_app::KeyDefect::kBadModulus);
+
+        BigNumber tiny_p = Prime(200), tiny_q = Prime(200);
+        key = MakeKey({&tiny_p, &tiny_q}, false);
+        assert(rsa_app::CheckKeyPair(key, cheap) == rsa_app::KeyDefect::kBadModulus);
+
+        BigNumber three;
+        three.SetWord(3);
+        BigNumber large = Prime(1024);
+        key = MakeKey({&three, &large}, false);
+        assert(rsa_app::CheckKeyPair(key, cheap) == rsa_app::KeyDefect::kSmallFactor);
+
+        BigNumber small_p = Prime(256), small_q = Prime(256);
+        // A valid three-prime key passes the cheap checks but cannot be
+        // split into two primes.
+        key = MakeKey({&small_p, &small_q, &large}, true);
+        assert(rsa_app::CheckKeyPair(key, cheap) == rsa_app::KeyDefect::kNone);
+        assert(rsa_app::CheckKeyPair(key, full) == rsa_app::KeyDefect::kCompositeFactor);
+
+        // q is the first prime above p + 2^100.
+        BigNumber offset, close;
+        BN_set_bit(offset.Get(), 100);
+        BN_add(close.Get(), p.Get(), offset.Get());
+        BN_add_word(close.Get(), 2);
+        while (!close.IsPrime(0, rsa_app::ThreadDrbg())) BN_add_word(close.Get(), 2);
+        key = MakeKey({&p, &close}, false);
+        assert(rsa_app::CheckKeyPair(key, cheap) == rsa_app::KeyDefect::kNone);
+        assert(rsa_app::CheckKeyPair(key, full) == rsa_app::KeyDefect::kCloseFactors);
+        std::cout << "TestKeyValidationFindsDefects passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestKeyValidationFindsDefects failed with exception: " << e.what()
+                  << std::endl;
+    }
+}
+
+void TestKeyValidationBulk() {
+    try {
+        rsa_app::ThreadPool pool(2);
+        std::vector<rsa_app::KeyPair> keys;
+        rsa_app::KeyTable table(1024);
+        for (int i = 0; i < 8; ++i) {
+            keys.push_back(rsa_app::GenerateKeyPair(1024));
+            if (i == 2 || i == 5) Corrupt(keys.back());
+            table.Add(keys.back());
+        }
+        for (auto level : {rsa_app::KeyCheckLevel::kCheap, rsa_app::KeyCheckLevel::kFull}) {
+            rsa_app::KeyValidationReport report = rsa_app::ValidateKeys(table, level, pool);
+            assert(report.checked == 8 && report.failures.size() == 2);
+            assert(report.failures[0].first == 2 && report.failures[1].first == 5);
+            assert(report.failures[0].second == rsa_app::KeyDefect::kRoundTripFailed);
+            assert(rsa_app::ValidateKeys(keys, level, pool).failures == report.failures);
+        }
+        assert(rsa_app::CheckKeyPair(table, 0, rsa_app::KeyCheckLevel::kFull) ==
+               rsa_app::KeyDefect::kNone);
+
+        std::vector<std::string> paths;
+        for (int i = 0; i < 4; ++i) {
+            paths.push_back(TempPath("key" + std::to_string(i)));
+            rsa_app::SaveKeyPair(keys[i], paths.back());
+        }
+        {
+            std::ofstream file(paths[3], std::ios::trunc);
+            file << "not a key\n";
+        }
+        paths.push_back(TempPath("missing"));
+        rsa_app::KeyTable loaded(1024);
+        rsa_app::KeyLoadReport report =
+            rsa_app::LoadKeyTable(paths, loaded, rsa_app::KeyCheckLevel::kCheap, pool);
+        assert(report.loaded == 2 && loaded.Size() == 2);
+        assert(report.rejected.size() == 3);
+        assert(report.rejected[0].first == 2 && report.rejected[0].second == "round_trip_failed");
+        assert(report.rejected[1].first == 3 && report.rejected[2].first == 4);
+        assert(BN_cmp(loaded.Modulus(1).Get(), keys[1].public_key.n.Get()) == 0);
+
+        rsa_app::KeyPair valid =
+            rsa_app::LoadValidatedKeyPair(paths[0], rsa_app::KeyCheckLevel::kFull);
+        assert(BN_cmp(valid.private_key.d.Get(), keys[0].private_key.d.Get()) == 0);
+        bool rejected = false;
+        try {
+            rsa_app::LoadValidatedKeyPair(paths[2], rsa_app::KeyCheckLevel::kCheap);
+        } catch (const std::invalid_argument& e) {
+            rejected = std::string(e.what()).find("round_trip_failed") != std::string::npos;
+        }
+        assert(rejected);
+        for (const auto& path : paths) std::remove(path.c_str());
+        std::cout << "TestKeyValidationBulk passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestKeyValidationBulk failed with exception: " << e.what() << std::endl;
+    }
+}
+
+int main() {
+    TestKeyValidationAcceptsValidKeys();
+    TestKeyValidationFindsDefects();
+    TestKeyValidationBulk();
+    return 0;
+}
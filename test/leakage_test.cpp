@@ -0,0 +1,136 @@
+#include "../src/leakage.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+bool Near(double a, double b, double tolerance = 1e-9) {
+    return std::fabs(a - b) <= tolerance * std::max(1.0, std::fabs(b));
+}
+
+// Timings of a kernel with an exponential tail of interrupts and misses;
+// class 1 is shifted by `shift` and scaled in spread by `spread`.
+uint64_t FakeTiming(std::mt19937_64& rng, int cls, double shift, double spread) {
+    std::normal_distribution<double> body(10000.0, 50.0 * (cls ? spread : 1.0));
+    std::exponential_distribution<double> tail(1.0 / 2000.0);
+    double value = body(rng) + (cls ? shift : 0.0);
+    if (rng() % 50 == 0) value += tail(rng);
+    return static_cast<uint64_t>(std::max(0.0, value));
+}
+
+rsa_app::LeakageResult RunFake(double shift, double spread, size_t samples) {
+    std::mt19937_64 rng(7);
+    rsa_app::LeakageTest test(1000);
+    for (size_t i = 0; i < samples; ++i) {
+        int cls = static_cast<int>(rng() & 1);
+        test.Push(cls, FakeTiming(rng, cls, shift, spread));
+    }
+    return test.Result();
+}
+
+}  // namespace
+
+void TestOnlineWelchTest() {
+    try {
+        rsa_app::OnlineWelchTest test;
+        assert(test.T() == 0.0);
+        for (double x : {1.0, 2.0, 3.0, 4.0}) test.Push(0, x);
+        for (double x : {2.0, 4.0, 6.0}) test.Push(1, x);
+        // Means 2.5 and 4, variances 5/3 and 4.
+        assert(test.Count(0) == 4 && test.Count(1) == 3);
+        assert(Near(test.Mean(0), 2.5) && Near(test.Mean(1), 4.0));
+        assert(Near(test.T(), -1.5 / std::sqrt(5.0 / 12.0 + 4.0 / 3.0)));
+
+        rsa_app::OnlineWelchTest constant;
+        for (int i = 0; i < 4; ++i) {
+            constant.Push(0, 7.0);
+            constant.Push(1, 7.0);
+        }
+        assert(constant.T() == 0.0);
+        std::cout << "TestOnlineWelchTest passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestOnlineWelchTest failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestLeakageTestVerdicts() {
+    try {
+        rsa_app::LeakageTest pending(1000);
+        for (int i = 0; i < 999; ++i) pending.Push(i & 1, 100);
+        assert(!pending.Calibrated());
+        assert(pending.Result().worst_test == -1 && !pending.Result().leaks);
+        assert(pending.Result().measurements == 999);
+        pending.Push(1, 100);
+        assert(pending.Calibrated() && pending.Result().measurements == 1000);
+
+        // Same distribution: no test fires.
+        rsa_app::LeakageResult same = RunFake(0.0, 1.0, 200000);
+        assert(same.measurements == 200000);
+        assert(!same.leaks && same.max_t < rsa_app::kLeakageThreshold);
+
+        // A shift of a tenth of the spread is found.
+        rsa_app::LeakageResult shifted = RunFake(5.0, 1.0, 200000);
+        assert(shifted.leaks);
+
+        // Equal means but class-dependent variance: the uncropped test
+        // misses it, the second-order test does not.
+        rsa_app::LeakageTest names(1000);
+        std::mt19937_64 rng(3);
+        std::normal_distribution<double> narrow(10000.0, 50.0), wide(10000.0, 150.0);
+        for (int i = 0; i < 200000; ++i) {
+            int cls = static_cast<int>(rng() & 1);
+            names.Push(cls, static_cast<uint64_t>(cls ? wide(rng) : narrow(rng)));
+        }
+        rsa_app::LeakageResult spread = names.Result();
+        int second_order = static_cast<int>(rsa_app::LeakageTest::TestCount()) - 1;
+        assert(spread.leaks);
+        assert(names.TestName(second_order) == "second order");
+        assert(std::fabs(names.TestT(second_order)) > rsa_app::kLeakageThreshold);
+        assert(std::fabs(names.TestT(0)) < rsa_app::kLeakageThreshold);
+        assert(names.TestName(0) == "all");
+        assert(names.TestName(1).rfind("crop p", 0) == 0);
+        assert(rsa_app::LeakageTest::TestCount() == rsa_app::LeakageTest::kCropCount + 2);
+
+        bool caught = false;
+        try {
+            names.Push(2, 1);
+        } catch (const std::invalid_argument&) {
+            caught = true;
+        }
+        assert(caught);
+        caught = false;
+        try {
+            rsa_app::LeakageTest(0);
+        } catch (const std::invalid_argument&) {
+            caught = true;
+        }
+        assert(caught);
+        std::cout << "TestLeakageTestVerdicts passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestLeakageTestVerdicts failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestCycleCounterAdvances() {
+    try {
+        uint64_t start = rsa_app::ReadCycleCounter();
+        volatile double sink = 0.0;
+        for (int i = 0; i < 100000; ++i) sink = sink + std::sqrt(static_cast<double>(i));
+        assert(rsa_app::ReadCycleCounter() > start);
+        std::cout << "TestCycleCounterAdvances passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestCycleCounterAdvances failed with exception: " << e.what() << std::endl;
+    }
+}
+
+int main() {
+    TestOnlineWelchTest();
+    TestLeakageTestVerdicts();
+    TestCycleCounterAdvances();
+    return 0;
+}
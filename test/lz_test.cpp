@@ -0,0 +1,154 @@
+#include "../src/lz.h"
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string RandomBytes(size_t length, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::string bytes(length, '\0');
+    for (char& c : bytes) c = static_cast<char>(rng());
+    return bytes;
+}
+
+// JSON-like records with repeated keys and small varying values
+std::string JsonRecords(size_t count) {
+    std::string json = "[";
+    for (size_t i = 0; i < count; ++i) {
+        json += "{\"id\":" + std::to_string(i) + ",\"user\":\"user" + std::to_string(i % 37) +
+                "\",\"active\":" + (i % 3 ? "true" : "false") + ",\"score\":" +
+                std::to_string(i * 7919 % 1000) + "},";
+    }
+    json.back() = ']';
+    return json;
+}
+
+bool Rejects(const std::string& frames) {
+    try {
+        rsa_app::LzDecompress(frames);
+    } catch (const std::invalid_argument&) {
+        return true;
+    }
+    return false;
+}
+
+}  // namespace
+
+void TestLzRoundTrip() {
+    try {
+        std::string json = JsonRecords(20000);  // Several frames
+        assert(json.size() > 3 * rsa_app::kLzFrameBytes);
+        std::vector<std::string> inputs = {
+            "", "a", "abcd", std::string(1000, 'z'), "abcabcabcabcabcabcabcabc",
+            RandomBytes(100, 1), RandomBytes(3 * rsa_app::kLzFrameBytes + 5, 2), json,
+            std::string(rsa_app::kLzFrameBytes, '\0')};
+        for (const auto& input : inputs) {
+            std::string compressed = rsa_app::LzCompress(input);
+            assert(rsa_app::LzDecompress(compressed) == input);
+            // Incompressible frames are stored with a 4-byte header.
+            size_t frames = (input.size() + rsa_app::kLzFrameBytes - 1) / rsa_app::kLzFrameBytes;
+            assert(compressed.size() <= input.size() + 4 * frames);
+        }
+        assert(rsa_app::LzCompress("").empty());
+        assert(rsa_app::LzCompress(json).size() * 4 < json.size());
+        assert(rsa_app::LzCompress(std::string(1000, 'z')).size() < 20);
+        std::cout << "TestLzRoundTrip passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestLzRoundTrip failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestLzStreaming() {
+    try {
+        std::string input = JsonRecords(15000) + RandomBytes(70000, 3);
+        std::string whole = rsa_app::LzCompress(input);
+        for (size_t piece : {1, 1000, 65536, 100000}) {
+            // Any split of the input gives the same frames...
+            rsa_app::LzStreamCompressor compressor;
+            std::string frames;
+            for (size_t pos = 0; pos < input.size(); pos += piece) {
+                frames += compressor.Update(input.substr(pos, piece));
+            }
+            frames += compressor.Finish();
+            assert(frames == whole);
+
+            // ... and any split of the frames decodes.
+            rsa_app::LzStreamDecompressor decompressor;
+            std::string output;
+            for (size_t pos = 0; pos < frames.size(); pos += piece) {
+                output += decompressor.Update(frames.substr(pos, piece));
+            }
+            decompressor.Finish();
+            assert(output == input);
+        }
+
+        rsa_app::LzStreamDecompressor truncated;
+        truncated.Update(whole.substr(0, whole.size() - 1));
+        bool caught = false;
+        try {
+            truncated.Finish();
+        } catch (const std::invalid_argument&) {
+            caught = true;
+        }
+        assert(caught);
+        std::cout << "TestLzStreaming passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestLzStreaming failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestLzRejectsCorruptFrames() {
+    try {
+        std::string frames = rsa_app::LzCompress(JsonRecords(100));
+        assert(frames[0] == 1);
+        assert(Rejects(frames.substr(0, 3)));
+        assert(Rejects(frames.substr(0, frames.size() - 1)));
+
+        std::string bad_type = frames;
+        bad_type[0] = 7;
+        assert(Rejects(bad_type));
+        std::string too_long = frames;
+        too_long[1] = 0x7f;  // Original length beyond kLzFrameBytes
+        assert(Rejects(too_long));
+        std::string wrong_length = frames;
+        wrong_length[3] = static_cast<char>(wrong_length[3] + 1);
+        assert(Rejects(wrong_length));
+
+        // A match reaching before the frame start: "abcd" then offset 9.
+        std::string before_start = std::string("\x01\x00\x00\x08\x00\x00\x07", 7) +
+                                   std::string("\x40" "abcd" "\x09\x00", 7);
+        assert(Rejects(before_start));
+        // A sequence with a match but no closing literals-only sequence.
+        std::string unterminated = std::string("\x01\x00\x00\x08\x00\x00\x07", 7) +
+                                   std::string("\x40" "abcd" "\x04\x00", 7);
+        assert(Rejects(unterminated));
+        std::string terminated = std::string("\x01\x00\x00\x08\x00\x00\x08", 7) +
+                                 std::string("\x40" "abcd" "\x04\x00\x00", 8);
+        assert(rsa_app::LzDecompress(terminated) == "abcdabcd");
+
+        // Random garbage never crashes, it only throws or decodes.
+        for (uint64_t seed = 0; seed < 200; ++seed) {
+            std::string garbage = frames;
+            std::mt19937_64 rng(seed);
+            for (int i = 0; i < 4; ++i) garbage[rng() % garbage.size()] = static_cast<char>(rng());
+            try {
+                rsa_app::LzDecompress(garbage);
+            } catch (const std::invalid_argument&) {
+            }
+        }
+        std::cout << "TestLzRejectsCorruptFrames passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestLzRejectsCorruptFrames failed with exception: " << e.what() << std::endl;
+    }
+}
+
+int main() {
+    TestLzRoundTrip();
+    TestLzStreaming();
+    TestLzRejectsCorruptFrames();
+    return 0;
+}
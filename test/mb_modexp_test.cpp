@@ -0,0 +1,139 @@
+#include "../src/mb_modexp.h"
+#include <openssl/bn.h>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Random odd modulus of exactly `bits` bits.
+BigNumber RandomOddModulus(int bits) {
+    BigNumber modulus;
+    BN_rand(modulus.Get(), bits, BN_RAND_TOP_ONE, BN_RAND_BOTTOM_ODD);
+    return modulus;
+}
+
+BigNumber RandomBelow(const BigNumber& limit) {
+    BigNumber value;
+    BN_rand_range(value.Get(), limit.Get());
+    return value;
+}
+
+BigNumber RandomBits(int bits) {
+    BigNumber value;
+    BN_rand(value.Get(), bits, BN_RAND_TOP_ANY, BN_RAND_BOTTOM_ANY);
+    return value;
+}
+
+// Runs `count` random operations on `kernel` and compares with ModExp.
+void CheckAgainstModExp(rsa_app::MbKernel kernel, int modulus_bits, int exponent_bits,
+                        size_t count) {
+    std::vector<BigNumber> bases, exponents, moduli;
+    for (size_t i = 0; i < count; ++i) {
+        moduli.push_back(RandomOddModulus(modulus_bits));
+        bases.push_back(RandomBelow(moduli.back()));
+        exponents.push_back(RandomBits(exponent_bits));
+    }
+    std::vector<const BIGNUM*> base_ptrs, exponent_ptrs, modulus_ptrs;
+    for (size_t i = 0; i < count; ++i) {
+        base_ptrs.push_back(bases[i].Get());
+        exponent_ptrs.push_back(exponents[i].Get());
+        modulus_ptrs.push_back(moduli[i].Get());
+    }
+
+    std::vector<BigNumber> results =
+        rsa_app::MultiBufferModExp(base_ptrs, exponent_ptrs, modulus_ptrs, kernel);
+    assert(results.size() == count);
+    for (size_t i = 0; i < count; ++i) {
+        BigNumber expected = bases[i].ModExp(exponents[i].Get(), moduli[i].Get());
+        assert(BN_cmp(results[i].Get(), expected.Get()) == 0);
+    }
+}
+
+std::vector<rsa_app::MbKernel> SupportedKernels() {
+    std::vector<rsa_app::MbKernel> kernels;
+    for (auto kernel : {rsa_app::MbKernel::kScalar, rsa_app::MbKernel::kAvx2,
+                        rsa_app::MbKernel::kAvx512Ifma}) {
+        if (rsa_app::MbKernelSupported(kernel)) kernels.push_back(kernel);
+    }
+    return kernels;
+}
+
+}  // namespace
+
+void TestMbModExpMatchesModExp() {
+    try {
+        for (auto kernel : SupportedKernels()) {
+            // Partial groups, whole groups and more than one group.
+            for (size_t count : {1, 3, 4, 8, 16, 17}) {
+                CheckAgainstModExp(kernel, 2048, 64, count);
+            }
+            // Limb counts that leave spare bits in the top limb.
+            for (int bits : {61, 520, 1000, 3072, 4096}) {
+                CheckAgainstModExp(kernel, bits, 80, 5);
+            }
+            // Full-size private exponents.
+            CheckAgainstModExp(kernel, 2048, 2048, 2);
+            std::cout << "TestMbModExpMatchesModExp (" << rsa_app::MbKernelName(kernel)
+                      << ") passed!" << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "TestMbModExpMatchesModExp failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestMbModExpEdgeCases() {
+    try {
+        BigNumber modulus = RandomOddModulus(2048);
+        BigNumber zero, one, large, exponent;
+        one.SetWord(1);
+        exponent.SetWord(65537);
+        // A base above the modulus is reduced first.
+        BN_lshift(large.Get(), modulus.Get(), 3);
+        BN_add_word(large.Get(), 5);
+
+        std::vector<const BIGNUM*> bases = {zero.Get(), one.Get(), large.Get(), modulus.Get()};
+        std::vector<const BIGNUM*> exponents = {exponent.Get(), zero.Get(), exponent.Get(),
+                                                exponent.Get()};
+        std::vector<const BIGNUM*> moduli(4, modulus.Get());
+        for (auto kernel : SupportedKernels()) {
+            auto results = rsa_app::MultiBufferModExp(bases, exponents, moduli, kernel);
+            assert(BN_is_zero(results[0].Get()));
+            assert(BN_is_one(results[1].Get()));
+            BigNumber five;
+            five.SetWord(5);
+            BigNumber expected = five.ModExp(exponent.Get(), modulus.Get());
+            assert(BN_cmp(results[2].Get(), expected.Get()) == 0);
+            assert(BN_is_zero(results[3].Get()));
+        }
+
+        bool caught_even = false;
+        BigNumber even;
+        even.SetWord(1024);
+        try {
+            rsa_app::MultiBufferModExp({one.Get()}, {one.Get()}, {even.Get()});
+        } catch (const std::invalid_argument&) {
+            caught_even = true;
+        }
+        assert(caught_even);
+
+        bool caught_size = false;
+        try {
+            rsa_app::MultiBufferModExp({one.Get()}, {}, {modulus.Get()});
+        } catch (const std::invalid_argument&) {
+            caught_size = true;
+        }
+        assert(caught_size);
+
+        std::cout << "TestMbModExpEdgeCases passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestMbModExpEdgeCases failed with exception: " << e.what() << std::endl;
+    }
+}
+
+int main() {
+    TestMbModExpMatchesModExp();
+    TestMbModExpEdgeCases();
+    return 0;
+}
@@ -0,0 +1,187 @@
+#include "../src/numa.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#include "../src/rsa.h"
+
+namespace {
+
+template <typename Exception, typename Fn>
+bool Throws(Fn fn) {
+    try {
+        fn();
+    } catch (const Exception&) {
+        return true;
+    }
+    return false;
+}
+
+void WriteFile(const std::string& path, const std::string& contents) {
+    std::ofstream file(path, std::ios::trunc);
+    file << contents;
+}
+
+}  // namespace
+
+void TestNumaTopology() {
+    try {
+        assert(rsa_app::ParseCpuList("0-3,8,10-11\n") ==
+               (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+        assert(rsa_app::ParseCpuList("5,1-2").front() == 1);
+        assert(rsa_app::ParseCpuList("\n").empty());
+        for (const char* malformed : {"3-1", "a", "1,,2", "1,", "-1", "0-"}) {
+            assert(Throws<std::invalid_argument>([&] { rsa_app::ParseCpuList(malformed); }));
+        }
+
+        rsa_app::NumaTopology simulated = rsa_app::SimulateNumaTopology(3);
+        assert(simulated.simulated && simulated.Nodes() == 3);
+        for (const auto& cpus : simulated.node_cpus) assert(!cpus.empty());
+        assert(Throws<std::invalid_argument>([] { rsa_app::SimulateNumaTopology(0); }));
+
+        // A fake sysfs tree: node 1 has no CPUs and is dropped.
+        rsa_app::NumaTopology detected = rsa_app::DetectNumaTopology();
+        assert(detected.Nodes() >= 1 && !detected.simulated);
+        int cpu = detected.node_cpus[0][0];
+        std::string root = "/tmp/rsa_numa_test_" + std::to_string(getpid());
+        mkdir(root.c_str(), 0700);
+        mkdir((root + "/node0").c_str(), 0700);
+        mkdir((root + "/node1").c_str(), 0700);
+        WriteFile(root + "/online", "0-1\n");
+        WriteFile(root + "/node0/cpulist", std::to_string(cpu) + "\n");
+        WriteFile(root + "/node1/cpulist", "\n");
+        rsa_app::NumaTopology fake = rsa_app::DetectNumaTopology(root);
+        assert(fake.Nodes() == 1 && fake.node_cpus[0] == std::vector<int>{cpu});
+        assert(rsa_app::DescribeNumaTopology(fake) == "1 node: " + std::to_string(cpu));
+        // Unreadable trees fall back to one node with every allowed CPU.
+        WriteFile(root + "/online", "garbage\n");
+        assert(rsa_app::DetectNumaTopology(root).Nodes() == 1);
+        assert(rsa_app::DetectNumaTopology(root + "/missing").Nodes() == 1);
+        for (const char* file : {"/online", "/node0/cpulist", "/node1/cpulist"}) {
+            std::remove((root + file).c_str());
+        }
+        rmdir((root + "/node0").c_str());
+        rmdir((root + "/node1").c_str());
+        rmdir(root.c_str());
+
+        rsa_app::NumaTopology described;
+        described.simulated = true;
+        described.node_cpus = {{0, 1, 2}, {3, 5}};
+        assert(rsa_app::DescribeNumaTopology(described) == "2 nodes (simulated): 0-2 | 3,5");
+        std::cout << "TestNumaTopology passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestNumaTopology failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestNumaPoolPinsWorkers() {
+    try {
+        rsa_app::NumaTopology topology = rsa_app::SimulateNumaTopology(2);
+        rsa_app::NumaPool pool(topology, 2);
+        assert(pool.Nodes() == 2 && pool.Size() == 4);
+        for (size_t node = 0; node < pool.Nodes(); ++node) {
+            std::atomic<int> foreign{0};
+            pool.Node(node).ParallelFor(64, [&](size_t, size_t) {
+#ifdef __linux__
+                const auto& cpus = topology.node_cpus[node];
+                if (std::find(cpus.begin(), cpus.end(), sched_getcpu()) == cpus.end()) ++foreign;
+#endif
+            });
+            assert(foreign == 0);
+#ifdef __linux__
+            assert(pool.Node(node).Pinned());
+#endif
+        }
+
+        // A single node is a plain pool.
+        rsa_app::NumaPool single(rsa_app::SimulateNumaTopology(1), 2);
+        assert(single.Nodes() == 1 && !single.Node(0).Pinned());
+        assert(Throws<std::invalid_argument>([] { rsa_app::NumaPool(rsa_app::NumaTopology()); }));
+        std::cout << "TestNumaPoolPinsWorkers passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestNumaPoolPinsWorkers failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestNumaDecryptBatch() {
+    try {
+        rsa_app::KeyTable table(1024);
+        std::vector<rsa_app::KeyPair> keys;
+        for (int i = 0; i < 4; ++i) {
+            keys.push_back(rsa_app::GenerateKeyPair(1024));
+            table.Add(keys.back());
+        }
+        std::vector<BigNumber> ciphertexts;
+        std::vector<BigNumber> messages;
+        std::vector<size_t> key_indices;
+        for (size_t i = 0; i < 24; ++i) {
+            BigNumber message;
+            message.SetWord(1000 + i);
+            ciphertexts.push_back(rsa_app::Encrypt(message, keys[i % 4].public_key));
+            messages.push_back(std::move(message));
+            key_indices.push_back(i % 4);
+        }
+
+        rsa_app::NumaPool pool(rsa_app::SimulateNumaTopology(2), 1);
+        rsa_app::NumaKeyReplicas all(table, pool);
+        for (size_t node = 0; node < 2; ++node) {
+            const rsa_app::KeyTable* replica = all.Replica(node);
+            assert(replica && replica->Size() == 4);
+            assert(BN_cmp(replica->Modulus(3).Get(), table.Modulus(3).Get()) == 0);
+            assert(all.Handle(node, 2).table == replica);
+        }
+        rsa_app::NumaBatchStats stats;
+        std::vector<BigNumber> plaintexts =
+            rsa_app::DecryptBatch(ciphertexts, key_indices, all, pool, &stats);
+        for (size_t i = 0; i < plaintexts.size(); ++i) {
+            assert(BN_cmp(plaintexts[i].Get(), messages[i].Get()) == 0);
+        }
+        assert(stats.items_per_node == (std::vector<size_t>{12, 12}));
+
+        // Only key 1 is hot; the rest run on the home node from the source.
+        rsa_app::NumaKeyReplicas hot(table, pool, {1}, 1);
+        assert(hot.Replicated(1) && !hot.Replicated(0) && hot.Replica(0)->Size() == 1);
+        assert(hot.Handle(0, 0).table == &table && hot.Handle(0, 1).table == hot.Replica(0));
+        plaintexts = rsa_app::DecryptBatch(ciphertexts, key_indices, hot, pool, &stats);
+        for (size_t i = 0; i < plaintexts.size(); ++i) {
+            assert(BN_cmp(plaintexts[i].Get(), messages[i].Get()) == 0);
+        }
+        assert(stats.items_per_node == (std::vector<size_t>{3, 21}));
+
+        // One node copies nothing.
+        rsa_app::NumaPool single(rsa_app::SimulateNumaTopology(1), 1);
+        rsa_app::NumaKeyReplicas none(table, single);
+        assert(none.Replica(0) == nullptr && none.Handle(0, 3).table == &table);
+        plaintexts = rsa_app::DecryptBatch(ciphertexts, key_indices, none, single);
+        assert(BN_cmp(plaintexts[5].Get(), messages[5].Get()) == 0);
+
+        assert(Throws<std::out_of_range>([&] { rsa_app::NumaKeyReplicas(table, pool, {4}); }));
+        assert(Throws<std::out_of_range>([&] { rsa_app::NumaKeyReplicas(table, pool, {}, 2); }));
+        key_indices[7] = 9;
+        assert(Throws<std::out_of_range>(
+            [&] { rsa_app::DecryptBatch(ciphertexts, key_indices, all, pool); }));
+        key_indices.pop_back();
+        assert(Throws<std::invalid_argument>(
+            [&] { rsa_app::DecryptBatch(ciphertexts, key_indices, all, pool); }));
+        std::cout << "TestNumaDecryptBatch passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestNumaDecryptBatch failed with exception: " << e.what() << std::endl;
+    }
+}
+
+int main() {
+    TestNumaTopology();
+    TestNumaPoolPinsWorkers();
+    TestNumaDecryptBatch();
+    return 0;
+}
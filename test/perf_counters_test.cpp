@@ -0,0 +1,46 @@
+#include "../src/perf_counters.h"
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+void TestPerfCountersMeasureWork() {
+    try {
+        rsa_app::PerfCounters counters;
+        // Either some events are counted or we are told why none are.
+        assert(counters.Available() || !counters.UnavailableReason().empty());
+
+        counters.Start();
+        volatile uint64_t sum = 0;
+        for (uint64_t i = 0; i < 1000000; ++i) sum = sum + i * i;
+        rsa_app::PerfSample sample = counters.Stop();
+        for (size_t e = 0; e < rsa_app::kPerfEventCount; ++e) {
+            auto event = static_cast<rsa_app::PerfEvent>(e);
+            if (!counters.Available(event)) assert(!sample.Has(event));
+        }
+        if (sample.Has(rsa_app::PerfEvent::kInstructions)) {
+            assert(sample.Get(rsa_app::PerfEvent::kInstructions) > 1000000);
+        }
+        if (sample.Has(rsa_app::PerfEvent::kCycles) && sample.Has(rsa_app::PerfEvent::kInstructions)) {
+            assert(sample.Ipc() > 0.0);
+        } else {
+            assert(sample.Ipc() == 0.0);
+        }
+
+        rsa_app::PerfSample empty;
+        assert(empty.Ipc() == 0.0);
+        empty.values = {100, 250, 0, 0, 0};
+        empty.valid = {true, true, false, false, false};
+        assert(empty.Ipc() == 2.5);
+        assert(std::string(rsa_app::PerfEventName(rsa_app::PerfEvent::kLlcMisses)) == "llc_misses");
+        std::cout << "TestPerfCountersMeasureWork passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestPerfCountersMeasureWork failed with exception: " << e.what() << std::endl;
+    }
+}
+
+int main() {
+    TestPerfCountersMeasureWork();
+    return 0;
+}
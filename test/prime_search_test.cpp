@@ -0,0 +1,150 @@
+#include "../src/prime_search.h"
+#include <openssl/bn.h>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+bool IsProbablePrime(const BigNumber& value) {
+    BN_CTX* ctx = BN_CTX_new();
+    int result = BN_check_prime(value.Get(), ctx, nullptr);
+    BN_CTX_free(ctx);
+    return result == 1;
+}
+
+}  // namespace
+
+void TestParallelPrimeIsPrime() {
+    try {
+        for (int bits : {64, 256, 521, 1024}) {
+            rsa_app::ParallelPrimeOptions options;
+            options.threads = 2;
+            rsa_app::ParallelPrimeStats stats;
+            BigNumber prime = rsa_app::GeneratePrimeParallel(bits, options, &stats);
+            assert(BN_num_bits(prime.Get()) == bits);
+            // The top two bits are set for full-length moduli.
+            assert(prime.GetBit(bits - 2));
+            assert(IsProbablePrime(prime));
+            assert(stats.threads == 2);
+            assert(stats.windows > stats.winning_window);
+            assert(stats.candidates > stats.rejected);
+            assert(stats.mr_rounds >= stats.candidates);
+        }
+        std::cout << "TestParallelPrimeIsPrime passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestParallelPrimeIsPrime failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestParallelPrimeIsDeterministic() {
+    try {
+        rsa_app::ParallelPrimeOptions options;
+        options.seed = 42;
+        options.window = 64;  // Small windows so that several are searched.
+        options.threads = 1;
+        rsa_app::ParallelPrimeStats reference_stats;
+        BigNumber reference = rsa_app::GeneratePrimeParallel(768, options, &reference_stats);
+        assert(reference_stats.seed == 42);
+
+        for (size_t threads : {2, 3, 8}) {
+            options.threads = threads;
+            rsa_app::ParallelPrimeStats stats;
+            BigNumber prime = rsa_app::GeneratePrimeParallel(768, options, &stats);
+            assert(BN_cmp(prime.Get(), reference.Get()) == 0);
+            assert(stats.winning_window == reference_stats.winning_window);
+        }
+
+        options.seed = 43;
+        BigNumber other = rsa_app::GeneratePrimeParallel(768, options);
+        assert(BN_cmp(other.Get(), reference.Get()) != 0);
+        std::cout << "TestParallelPrimeIsDeterministic passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestParallelPrimeIsDeterministic failed with exception: " << e.what()
+                  << std::endl;
+    }
+}
+
+void TestParallelPrimeRejectsSmallSizes() {
+    try {
+        bool caught = false;
+        try {
+            rsa_app::GeneratePrimeParallel(32);
+        } catch (const std::invalid_argument&) {
+            caught = true;
+        }
+        assert(caught);
+        assert(BigNumber::MillerRabinRounds(4096) == 3);
+        assert(BigNumber::MillerRabinRounds(1024) == 5);
+        std::cout << "TestParallelPrimeRejectsSmallSizes passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestParallelPrimeRejectsSmallSizes failed with exception: " << e.what()
+                  << std::endl;
+    }
+}
+
+void TestSafePrimeIsSafe() {
+    try {
+        for (int bits : {64, 256, 512}) {
+            rsa_app::ParallelPrimeOptions options;
+            options.threads = 2;
+            rsa_app::SafePrimeStats stats;
+            BigNumber prime = rsa_app::GenerateSafePrimeParallel(bits, options, &stats);
+            assert(BN_num_bits(prime.Get()) == bits);
+            assert(prime.GetBit(bits - 2));
+            assert(IsProbablePrime(prime));
+            BigNumber half;
+            assert(BN_rshift1(half.Get(), prime.Get()));
+            assert(IsProbablePrime(half));
+            assert(stats.threads == 2);
+            assert(stats.windows > stats.winning_window);
+            assert(stats.candidates >
+                   stats.fermat_rejected + stats.pocklington_rejected + stats.mr_rejected);
+            assert(stats.mr_rounds >= static_cast<uint64_t>(BigNumber::MillerRabinRounds(bits - 1)));
+        }
+        std::cout << "TestSafePrimeIsSafe passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestSafePrimeIsSafe failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestSafePrimeIsDeterministic() {
+    try {
+        rsa_app::ParallelPrimeOptions options;
+        options.seed = 7;
+        options.window = 512;  // Small windows so that several are searched.
+        options.threads = 1;
+        rsa_app::SafePrimeStats reference_stats;
+        BigNumber reference = rsa_app::GenerateSafePrimeParallel(384, options, &reference_stats);
+        assert(reference_stats.seed == 7);
+
+        for (size_t threads : {2, 5}) {
+            options.threads = threads;
+            rsa_app::SafePrimeStats stats;
+            BigNumber prime = rsa_app::GenerateSafePrimeParallel(384, options, &stats);
+            assert(BN_cmp(prime.Get(), reference.Get()) == 0);
+            assert(stats.winning_window == reference_stats.winning_window);
+        }
+
+        bool caught = false;
+        try {
+            rsa_app::GenerateSafePrimeParallel(32);
+        } catch (const std::invalid_argument&) {
+            caught = true;
+        }
+        assert(caught);
+        std::cout << "TestSafePrimeIsDeterministic passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestSafePrimeIsDeterministic failed with exception: " << e.what()
+                  << std::endl;
+    }
+}
+
+int main() {
+    TestParallelPrimeIsPrime();
+    TestParallelPrimeIsDeterministic();
+    TestParallelPrimeRejectsSmallSizes();
+    TestSafePrimeIsSafe();
+    TestSafePrimeIsDeterministic();
+    return 0;
+}
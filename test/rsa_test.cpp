@@ -1,8 +1,14 @@
 #include "../src/rsa.h"
+#include "../src/fixed_modexp.h"
 #include <cassert>
+#include <cstdio>
 #include <iostream>
 #include <exception>
+#include <fstream>
 #include <sstream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
 
 void TestRSAKeyGeneration() {
     try {
@@ -23,6 +29,31 @@ void TestRSAKeyGeneration() {
     }
 }
 
+void TestRSAKeyGenerationStats() {
+    try {
+        rsa_app::KeyGenStats stats;
+        rsa_app::KeyPair key_pair = rsa_app::GenerateKeyPair(1024, &stats);
+        assert(key_pair.public_key.n.NumBits() == 1024);
+
+        for (const auto* search : {&stats.p_search, &stats.q_search}) {
+            // The accepted candidate is never counted as rejected.
+            assert(search->candidates >= 1);
+            assert(search->rejected == search->candidates - 1);
+            // At least one round per rejected candidate plus the full set of
+            // rounds for the accepted prime.
+            assert(search->mr_rounds > search->rejected);
+            assert(search->seconds > 0.0);
+        }
+        double phases = stats.p_search.seconds + stats.q_search.seconds +
+                        stats.multiply_seconds + stats.gcd_seconds + stats.inverse_seconds;
+        assert(phases <= stats.total_seconds);
+
+        std::cout << "TestRSAKeyGenerationStats passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestRSAKeyGenerationStats failed with exception: " << e.what() << std::endl;
+    }
+}
+
 void TestRSAEncryptDecrypt() {
     try {
         // Generate a key pair
@@ -143,13 +174,203 @@ void TestPrintRSAKeys() {
     }
 }
 
+void TestRSABatchEncryptDecrypt() {
+    try {
+        rsa_app::KeyPair key_pair = rsa_app::GenerateKeyPair(1024);
+        rsa_app::ThreadPool pool(3);
+
+        std::vector<BigNumber> messages;
+        for (int i = 0; i < 25; ++i) {
+            messages.push_back(rsa_app::StringToNumber("record " + std::to_string(i)));
+        }
+
+        std::vector<BigNumber> ciphertexts =
+            rsa_app::EncryptBatch(messages, key_pair.public_key, pool);
+        std::vector<BigNumber> decrypted =
+            rsa_app::DecryptBatch(ciphertexts, key_pair.private_key, pool);
+
+        assert(decrypted.size() == messages.size());
+        for (size_t i = 0; i < messages.size(); ++i) {
+            BigNumber single = rsa_app::Encrypt(messages[i], key_pair.public_key);
+            assert(BN_cmp(single.Get(), ciphertexts[i].Get()) == 0);
+            assert(BN_cmp(messages[i].Get(), decrypted[i].Get()) == 0);
+        }
+
+        // An oversized message fails the whole batch.
+        messages.push_back(key_pair.public_key.n.Copy());
+        bool caught_error = false;
+        try {
+            rsa_app::EncryptBatch(messages, key_pair.public_key, pool);
+        } catch (const std::invalid_argument&) {
+            caught_error = true;
+        }
+        assert(caught_error);
+
+        std::cout << "TestRSABatchEncryptDecrypt passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestRSABatchEncryptDecrypt failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestRSABatchDecryptMultiBuffer() {
+    try {
+        // 2048-bit keys take the multi-buffer path where IFMA is available.
+        rsa_app::KeyPair key_pair = rsa_app::GenerateKeyPair(2048);
+        rsa_app::ThreadPool pool(2);
+
+        std::vector<BigNumber> messages, ciphertexts;
+        for (int i = 0; i < 21; ++i) {
+            messages.push_back(rsa_app::StringToNumber("multi-buffer " + std::to_string(i)));
+            ciphertexts.push_back(rsa_app::Encrypt(messages.back(), key_pair.public_key));
+        }
+        std::vector<BigNumber> decrypted =
+            rsa_app::DecryptBatch(ciphertexts, key_pair.private_key, pool);
+        assert(decrypted.size() == messages.size());
+        for (size_t i = 0; i < messages.size(); ++i) {
+            assert(BN_cmp(messages[i].Get(), decrypted[i].Get()) == 0);
+        }
+
+        ciphertexts.push_back(key_pair.private_key.n.Copy());
+        bool caught_error = false;
+        try {
+            rsa_app::DecryptBatch(ciphertexts, key_pair.private_key, pool);
+        } catch (const std::invalid_argument&) {
+            caught_error = true;
+        }
+        assert(caught_error);
+
+        std::cout << "TestRSABatchDecryptMultiBuffer passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestRSABatchDecryptMultiBuffer failed with exception: " << e.what()
+                  << std::endl;
+    }
+}
+
+void TestRSAModExpBackendsAgree() {
+    try {
+        rsa_app::KeyPair key_pair = rsa_app::GenerateKeyPair(2048);
+        BigNumber message = rsa_app::StringToNumber("size-specialized kernels");
+
+        rsa_app::SetModExpBackend(rsa_app::ModExpBackend::kOpenSsl);
+        BigNumber openssl_ciphertext = rsa_app::Encrypt(message, key_pair.public_key);
+        BigNumber openssl_plaintext = rsa_app::Decrypt(openssl_ciphertext, key_pair.private_key);
+        rsa_app::SetModExpBackend(rsa_app::ModExpBackend::kFixed);
+        BigNumber fixed_ciphertext = rsa_app::Encrypt(message, key_pair.public_key);
+        BigNumber fixed_plaintext = rsa_app::Decrypt(fixed_ciphertext, key_pair.private_key);
+
+        assert(BN_cmp(openssl_ciphertext.Get(), fixed_ciphertext.Get()) == 0);
+        assert(BN_cmp(openssl_plaintext.Get(), message.Get()) == 0);
+        assert(BN_cmp(fixed_plaintext.Get(), message.Get()) == 0);
+
+        std::cout << "TestRSAModExpBackendsAgree passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestRSAModExpBackendsAgree failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestRSAParallelKeyGeneration() {
+    try {
+        rsa_app::ParallelPrimeOptions options;
+        options.seed = 7;
+        options.threads = 1;
+        rsa_app::KeyGenStats stats;
+        rsa_app::KeyPair first = rsa_app::GenerateKeyPair(1024, options, &stats);
+        options.threads = 3;
+        rsa_app::KeyPair second = rsa_app::GenerateKeyPair(1024, options);
+
+        // Same seed, same key, whatever the thread count.
+        assert(BN_num_bits(first.public_key.n.Get()) == 1024);
+        assert(BN_cmp(first.public_key.n.Get(), second.public_key.n.Get()) == 0);
+        assert(stats.p_search.candidates > 0 && stats.q_search.candidates > 0);
+
+        BigNumber message = rsa_app::StringToNumber("parallel primes");
+        BigNumber ciphertext = rsa_app::Encrypt(message, first.public_key);
+        BigNumber plaintext = rsa_app::Decrypt(ciphertext, second.private_key);
+        assert(BN_cmp(plaintext.Get(), message.Get()) == 0);
+
+        std::cout << "TestRSAParallelKeyGeneration passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestRSAParallelKeyGeneration failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestRSADrbgKeyGeneration() {
+    try {
+        rsa_app::Drbg first_drbg(11, 0), second_drbg(11, 0);
+        rsa_app::KeyGenStats stats;
+        rsa_app::KeyPair first = rsa_app::GenerateKeyPair(1024, first_drbg, &stats);
+        rsa_app::KeyPair second = rsa_app::GenerateKeyPair(1024, second_drbg);
+        assert(BN_num_bits(first.public_key.n.Get()) == 1024);
+        assert(BN_cmp(first.public_key.n.Get(), second.public_key.n.Get()) == 0);
+        assert(stats.p_search.candidates > 0 && stats.q_search.mr_rounds > 0);
+
+        rsa_app::KeyPair threaded = rsa_app::GenerateKeyPair(1024, rsa_app::ThreadDrbg());
+        assert(BN_cmp(threaded.public_key.n.Get(), first.public_key.n.Get()) != 0);
+
+        BigNumber message = rsa_app::StringToNumber("per-thread randomness");
+        BigNumber ciphertext = rsa_app::Encrypt(message, threaded.public_key);
+        BigNumber plaintext = rsa_app::Decrypt(ciphertext, threaded.private_key);
+        assert(BN_cmp(plaintext.Get(), message.Get()) == 0);
+
+        std::cout << "TestRSADrbgKeyGeneration passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestRSADrbgKeyGeneration failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestRSAKeyFileRoundTrip() {
+    try {
+        rsa_app::KeyPair key_pair = rsa_app::GenerateKeyPair(512);
+        std::string path = "rsa_test_key.txt";
+        std::string public_path = "rsa_test_key.pub";
+        // An existing world-readable file is narrowed to the owner.
+        std::ofstream(path) << "stale\n";
+        chmod(path.c_str(), 0644);
+        rsa_app::SaveKeyPair(key_pair, path);
+        struct stat info;
+        assert(stat(path.c_str(), &info) == 0 && (info.st_mode & 0777) == 0600);
+        rsa_app::SavePublicKey(key_pair.public_key, public_path);
+
+        rsa_app::KeyPair loaded = rsa_app::LoadKeyPair(path);
+        assert(BN_cmp(loaded.public_key.n.Get(), key_pair.public_key.n.Get()) == 0);
+        assert(BN_cmp(loaded.public_key.e.Get(), key_pair.public_key.e.Get()) == 0);
+        assert(BN_cmp(loaded.private_key.n.Get(), key_pair.private_key.n.Get()) == 0);
+        assert(BN_cmp(loaded.private_key.d.Get(), key_pair.private_key.d.Get()) == 0);
+
+        rsa_app::PublicKey public_key = rsa_app::LoadPublicKey(public_path);
+        assert(BN_cmp(public_key.n.Get(), key_pair.public_key.n.Get()) == 0);
+
+        // A public key file cannot be loaded as a key pair.
+        bool caught_error = false;
+        try {
+            rsa_app::LoadKeyPair(public_path);
+        } catch (const std::invalid_argument&) {
+            caught_error = true;
+        }
+        assert(caught_error);
+
+        std::remove(path.c_str());
+        std::remove(public_path.c_str());
+        std::cout << "TestRSAKeyFileRoundTrip passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestRSAKeyFileRoundTrip failed with exception: " << e.what() << std::endl;
+    }
+}
+
 int main() {
     TestRSAKeyGeneration();
+    TestRSAKeyGenerationStats();
     TestRSAEncryptDecrypt();
     TestRSAStringConversion();
     TestRSAFullProcess();
     TestBase64Encode();
     TestFormatBigNumber();
     TestPrintRSAKeys();
+    TestRSABatchEncryptDecrypt();
+    TestRSABatchDecryptMultiBuffer();
+    TestRSAModExpBackendsAgree();
+    TestRSAParallelKeyGeneration();
+    TestRSADrbgKeyGeneration();
+    TestRSAKeyFileRoundTrip();
     return 0;
 }
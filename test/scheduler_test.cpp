@@ -0,0 +1,151 @@
+#include "../src/scheduler.h"
+#include <openssl/bn.h>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using rsa_app::TaskPriority;
+
+void TestSchedulerRunsByPriority() {
+    try {
+        rsa_app::Scheduler scheduler({1});
+        std::promise<void> release;
+        std::shared_future<void> gate = release.get_future().share();
+        // Occupies the only worker while the other tasks queue up.
+        auto blocker = scheduler.Submit(TaskPriority::kBatch, [gate] { gate.wait(); });
+
+        std::mutex mutex;
+        std::vector<int> order;
+        std::vector<std::future<int>> results;
+        for (TaskPriority priority :
+             {TaskPriority::kBackground, TaskPriority::kBatch, TaskPriority::kInteractive}) {
+            for (int i = 0; i < 2; ++i) {
+                int tag = static_cast<int>(priority) * 10 + i;
+                results.push_back(scheduler.Submit(priority, [&mutex, &order, tag] {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    order.push_back(tag);
+                    return tag;
+                }));
+            }
+        }
+        auto failing = scheduler.Submit(TaskPriority::kBackground,
+                                        [] { throw std::runtime_error("boom"); });
+        release.set_value();
+        scheduler.Wait();
+
+        assert((order == std::vector<int>{0, 1, 10, 11, 20, 21}));
+        assert(results[0].get() == 20);
+        bool caught = false;
+        try {
+            failing.get();
+        } catch (const std::runtime_error&) {
+            caught = true;
+        }
+        assert(caught);
+
+        rsa_app::PriorityClassMetrics interactive = scheduler.Metrics(TaskPriority::kInteractive);
+        assert(interactive.submitted == 2 && interactive.completed == 2);
+        assert(interactive.queued == 0 && interactive.running == 0);
+        assert(interactive.queue_seconds.count == 2 && interactive.queue_seconds.min >= 0.0);
+        rsa_app::PriorityClassMetrics background = scheduler.Metrics(TaskPriority::kBackground);
+        assert(background.submitted == 3 && background.completed == 3 && background.failed == 1);
+        assert(std::string(rsa_app::TaskPriorityName(TaskPriority::kBatch)) == "batch");
+        std::cout << "TestSchedulerRunsByPriority passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestSchedulerRunsByPriority failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestSchedulerConcurrencyLimits() {
+    try {
+        rsa_app::SchedulerOptions options;
+        options.threads = 4;
+        options.max_running[static_cast<size_t>(TaskPriority::kBackground)] = 1;
+        rsa_app::Scheduler scheduler(options);
+
+        std::atomic<int> running{0}, peak{0};
+        for (int i = 0; i < 8; ++i) {
+            scheduler.Submit(TaskPriority::kBackground, [&running, &peak] {
+                int now = ++running;
+                int seen = peak.load();
+                while (now > seen && !peak.compare_exchange_weak(seen, now)) {
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                --running;
+            });
+        }
+        // Other classes still use the remaining workers.
+        auto interactive = scheduler.Submit(TaskPriority::kInteractive, [] { return 7; });
+        assert(interactive.get() == 7);
+        scheduler.Wait();
+        assert(peak.load() == 1);
+        assert(scheduler.Metrics(TaskPriority::kBackground).peak_running == 1);
+        assert(scheduler.Metrics(TaskPriority::kBackground).completed == 8);
+        std::cout << "TestSchedulerConcurrencyLimits passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestSchedulerConcurrencyLimits failed with exception: " << e.what()
+                  << std::endl;
+    }
+}
+
+void TestSchedulerPreemptsKeyGeneration() {
+    try {
+        rsa_app::Scheduler scheduler({1});
+        // A background task that only finishes once an interactive task ran;
+        // with one worker that can only happen through Yield().
+        std::atomic<bool> served{false};
+        std::promise<void> started;
+        auto background = scheduler.Submit(TaskPriority::kBackground, [&] {
+            started.set_value();
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            while (!served && std::chrono::steady_clock::now() < deadline) {
+                if (scheduler.ShouldYield()) scheduler.Yield();
+            }
+            return served.load();
+        });
+        started.get_future().wait();
+        auto interactive = scheduler.Submit(TaskPriority::kInteractive, [&] { served = true; });
+        assert(background.get());
+        interactive.get();
+        assert(!scheduler.ShouldYield() && !scheduler.Yield());
+
+        // Decryption requests overtake a running key generation.
+        rsa_app::KeyPair key = rsa_app::GenerateKeyPair(1024);
+        BigNumber message = rsa_app::StringToNumber("urgent");
+        BigNumber ciphertext = rsa_app::Encrypt(message, key.public_key);
+        auto keygen = scheduler.SubmitKeyGeneration(2048);
+        std::vector<std::future<BigNumber>> plaintexts;
+        for (int i = 0; i < 4; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            plaintexts.push_back(scheduler.Submit(TaskPriority::kInteractive, [&] {
+                return rsa_app::Decrypt(ciphertext, key.private_key);
+            }));
+        }
+        for (auto& plaintext : plaintexts) {
+            assert(BN_cmp(plaintext.get().Get(), message.Get()) == 0);
+        }
+        rsa_app::KeyPair generated = keygen.get();
+        assert(BN_num_bits(generated.public_key.n.Get()) == 2048);
+        scheduler.Wait();
+        assert(scheduler.Metrics(TaskPriority::kBackground).preemptions >= 1);
+        assert(scheduler.Metrics(TaskPriority::kInteractive).completed == 5);
+        std::cout << "TestSchedulerPreemptsKeyGeneration passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestSchedulerPreemptsKeyGeneration failed with exception: " << e.what()
+                  << std::endl;
+    }
+}
+
+int main() {
+    TestSchedulerRunsByPriority();
+    TestSchedulerConcurrencyLimits();
+    TestSchedulerPreemptsKeyGeneration();
+    return 0;
+}
@@ -0,0 +1,334 @@
+#include "../src/shard.h"
+#include <openssl/bn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cassert>
+#include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::string SocketPath(const std::string& name) {
+    return "/tmp/rsa_shard_test_" + std::to_string(getpid()) + "_" + name + ".sock";
+}
+
+std::string KeyId(int i) { return "tenant-" + std::to_string(i); }
+
+// Counts this process's open file descriptors.
+size_t OpenDescriptors() {
+    size_t count = 0;
+    for (const auto& entry : std::filesystem::directory_iterator("/proc/self/fd")) {
+        (void)entry;
+        ++count;
+    }
+    return count;
+}
+
+bool Decrypts(rsa_app::ShardRouter& router, const std::string& key_id, const BigNumber& message) {
+    BigNumber ciphertext = router.Encrypt(key_id, message);
+    return BN_cmp(router.Decrypt(key_id, ciphertext).Get(), message.Get()) == 0;
+}
+
+}  // namespace
+
+void TestHashRingMovesOnlyChangedKeys() {
+    try {
+        rsa_app::HashRing ring;
+        for (int i = 0; i < 4; ++i) ring.AddNode("w" + std::to_string(i));
+        const int kKeys = 20000;
+        std::map<std::string, int> counts;
+        std::vector<std::string> before;
+        for (int i = 0; i < kKeys; ++i) {
+            before.push_back(ring.NodeFor(KeyId(i)));
+            ++counts[before.back()];
+        }
+        assert(counts.size() == 4);
+        for (const auto& entry : counts) {
+            assert(entry.second > kKeys * 15 / 100 && entry.second < kKeys * 35 / 100);
+        }
+
+        // Only keys that now belong to the new node move, about a fifth.
+        ring.AddNode("w4");
+        ring.AddNode("w4");
+        assert(ring.Nodes().size() == 5);
+        int moved = 0;
+        for (int i = 0; i < kKeys; ++i) {
+            const std::string& owner = ring.NodeFor(KeyId(i));
+            if (owner == before[i]) continue;
+            assert(owner == "w4");
+            ++moved;
+        }
+        assert(moved > kKeys / 10 && moved < kKeys * 3 / 10);
+
+        ring.RemoveNode("w4");
+        for (int i = 0; i < kKeys; ++i) assert(ring.NodeFor(KeyId(i)) == before[i]);
+
+        bool caught = false;
+        try {
+            rsa_app::HashRing().NodeFor("x");
+        } catch (const std::logic_error&) {
+            caught = true;
+        }
+        assert(caught);
+        std::cout << "TestHashRingMovesOnlyChangedKeys passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestHashRingMovesOnlyChangedKeys failed with exception: " << e.what()
+                  << std::endl;
+    }
+}
+
+void TestShardRouterRebalances(const std::vector<std::string>& sockets) {
+    try {
+        rsa_app::ShardRouter router;
+        for (int i = 0; i < 3; ++i) {
+            size_t moved = router.AddWorker("w" + std::to_string(i), sockets[i]);
+            assert(moved == 0);
+        }
+
+        std::vector<rsa_app::KeyPair> keys;
+        for (int i = 0; i < 4; ++i) keys.push_back(rsa_app::GenerateKeyPair(512));
+        const int kKeys = 40;
+        for (int i = 0; i < kKeys; ++i) router.PutKey(KeyId(i), keys[i % 4]);
+        BigNumber message = rsa_app::StringToNumber("sharded");
+        for (int i = 0; i < kKeys; ++i) assert(Decrypts(router, KeyId(i), message));
+
+        size_t held = 0;
+        for (int i = 0; i < 3; ++i) {
+            std::string id = "w" + std::to_string(i);
+            for (const auto& key_id : router.ListKeys(id)) {
+                assert(router.WorkerFor(key_id) == id);
+                ++held;
+            }
+        }
+        assert(held == kKeys);
+
+        // A new worker receives exactly the keys it now owns.
+        size_t moved = router.AddWorker("w3", sockets[3]);
+        std::vector<std::string> on_new = router.ListKeys("w3");
+        assert(moved > 0 && moved == on_new.size());
+        for (const auto& key_id : on_new) assert(router.WorkerFor(key_id) == "w3");
+
+        // Removing a worker hands its keys to the others.
+        size_t drained = router.ListKeys("w1").size();
+        size_t removed = router.RemoveWorker("w1");
+        assert(removed == drained);
+        for (int i = 0; i < kKeys; ++i) {
+            assert(router.WorkerFor(KeyId(i)) != "w1");
+            assert(Decrypts(router, KeyId(i), message));
+        }
+
+        bool caught = false;
+        try {
+            router.Decrypt("missing", message);
+        } catch (const std::invalid_argument&) {
+            caught = true;
+        }
+        assert(caught);
+        caught = false;
+        try {
+            router.AddWorker("w0", sockets[0]);
+        } catch (const std::invalid_argument&) {
+            caught = true;
+        }
+        assert(caught);
+
+        rsa_app::ClusterMetrics metrics = router.Metrics();
+        assert(metrics.shards.size() == 3);
+        assert(metrics.keys == kKeys);
+        assert(metrics.keys_moved == moved + drained);
+        assert(metrics.errors == 1);
+        // Requests served by w1 left with it.
+        assert(metrics.requests >= 2 * kKeys);
+        assert(metrics.requests_per_second > 0.0);
+
+        // w1 still runs with no keys; the rest drain into the last worker,
+        // which cannot be removed while it holds keys.
+        router.ShutdownWorker("w0");
+        router.ShutdownWorker("w2");
+        assert(router.ListKeys("w3").size() == kKeys);
+        caught = false;
+        try {
+            router.ShutdownWorker("w3");
+        } catch (const std::invalid_argument&) {
+            caught = true;
+        }
+        assert(caught);
+        for (int i = 0; i < kKeys; ++i) assert(Decrypts(router, KeyId(i), message));
+        rsa_app::ShardClient(sockets[1]).Shutdown();
+        std::cout << "TestShardRouterRebalances passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestShardRouterRebalances failed with exception: " << e.what() << std::endl;
+    }
+}
+
+// `sockets` are four fresh workers; the third, `victim`, is killed after
+// the keys are stored, so that rebalances fail partway.
+void TestShardRouterRollsBackFailedRebalance(const std::vector<std::string>& sockets,
+                                             pid_t victim) {
+    try {
+        rsa_app::ShardRouter router;
+        for (int i = 0; i < 3; ++i) router.AddWorker("f" + std::to_string(i), sockets[i]);
+        rsa_app::KeyPair key = rsa_app::GenerateKeyPair(512);
+        const int kKeys = 40;
+        std::vector<std::string> owners;
+        for (int i = 0; i < kKeys; ++i) {
+            router.PutKey(KeyId(i), key);
+            owners.push_back(router.WorkerFor(KeyId(i)));
+        }
+        std::vector<std::string> on_f0 = router.ListKeys("f0");
+
+        // Draining f0 moves some keys to f1 before the first one for f2.
+        rsa_app::HashRing remaining;
+        remaining.AddNode("f1");
+        remaining.AddNode("f2");
+        size_t first_f1 = on_f0.size();
+        size_t first_f2 = on_f0.size();
+        for (size_t i = on_f0.size(); i-- > 0;) {
+            (remaining.NodeFor(on_f0[i]) == "f1" ? first_f1 : first_f2) = i;
+        }
+        assert(first_f1 < first_f2 && first_f2 < on_f0.size());
+
+        kill(victim, SIGKILL);
+        waitpid(victim, nullptr, 0);
+        BigNumber message = rsa_app::StringToNumber("rolled back");
+        auto check_keys = [&] {
+            for (int i = 0; i < kKeys; ++i) {
+                assert(router.WorkerFor(KeyId(i)) == owners[i]);
+                if (owners[i] != "f2") assert(Decrypts(router, KeyId(i), message));
+            }
+        };
+
+        bool caught = false;
+        try {
+            router.RemoveWorker("f0");
+        } catch (const std::runtime_error&) {
+            caught = true;
+        }
+        assert(caught);
+        assert(router.ListKeys("f0") == on_f0);
+        check_keys();
+
+        // f0 and f1 hand keys to f3 before listing f2 fails.
+        rsa_app::HashRing grown;
+        for (int i = 0; i < 4; ++i) grown.AddNode("f" + std::to_string(i));
+        bool handed_over = false;
+        for (int i = 0; i < kKeys; ++i) {
+            handed_over |= owners[i] != "f2" && grown.NodeFor(KeyId(i)) == "f3";
+        }
+        assert(handed_over);
+        caught = false;
+        try {
+            router.AddWorker("f3", sockets[3]);
+        } catch (const std::runtime_error&) {
+            caught = true;
+        }
+        assert(caught);
+        check_keys();
+        caught = false;
+        try {
+            router.ListKeys("f3");
+        } catch (const std::invalid_argument&) {
+            caught = true;
+        }
+        assert(caught);
+
+        for (int i : {0, 1, 3}) rsa_app::ShardClient(sockets[i]).Shutdown();
+        std::cout << "TestShardRouterRollsBackFailedRebalance passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestShardRouterRollsBackFailedRebalance failed with exception: " << e.what()
+                  << std::endl;
+    }
+}
+
+void TestShardRouterServesClients(const std::string& worker_socket) {
+    try {
+        rsa_app::ShardRouter router;
+        router.AddWorker("w3", worker_socket);
+        std::string router_socket = SocketPath("router");
+        std::thread server([&] { router.Serve(router_socket); });
+        // Serve creates the socket asynchronously.
+        std::unique_ptr<rsa_app::ShardClient> client;
+        for (int attempt = 0; !client && attempt < 500; ++attempt) {
+            try {
+                client = std::make_unique<rsa_app::ShardClient>(router_socket);
+            } catch (const std::runtime_error&) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+        assert(client);
+
+        rsa_app::KeyPair key = rsa_app::GenerateKeyPair(512);
+        client->PutKey("remote", key);
+        BigNumber message = rsa_app::StringToNumber("via router");
+        BigNumber ciphertext = client->Encrypt("remote", message);
+        assert(BN_cmp(client->Decrypt("remote", ciphertext).Get(), message.Get()) == 0);
+        rsa_app::ClusterMetrics metrics = client->Metrics();
+        assert(metrics.shards.size() == 1 && metrics.shards[0].worker == "w3");
+        assert(metrics.keys == router.ListKeys("w3").size());
+
+        // Closed connections give their descriptors back.
+        size_t open_before = OpenDescriptors();
+        for (int i = 0; i < 200; ++i) rsa_app::ShardClient(router_socket).Metrics();
+        size_t open_after = OpenDescriptors();
+        for (int attempt = 0; open_after > open_before && attempt < 500; ++attempt) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            open_after = OpenDescriptors();
+        }
+        assert(open_after <= open_before);
+        client->Shutdown();
+        server.join();
+
+        rsa_app::ShardClient(worker_socket).Shutdown();
+        std::cout << "TestShardRouterServesClients passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestShardRouterServesClients failed with exception: " << e.what()
+                  << std::endl;
+    }
+}
+
+int main() {
+    // Workers are forked before any test starts a thread.
+    std::vector<std::string> sockets;
+    std::vector<pid_t> workers;
+    try {
+        for (int i = 0; i < 8; ++i) {
+            std::string name = (i < 4 ? "w" : "f") + std::to_string(i % 4);
+            sockets.push_back(SocketPath(name));
+            workers.push_back(rsa_app::SpawnShardWorker(sockets.back()));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Spawning shard workers failed with exception: " << e.what() << std::endl;
+        return 1;
+    }
+
+    TestHashRingMovesOnlyChangedKeys();
+    TestShardRouterRebalances(sockets);
+    TestShardRouterServesClients(sockets[3]);
+    TestShardRouterRollsBackFailedRebalance(
+        std::vector<std::string>(sockets.begin() + 4, sockets.end()), workers[6]);
+    workers.erase(workers.begin() + 6);  // Killed and reaped by the test.
+
+    // Every worker was shut down by a test; kill the ones a failure left.
+    for (pid_t pid : workers) {
+        int status = 0;
+        for (int attempt = 0; waitpid(pid, &status, WNOHANG) == 0; ++attempt) {
+            if (attempt == 500) {
+                std::cerr << "Shard worker " << pid << " did not exit" << std::endl;
+                kill(pid, SIGKILL);
+                waitpid(pid, &status, 0);
+                return 1;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include "../src/stats.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+bool Near(double a, double b, double tolerance = 1e-9) {
+    return std::fabs(a - b) <= tolerance * std::max(1.0, std::fabs(b));
+}
+
+}  // namespace
+
+void TestStatsSummary() {
+    try {
+        rsa_app::SampleSummary s = rsa_app::Summarize({5, 1, 4, 2, 3});
+        assert(s.count == 5);
+        assert(s.min == 1 && s.max == 5);
+        assert(Near(s.mean, 3.0));
+        assert(Near(s.stddev, std::sqrt(2.5)));
+        assert(Near(s.p50, 3.0));
+        assert(Near(s.p90, 4.6));  // Linear interpolation between 4 and 5
+
+        rsa_app::SampleSummary empty = rsa_app::Summarize({});
+        assert(empty.count == 0);
+
+        std::cout << "TestStatsSummary passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestStatsSummary failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestStatsHistogramAndCdf() {
+    try {
+        rsa_app::Histogram histogram = rsa_app::BuildHistogram({0, 1, 2, 3, 4, 10}, 5);
+        assert(histogram.min == 0 && Near(histogram.bin_width, 2.0));
+        assert((histogram.counts == std::vector<size_t>{2, 2, 1, 0, 1}));
+
+        rsa_app::Histogram flat = rsa_app::BuildHistogram({7, 7, 7}, 4);
+        assert(flat.counts[0] == 3);
+
+        auto cdf = rsa_app::EmpiricalCdf({3, 1, 2, 2});
+        assert(cdf.size() == 3);
+        assert(cdf[0].first == 1 && Near(cdf[0].second, 0.25));
+        assert(cdf[1].first == 2 && Near(cdf[1].second, 0.75));
+        assert(cdf[2].first == 3 && Near(cdf[2].second, 1.0));
+
+        std::cout << "TestStatsHistogramAndCdf passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestStatsHistogramAndCdf failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestStatsPowerLawFit() {
+    try {
+        std::vector<double> x = {512, 1024, 2048, 4096};
+        std::vector<double> y;
+        for (double value : x) y.push_back(3e-12 * std::pow(value, 4));
+
+        rsa_app::PowerLawFit fit = rsa_app::FitPowerLaw(x, y);
+        assert(Near(fit.exponent, 4.0, 1e-6));
+        assert(Near(fit.coefficient, 3e-12, 1e-6));
+        assert(Near(fit.r_squared, 1.0, 1e-9));
+
+        rsa_app::PowerLawFit fixed = rsa_app::FitFixedExponent(x, y, 4.0);
+        assert(Near(fixed.coefficient, 3e-12, 1e-6));
+        assert(Near(fixed.r_squared, 1.0, 1e-9));
+
+        std::cout << "TestStatsPowerLawFit passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestStatsPowerLawFit failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestStatsSignificance() {
+    try {
+        // Completely separated samples: U = 0, z = -12 / sqrt(275 / 12).
+        rsa_app::MannWhitneyResult separated =
+            rsa_app::MannWhitneyU({1, 2, 3, 4, 5}, {6, 7, 8, 9, 10});
+        assert(Near(separated.u, 0.0));
+        assert(Near(separated.z, -12.0 / std::sqrt(275.0 / 12.0)));
+        assert(Near(separated.p_value, 0.01219, 1e-3));
+
+        rsa_app::MannWhitneyResult same = rsa_app::MannWhitneyU({1, 2, 3, 4, 5}, {1, 2, 3, 4, 5});
+        assert(Near(same.u, 12.5) && Near(same.p_value, 1.0));
+        assert(rsa_app::MannWhitneyU({}, {1.0}).p_value == 1.0);
+        assert(rsa_app::MannWhitneyU({2, 2, 2}, {2, 2}).p_value == 1.0);
+
+        std::vector<double> baseline, doubled;
+        for (int i = 1; i <= 20; ++i) {
+            baseline.push_back(i);
+            doubled.push_back(2.0 * i);
+        }
+        rsa_app::RatioInterval ratio = rsa_app::BootstrapMedianRatio(baseline, doubled);
+        assert(Near(ratio.ratio, 2.0));
+        assert(ratio.low <= 2.0 && ratio.high >= 2.0 && ratio.low > 1.0);
+        rsa_app::RatioInterval again = rsa_app::BootstrapMedianRatio(baseline, doubled);
+        assert(again.low == ratio.low && again.high == ratio.high);
+        assert(rsa_app::BootstrapMedianRatio({0.0}, {1.0}).ratio == 0.0);
+
+        std::cout << "TestStatsSignificance passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestStatsSignificance failed with exception: " << e.what() << std::endl;
+    }
+}
+
+int main() {
+    TestStatsSummary();
+    TestStatsHistogramAndCdf();
+    TestStatsPowerLawFit();
+    TestStatsSignificance();
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include "../src/thread_pool.h"
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+void TestThreadPoolRunsAllTasks() {
+    try {
+        rsa_app::ThreadPool pool(4);
+        assert(pool.Size() == 4);
+
+        std::atomic<int> counter{0};
+        for (int i = 0; i < 1000; ++i) {
+            pool.Submit([&counter] { counter.fetch_add(1); });
+        }
+        pool.Wait();
+        assert(counter.load() == 1000);
+
+        std::cout << "TestThreadPoolRunsAllTasks passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestThreadPoolRunsAllTasks failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestThreadPoolParallelForCoversRange() {
+    try {
+        rsa_app::ThreadPool pool(3);
+        for (size_t count : {0, 1, 2, 7, 100, 1001}) {
+            std::vector<int> hits(count, 0);
+            pool.ParallelFor(count, [&hits](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) ++hits[i];
+            });
+            for (int hit : hits) assert(hit == 1);
+        }
+
+        std::cout << "TestThreadPoolParallelForCoversRange passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestThreadPoolParallelForCoversRange failed with exception: " << e.what()
+                  << std::endl;
+    }
+}
+
+void TestThreadPoolPropagatesExceptions() {
+    try {
+        rsa_app::ThreadPool pool(2);
+        bool caught_error = false;
+        try {
+            pool.ParallelFor(10, [](size_t begin, size_t) {
+                if (begin == 0) throw std::invalid_argument("boom");
+            });
+        } catch (const std::invalid_argument&) {
+            caught_error = true;
+        }
+        assert(caught_error);
+
+        // The pool stays usable after a failure.
+        std::atomic<int> counter{0};
+        pool.Submit([&counter] { counter.fetch_add(1); });
+        pool.Wait();
+        assert(counter.load() == 1);
+
+        std::cout << "TestThreadPoolPropagatesExceptions passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestThreadPoolPropagatesExceptions failed with exception: " << e.what()
+                  << std::endl;
+    }
+}
+
+void TestThreadPoolParallelForIsPerCall() {
+    try {
+        rsa_app::ThreadPool pool(2);
+        // Concurrent callers see only their own failures.
+        std::atomic<int> completed{0};
+        bool wrong_error = false;
+        std::thread failing([&] {
+            for (int round = 0; round < 50; ++round) {
+                try {
+                    pool.ParallelFor(4, [](size_t, size_t) { throw std::runtime_error("mine"); });
+                } catch (const std::runtime_error&) {
+                }
+            }
+        });
+        for (int round = 0; round < 50; ++round) {
+            try {
+                pool.ParallelFor(8, [&completed](size_t begin, size_t end) {
+                    completed.fetch_add(static_cast<int>(end - begin));
+                });
+            } catch (const std::exception&) {
+                wrong_error = true;
+            }
+        }
+        failing.join();
+        assert(!wrong_error && completed.load() == 400);
+
+        // A nested call from a pool task runs inline instead of deadlocking.
+        std::vector<int> hits(16, 0);
+        pool.ParallelFor(2, [&](size_t begin, size_t end) {
+            for (size_t outer = begin; outer < end; ++outer) {
+                pool.ParallelFor(8, [&](size_t inner_begin, size_t inner_end) {
+                    for (size_t i = inner_begin; i < inner_end; ++i) ++hits[outer * 8 + i];
+                });
+            }
+        });
+        for (int hit : hits) assert(hit == 1);
+
+        bool caught = false;
+        pool.Submit([&] {
+            try {
+                pool.Wait();
+            } catch (const std::logic_error&) {
+                caught = true;
+            }
+        });
+        pool.Wait();
+        assert(caught);
+        std::cout << "TestThreadPoolParallelForIsPerCall passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestThreadPoolParallelForIsPerCall failed with exception: " << e.what()
+                  << std::endl;
+    }
+}
+
+int main() {
+    TestThreadPoolRunsAllTasks();
+    TestThreadPoolParallelForCoversRange();
+    TestThreadPoolPropagatesExceptions();
+    TestThreadPoolParallelForIsPerCall();
+    return 0;
+}
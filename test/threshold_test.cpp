@@ -0,0 +1,218 @@
+#include "../src/threshold.h"
+#include <openssl/bn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cassert>
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::string SocketPath(int holder) {
+    return "/tmp/rsa_threshold_test_" + std::to_string(getpid()) + "_" +
+           std::to_string(holder) + ".sock";
+}
+
+BigNumber RandomBelow(const BigNumber& modulus) {
+    BigNumber value;
+    BN_rand_range(value.Get(), modulus.Get());
+    return value;
+}
+
+}  // namespace
+
+void TestThresholdSharesCombine() {
+    try {
+        for (int bits : {1024, 2048}) {
+            rsa_app::KeyPair key = rsa_app::GenerateKeyPair(bits);
+            BigNumber ciphertext = RandomBelow(key.public_key.n);
+            BigNumber expected = rsa_app::Decrypt(ciphertext, key.private_key);
+            for (size_t count = 1; count <= 4; ++count) {
+                std::vector<rsa_app::KeyShare> shares =
+                    rsa_app::SplitPrivateKey(key.private_key, count);
+                assert(shares.size() == count);
+
+                // The shares add up to d.
+                BigNumber sum;
+                BN_zero(sum.Get());
+                for (const auto& share : shares) {
+                    assert(BN_cmp(share.n.Get(), key.public_key.n.Get()) == 0);
+                    sum = share.negative ? sum.Sub(share.d.Get()) : sum.Add(share.d.Get());
+                }
+                assert(BN_cmp(sum.Get(), key.private_key.d.Get()) == 0);
+                if (count > 1) {
+                    assert(shares[0].d.NumBits() > key.private_key.d.NumBits());
+                    assert(shares.back().negative);
+                }
+
+                std::vector<BigNumber> partials;
+                for (const auto& share : shares) {
+                    partials.push_back(rsa_app::PartialDecrypt(ciphertext, share));
+                    rsa_app::KeyShare decoded =
+                        rsa_app::DecodeKeyShare(rsa_app::EncodeKeyShare(share));
+                    assert(BN_cmp(decoded.d.Get(), share.d.Get()) == 0);
+                    assert(decoded.negative == share.negative);
+                }
+                BigNumber plaintext =
+                    rsa_app::CombinePartials(partials, key.public_key.n.Get());
+                assert(BN_cmp(plaintext.Get(), expected.Get()) == 0);
+            }
+        }
+
+        rsa_app::KeyPair key = rsa_app::GenerateKeyPair(512);
+        std::vector<rsa_app::KeyShare> shares = rsa_app::SplitPrivateKey(key.private_key, 2);
+        bool caught = false;
+        try {
+            rsa_app::PartialDecrypt(key.public_key.n, shares[0]);
+        } catch (const std::invalid_argument&) {
+            caught = true;
+        }
+        assert(caught);
+        caught = false;
+        try {
+            rsa_app::SplitPrivateKey(key.private_key, 0);
+        } catch (const std::invalid_argument&) {
+            caught = true;
+        }
+        assert(caught);
+        std::cout << "TestThresholdSharesCombine passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestThresholdSharesCombine failed with exception: " << e.what()
+                  << std::endl;
+    }
+}
+
+void TestThresholdCoordinatorDecrypts(const std::vector<std::string>& sockets) {
+    try {
+        rsa_app::ThresholdCoordinator coordinator(sockets, 8);
+        assert(coordinator.Holders() == 3);
+        rsa_app::KeyPair first = rsa_app::GenerateKeyPair(1024);
+        rsa_app::KeyPair second = rsa_app::GenerateKeyPair(2048);
+        coordinator.AddKey("first", first);
+        coordinator.AddKey("second", second);
+
+        BigNumber message = rsa_app::StringToNumber("split key");
+        BigNumber ciphertext = rsa_app::Encrypt(message, second.public_key);
+        assert(BN_cmp(coordinator.Decrypt("second", ciphertext).Get(), message.Get()) == 0);
+
+        // A batch larger than max_batch takes several rounds.
+        std::vector<BigNumber> messages, ciphertexts;
+        for (int i = 0; i < 20; ++i) {
+            messages.push_back(RandomBelow(first.public_key.n));
+            ciphertexts.push_back(rsa_app::Encrypt(messages.back(), first.public_key));
+        }
+        uint64_t rounds = coordinator.Metrics().rounds;
+        std::vector<BigNumber> plaintexts = coordinator.DecryptBatch("first", ciphertexts);
+        for (size_t i = 0; i < messages.size(); ++i) {
+            assert(BN_cmp(plaintexts[i].Get(), messages[i].Get()) == 0);
+        }
+        assert(coordinator.Metrics().rounds == rounds + 3);
+        assert(coordinator.Metrics().largest_batch == 8);
+
+        // Concurrent callers of both keys share rounds.
+        std::vector<std::thread> callers;
+        std::vector<int> correct(8, 0);
+        for (int t = 0; t < 8; ++t) {
+            callers.emplace_back([&, t] {
+                for (int i = 0; i < 5; ++i) {
+                    const char* id = t % 2 ? "first" : "second";
+                    const rsa_app::KeyPair& key = t % 2 ? first : second;
+                    BigNumber m = RandomBelow(key.public_key.n);
+                    BigNumber c = rsa_app::Encrypt(m, key.public_key);
+                    correct[t] += BN_cmp(coordinator.Decrypt(id, c).Get(), m.Get()) == 0;
+                }
+            });
+        }
+        for (auto& caller : callers) caller.join();
+        for (int count : correct) assert(count == 5);
+        rsa_app::ThresholdMetrics metrics = coordinator.Metrics();
+        assert(metrics.requests == 61 && metrics.failures == 0);
+        assert(metrics.rounds <= metrics.requests);
+
+        // Adding a key does not disturb rounds in flight.
+        std::thread adder([&] { coordinator.AddKey("third", first); });
+        for (int i = 0; i < 5; ++i) {
+            assert(BN_cmp(coordinator.Decrypt("second", ciphertext).Get(), message.Get()) == 0);
+        }
+        adder.join();
+        assert(BN_cmp(coordinator.Decrypt("third", ciphertexts[0]).Get(), messages[0].Get()) == 0);
+
+        bool caught = false;
+        try {
+            coordinator.Decrypt("missing", ciphertext);
+        } catch (const std::invalid_argument&) {
+            caught = true;
+        }
+        assert(caught);
+        caught = false;
+        try {
+            coordinator.Decrypt("first", first.public_key.n);
+        } catch (const std::invalid_argument&) {
+            caught = true;
+        }
+        assert(caught);
+
+        // A corrupted share is caught by the public-key check.
+        std::vector<rsa_app::KeyShare> shares = rsa_app::SplitPrivateKey(second.private_key, 3);
+        BN_add_word(shares[1].d.Get(), 1);
+        rsa_app::ShardConnection(sockets[1])
+            .Call(rsa_app::kShardPutShare, "second", rsa_app::EncodeKeyShare(shares[1]));
+        caught = false;
+        try {
+            coordinator.Decrypt("second", ciphertext);
+        } catch (const std::runtime_error&) {
+            caught = true;
+        }
+        assert(caught);
+        assert(coordinator.Metrics().failures == 3);
+        std::cout << "TestThresholdCoordinatorDecrypts passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestThresholdCoordinatorDecrypts failed with exception: " << e.what()
+                  << std::endl;
+    }
+}
+
+int main() {
+    // Share holders are forked before any test starts a thread.
+    std::vector<std::string> sockets;
+    std::vector<pid_t> holders;
+    try {
+        for (int i = 0; i < 3; ++i) {
+            sockets.push_back(SocketPath(i));
+            holders.push_back(rsa_app::SpawnShardWorker(sockets.back()));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Spawning share holders failed with exception: " << e.what() << std::endl;
+        return 1;
+    }
+
+    TestThresholdSharesCombine();
+    TestThresholdCoordinatorDecrypts(sockets);
+
+    for (const auto& socket : sockets) {
+        try {
+            rsa_app::ShardClient(socket).Shutdown();
+        } catch (const std::exception& e) {
+            std::cerr << "Stopping share holder failed with exception: " << e.what() << std::endl;
+        }
+    }
+    for (pid_t pid : holders) {
+        int status = 0;
+        for (int attempt = 0; waitpid(pid, &status, WNOHANG) == 0; ++attempt) {
+            if (attempt == 500) {
+                std::cerr << "Share holder " << pid << " did not exit" << std::endl;
+                kill(pid, SIGKILL);
+                waitpid(pid, &status, 0);
+                return 1;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    return 0;
+}
@@ -0,0 +1,142 @@
+#include "../src/trace.h"
+#include <unistd.h>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../src/drbg.h"
+#include "../src/rsa.h"
+#include "../src/thread_pool.h"
+
+namespace {
+
+bool Contains(const std::string& text, const std::string& part) {
+    return text.find(part) != std::string::npos;
+}
+
+std::string TraceJson() {
+    std::ostringstream out;
+    rsa_app::WriteTrace(out);
+    return out.str();
+}
+
+}  // namespace
+
+void TestTraceRecordsSpans() {
+    try {
+        rsa_app::StartTracing(1024);
+        rsa_app::StopTracing();
+        { rsa_app::TraceSpan ignored("ignored", "test"); }
+        assert(rsa_app::SummarizeTrace().spans == 0);
+
+        rsa_app::StartTracing(1024);
+        {
+            rsa_app::TraceSpan outer("outer", "test");
+            outer.SetArg(42);
+            rsa_app::ThreadPool pool(2);
+            pool.ParallelFor(8, [](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    rsa_app::TraceSpan inner("inner", "test", static_cast<int64_t>(i));
+                }
+            });
+        }
+        rsa_app::StopTracing();
+        rsa_app::TraceSummary summary = rsa_app::SummarizeTrace();
+        assert(summary.spans >= 9 && summary.dropped == 0);
+        assert(summary.threads >= 2);
+
+        std::string json = TraceJson();
+        assert(json.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0) == 0);
+        assert(Contains(json, "{\"name\":\"outer\",\"cat\":\"test\",\"ph\":\"X\""));
+        assert(Contains(json, "\"args\":{\"value\":42}"));
+        assert(Contains(json, "\"name\":\"inner\""));
+        // The pool reports how long each task waited in its queue.
+        assert(Contains(json, "\"name\":\"queue_wait\""));
+        assert(!Contains(json, "\"name\":\"ignored\""));
+        std::cout << "TestTraceRecordsSpans passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestTraceRecordsSpans failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestTraceRingOverwrites() {
+    try {
+        rsa_app::StartTracing(4);
+        for (int i = 0; i < 10; ++i) rsa_app::TraceSpan span("span", "test", i);
+        rsa_app::TraceSummary summary = rsa_app::SummarizeTrace();
+        assert(summary.spans == 4 && summary.dropped == 6 && summary.threads == 1);
+        // The newest spans survive.
+        std::string json = TraceJson();
+        assert(Contains(json, "\"args\":{\"value\":9}") && !Contains(json, "\"args\":{\"value\":5}"));
+        assert(Contains(json, "\"dropped_spans\":6"));
+
+        // A new session starts empty.
+        rsa_app::StartTracing(4);
+        assert(rsa_app::SummarizeTrace().spans == 0);
+        rsa_app::StopTracing();
+
+        bool caught = false;
+        try {
+            rsa_app::StartTracing(0);
+        } catch (const std::invalid_argument&) {
+            caught = true;
+        }
+        assert(caught && !rsa_app::TracingEnabled());
+        std::cout << "TestTraceRingOverwrites passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestTraceRingOverwrites failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestTraceInstrumentation() {
+    try {
+        rsa_app::StartTracing();
+        rsa_app::KeyPair key_pair = rsa_app::GenerateKeyPair(512, rsa_app::ThreadDrbg());
+        rsa_app::ThreadPool pool(2);
+        std::vector<BigNumber> messages;
+        for (unsigned long i = 1; i <= 4; ++i) {
+            BigNumber message;
+            message.SetWord(i + 1);
+            messages.push_back(std::move(message));
+        }
+        auto ciphertexts = rsa_app::EncryptBatch(messages, key_pair.public_key, pool);
+        auto plaintexts = rsa_app::DecryptBatch(ciphertexts, key_pair.private_key, pool);
+        assert(BN_cmp(plaintexts[3].Get(), messages[3].Get()) == 0);
+        rsa_app::StopTracing();
+
+        std::string path = "/tmp/rsa_trace_test_" + std::to_string(getpid()) + ".json";
+        rsa_app::WriteTrace(path);
+        std::ifstream file(path);
+        std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        for (const char* name : {"GenerateKeyPair", "prime_search", "miller_rabin", "assemble_key",
+                                 "EncryptBatch", "DecryptBatch", "Encrypt", "Decrypt",
+                                 "ParallelFor", "queue_wait"}) {
+            assert(Contains(json, std::string("\"name\":\"") + name + "\""));
+        }
+        assert(Contains(json, "{\"name\":\"GenerateKeyPair\",\"cat\":\"keygen\""));
+        std::remove(path.c_str());
+
+        bool caught = false;
+        try {
+            rsa_app::WriteTrace("/nonexistent/dir/trace.json");
+        } catch (const std::runtime_error&) {
+            caught = true;
+        }
+        assert(caught);
+        std::cout << "TestTraceInstrumentation passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestTraceInstrumentation failed with exception: " << e.what() << std::endl;
+    }
+}
+
+int main() {
+    TestTraceRecordsSpans();
+    TestTraceRingOverwrites();
+    TestTraceInstrumentation();
+    return 0;
+}
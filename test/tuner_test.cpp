@@ -0,0 +1,196 @@
+#include "../src/tuner.h"
+#include <unistd.h>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include "../src/rsa.h"
+
+namespace {
+
+std::string TempPath(const std::string& name) {
+    return "/tmp/rsa_tuner_test_" + std::to_string(getpid()) + "_" + name;
+}
+
+rsa_app::TuningOptions QuickOptions(int bits) {
+    rsa_app::TuningOptions options;
+    options.bits = {bits};
+    options.max_threads = 2;
+    options.max_batch = 16;
+    options.trial_seconds = 0.01;
+    return options;
+}
+
+template <typename Exception, typename Fn>
+bool Throws(Fn fn) {
+    try {
+        fn();
+    } catch (const Exception&) {
+        return true;
+    }
+    return false;
+}
+
+void WriteFile(const std::string& path, const std::string& contents) {
+    std::ofstream file(path, std::ios::trunc);
+    file << contents;
+}
+
+}  // namespace
+
+void TestTunerCalibrates() {
+    try {
+        rsa_app::ModExpBackend backend = rsa_app::ActiveModExpBackend();
+        rsa_app::FixedKernel kernel = rsa_app::ActiveFixedKernel();
+
+        rsa_app::TuningPlan plan = rsa_app::CalibrateKeySize(2048, QuickOptions(2048));
+        assert(plan.bits == 2048);
+        assert(plan.threads == 1 || plan.threads == 2);
+        assert(plan.batch_size >= plan.threads && plan.batch_size <= 16);
+        assert(plan.batch_size % plan.threads == 0);
+        assert(plan.decrypts_per_second > 0 && plan.encrypts_per_second > plan.decrypts_per_second);
+        // Decryption stays constant-time where a fixed kernel exists.
+        if (rsa_app::FixedKernelSupported(rsa_app::FixedKernel::kPortable)) {
+            assert(plan.backend == rsa_app::ModExpBackend::kFixed);
+            assert(rsa_app::FixedKernelSupported(plan.kernel));
+        }
+        // Calibration leaves the process settings alone.
+        assert(rsa_app::ActiveModExpBackend() == backend);
+        assert(rsa_app::ActiveFixedKernel() == kernel);
+
+        // No fixed kernel covers 1024 bits.
+        rsa_app::TuningPlan small = rsa_app::CalibrateKeySize(1024, QuickOptions(1024));
+        assert(small.backend == rsa_app::ModExpBackend::kOpenSsl);
+
+        rsa_app::TuningOptions bad = QuickOptions(1024);
+        bad.trial_seconds = 0;
+        assert(Throws<std::invalid_argument>([&] { rsa_app::CalibrateKeySize(1024, bad); }));
+        std::cout << "TestTunerCalibrates passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestTunerCalibrates failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestTunerProfileRoundTrip() {
+    try {
+        rsa_app::TuningProfile profile;
+        profile.host = "Example CPU @ 3.00GHz x8";
+        rsa_app::TuningPlan plan;
+        plan.bits = 3072;
+        plan.threads = 8;
+        plan.batch_size = 128;
+        plan.backend = rsa_app::ModExpBackend::kFixed;
+        plan.kernel = rsa_app::FixedKernel::kMulxAdx;
+        plan.decrypts_per_second = 812.5;
+        plan.encrypts_per_second = 40100.3;
+        profile.plans.push_back(plan);
+        plan.bits = 1024;
+        plan.backend = rsa_app::ModExpBackend::kOpenSsl;
+        plan.kernel = rsa_app::FixedKernel::kPortable;
+        profile.plans.push_back(plan);
+
+        std::string path = TempPath("profile");
+        rsa_app::SaveTuningProfile(profile, path);
+        rsa_app::TuningProfile loaded = rsa_app::LoadTuningProfile(path);
+        assert(loaded.host == profile.host && loaded.plans.size() == 2);
+        const rsa_app::TuningPlan* found = loaded.Find(3072);
+        assert(found && found->threads == 8 && found->batch_size == 128);
+        assert(found->backend == rsa_app::ModExpBackend::kFixed);
+        assert(found->kernel == rsa_app::FixedKernel::kMulxAdx);
+        assert(found->decrypts_per_second == 812.5);
+        assert(loaded.Find(1024)->backend == rsa_app::ModExpBackend::kOpenSsl);
+        assert(loaded.Find(2048) == nullptr);
+        assert(rsa_app::DescribeTuningPlan(*found) ==
+               "3072-bit: fixed/mulx_adx, 8 threads, batch 128, 812.5 decrypts/s, "
+               "40100.3 encrypts/s");
+
+        assert(Throws<std::runtime_error>([&] { rsa_app::LoadTuningProfile(TempPath("none")); }));
+        const char* malformed[] = {
+            "not a profile\nhost x\n",
+            "rsa_app tuning v1\nplan bits=2048 threads=1 batch=1 backend=fixed kernel=portable "
+            "decrypts_per_second=1 encrypts_per_second=1\n",
+            "rsa_app tuning v1\nhost x\nplan bits=2048 threads=1 batch=1 backend=fixed "
+            "kernel=portable decrypts_per_second=1\n",
+            "rsa_app tuning v1\nhost x\nplan bits=2048 threads=0 batch=1 backend=fixed "
+            "kernel=portable decrypts_per_second=1 encrypts_per_second=1\n",
+            "rsa_app tuning v1\nhost x\nplan bits=2048 threads=1 batch=1 backend=gpu "
+            "kernel=portable decrypts_per_second=1 encrypts_per_second=1\n",
+            "rsa_app tuning v1\nhost x\nplan bits=abc threads=1 batch=1 backend=fixed "
+            "kernel=portable decrypts_per_second=1 encrypts_per_second=1\n",
+            "rsa_app tuning v1\nhost x\nplan bits=2048 threads=-1 batch=1 backend=fixed "
+            "kernel=portable decrypts_per_second=1 encrypts_per_second=1\n",
+            "rsa_app tuning v1\nhost x\nplan bits=2048 threads=1 batch=1e30 backend=fixed "
+            "kernel=portable decrypts_per_second=1 encrypts_per_second=1\n",
+            "rsa_app tuning v1\nhost x\nplan bits=99999999999 threads=1 batch=1 backend=fixed "
+            "kernel=portable decrypts_per_second=1 encrypts_per_second=1\n",
+            "rsa_app tuning v1\nhost x\nthreads 4\n"};
+        for (const char* contents : malformed) {
+            WriteFile(path, contents);
+            assert(Throws<std::invalid_argument>([&] { rsa_app::LoadTuningProfile(path); }));
+        }
+        std::remove(path.c_str());
+        std::cout << "TestTunerProfileRoundTrip passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestTunerProfileRoundTrip failed with exception: " << e.what() << std::endl;
+    }
+}
+
+void TestTunerLoadOrCalibrate() {
+    try {
+        std::string path = TempPath("cached");
+        rsa_app::TuningOptions options = QuickOptions(1024);
+        bool calibrated = false;
+        rsa_app::TuningPlan first = rsa_app::LoadOrCalibrate(path, 1024, options, &calibrated);
+        assert(calibrated);
+        rsa_app::TuningPlan second = rsa_app::LoadOrCalibrate(path, 1024, options, &calibrated);
+        assert(!calibrated);
+        assert(second.threads == first.threads && second.batch_size == first.batch_size);
+
+        // A new size is added next to the cached one.
+        rsa_app::LoadOrCalibrate(path, 1536, options, &calibrated);
+        assert(calibrated);
+        rsa_app::TuningProfile profile = rsa_app::LoadTuningProfile(path);
+        assert(profile.host == rsa_app::HostSignature());
+        assert(profile.plans.size() == 2 && profile.plans[0].bits == 1024);
+
+        // A profile from other hardware is replaced.
+        profile.host = "other hardware";
+        rsa_app::SaveTuningProfile(profile, path);
+        rsa_app::LoadOrCalibrate(path, 1024, options, &calibrated);
+        assert(calibrated);
+        profile = rsa_app::LoadTuningProfile(path);
+        assert(profile.host == rsa_app::HostSignature() && profile.plans.size() == 1);
+
+        // So is an unreadable one.
+        WriteFile(path, "garbage\n");
+        rsa_app::LoadOrCalibrate(path, 1024, options, &calibrated);
+        assert(calibrated && rsa_app::LoadTuningProfile(path).plans.size() == 1);
+        std::remove(path.c_str());
+
+        // Applying a plan switches the process-wide kernel.
+        rsa_app::ModExpBackend backend = rsa_app::ActiveModExpBackend();
+        rsa_app::FixedKernel kernel = rsa_app::ActiveFixedKernel();
+        rsa_app::TuningPlan plan;
+        plan.backend = rsa_app::ModExpBackend::kOpenSsl;
+        plan.kernel = rsa_app::FixedKernel::kPortable;
+        rsa_app::ApplyTuningPlan(plan);
+        assert(rsa_app::ActiveModExpBackend() == rsa_app::ModExpBackend::kOpenSsl);
+        if (rsa_app::FixedKernelSupported(rsa_app::FixedKernel::kPortable)) {
+            assert(rsa_app::ActiveFixedKernel() == rsa_app::FixedKernel::kPortable);
+        }
+        rsa_app::SetModExpBackend(backend);
+        rsa_app::SetFixedKernel(kernel);
+        std::cout << "TestTunerLoadOrCalibrate passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "TestTunerLoadOrCalibrate failed with exception: " << e.what() << std::endl;
+    }
+}
+
+int main() {
+    TestTunerCalibrates();
+    TestTunerProfileRoundTrip();
+    TestTunerLoadOrCalibrate();
+    return 0;
+}